@@ -1032,7 +1032,7 @@ struct CxxrtlWorker {
 			return dump_sigchunk(sig.as_chunk(), is_lhs, for_debug);
 		} else {
 			bool first = true;
-			auto chunks = sig.chunks();
+			std::vector<RTLIL::SigChunk> chunks = sig.chunks();
 			for (auto it = chunks.rbegin(); it != chunks.rend(); it++) {
 				if (!first)
 					f << ".concat(";
@@ -31,6 +31,8 @@
 #include "libs/sha1/sha1.h"
 #include "ast.h"
 
+#include <atomic>
+
 YOSYS_NAMESPACE_BEGIN
 
 using namespace AST;
@@ -39,23 +41,24 @@ using namespace AST_INTERNAL;
 // instantiate global variables (public API)
 namespace AST {
 	bool sv_mode_but_global_and_used_for_literally_one_condition;
-	unsigned long long astnodes = 0;
+	std::atomic<unsigned long long> astnodes(0);
 	unsigned long long astnode_count() { return astnodes; }
 }
 
-// instantiate global variables (private API)
+// instantiate global variables (private API), these are per thread so that
+// modules can be derived concurrently (see `hierarchy -j`)
 namespace AST_INTERNAL {
-	bool flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches, flag_nomeminit;
-	bool flag_nomem2reg, flag_mem2reg, flag_noblackbox, flag_lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_autowire;
-	AstNode *current_ast, *current_ast_mod;
-	std::map<std::string, AstNode*> current_scope;
-	const dict<RTLIL::SigBit, RTLIL::SigBit> *genRTLIL_subst_ptr = NULL;
-	RTLIL::SigSpec ignoreThisSignalsInInitial;
-	AstNode *current_always, *current_top_block, *current_block, *current_block_child;
-	Module *current_module;
-	bool current_always_clocked;
-	dict<std::string, int> current_memwr_count;
-	dict<std::string, pool<int>> current_memwr_visible;
+	thread_local bool flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches, flag_nomeminit;
+	thread_local bool flag_nomem2reg, flag_mem2reg, flag_noblackbox, flag_lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_autowire;
+	thread_local AstNode *current_ast, *current_ast_mod;
+	thread_local std::map<std::string, AstNode*> current_scope;
+	thread_local const dict<RTLIL::SigBit, RTLIL::SigBit> *genRTLIL_subst_ptr = NULL;
+	thread_local RTLIL::SigSpec ignoreThisSignalsInInitial;
+	thread_local AstNode *current_always, *current_top_block, *current_block, *current_block_child;
+	thread_local Module *current_module;
+	thread_local bool current_always_clocked;
+	thread_local dict<std::string, int> current_memwr_count;
+	thread_local dict<std::string, pool<int>> current_memwr_visible;
 }
 
 // convert node types to string
@@ -203,9 +206,10 @@ bool AstNode::get_bool_attribute(RTLIL::IdString id)
 AstNode::AstNode(AstSrcLocType loc, AstNodeType type, std::unique_ptr<AstNode> child1, std::unique_ptr<AstNode> child2, std::unique_ptr<AstNode> child3, std::unique_ptr<AstNode> child4)
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
-	astnodes++;
+	unsigned int &counter = hashidx_local ? *hashidx_local : hashidx_count;
+	counter = mkhash_xorshift(counter);
+	hashidx_ = counter;
+	astnodes.fetch_add(1, std::memory_order_relaxed);
 
 	this->type = type;
 	location = loc;
@@ -249,6 +253,52 @@ AstNode::AstNode(AstSrcLocType loc, AstNodeType type, std::unique_ptr<AstNode> c
 	fixup_hierarchy_flags();
 }
 
+// copy the content of a node and (recursively) its children and attributes,
+// the hierarchy flags of the copy are set by the caller
+static void copy_node_content(const AstNode &from, AstNode &to)
+{
+	to.type = from.type;
+	to.str = from.str;
+	to.bits = from.bits;
+	to.is_input = from.is_input;
+	to.is_output = from.is_output;
+	to.is_reg = from.is_reg;
+	to.is_logic = from.is_logic;
+	to.is_signed = from.is_signed;
+	to.is_string = from.is_string;
+	to.is_wand = from.is_wand;
+	to.is_wor = from.is_wor;
+	to.range_valid = from.range_valid;
+	to.range_swapped = from.range_swapped;
+	to.was_checked = from.was_checked;
+	to.is_unsized = from.is_unsized;
+	to.is_custom_type = from.is_custom_type;
+	to.port_id = from.port_id,
+	to.range_left = from.range_left,
+	to.range_right = from.range_right;
+	to.integer = from.integer;
+	to.realvalue = from.realvalue;
+	to.is_enum = from.is_enum;
+	to.dimensions = from.dimensions;
+	to.unpacked_dimensions = from.unpacked_dimensions;
+	to.id2ast = from.id2ast;
+	to.basic_prep = from.basic_prep;
+	to.lookahead = from.lookahead;
+	to.in_lvalue = from.in_lvalue;
+	to.in_param = from.in_param;
+
+	auto copy = [](const AstNode &node) {
+		auto that = std::make_unique<AstNode>(node.location, node.type);
+		copy_node_content(node, *that);
+		return that;
+	};
+	to.children.reserve(from.children.size());
+	for (auto &child : from.children)
+		to.children.push_back(copy(*child));
+	for (auto &[key, val] : from.attributes)
+		to.attributes.emplace_hint(to.attributes.end(), key, copy(*val));
+}
+
 // create a (deep recursive) copy of a node
 std::unique_ptr<AstNode> AstNode::clone() const
 {
@@ -260,45 +310,12 @@ std::unique_ptr<AstNode> AstNode::clone() const
 // create a (deep recursive) copy of a node use 'other' as target root node
 void AstNode::cloneInto(AstNode &other) const
 {
-	other.type = type;
-	other.str = str;
-	other.bits = bits;
-	other.is_input = is_input;
-	other.is_output = is_output;
-	other.is_reg = is_reg;
-	other.is_logic = is_logic;
-	other.is_signed = is_signed;
-	other.is_string = is_string;
-	other.is_wand = is_wand;
-	other.is_wor = is_wor;
-	other.range_valid = range_valid;
-	other.range_swapped = range_swapped;
-	other.was_checked = was_checked;
-	other.is_unsized = is_unsized;
-	other.is_custom_type = is_custom_type;
-	other.port_id = port_id,
-	other.range_left = range_left,
-	other.range_right = range_right;
-	other.integer = integer;
-	other.realvalue = realvalue;
-	other.is_enum = is_enum;
-	other.dimensions = dimensions;
-	other.unpacked_dimensions = unpacked_dimensions;
-	other.id2ast = id2ast;
-	other.basic_prep = basic_prep;
-	other.lookahead = lookahead;
-	other.location = location;
-	other.in_lvalue = in_lvalue;
-	other.in_param = in_param;
-	// Keep in_lvalue_from_above and in_param_from_above untouched
-
 	other.delete_children();
-	for (auto& child : this->children)
-		other.children.push_back(child->clone());
-	for (auto& [key, val] : this->attributes)
-		other.attributes[key] = (val->clone());
-	 // fixup to set flags on cloned children
-	other.fixup_hierarchy_flags();
+	copy_node_content(*this, other);
+	other.location = location;
+	// Keep in_lvalue_from_above and in_param_from_above untouched, and set
+	// the flags of all copied nodes in one pass from the top
+	other.fixup_hierarchy_flags(true);
 }
 
 // delete all children in this node
@@ -311,7 +328,7 @@ void AstNode::delete_children()
 // AstNode destructor
 AstNode::~AstNode()
 {
-	astnodes--;
+	astnodes.fetch_sub(1, std::memory_order_relaxed);
 	delete_children();
 }
 
@@ -922,7 +939,7 @@ std::unique_ptr<AstNode> AstNode::mktemp_logic(AstSrcLocType loc, const std::str
 {
 	auto wire_owned = std::make_unique<AstNode>(loc, AST_WIRE, std::make_unique<AstNode>(loc, AST_RANGE, mkconst_int(loc, range_left, true), mkconst_int(loc, range_right, true)));
 	auto* wire = wire_owned.get();
-	wire->str = stringf("%s%s:%d$%d", name, RTLIL::encode_filename(*location.begin.filename), location.begin.line, autoidx++);
+	wire->str = stringf("%s%s:%d$%d", name, RTLIL::encode_filename(*location.begin.filename), location.begin.line, next_autoidx());
 	if (nosync)
 		wire->set_attribute(ID::nosync, AstNode::mkconst_int(loc, 1, false));
 	wire->is_signed = is_signed;
@@ -1104,7 +1121,9 @@ static bool param_has_no_default(const AstNode* param) {
 		(children.size() == 1 && children[0]->type == AST_RANGE);
 }
 
-static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool defer, std::unique_ptr<AstNode> original_ast = NULL, bool quiet = false)
+// unless add_to_design is false, in which case the design is only read and
+// the new module is returned without adding it
+static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool defer, std::unique_ptr<AstNode> original_ast = NULL, bool quiet = false, bool add_to_design = true)
 {
 	log_assert(current_scope.empty());
 	log_assert(ast->type == AST_MODULE || ast->type == AST_INTERFACE);
@@ -1141,8 +1160,19 @@ static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool d
 		log("--- END OF AST DUMP ---\n");
 	}
 
-	if (!defer)
+	std::string cache_key;
+	if (!defer && !elab_cache_dir.empty() && !flag_dump_ast2 && !flag_dump_vlog2)
+		cache_key = elab_cache_key(ast);
+
+	if (!cache_key.empty() && elab_cache_load(module, cache_key))
+	{
+		// generated RTLIL loaded from the cache
+	}
+	else if (!defer)
 	{
+		int autoidx_before = autoidx_local ? *autoidx_local : autoidx;
+		elab_context_dependent = false;
+
 		for (auto& node : ast->children)
 			if (node->type == AST_PARAMETER && param_has_no_default(node.get()))
 				node->input_error("Parameter `%s' has no default value and has not been overridden!\n", node->str);
@@ -1282,6 +1312,9 @@ static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool d
 
 		ignoreThisSignalsInInitial = RTLIL::SigSpec();
 		current_scope.clear();
+
+		if (!cache_key.empty() && !elab_context_dependent)
+			elab_cache_store(module, cache_key, (autoidx_local ? *autoidx_local : autoidx) - autoidx_before);
 	}
 	else {
 		for (auto &attr : ast->attributes) {
@@ -1308,6 +1341,7 @@ static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool d
 	module->icells = flag_icells;
 	module->pwires = flag_pwires;
 	module->autowire = flag_autowire;
+	module->cache_dir = elab_cache_dir;
 	module->fixup_ports();
 
 	if (flag_dump_rtlil) {
@@ -1316,7 +1350,8 @@ static RTLIL::Module *process_module(RTLIL::Design *design, AstNode *ast, bool d
 		log("--- END OF RTLIL DUMP ---\n");
 	}
 
-	design->add(current_module);
+	if (add_to_design)
+		design->add(current_module);
 	return current_module;
 }
 
@@ -1376,7 +1411,8 @@ static void rename_in_package_stmts(AstNode *pkg)
 
 // create AstModule instances for all modules in the AST tree and add them to 'design'
 void AST::process(RTLIL::Design *design, AstNode *ast, bool nodisplay, bool dump_ast1, bool dump_ast2, bool no_dump_ptr, bool dump_vlog1, bool dump_vlog2, bool dump_rtlil,
-		bool nolatches, bool nomeminit, bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire)
+		bool nolatches, bool nomeminit, bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire,
+		const std::string &cache_dir)
 {
 	current_ast = ast;
 	current_ast_mod = nullptr;
@@ -1398,6 +1434,7 @@ void AST::process(RTLIL::Design *design, AstNode *ast, bool nodisplay, bool dump
 	flag_icells = icells;
 	flag_pwires = pwires;
 	flag_autowire = autowire;
+	elab_cache_dir = cache_dir;
 
 	ast->fixup_hierarchy_flags(true);
 
@@ -1758,6 +1795,34 @@ RTLIL::IdString AstModule::derive(RTLIL::Design *design, const dict<RTLIL::IdStr
 	return modname;
 }
 
+// set up deriving a module on another thread, for `hierarchy -j`
+RTLIL::IdString AstModule::derive_job(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::function<RTLIL::Module*()> &job)
+{
+	std::string modname = derived_name(parameters, true);
+	if (design->has(modname))
+		return modname;
+
+	// derive() uses these flags as they were left by the last frontend call,
+	// they are per thread and have to be passed on to the job
+	bool quiet = lib || attributes.count(ID::blackbox) || attributes.count(ID::whitebox);
+	bool nodisplay = flag_nodisplay, no_dump_ptr = flag_no_dump_ptr, dump_rtlil = flag_dump_rtlil;
+
+	job = [this, design, parameters, quiet, nodisplay, no_dump_ptr, dump_rtlil]() -> RTLIL::Module* {
+		flag_nodisplay = nodisplay;
+		flag_no_dump_ptr = no_dump_ptr;
+		flag_dump_rtlil = dump_rtlil;
+
+		std::unique_ptr<AstNode> new_ast = NULL;
+		std::string modname = derive_common(design, parameters, &new_ast, quiet);
+		log_assert(new_ast != nullptr);
+		new_ast->str = modname;
+		RTLIL::Module *module = process_module(design, new_ast.get(), false, NULL, quiet, false);
+		module->check();
+		return module;
+	};
+	return modname;
+}
+
 static std::string serialize_param_value(const RTLIL::Const &val) {
 	std::string res;
 	if (val.flags & RTLIL::ConstFlags::CONST_FLAG_STRING)
@@ -1783,12 +1848,10 @@ std::string AST::derived_module_name(std::string stripped_name, const std::vecto
 		return "$paramod" + stripped_name + para_info;
 }
 
-// create a new parametric module (when needed) and return the name of the generated module
-std::string AstModule::derive_common(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::unique_ptr<AstNode>* new_ast_out, bool quiet)
+// the name of the module derived with the given parameters
+std::string AstModule::derived_name(const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool quiet)
 {
 	std::string stripped_name = name.str();
-	(*new_ast_out) = nullptr;
-
 	if (stripped_name.compare(0, 9, "$abstract") == 0)
 		stripped_name = stripped_name.substr(9);
 
@@ -1814,10 +1877,21 @@ std::string AstModule::derive_common(RTLIL::Design *design, const dict<RTLIL::Id
 		}
 	}
 
-	std::string modname = stripped_name;
 	if (parameters.size()) // not named_parameters to cover hierarchical defparams
-		modname = derived_module_name(stripped_name, named_parameters);
+		return derived_module_name(stripped_name, named_parameters);
+	return stripped_name;
+}
 
+// create a new parametric module (when needed) and return the name of the generated module
+std::string AstModule::derive_common(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::unique_ptr<AstNode>* new_ast_out, bool quiet)
+{
+	std::string stripped_name = name.str();
+	(*new_ast_out) = nullptr;
+
+	if (stripped_name.compare(0, 9, "$abstract") == 0)
+		stripped_name = stripped_name.substr(9);
+
+	std::string modname = derived_name(parameters, quiet);
 	if (design->has(modname))
 		return modname;
 
@@ -1833,7 +1907,7 @@ std::string AstModule::derive_common(RTLIL::Design *design, const dict<RTLIL::Id
 	if (!new_ast->attributes.count(ID::hdlname))
 		new_ast->set_attribute(ID::hdlname, AstNode::mkconst_str(loc, stripped_name.substr(1)));
 
-	para_counter = 0;
+	int para_counter = 0;
 	for (auto& child : new_ast->children) {
 		if (child->type != AST_PARAMETER)
 			continue;
@@ -1900,6 +1974,7 @@ RTLIL::Module *AstModule::clone() const
 	new_mod->icells = icells;
 	new_mod->pwires = pwires;
 	new_mod->autowire = autowire;
+	new_mod->cache_dir = cache_dir;
 
 	return new_mod;
 }
@@ -1922,6 +1997,7 @@ void AstModule::loadconfig() const
 	flag_icells = icells;
 	flag_pwires = pwires;
 	flag_autowire = autowire;
+	elab_cache_dir = cache_dir;
 }
 
 void AstNode::formatted_input_error(std::string str) const
@@ -187,14 +187,32 @@ namespace AST
 		bool get_bool_attribute(RTLIL::IdString id);
 
 		// node content - most of it is unused in most node types
+		// (the members are grouped by size so that there is no padding between
+		// them, there can be many millions of nodes)
 		std::string str;
 		std::vector<RTLIL::State> bits;
 		bool is_input, is_output, is_reg, is_logic, is_signed, is_string, is_wand, is_wor, range_valid, range_swapped, was_checked, is_unsized, is_custom_type;
+		// set for IDs typed to an enumeration, not used
+		bool is_enum;
+
+		// this is used by simplify to detect if basic analysis has been performed already on the node
+		bool basic_prep;
+
+		// this is used for ID references in RHS expressions that should use the "new" value for non-blocking assignments
+		bool lookahead;
+
+		// are we embedded in an lvalue, param?
+		// (see fixup_hierarchy_flags)
+		bool in_lvalue;
+		bool in_param;
+		bool in_lvalue_from_above;
+		bool in_param_from_above;
+
 		int port_id, range_left, range_right;
 		uint32_t integer;
+		// Number of unpacked dimensions in `dimensions`.
+		int unpacked_dimensions;
 		double realvalue;
-		// set for IDs typed to an enumeration, not used
-		bool is_enum;
 
 		// Declared range for array dimension.
 		struct dimension_t {
@@ -205,30 +223,15 @@ namespace AST
 		// Packed and unpacked dimensions for arrays.
 		// Unpacked dimensions go first, to follow the order of indexing.
 		std::vector<dimension_t> dimensions;
-		// Number of unpacked dimensions.
-		int unpacked_dimensions;
 
 		// this is set by simplify and used during RTLIL generation
 		AstNode* id2ast;
 
-		// this is used by simplify to detect if basic analysis has been performed already on the node
-		bool basic_prep;
-
-		// this is used for ID references in RHS expressions that should use the "new" value for non-blocking assignments
-		bool lookahead;
-
 		// this is the original sourcecode location that resulted in this AST node
 		// it is automatically set by the constructor using AST::current_filename and
 		// the AST::get_line_num() callback function.
 		AstSrcLocType location;
 
-		// are we embedded in an lvalue, param?
-		// (see fixup_hierarchy_flags)
-		bool in_lvalue;
-		bool in_param;
-		bool in_lvalue_from_above;
-		bool in_param_from_above;
-
 		// creating and deleting nodes
 		AstNode(AstSrcLocType loc, AstNodeType type = AST_NONE, std::unique_ptr<AstNode> child1 = nullptr, std::unique_ptr<AstNode> child2 = nullptr, std::unique_ptr<AstNode> child3 = nullptr, std::unique_ptr<AstNode> child4 = nullptr);
 		std::unique_ptr<AstNode> clone() const;
@@ -283,7 +286,7 @@ namespace AST
 			bool explicitly_sized;
 		};
 		bool has_const_only_constructs();
-		bool replace_variables(std::map<std::string, varinfo_t> &variables, AstNode *fcall, bool must_succeed);
+		bool replace_variables(dict<std::string, varinfo_t> &variables, AstNode *fcall, bool must_succeed);
 		std::unique_ptr<AstNode> eval_const_function(AstNode *fcall, bool must_succeed);
 		bool is_simple_const_expr();
 
@@ -388,15 +391,19 @@ namespace AST
 
 	// process an AST tree (ast must point to an AST_DESIGN node) and generate RTLIL code
 	void process(RTLIL::Design *design, AstNode *ast, bool nodisplay, bool dump_ast1, bool dump_ast2, bool no_dump_ptr, bool dump_vlog1, bool dump_vlog2, bool dump_rtlil, bool nolatches, bool nomeminit,
-			bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire);
+			bool nomem2reg, bool mem2reg, bool noblackbox, bool lib, bool nowb, bool noopt, bool icells, bool pwires, bool nooverwrite, bool overwrite, bool defer, bool autowire,
+			const std::string &elab_cache_dir);
 
 	// parametric modules are supported directly by the AST library
 	// therefore we need our own derivate of RTLIL::Module with overloaded virtual functions
 	struct AstModule : RTLIL::Module {
 		std::unique_ptr<AstNode> ast;
 		bool nolatches, nomeminit, nomem2reg, mem2reg, noblackbox, lib, nowb, noopt, icells, pwires, autowire;
+		std::string cache_dir;
 		RTLIL::IdString derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool mayfail) override;
 		RTLIL::IdString derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, const dict<RTLIL::IdString, RTLIL::Module*> &interfaces, const dict<RTLIL::IdString, RTLIL::IdString> &modports, bool mayfail) override;
+		RTLIL::IdString derive_job(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::function<RTLIL::Module*()> &job) override;
+		std::string derived_name(const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool quiet = false);
 		std::string derive_common(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::unique_ptr<AstNode>* new_ast_out, bool quiet = false);
 		void expand_interfaces(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Module *> &local_interfaces) override;
 		bool reprocess_if_necessary(RTLIL::Design *design) override;
@@ -440,21 +447,30 @@ namespace AST
 
 namespace AST_INTERNAL
 {
-	// internal state variables
-	extern bool flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_rtlil, flag_nolatches, flag_nomeminit;
-	extern bool flag_nomem2reg, flag_mem2reg, flag_lib, flag_noopt, flag_icells, flag_pwires, flag_autowire;
-	extern AST::AstNode *current_ast, *current_ast_mod;
-	extern std::map<std::string, AST::AstNode*> current_scope;
-	extern const dict<RTLIL::SigBit, RTLIL::SigBit> *genRTLIL_subst_ptr;
-	extern RTLIL::SigSpec ignoreThisSignalsInInitial;
-	extern AST::AstNode *current_always, *current_top_block, *current_block, *current_block_child;
-	extern RTLIL::Module *current_module;
-	extern bool current_always_clocked;
-	extern dict<std::string, int> current_memwr_count;
-	extern dict<std::string, pool<int>> current_memwr_visible;
+	// internal state variables, per thread
+	extern thread_local bool flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_rtlil, flag_nolatches, flag_nomeminit;
+	extern thread_local bool flag_nomem2reg, flag_mem2reg, flag_noblackbox, flag_lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_autowire;
+	extern thread_local AST::AstNode *current_ast, *current_ast_mod;
+	extern thread_local std::map<std::string, AST::AstNode*> current_scope;
+	extern thread_local const dict<RTLIL::SigBit, RTLIL::SigBit> *genRTLIL_subst_ptr;
+	extern thread_local RTLIL::SigSpec ignoreThisSignalsInInitial;
+	extern thread_local AST::AstNode *current_always, *current_top_block, *current_block, *current_block_child;
+	extern thread_local RTLIL::Module *current_module;
+	extern thread_local bool current_always_clocked;
+	extern thread_local dict<std::string, int> current_memwr_count;
+	extern thread_local dict<std::string, pool<int>> current_memwr_visible;
 	struct LookaheadRewriter;
 	struct ProcessGenerator;
 
+	// on-disk cache of generated RTLIL (see elab_cache.cc), enabled when
+	// elab_cache_dir is set; simplify() sets elab_context_dependent when the
+	// result depends on more than the module's AST and may not be cached
+	extern thread_local std::string elab_cache_dir;
+	extern thread_local bool elab_context_dependent;
+	std::string elab_cache_key(const AST::AstNode *ast);
+	bool elab_cache_load(RTLIL::Module *module, const std::string &key);
+	void elab_cache_store(RTLIL::Module *module, const std::string &key, int num_autoidx);
+
 	// Create and add a new AstModule from new_ast, then use it to replace
 	// old_module in design, renaming old_module to move it out of the way.
 	// Return the new module.
@@ -0,0 +1,165 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  On-disk cache for the RTLIL generated from a module's AST (see the -cache
+ *  option of read_verilog). A cache entry is keyed by a hash of everything
+ *  process_module() gets to see: the module's AST before simplification
+ *  (which already has the parameter values of a derived module and the
+ *  effect of `define macros baked in), the frontend options and the yosys
+ *  version. Elaborations that looked at anything outside of this, like other
+ *  modules in the design or memory initialization files, are not stored.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "libs/sha1/sha1.h"
+#include "backends/rtlil/rtlil_backend.h"
+#include "frontends/rtlil/rtlil_frontend.h"
+#include "ast.h"
+
+#include <mutex>
+
+YOSYS_NAMESPACE_BEGIN
+
+using namespace AST;
+using namespace AST_INTERNAL;
+
+namespace AST_INTERNAL {
+	thread_local std::string elab_cache_dir;
+	thread_local bool elab_context_dependent;
+}
+
+// serializes the temporary file handling in elab_cache_store() when modules
+// are derived concurrently
+static std::mutex elab_cache_mutex;
+
+static void fingerprint(const AstNode *node, std::string &out)
+{
+	if (node == nullptr) {
+		out += "-\n";
+		return;
+	}
+
+	out += stringf("%d %s %zu:%s", node->type, node->loc_string(), node->str.size(), node->str);
+	out += stringf(" %d%d%d%d%d%d%d%d%d%d%d%d%d", node->is_input, node->is_output, node->is_reg, node->is_logic, node->is_signed,
+			node->is_string, node->is_wand, node->is_wor, node->range_valid, node->range_swapped, node->is_unsized,
+			node->is_custom_type, node->is_enum);
+	out += stringf(" %d %d %d %u %a %d", node->port_id, node->range_left, node->range_right, node->integer, node->realvalue,
+			node->unpacked_dimensions);
+	for (auto &dim : node->dimensions)
+		out += stringf(" [%d+:%d%s]", dim.range_right, dim.range_width, dim.range_swapped ? "s" : "");
+	out += " '";
+	for (auto bit : node->bits)
+		out += "01xz-m"[bit];
+	out += stringf("' %zu %zu\n", node->attributes.size(), node->children.size());
+
+	for (auto &it : node->attributes) {
+		out += it.first.str() + "\n";
+		fingerprint(it.second.get(), out);
+	}
+	for (auto &child : node->children)
+		fingerprint(child.get(), out);
+}
+
+std::string AST_INTERNAL::elab_cache_key(const AstNode *ast)
+{
+	std::string data = stringf("%s\n", yosys_version_str);
+	for (bool flag : {flag_nolatches, flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, flag_lib, flag_nowb,
+			flag_noopt, flag_icells, flag_pwires, flag_autowire, sv_mode_but_global_and_used_for_literally_one_condition})
+		data += flag ? '1' : '0';
+	data += "\n";
+
+	fingerprint(ast, data);
+
+	// packages in the same file can be imported by name
+	if (current_ast != nullptr)
+		for (auto &child : current_ast->children)
+			if (child->type == AST_PACKAGE)
+				fingerprint(child.get(), data);
+
+	return sha1(data);
+}
+
+static std::string elab_cache_filename(const std::string &key)
+{
+	return elab_cache_dir + "/" + key + ".il";
+}
+
+bool AST_INTERNAL::elab_cache_load(RTLIL::Module *module, const std::string &key)
+{
+	std::string filename = elab_cache_filename(key);
+	std::ifstream f(filename);
+	if (f.fail())
+		return false;
+
+	// the first line records how many auto-generated names generating the
+	// module used up, so that the names created afterwards are the same as
+	// without the cache
+	std::string header;
+	int num_autoidx = 0;
+	std::getline(f, header);
+	if (sscanf(header.c_str(), "# elaboration cache entry, autoidx +%d", &num_autoidx) != 1)
+		return false;
+
+	std::stringstream text;
+	text << f.rdbuf();
+	std::string rtlil = text.str();
+
+	// a broken entry (e.g. from a different Yosys version) is a cache miss
+	RTLIL::Design cached;
+	std::string error;
+	if (!RTLIL_FRONTEND::try_parse_text(&cached, rtlil.data(), rtlil.data() + rtlil.size(), error)) {
+		log_warning("Ignoring elaboration cache entry `%s': %s", filename, error);
+		return false;
+	}
+	RTLIL::Module *cached_module = cached.module(module->name);
+	if (GetSize(cached.modules()) != 1 || cached_module == nullptr) {
+		log_warning("Ignoring elaboration cache entry `%s', which doesn't hold module %s.\n", filename, log_id(module->name));
+		return false;
+	}
+	cached_module->cloneInto(module);
+
+	if (autoidx_local)
+		*autoidx_local += num_autoidx;
+	else
+		autoidx += num_autoidx;
+
+	log("Using cached RTLIL representation from `%s'.\n", filename);
+	return true;
+}
+
+void AST_INTERNAL::elab_cache_store(RTLIL::Module *module, const std::string &key, int num_autoidx)
+{
+	std::ostringstream buffer;
+	buffer << stringf("# elaboration cache entry, autoidx +%d\n", num_autoidx);
+	RTLIL_BACKEND::dump_module(buffer, "", module, nullptr, false);
+
+	// write to a temporary file first, so that concurrent runs never read
+	// a partially written entry
+	std::lock_guard<std::mutex> lock(elab_cache_mutex);
+	std::string filename = elab_cache_filename(key);
+	std::string temp_filename = make_temp_file(elab_cache_dir + "/.tmp_XXXXXX");
+	std::ofstream f(temp_filename, std::ofstream::trunc);
+	f << buffer.str();
+	f.close();
+	if (f.fail() || rename(temp_filename.c_str(), filename.c_str()) != 0) {
+		log_warning("Failed to write elaboration cache entry `%s'.\n", filename);
+		remove(temp_filename.c_str());
+	}
+}
+
+YOSYS_NAMESPACE_END
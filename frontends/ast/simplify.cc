@@ -593,7 +593,7 @@ static std::string prefix_id(const std::string &prefix, const std::string &str)
 }
 
 // direct access to this global should be limited to the following two functions
-static const RTLIL::Design *simplify_design_context = nullptr;
+static thread_local const RTLIL::Design *simplify_design_context = nullptr;
 
 void AST::set_simplify_design_context(const RTLIL::Design *design)
 {
@@ -611,6 +611,9 @@ const RTLIL::Module* AstNode::lookup_cell_module()
 {
 	log_assert(type == AST_CELL);
 
+	// the result depends on what else is in the design
+	elab_context_dependent = true;
+
 	auto reprocess_after = [this] (const std::string &modname) {
 		if (!attributes.count(ID::reprocess_after))
 			set_attribute(ID::reprocess_after, AstNode::mkconst_str(location, modname));
@@ -888,6 +891,150 @@ static void check_auto_nosync(AstNode *node)
 		check_auto_nosync(child.get());
 }
 
+// Results of constant function calls. The result of evaluating a function
+// only depends on its body, on the functions it calls, on the values of the
+// parameters they refer to and on the arguments, so it can be reused for
+// calls with a key made of these, e.g. from other iterations of a generate
+// loop or from another module derived from the same parametric module.
+static thread_local dict<std::string, std::pair<std::vector<RTLIL::State>, bool>> const_function_cache;
+
+template<typename T>
+static void key_append(std::string &key, const T &value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static void key_append_node(std::string &key, const AstNode *node)
+{
+	key_append(key, node->type);
+	key_append(key, node->str.size());
+	key += node->str;
+	key_append(key, node->bits.size());
+	key.append(reinterpret_cast<const char*>(node->bits.data()), node->bits.size());
+	uint32_t flags = node->is_input | node->is_output << 1 | node->is_reg << 2 | node->is_logic << 3 | node->is_signed << 4 |
+			node->is_string << 5 | node->is_wand << 6 | node->is_wor << 7 | node->range_valid << 8 | node->range_swapped << 9 |
+			node->is_unsized << 10 | node->is_custom_type << 11 | node->is_enum << 12;
+	key_append(key, flags);
+	key_append(key, node->port_id);
+	key_append(key, node->range_left);
+	key_append(key, node->range_right);
+	key_append(key, node->integer);
+	key_append(key, node->realvalue);
+	key_append(key, node->unpacked_dimensions);
+	for (auto &dim : node->dimensions) {
+		key_append(key, dim.range_right);
+		key_append(key, dim.range_width);
+		key_append(key, dim.range_swapped);
+	}
+	key_append(key, node->dimensions.size());
+	key_append(key, node->attributes.size());
+	key_append(key, node->children.size());
+}
+
+static void key_append_tree(std::string &key, const AstNode *node)
+{
+	key_append_node(key, node);
+	for (auto &it : node->attributes) {
+		key_append(key, it.first.size());
+		key += it.first.str();
+		key_append_tree(key, it.second.get());
+	}
+	for (auto &child : node->children)
+		key_append_tree(key, child.get());
+}
+
+static bool is_pure_system_function(const std::string &name)
+{
+	static const pool<std::string> pure_functions = {
+		"\\$clog2", "\\$ln", "\\$log10", "\\$exp", "\\$sqrt", "\\$pow", "\\$floor", "\\$ceil",
+		"\\$sin", "\\$cos", "\\$tan", "\\$asin", "\\$acos", "\\$atan", "\\$atan2", "\\$hypot",
+		"\\$sinh", "\\$cosh", "\\$tanh", "\\$asinh", "\\$acosh", "\\$atanh", "\\$rtoi", "\\$itor",
+		"\\$signed", "\\$unsigned", "\\$countbits", "\\$countones", "\\$isunknown", "\\$onehot", "\\$onehot0",
+	};
+	return pure_functions.count(name) != 0;
+}
+
+// Appends everything the evaluation of `node` (a function declaration or a
+// part of it) depends on to `key`. Returns false if it refers to anything
+// other than its own variables, functions and constant parameters.
+static bool const_function_key(std::string &key, const AstNode *node, pool<std::string> &locals, pool<const AstNode*> &callees)
+{
+	switch (node->type)
+	{
+	case AST_WIRETYPE:
+	case AST_PREFIX:
+	case AST_TCALL:
+	case AST_TYPEDEF:
+	case AST_ENUM:
+	case AST_STRUCT:
+	case AST_UNION:
+	case AST_MEMORY:
+		return false;
+
+	case AST_IDENTIFIER:
+		if (!locals.count(node->str)) {
+			auto it = current_scope.find(node->str);
+			if (it == current_scope.end())
+				return false;
+			const AstNode *param = it->second;
+			if (param->type != AST_PARAMETER && param->type != AST_LOCALPARAM && param->type != AST_ENUM_ITEM)
+				return false;
+			if (param->children.empty() || (param->children[0]->type != AST_CONSTANT && param->children[0]->type != AST_REALVALUE))
+				return false;
+			key_append_tree(key, param);
+		}
+		break;
+
+	case AST_FCALL:
+		if (node->str.compare(0, 2, "\\$") == 0) {
+			if (!is_pure_system_function(node->str))
+				return false;
+		} else if (!locals.count(node->str)) {
+			auto it = current_scope.find(node->str);
+			if (it == current_scope.end() || it->second->type != AST_FUNCTION || it->second->attributes.count(ID::via_celltype))
+				return false;
+			if (!callees.count(it->second)) {
+				callees.insert(it->second);
+				pool<std::string> callee_locals;
+				if (!const_function_key(key, it->second, callee_locals, callees))
+					return false;
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	key_append_node(key, node);
+	for (auto &it : node->attributes) {
+		key_append(key, it.first.size());
+		key += it.first.str();
+		key_append_tree(key, it.second.get());
+	}
+
+	// declarations are visible in the whole block containing them (a
+	// function's own name refers to its result variable)
+	bool has_decls = node->type == AST_FUNCTION;
+	for (auto &child : node->children)
+		if (child->type == AST_WIRE || child->type == AST_LOCALPARAM || child->type == AST_PARAMETER)
+			has_decls = true;
+	pool<std::string> inner_locals;
+	if (has_decls) {
+		inner_locals = locals;
+		if (node->type == AST_FUNCTION)
+			inner_locals.insert(node->str);
+		for (auto &child : node->children)
+			if (child->type == AST_WIRE || child->type == AST_LOCALPARAM || child->type == AST_PARAMETER)
+				inner_locals.insert(child->str);
+	}
+
+	for (auto &child : node->children)
+		if (!const_function_key(key, child.get(), has_decls ? inner_locals : locals, callees))
+			return false;
+	return true;
+}
+
 // convert the AST into a simpler AST that has all parameters substituted by their
 // values, unrolled for-loops, expanded generate blocks, etc. when this function
 // is done with an AST it can be converted into RTLIL using genRTLIL().
@@ -896,15 +1043,15 @@ static void check_auto_nosync(AstNode *node)
 // nodes that link to a different node using names and lexical scoping.
 bool AstNode::simplify(bool const_fold, int stage, int width_hint, bool sign_hint)
 {
-	static int recursion_counter = 0;
-	static bool deep_recursion_warning = false;
+	static thread_local int recursion_counter = 0;
+	static thread_local bool deep_recursion_warning = false;
 
 	if (recursion_counter++ == 1000 && deep_recursion_warning) {
 		log_warning("Deep recursion in AST simplifier.\nDoes this design contain overly long or deeply nested expressions, or excessive recursion?\n");
 		deep_recursion_warning = false;
 	}
 
-	static bool unevaluated_tern_branch = false;
+	static thread_local bool unevaluated_tern_branch = false;
 
 	std::unique_ptr<AstNode> newNode = nullptr;
 	bool did_something = false;
@@ -1383,7 +1530,7 @@ bool AstNode::simplify(bool const_fold, int stage, int width_hint, bool sign_hin
 
 				// create the indirection wire
 				std::stringstream sstr;
-				sstr << "$indirect$" << ref->name.c_str() << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++);
+				sstr << "$indirect$" << ref->name.c_str() << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx();
 				std::string tmp_str = sstr.str();
 				add_wire_for_ref(location, ref, tmp_str);
 
@@ -2364,7 +2511,7 @@ bool AstNode::simplify(bool const_fold, int stage, int width_hint, bool sign_hin
 			std::swap(data_range_left, data_range_right);
 
 		std::stringstream sstr;
-		sstr << "$mem2bits$" << str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++);
+		sstr << "$mem2bits$" << str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx();
 		std::string wire_id = sstr.str();
 
 		auto wire_owned = std::make_unique<AstNode>(location, AST_WIRE, std::make_unique<AstNode>(location, AST_RANGE, mkconst_int(location, data_range_left, true), mkconst_int(location, data_range_right, true)));
@@ -3129,7 +3276,7 @@ skip_dynamic_range_lvalue_expansion:;
 
 			auto wire_tmp_owned = std::make_unique<AstNode>(location, AST_WIRE, std::make_unique<AstNode>(location, AST_RANGE, mkconst_int(location, width_hint-1, true), mkconst_int(location, 0, true)));
 			auto wire_tmp = wire_tmp_owned.get();
-			wire_tmp->str = stringf("$splitcmplxassign$%s:%d$%d", RTLIL::encode_filename(*location.begin.filename), location.begin.line, autoidx++);
+			wire_tmp->str = stringf("$splitcmplxassign$%s:%d$%d", RTLIL::encode_filename(*location.begin.filename), location.begin.line, next_autoidx());
 			current_scope[wire_tmp->str] = wire_tmp;
 			current_ast_mod->children.push_back(std::move(wire_tmp_owned));
 			wire_tmp->set_attribute(ID::nosync, AstNode::mkconst_int(location, 1, false));
@@ -3171,7 +3318,7 @@ skip_dynamic_range_lvalue_expansion:;
 			input_error("Insufficient number of array indices for %s.\n", log_id(str));
 
 		std::stringstream sstr;
-		sstr << "$memwr$" << children[0]->str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++);
+		sstr << "$memwr$" << children[0]->str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx();
 		std::string id_addr = sstr.str() + "_ADDR", id_data = sstr.str() + "_DATA", id_en = sstr.str() + "_EN";
 
 		int mem_width, mem_size, addr_bits;
@@ -3371,7 +3518,7 @@ skip_dynamic_range_lvalue_expansion:;
 		{
 			if (str == "\\$initstate")
 			{
-				int myidx = autoidx++;
+				int myidx = next_autoidx();
 
 				auto wire_owned = std::make_unique<AstNode>(location, AST_WIRE);
 				auto* wire = wire_owned.get();
@@ -3433,7 +3580,7 @@ skip_dynamic_range_lvalue_expansion:;
 					goto apply_newNode;
 				}
 
-				int myidx = autoidx++;
+				int myidx = next_autoidx();
 				AstNode* outreg = nullptr;
 
 				for (int i = 0; i < num_steps; i++)
@@ -3820,6 +3967,7 @@ skip_dynamic_range_lvalue_expansion:;
 				}
 
 				newNode = dpi_call(dpi_decl->location, rtype, fname, argtypes, args);
+				elab_context_dependent = true;
 
 				goto apply_newNode;
 			}
@@ -3903,27 +4051,49 @@ skip_dynamic_range_lvalue_expansion:;
 
 
 		std::stringstream sstr;
-		sstr << str << "$func$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++) << '.';
+		sstr << str << "$func$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx() << '.';
 		std::string prefix = sstr.str();
 
 		auto* decl = current_scope[str];
 		if (unevaluated_tern_branch && decl->is_recursive_function())
 			goto replace_fcall_later;
-		auto decl_clone = decl->clone();
-		decl = decl_clone.get(); // sketchy?
-		decl->replace_result_wire_name_in_function(str, "$result"); // enables recursion
-		decl->expand_genblock(prefix);
 
-		if (decl->type == AST_FUNCTION && !decl->attributes.count(ID::via_celltype))
+		bool const_func_call = decl->type == AST_FUNCTION && !decl->attributes.count(ID::via_celltype);
+		bool all_args_const = true;
+		std::string const_func_key;
+		if (const_func_call)
 		{
-			bool require_const_eval = decl->has_const_only_constructs();
-			bool all_args_const = true;
 			for (auto& child : children) {
 				while (child->simplify(true, 1, -1, false)) { }
 				if (child->type != AST_CONSTANT && child->type != AST_REALVALUE)
 					all_args_const = false;
 			}
 
+			pool<std::string> locals;
+			pool<const AstNode*> callees = {decl};
+			key_append(const_func_key, sv_mode_but_global_and_used_for_literally_one_condition);
+			if (all_args_const && const_function_key(const_func_key, decl, locals, callees)) {
+				for (auto& child : children)
+					key_append_tree(const_func_key, child.get());
+				auto it = const_function_cache.find(const_func_key);
+				if (it != const_function_cache.end()) {
+					newNode = mkconst_bits(decl->location, it->second.first, it->second.second);
+					goto apply_newNode;
+				}
+			} else {
+				const_func_key.clear();
+			}
+		}
+
+		auto decl_clone = decl->clone();
+		decl = decl_clone.get(); // sketchy?
+		decl->replace_result_wire_name_in_function(str, "$result"); // enables recursion
+		decl->expand_genblock(prefix);
+
+		if (const_func_call)
+		{
+			bool require_const_eval = decl->has_const_only_constructs();
+
 			if (all_args_const) {
 				auto func_workspace = decl->clone();
 				func_workspace->set_in_param_flag(true);
@@ -3931,6 +4101,11 @@ skip_dynamic_range_lvalue_expansion:;
 				// func_workspace->dumpAst(stdout, "func_workspace ");
 				newNode = func_workspace->eval_const_function(this, in_param || require_const_eval);
 				if (newNode) {
+					if (!const_func_key.empty()) {
+						if (GetSize(const_function_cache) >= 10000)
+							const_function_cache.clear();
+						const_function_cache[const_func_key] = {newNode->bits, newNode->is_signed};
+					}
 					goto apply_newNode;
 				}
 			}
@@ -4471,6 +4646,9 @@ std::unique_ptr<AstNode> AstNode::readmem(bool is_readmemh, std::string mem_file
 	for (int i = 0; i < mem_width; i++)
 		en_bits.push_back(State::S1);
 
+	// the file contents are not part of the elaboration cache key
+	elab_context_dependent = true;
+
 	std::ifstream f;
 	f.open(mem_filename.c_str());
 	if (f.fail()) {
@@ -5036,7 +5214,7 @@ bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod,
 			children[0]->children[0]->children[0]->type != AST_CONSTANT)
 	{
 		std::stringstream sstr;
-		sstr << "$mem2reg_wr$" << children[0]->str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++);
+		sstr << "$mem2reg_wr$" << children[0]->str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx();
 		std::string id_addr = sstr.str() + "_ADDR", id_data = sstr.str() + "_DATA";
 
 		int mem_width, mem_size, addr_bits;
@@ -5155,7 +5333,7 @@ bool AstNode::mem2reg_as_needed_pass2(pool<AstNode*> &mem2reg_set, AstNode *mod,
 		else
 		{
 			std::stringstream sstr;
-			sstr << "$mem2reg_rd$" << str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << (autoidx++);
+			sstr << "$mem2reg_rd$" << str << "$" << RTLIL::encode_filename(*location.begin.filename) << ":" << location.begin.line << "$" << next_autoidx();
 			std::string id_addr = sstr.str() + "_ADDR", id_data = sstr.str() + "_DATA";
 
 			int mem_width, mem_size, addr_bits;
@@ -5352,10 +5530,12 @@ bool AstNode::is_simple_const_expr()
 }
 
 // helper function for AstNode::eval_const_function()
-bool AstNode::replace_variables(std::map<std::string, AstNode::varinfo_t> &variables, AstNode *fcall, bool must_succeed)
+bool AstNode::replace_variables(dict<std::string, AstNode::varinfo_t> &variables, AstNode *fcall, bool must_succeed)
 {
-	if (type == AST_IDENTIFIER && variables.count(str)) {
-		int offset = variables.at(str).offset, width = variables.at(str).val.size();
+	auto var = type == AST_IDENTIFIER ? variables.find(str) : variables.end();
+	if (var != variables.end()) {
+		const varinfo_t &info = var->second;
+		int offset = info.offset, width = info.val.size();
 		if (!children.empty()) {
 			if (children.size() != 1 || children.at(0)->type != AST_RANGE) {
 				if (!must_succeed)
@@ -5375,15 +5555,14 @@ bool AstNode::replace_variables(std::map<std::string, AstNode::varinfo_t> &varia
 			offset = min(children.at(0)->range_left, children.at(0)->range_right);
 			width = min(std::abs(children.at(0)->range_left - children.at(0)->range_right) + 1, width);
 		}
-		offset -= variables.at(str).offset;
-		if (variables.at(str).range_swapped)
+		offset -= info.offset;
+		if (info.range_swapped)
 			offset = -offset;
-		const RTLIL::Const &val = variables.at(str).val;
 		std::vector<RTLIL::State> new_bits;
 		new_bits.reserve(width);
 		for (int i = 0; i < width; i++)
-			new_bits.push_back(val[offset+i]);
-		auto newNode = mkconst_bits(location, new_bits, variables.at(str).is_signed);
+			new_bits.push_back(info.val[offset+i]);
+		auto newNode = mkconst_bits(location, new_bits, info.is_signed);
 		newNode->cloneInto(*this);
 		return true;
 	}
@@ -5397,8 +5576,14 @@ bool AstNode::replace_variables(std::map<std::string, AstNode::varinfo_t> &varia
 // attempt to statically evaluate a functions with all-const arguments
 std::unique_ptr<AstNode> AstNode::eval_const_function(AstNode *fcall, bool must_succeed)
 {
-	std::map<std::string, AstNode*> backup_scope = current_scope;
-	std::map<std::string, AstNode::varinfo_t> variables;
+	// the scope entries replaced by the function's variables and localparams
+	std::vector<std::pair<std::string, AstNode*>> backup_scope;
+	auto add_to_scope = [&](AstNode *node) {
+		auto it = current_scope.find(node->str);
+		backup_scope.emplace_back(node->str, it == current_scope.end() ? nullptr : it->second);
+		current_scope[node->str] = node;
+	};
+	dict<std::string, AstNode::varinfo_t> variables;
 	auto block = std::make_unique<AstNode>(location, AST_BLOCK);
 	std::unique_ptr<AstNode> result = nullptr;
 
@@ -5455,7 +5640,7 @@ std::unique_ptr<AstNode> AstNode::eval_const_function(AstNode *fcall, bool must_
 					variable.val = variable.arg->realAsConst(width);
 				}
 			}
-			current_scope[stmt->str] = stmt.get();
+			add_to_scope(stmt.get());
 			temporary_nodes.push_back(std::move(stmt));
 
 			block->children.erase(block->children.begin());
@@ -5468,7 +5653,7 @@ std::unique_ptr<AstNode> AstNode::eval_const_function(AstNode *fcall, bool must_
 		{
 			while (stmt->simplify(true, 1, -1, false)) { }
 
-			current_scope[stmt->str] = stmt.get();
+			add_to_scope(stmt.get());
 			temporary_nodes.push_back(std::move(stmt));
 
 			block->children.erase(block->children.begin());
@@ -5676,7 +5861,12 @@ std::unique_ptr<AstNode> AstNode::eval_const_function(AstNode *fcall, bool must_
 	result = AstNode::mkconst_bits(location, variables.at(str).val.to_bits(), variables.at(str).is_signed);
 
 finished:
-	current_scope = backup_scope;
+	for (auto it = backup_scope.rbegin(); it != backup_scope.rend(); it++) {
+		if (it->second == nullptr)
+			current_scope.erase(it->first);
+		else
+			current_scope[it->first] = it->second;
+	}
 	return result;
 }
 
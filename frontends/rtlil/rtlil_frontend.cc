@@ -26,6 +26,14 @@
 #include "kernel/register.h"
 #include "kernel/log.h"
 
+#if !defined(_WIN32) && !defined(__wasm)
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#  define RTLIL_FRONTEND_MMAP
+#endif
+
 void rtlil_frontend_yyerror(char const *s)
 {
 	YOSYS_NAMESPACE_PREFIX log_error("Parser error in line %d: %s\n", rtlil_frontend_yyget_lineno(), s);
@@ -38,6 +46,54 @@ void rtlil_frontend_yywarning(char const *s)
 
 YOSYS_NAMESPACE_BEGIN
 
+// The text handed to the hand-written parser: a plain file mapped into
+// memory, or a copy of what can be read from any other stream.
+struct RTLILInput
+{
+	std::string buffer;
+	const char *begin = nullptr, *end = nullptr;
+#ifdef RTLIL_FRONTEND_MMAP
+	void *mapping = MAP_FAILED;
+	size_t mapping_size = 0;
+#endif
+
+	RTLILInput(std::istream *f, const std::string &filename)
+	{
+#ifdef RTLIL_FRONTEND_MMAP
+		std::streamoff offset = dynamic_cast<std::ifstream*>(f) ? std::streamoff(f->tellg()) : -1;
+		int fd = offset < 0 ? -1 : open(filename.c_str(), O_RDONLY);
+		struct stat st;
+		if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > offset) {
+			mapping_size = st.st_size;
+			mapping = mmap(nullptr, mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		if (fd >= 0)
+			close(fd);
+		if (mapping != MAP_FAILED) {
+			begin = static_cast<const char*>(mapping) + offset;
+			end = static_cast<const char*>(mapping) + mapping_size;
+			return;
+		}
+#else
+		(void)filename;
+#endif
+		char block[65536];
+		std::streamsize n;
+		while ((n = f->rdbuf()->sgetn(block, sizeof(block))) > 0)
+			buffer.append(block, n);
+		begin = buffer.data();
+		end = begin + buffer.size();
+	}
+
+	~RTLILInput()
+	{
+#ifdef RTLIL_FRONTEND_MMAP
+		if (mapping != MAP_FAILED)
+			munmap(mapping, mapping_size);
+#endif
+	}
+};
+
 struct RTLILFrontend : public Frontend {
 	RTLILFrontend() : Frontend("rtlil", "read modules from RTLIL file") { }
 	void help() override
@@ -60,12 +116,25 @@ struct RTLILFrontend : public Frontend {
 		log("    -lib\n");
 		log("        only create empty blackbox modules\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        parse the modules of the file on up to <N> threads. The modules are\n");
+		log("        added to the design after all of them are parsed, and the resulting\n");
+		log("        design is the same for every <N>.\n");
+		log("\n");
+		log("    -legacy\n");
+		log("        use the flex/bison based parser instead of the hand-written one. It\n");
+		log("        accepts the same input and is kept for comparison.\n");
+		log("\n");
+		log("Plain files are mapped into memory and parsed in place.\n");
+		log("\n");
 	}
 	void execute(std::istream *&f, std::string filename, std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		RTLIL_FRONTEND::flag_nooverwrite = false;
 		RTLIL_FRONTEND::flag_overwrite = false;
 		RTLIL_FRONTEND::flag_lib = false;
+		bool flag_legacy = false;
+		int num_threads = 0;
 
 		log_header(design, "Executing RTLIL frontend.\n");
 
@@ -86,12 +155,29 @@ struct RTLILFrontend : public Frontend {
 				RTLIL_FRONTEND::flag_lib = true;
 				continue;
 			}
+			if (arg == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads: %s\n", args[argidx]);
+				continue;
+			}
+			if (arg == "-legacy") {
+				flag_legacy = true;
+				continue;
+			}
 			break;
 		}
 		extra_args(f, filename, args, argidx);
 
 		log("Input filename: %s\n", filename);
 
+		if (!flag_legacy) {
+			RTLILInput input(f, filename);
+			RTLIL_FRONTEND::parse_text(design, input.begin, input.end, RTLIL_FRONTEND::flag_nooverwrite,
+					RTLIL_FRONTEND::flag_overwrite, RTLIL_FRONTEND::flag_lib, num_threads);
+			return;
+		}
+
 		RTLIL_FRONTEND::lexin = f;
 		RTLIL_FRONTEND::current_design = design;
 		rtlil_frontend_yydebug = false;
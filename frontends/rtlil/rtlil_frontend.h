@@ -35,6 +35,19 @@ namespace RTLIL_FRONTEND {
 	extern bool flag_nooverwrite;
 	extern bool flag_overwrite;
 	extern bool flag_lib;
+
+	// Parses the RTLIL text from `begin` to `end` with the hand-written parser
+	// in rtlil_reader.cc. With num_threads >= 1, the modules are parsed by up
+	// to that many threads and added to the design after all of them are
+	// parsed, otherwise the text is parsed in one go like the bison parser
+	// does.
+	void parse_text(RTLIL::Design *design, const char *begin, const char *end,
+			bool flag_nooverwrite, bool flag_overwrite, bool flag_lib, int num_threads = 0);
+
+	// Like parse_text() without threads, but returns false and stores the
+	// message in `error` instead of raising a parser error, for callers that
+	// can get the design some other way.
+	bool try_parse_text(RTLIL::Design *design, const char *begin, const char *end, std::string &error);
 }
 
 YOSYS_NAMESPACE_END
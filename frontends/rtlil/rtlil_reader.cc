@@ -0,0 +1,951 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ *  ---
+ *
+ *  A hand-written parser for the RTLIL text representation. It accepts the
+ *  same language as rtlil_lexer.l and rtlil_parser.y and builds the same
+ *  design, but works on the input text in place (token texts are views into
+ *  the input, identifiers are only turned into IdStrings where the design
+ *  keeps them) and can parse the modules of a file in parallel.
+ *
+ */
+
+#include "rtlil_frontend.h"
+#include "kernel/threading.h"
+
+#include <climits>
+#include <unordered_map>
+
+YOSYS_NAMESPACE_BEGIN
+
+namespace {
+
+enum class Tok { Eof, Eol, Word, Id, Value, Int, Invalid, String, Char };
+
+enum class ModuleAction { Add, Replace, Ignore };
+
+// A module found by the top-level pass over the input, parsed by a task
+struct ModuleChunk
+{
+	RTLIL::IdString name;
+	dict<RTLIL::IdString, RTLIL::Const> attributes;
+	ModuleAction action;
+	std::string message;
+	const char *begin, *end;
+	int line;
+	std::unique_ptr<RTLIL::Module> module;
+};
+
+// Thrown instead of calling log_error() by the top-level pass while the
+// modules are parsed in tasks, see RtlilReader::defer_errors.
+struct DeferredParseError
+{
+	std::string message;
+};
+
+bool is_space(char c)
+{
+	return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+bool is_digit(char c)
+{
+	return '0' <= c && c <= '9';
+}
+
+RTLIL::State state_from_char(char c)
+{
+	switch (c) {
+	case '0': return RTLIL::S0;
+	case '1': return RTLIL::S1;
+	case 'z': return RTLIL::Sz;
+	case '-': return RTLIL::Sa;
+	case 'm': return RTLIL::Sm;
+	default: return RTLIL::Sx;
+	}
+}
+
+// Returns the start of the `end` line that closes the module body starting
+// at `p`, or `end` if there is none. Only looks at the first word of each
+// line: `cell`, `process` and `switch` open a block that is closed by `end`.
+// Counts the newlines skipped in `line`.
+const char *find_module_end(const char *p, const char *end, int &line)
+{
+	int depth = 0;
+	while (p != end) {
+		while (p != end && (*p == ' ' || *p == '\t'))
+			p++;
+		const char *word = p;
+		while (p != end && 'a' <= *p && *p <= 'z')
+			p++;
+		std::string_view first(word, p - word);
+		if (p == end || is_space(*p)) {
+			if (first == "end") {
+				if (depth == 0)
+					return word;
+				depth--;
+			} else if (first == "cell" || first == "process" || first == "switch")
+				depth++;
+		}
+		while (p != end && *p != '\n' && *p != '\r')
+			p++;
+		for (; p != end && (*p == '\n' || *p == '\r'); p++)
+			if (*p == '\n')
+				line++;
+	}
+	return end;
+}
+
+struct RtlilReader
+{
+	RTLIL::Design *design;
+	bool flag_nooverwrite, flag_overwrite, flag_lib;
+
+	// When set, the top-level pass records the modules in `chunks` instead
+	// of parsing their bodies, and throws DeferredParseError so that its
+	// error comes after the messages of the modules before it.
+	std::vector<ModuleChunk> *chunks = nullptr;
+	bool defer_errors = false;
+	dict<RTLIL::IdString, bool> defined_blackbox;
+
+	const char *p, *end;
+	int line;
+
+	// the current token
+	Tok tok = Tok::Eof;
+	std::string_view text;
+	int tok_line = 0;
+	int integer = 0;
+	std::string string_value;
+
+	RTLIL::Module *module = nullptr;
+	RTLIL::Process *process = nullptr;
+	dict<RTLIL::IdString, RTLIL::Const> attrbuf;
+	std::vector<std::vector<RTLIL::SwitchRule*>*> switch_stack;
+	std::vector<RTLIL::CaseRule*> case_stack;
+
+	// wires of the current module, and the IdStrings of cell types, port,
+	// parameter and attribute names seen so far
+	std::unordered_map<std::string_view, RTLIL::Wire*> wires;
+	std::unordered_map<std::string_view, RTLIL::IdString> names;
+	std::string scratch;
+
+	RtlilReader(RTLIL::Design *design, const char *begin, const char *end, int line,
+			bool flag_nooverwrite, bool flag_overwrite, bool flag_lib) :
+			design(design), flag_nooverwrite(flag_nooverwrite), flag_overwrite(flag_overwrite), flag_lib(flag_lib),
+			p(begin), end(end), line(line) { }
+
+	// Like the bison parser, reports the line after the current token,
+	// which for the checks done at the end of a statement is the line of the
+	// next statement.
+	[[noreturn]] void error(const std::string &message)
+	{
+		if (defer_errors)
+			throw DeferredParseError{stringf("Parser error in line %d: %s\n", line, message)};
+		log_error("Parser error in line %d: %s\n", line, message);
+	}
+
+	[[noreturn]] void syntax_error()
+	{
+		error("syntax error");
+	}
+
+	void next()
+	{
+		while (p != end && (*p == ' ' || *p == '\t' || *p == '#')) {
+			if (*p == '#')
+				while (p != end && *p != '\n')
+					p++;
+			else
+				p++;
+		}
+
+		tok_line = line;
+		const char *start = p;
+		if (p == end) {
+			tok = Tok::Eof;
+		} else if (*p == '\r' || *p == '\n') {
+			for (; p != end && (*p == '\r' || *p == '\n'); p++)
+				if (*p == '\n')
+					line++;
+			tok = Tok::Eol;
+		} else if ('a' <= *p && *p <= 'z') {
+			while (p != end && 'a' <= *p && *p <= 'z')
+				p++;
+			tok = Tok::Word;
+		} else if ((*p == '\\' || *p == '$') && p + 1 != end && !is_space(p[1])) {
+			while (p != end && !is_space(*p))
+				p++;
+			tok = Tok::Id;
+		} else if (is_digit(*p) || (*p == '-' && p + 1 != end && is_digit(p[1]))) {
+			next_number();
+		} else if (*p == '"') {
+			next_string();
+		} else {
+			p++;
+			tok = Tok::Char;
+		}
+		text = std::string_view(start, p - start);
+	}
+
+	void next_number()
+	{
+		const char *q = *p == '-' ? p + 1 : p;
+		const char *digits = q;
+		while (q != end && is_digit(*q))
+			q++;
+
+		if (*p != '-' && q != end && *q == '\'') {
+			q++;
+			if (q != end && *q == 's')
+				q++;
+			while (q != end && (*q == '0' || *q == '1' || *q == 'x' || *q == 'z' || *q == 'm' || *q == '-'))
+				q++;
+			p = q;
+			tok = Tok::Value;
+			return;
+		}
+
+		// like the flex lexer, integers that don't fit an int are invalid tokens
+		long long value = 0;
+		bool overflow = false;
+		for (const char *d = digits; d != q && !overflow; d++) {
+			value = value * 10 + (*d - '0');
+			overflow = value > (long long)INT_MAX + 1;
+		}
+		if (*p == '-')
+			value = -value;
+		p = q;
+		if (overflow || value < INT_MIN || value > INT_MAX) {
+			tok = Tok::Invalid;
+		} else {
+			tok = Tok::Int;
+			integer = value;
+		}
+	}
+
+	void next_string()
+	{
+		string_value.clear();
+		for (p++; p != end && *p != '\n'; ) {
+			char c = *p++;
+			if (c == '"') {
+				// the string ends at the first escaped NUL character
+				size_t nul = string_value.find('\0');
+				if (nul != std::string::npos)
+					string_value.resize(nul);
+				tok = Tok::String;
+				return;
+			}
+			if (c == '\\' && p != end && *p != '\n') {
+				c = *p++;
+				if (c == 'n')
+					c = '\n';
+				else if (c == 't')
+					c = '\t';
+				else if ('0' <= c && c <= '7') {
+					int value = c - '0';
+					for (int i = 0; i < 2 && p != end && '0' <= *p && *p <= '7'; i++)
+						value = value * 8 + (*p++ - '0');
+					c = value;
+				}
+			}
+			string_value += c;
+		}
+		tok = Tok::Invalid;
+	}
+
+	bool at_word(std::string_view word) const
+	{
+		return tok == Tok::Word && text == word;
+	}
+
+	bool at_char(char c) const
+	{
+		return tok == Tok::Char && text[0] == c;
+	}
+
+	void expect_word(std::string_view word)
+	{
+		if (!at_word(word))
+			syntax_error();
+		next();
+	}
+
+	void expect_eol()
+	{
+		if (tok != Tok::Eol)
+			syntax_error();
+		do
+			next();
+		while (tok == Tok::Eol);
+	}
+
+	std::string_view expect_id()
+	{
+		if (tok != Tok::Id)
+			syntax_error();
+		std::string_view id = text;
+		next();
+		return id;
+	}
+
+	int expect_int()
+	{
+		if (tok != Tok::Int)
+			syntax_error();
+		int value = integer;
+		next();
+		return value;
+	}
+
+	RTLIL::IdString make_id(std::string_view name)
+	{
+		scratch.assign(name.data(), name.size());
+		return RTLIL::IdString(scratch);
+	}
+
+	// for names that are used many times in a file
+	RTLIL::IdString cached_id(std::string_view name)
+	{
+		auto it = names.find(name);
+		if (it != names.end())
+			return it->second;
+		RTLIL::IdString id = make_id(name);
+		names.emplace(name, id);
+		return id;
+	}
+
+	RTLIL::Const parse_constant()
+	{
+		if (tok == Tok::Int) {
+			RTLIL::Const value(integer);
+			next();
+			return value;
+		}
+		if (tok == Tok::String) {
+			RTLIL::Const value(string_value);
+			next();
+			return value;
+		}
+		if (tok != Tok::Value)
+			syntax_error();
+
+		// <width>'[s]<bits>, most significant bit first; missing bits are
+		// filled with the most significant one, or 0 if that is a 1
+		char *ep;
+		int width = strtol(text.data(), &ep, 10);
+		const char *q = ep + 1, *q_end = text.data() + text.size();
+		bool is_signed = q != q_end && *q == 's';
+		if (is_signed)
+			q++;
+		int num_bits = q_end - q;
+		RTLIL::State fill = num_bits == 0 ? RTLIL::Sx : state_from_char(*q);
+		if (fill == RTLIL::S1)
+			fill = RTLIL::S0;
+
+		RTLIL::Const::Builder builder(std::max(width, 0));
+		for (int i = 0; i < width; i++)
+			builder.push_back(i < num_bits ? state_from_char(q_end[-1 - i]) : fill);
+		RTLIL::Const value = builder.build();
+		if (is_signed)
+			value.flags |= RTLIL::CONST_FLAG_SIGNED;
+		next();
+		return value;
+	}
+
+	RTLIL::SigSpec parse_sigspec()
+	{
+		RTLIL::SigSpec sig;
+		if (at_char('{')) {
+			next();
+			std::vector<RTLIL::SigSpec> parts;
+			while (!at_char('}'))
+				parts.push_back(parse_sigspec());
+			next();
+			for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+				sig.append(*it);
+		} else if (tok == Tok::Id) {
+			auto it = wires.find(text);
+			if (it == wires.end())
+				error(stringf("RTLIL error: wire %s not found", std::string(text)));
+			sig = RTLIL::SigSpec(it->second);
+			next();
+		} else {
+			sig = RTLIL::SigSpec(parse_constant());
+		}
+
+		while (at_char('[')) {
+			next();
+			int index = expect_int();
+			if (at_char(':')) {
+				next();
+				int lsb = expect_int();
+				if (!at_char(']'))
+					syntax_error();
+				if (index >= sig.size() || index < 0 || index < lsb)
+					error("invalid slice");
+				sig = sig.extract(lsb, index - lsb + 1);
+			} else {
+				if (!at_char(']'))
+					syntax_error();
+				if (index >= sig.size() || index < 0)
+					error("bit index out of range");
+				sig = sig.extract(index);
+			}
+			next();
+		}
+		return sig;
+	}
+
+	void parse_attribute()
+	{
+		next();
+		std::string_view name = expect_id();
+		RTLIL::Const value = parse_constant();
+		expect_eol();
+		attrbuf[cached_id(name)] = std::move(value);
+	}
+
+	void check_dangling_attribute()
+	{
+		if (!attrbuf.empty())
+			error("dangling attribute");
+	}
+
+	void parse_parameter()
+	{
+		next();
+		RTLIL::IdString name = cached_id(expect_id());
+		if (tok == Tok::Eol) {
+			expect_eol();
+			module->avail_parameters(name);
+			return;
+		}
+		RTLIL::Const value = parse_constant();
+		expect_eol();
+		module->avail_parameters(name);
+		module->parameter_default_values[name] = std::move(value);
+	}
+
+	void parse_wire()
+	{
+		next();
+		int width = 1, start_offset = 0, port_id = 0;
+		bool upto = false, is_signed = false, port_input = false, port_output = false;
+		while (tok == Tok::Word) {
+			if (text == "width") {
+				next();
+				if (tok == Tok::Invalid)
+					error("RTLIL error: invalid wire width");
+				width = expect_int();
+			} else if (text == "upto") {
+				next();
+				upto = true;
+			} else if (text == "signed") {
+				next();
+				is_signed = true;
+			} else if (text == "offset") {
+				next();
+				start_offset = expect_int();
+			} else if (text == "input" || text == "output" || text == "inout") {
+				port_input = text != "output";
+				port_output = text != "input";
+				next();
+				port_id = expect_int();
+			} else
+				syntax_error();
+		}
+		std::string_view name = expect_id();
+		expect_eol();
+
+		if (wires.count(name))
+			error(stringf("RTLIL error: redefinition of wire %s.", std::string(name)));
+		RTLIL::Wire *wire = module->addWire(make_id(name), width);
+		wire->attributes = std::move(attrbuf);
+		attrbuf.clear();
+		wire->upto = upto;
+		wire->is_signed = is_signed;
+		wire->start_offset = start_offset;
+		wire->port_id = port_id;
+		wire->port_input = port_input;
+		wire->port_output = port_output;
+		wires.emplace(name, wire);
+	}
+
+	void parse_memory()
+	{
+		next();
+		RTLIL::Memory *memory = new RTLIL::Memory;
+		memory->attributes = std::move(attrbuf);
+		attrbuf.clear();
+		while (tok == Tok::Word) {
+			if (text == "width") {
+				next();
+				memory->width = expect_int();
+			} else if (text == "size") {
+				next();
+				memory->size = expect_int();
+			} else if (text == "offset") {
+				next();
+				memory->start_offset = expect_int();
+			} else
+				syntax_error();
+		}
+		std::string_view name = expect_id();
+		expect_eol();
+
+		RTLIL::IdString id = make_id(name);
+		if (module->memories.count(id) != 0)
+			error(stringf("RTLIL error: redefinition of memory %s.", std::string(name)));
+		memory->name = id;
+		module->memories[id] = memory;
+	}
+
+	void parse_cell()
+	{
+		next();
+		std::string_view type = expect_id();
+		std::string_view name = expect_id();
+		expect_eol();
+
+		RTLIL::IdString id = make_id(name);
+		if (module->cell(id) != nullptr)
+			error(stringf("RTLIL error: redefinition of cell %s.", std::string(name)));
+		RTLIL::Cell *cell = module->addCell(id, cached_id(type));
+		cell->attributes = std::move(attrbuf);
+		attrbuf.clear();
+
+		while (!at_word("end")) {
+			if (at_word("parameter")) {
+				next();
+				bool is_signed = false, is_real = false;
+				if (at_word("signed")) {
+					is_signed = true;
+					next();
+				} else if (at_word("real")) {
+					is_real = true;
+					next();
+				}
+				RTLIL::IdString param = cached_id(expect_id());
+				RTLIL::Const value = parse_constant();
+				expect_eol();
+				RTLIL::Const &slot = cell->parameters[param];
+				slot = std::move(value);
+				if (is_signed)
+					slot.flags |= RTLIL::CONST_FLAG_SIGNED;
+				if (is_real)
+					slot.flags |= RTLIL::CONST_FLAG_REAL;
+			} else if (at_word("connect")) {
+				next();
+				std::string_view port = expect_id();
+				RTLIL::SigSpec sig = parse_sigspec();
+				expect_eol();
+				RTLIL::IdString port_id = cached_id(port);
+				if (cell->hasPort(port_id))
+					error(stringf("RTLIL error: redefinition of cell port %s.", std::string(port)));
+				cell->setPort(port_id, std::move(sig));
+			} else
+				syntax_error();
+		}
+		next();
+		expect_eol();
+	}
+
+	void parse_assign()
+	{
+		next();
+		RTLIL::SigSpec lhs = parse_sigspec();
+		RTLIL::SigSpec rhs = parse_sigspec();
+		expect_eol();
+		check_dangling_attribute();
+
+		// See https://github.com/YosysHQ/yosys/pull/4765 for discussion on this
+		// warning
+		if (!switch_stack.back()->empty())
+			log_warning("In line %d: %s\n", line,
+				"case rule assign statements after switch statements may cause unexpected behaviour. "
+				"The assign statement is reordered to come before all switch statements.");
+
+		case_stack.back()->actions.push_back(RTLIL::SigSig(std::move(lhs), std::move(rhs)));
+	}
+
+	void parse_case_body()
+	{
+		while (true) {
+			if (at_word("attribute"))
+				parse_attribute();
+			else if (at_word("switch"))
+				parse_switch();
+			else if (at_word("assign"))
+				parse_assign();
+			else
+				break;
+		}
+	}
+
+	void parse_switch()
+	{
+		next();
+		RTLIL::SigSpec signal = parse_sigspec();
+		expect_eol();
+		RTLIL::SwitchRule *rule = new RTLIL::SwitchRule;
+		rule->signal = std::move(signal);
+		rule->attributes = std::move(attrbuf);
+		attrbuf.clear();
+		switch_stack.back()->push_back(rule);
+
+		while (at_word("attribute"))
+			parse_attribute();
+
+		while (at_word("case")) {
+			next();
+			RTLIL::CaseRule *case_rule = new RTLIL::CaseRule;
+			case_rule->attributes = std::move(attrbuf);
+			attrbuf.clear();
+			rule->cases.push_back(case_rule);
+			switch_stack.push_back(&case_rule->switches);
+			case_stack.push_back(case_rule);
+
+			if (tok != Tok::Eol && !at_char(','))
+				case_rule->compare.push_back(parse_sigspec());
+			while (at_char(',')) {
+				next();
+				case_rule->compare.push_back(parse_sigspec());
+			}
+			expect_eol();
+			parse_case_body();
+
+			switch_stack.pop_back();
+			case_stack.pop_back();
+		}
+		expect_word("end");
+		expect_eol();
+	}
+
+	void parse_sync()
+	{
+		next();
+		RTLIL::SyncType type;
+		RTLIL::SigSpec signal;
+		if (at_word("always") || at_word("global") || at_word("init")) {
+			type = at_word("always") ? RTLIL::STa : at_word("global") ? RTLIL::STg : RTLIL::STi;
+			next();
+		} else {
+			if (at_word("low"))
+				type = RTLIL::ST0;
+			else if (at_word("high"))
+				type = RTLIL::ST1;
+			else if (at_word("posedge"))
+				type = RTLIL::STp;
+			else if (at_word("negedge"))
+				type = RTLIL::STn;
+			else if (at_word("edge"))
+				type = RTLIL::STe;
+			else
+				syntax_error();
+			next();
+			signal = parse_sigspec();
+		}
+		expect_eol();
+
+		RTLIL::SyncRule *rule = new RTLIL::SyncRule;
+		rule->type = type;
+		rule->signal = std::move(signal);
+		process->syncs.push_back(rule);
+
+		while (true) {
+			if (at_word("update")) {
+				next();
+				RTLIL::SigSpec lhs = parse_sigspec();
+				RTLIL::SigSpec rhs = parse_sigspec();
+				expect_eol();
+				rule->actions.push_back(RTLIL::SigSig(std::move(lhs), std::move(rhs)));
+			} else if (at_word("attribute") || at_word("memwr")) {
+				while (at_word("attribute"))
+					parse_attribute();
+				expect_word("memwr");
+				RTLIL::MemWriteAction act;
+				act.memid = cached_id(expect_id());
+				act.address = parse_sigspec();
+				act.data = parse_sigspec();
+				act.enable = parse_sigspec();
+				act.priority_mask = parse_constant();
+				expect_eol();
+				act.attributes = std::move(attrbuf);
+				attrbuf.clear();
+				rule->mem_write_actions.push_back(std::move(act));
+			} else
+				break;
+		}
+	}
+
+	void parse_process()
+	{
+		next();
+		std::string_view name = expect_id();
+		expect_eol();
+
+		RTLIL::IdString id = make_id(name);
+		if (module->processes.count(id) != 0)
+			error(stringf("RTLIL error: redefinition of process %s.", std::string(name)));
+		process = module->addProcess(id);
+		process->attributes = std::move(attrbuf);
+		attrbuf.clear();
+		switch_stack.clear();
+		switch_stack.push_back(&process->root_case.switches);
+		case_stack.clear();
+		case_stack.push_back(&process->root_case);
+
+		parse_case_body();
+		while (at_word("sync"))
+			parse_sync();
+		expect_word("end");
+		expect_eol();
+		process = nullptr;
+	}
+
+	void parse_connect()
+	{
+		next();
+		RTLIL::SigSpec lhs = parse_sigspec();
+		RTLIL::SigSpec rhs = parse_sigspec();
+		expect_eol();
+		check_dangling_attribute();
+		module->connect(lhs, rhs);
+	}
+
+	// Parses module statements up to the `end` of the module or the end of
+	// the input.
+	void parse_module_body()
+	{
+		wires.clear();
+		while (tok == Tok::Word) {
+			if (text == "wire")
+				parse_wire();
+			else if (text == "cell")
+				parse_cell();
+			else if (text == "connect")
+				parse_connect();
+			else if (text == "attribute")
+				parse_attribute();
+			else if (text == "process")
+				parse_process();
+			else if (text == "memory")
+				parse_memory();
+			else if (text == "parameter")
+				parse_parameter();
+			else if (text == "end")
+				break;
+			else
+				syntax_error();
+		}
+		if (tok != Tok::Eof && !at_word("end"))
+			syntax_error();
+	}
+
+	void finish_module(bool discard)
+	{
+		check_dangling_attribute();
+		module->fixup_ports();
+		if (discard)
+			delete module;
+		else if (flag_lib)
+			module->makeblackbox();
+		module = nullptr;
+	}
+
+	// What to do with a module that has the same name as one in the design.
+	ModuleAction redefinition_action(const std::string &name, bool existing_blackbox, std::string &message)
+	{
+		if (!flag_overwrite && (flag_lib || (attrbuf.count(ID::blackbox) && attrbuf.at(ID::blackbox).as_bool()))) {
+			message = stringf("Ignoring blackbox re-definition of module %s.\n", name);
+			return ModuleAction::Ignore;
+		}
+		if (!flag_nooverwrite && !flag_overwrite && !existing_blackbox)
+			error(stringf("RTLIL error: redefinition of module %s.", name));
+		if (flag_nooverwrite) {
+			message = stringf("Ignoring re-definition of module %s.\n", name);
+			return ModuleAction::Ignore;
+		}
+		message = stringf("Replacing existing%s module %s.\n", existing_blackbox ? " blackbox" : "", name);
+		return ModuleAction::Replace;
+	}
+
+	void parse_module()
+	{
+		next();
+		std::string_view name = expect_id();
+		expect_eol();
+		RTLIL::IdString id = make_id(name);
+
+		if (chunks == nullptr)
+		{
+			ModuleAction action = ModuleAction::Add;
+			if (design->has(id)) {
+				RTLIL::Module *existing_mod = design->module(id);
+				std::string message;
+				action = redefinition_action(std::string(name), existing_mod->get_bool_attribute(ID::blackbox), message);
+				log("%s", message);
+				if (action == ModuleAction::Replace)
+					design->remove(existing_mod);
+			}
+
+			module = new RTLIL::Module;
+			module->name = id;
+			module->attributes = std::move(attrbuf);
+			attrbuf.clear();
+			if (action != ModuleAction::Ignore)
+				design->add(module);
+
+			parse_module_body();
+			if (tok == Tok::Eof)
+				syntax_error();
+			finish_module(action == ModuleAction::Ignore);
+			next();
+			expect_eol();
+			return;
+		}
+
+		// Decide about redefinitions based on the modules of the design and
+		// those added by the previous chunks, as the modules are only added
+		// to the design after all of them are parsed.
+		ModuleChunk chunk;
+		chunk.name = id;
+		chunk.action = ModuleAction::Add;
+		auto it = defined_blackbox.find(id);
+		if (it != defined_blackbox.end() || design->has(id)) {
+			bool existing_blackbox = it != defined_blackbox.end() ? it->second : design->module(id)->get_bool_attribute(ID::blackbox);
+			chunk.action = redefinition_action(std::string(name), existing_blackbox, chunk.message);
+		}
+		if (chunk.action != ModuleAction::Ignore)
+			defined_blackbox[id] = flag_lib || (attrbuf.count(ID::blackbox) && attrbuf.at(ID::blackbox).as_bool());
+		chunk.attributes = std::move(attrbuf);
+		attrbuf.clear();
+
+		// continue after the body, at its `end`
+		chunk.begin = tok == Tok::Eof ? end : text.data();
+		chunk.line = tok_line;
+		line = tok_line;
+		chunk.end = p = find_module_end(chunk.begin, end, line);
+		chunks->push_back(std::move(chunk));
+		next();
+		expect_word("end");
+		expect_eol();
+	}
+
+	void parse_chunk(ModuleChunk &chunk)
+	{
+		chunk.module = std::make_unique<RTLIL::Module>();
+		module = chunk.module.get();
+		module->name = chunk.name;
+		module->attributes = chunk.attributes;
+
+		next();
+		parse_module_body();
+		if (tok != Tok::Eof)
+			syntax_error();
+		check_dangling_attribute();
+		module->fixup_ports();
+		if (flag_lib && chunk.action != ModuleAction::Ignore)
+			module->makeblackbox();
+		module = nullptr;
+	}
+
+	void parse_design()
+	{
+		next();
+		while (tok == Tok::Eol)
+			next();
+		while (tok != Tok::Eof) {
+			if (at_word("module")) {
+				parse_module();
+			} else if (at_word("attribute")) {
+				parse_attribute();
+			} else if (at_word("autoidx")) {
+				next();
+				int value = expect_int();
+				expect_eol();
+				autoidx = std::max(autoidx, value);
+			} else
+				syntax_error();
+		}
+		check_dangling_attribute();
+	}
+};
+
+}
+
+void RTLIL_FRONTEND::parse_text(RTLIL::Design *design, const char *begin, const char *end,
+		bool flag_nooverwrite, bool flag_overwrite, bool flag_lib, int num_threads)
+{
+	RtlilReader reader(design, begin, end, 1, flag_nooverwrite, flag_overwrite, flag_lib);
+
+	// Modules are built outside of the design and added at the end, which
+	// would bypass monitors and the driver tracking of a buffer-normalized
+	// design.
+	if (num_threads < 1 || !design->monitors.empty() || design->flagBufferedNormalized) {
+		reader.parse_design();
+		return;
+	}
+
+	std::vector<ModuleChunk> chunks;
+	std::string pending_error;
+	reader.chunks = &chunks;
+	reader.defer_errors = true;
+	try {
+		reader.parse_design();
+	} catch (const DeferredParseError &e) {
+		pending_error = e.message;
+	}
+
+	std::vector<unsigned int> hash_seeds;
+	for (auto &chunk : chunks)
+		hash_seeds.push_back(run_hash(chunk.name.str()));
+	parallel_for_tasks(hash_seeds, num_threads, [&](int i) {
+		ModuleChunk &chunk = chunks[i];
+		if (!chunk.message.empty())
+			log("%s", chunk.message);
+		RtlilReader task_reader(design, chunk.begin, chunk.end, chunk.line, flag_nooverwrite, flag_overwrite, flag_lib);
+		task_reader.parse_chunk(chunk);
+	});
+
+	for (auto &chunk : chunks) {
+		if (chunk.action == ModuleAction::Ignore)
+			continue;
+		if (chunk.action == ModuleAction::Replace)
+			design->remove(design->module(chunk.name));
+		design->add(chunk.module.release());
+	}
+
+	if (!pending_error.empty())
+		log_error("%s", pending_error);
+}
+
+bool RTLIL_FRONTEND::try_parse_text(RTLIL::Design *design, const char *begin, const char *end, std::string &error)
+{
+	RtlilReader reader(design, begin, end, 1, false, false, false);
+	reader.defer_errors = true;
+	try {
+		reader.parse_design();
+	} catch (const DeferredParseError &e) {
+		error = e.message;
+		return false;
+	}
+	return true;
+}
+
+YOSYS_NAMESPACE_END
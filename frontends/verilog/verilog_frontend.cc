@@ -215,6 +215,17 @@ struct VerilogFrontend : public Frontend {
 		log("        to a later 'hierarchy' command. Useful in cases where the default\n");
 		log("        parameters of modules yield invalid or not synthesizable code.\n");
 		log("\n");
+		log("    -cache <dir>\n");
+		log("        keep the RTLIL generated for each module, including modules derived\n");
+		log("        later with different parameters, in the given directory and reuse it\n");
+		log("        when the same module is generated again in a later run. An entry is\n");
+		log("        identified by the module's source code after preprocessing (so\n");
+		log("        defines are taken into account), its parameter values, the frontend\n");
+		log("        options and the yosys version. Modules that use $readmem, DPI\n");
+		log("        functions, or the ports of other modules to generate their RTLIL are\n");
+		log("        not cached. Messages printed while generating a module, including\n");
+		log("        $display output, are not repeated when it is loaded from the cache.\n");
+		log("\n");
 		log("    -noautowire\n");
 		log("        make the default of `default_nettype be \"none\" instead of \"wire\".\n");
 		log("\n");
@@ -278,6 +289,7 @@ struct VerilogFrontend : public Frontend {
 		bool flag_nosynthesis = false;
 		bool flag_yydebug = false;
 		bool flag_relative_share = false;
+		std::string cache_dir;
 		define_map_t defines_map;
 
 		std::list<std::string> include_dirs;
@@ -447,6 +459,10 @@ struct VerilogFrontend : public Frontend {
 				flag_defer = true;
 				continue;
 			}
+			if (arg == "-cache" && argidx+1 < args.size()) {
+				cache_dir = args[++argidx];
+				continue;
+			}
 			if (arg == "-noautowire") {
 				parse_state.default_nettype_wire = false;
 				continue;
@@ -495,6 +511,9 @@ struct VerilogFrontend : public Frontend {
 
 		extra_args(f, filename, args, argidx);
 
+		if (!cache_dir.empty() && !create_directory(cache_dir))
+			log_cmd_error("Can't create cache directory `%s'.\n", cache_dir);
+
 		log_header(design, "Executing Verilog-2005 frontend: %s\n", filename);
 
 		log("Parsing %s%s input from `%s' to AST representation.\n",
@@ -561,7 +580,8 @@ struct VerilogFrontend : public Frontend {
 			error_on_dpi_function(parse_state.current_ast);
 
 		AST::process(design, parse_state.current_ast, flag_nodisplay, flag_dump_ast1, flag_dump_ast2, flag_no_dump_ptr, flag_dump_vlog1, flag_dump_vlog2, flag_dump_rtlil, flag_nolatches,
-				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, parse_mode.lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, parse_state.default_nettype_wire);
+				flag_nomeminit, flag_nomem2reg, flag_mem2reg, flag_noblackbox, parse_mode.lib, flag_nowb, flag_noopt, flag_icells, flag_pwires, flag_nooverwrite, flag_overwrite, flag_defer, parse_state.default_nettype_wire,
+				cache_dir);
 
 
 		if (!flag_nopp)
@@ -0,0 +1,112 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys_common.h"
+#include "kernel/log.h"
+
+#include <new>
+
+#ifndef YOSYS_ARENA_H
+#define YOSYS_ARENA_H
+
+YOSYS_NAMESPACE_BEGIN
+
+// Hands out fixed size blocks of memory carved from larger slabs. The owner
+// constructs objects in the blocks with placement new and destroys them
+// explicitly. Freed blocks are reused by later allocations, the slabs are only
+// returned to the system when the arena itself is destroyed, so the owner may
+// skip deallocate() for objects that live until then. Not thread-safe.
+//
+// The block size is a constructor argument rather than a template parameter so
+// that an arena can be declared as a member before the object type is complete.
+class SlabArena
+{
+public:
+	static constexpr size_t min_slab_blocks = 16;
+	static constexpr size_t max_slab_blocks = 4096;
+
+	SlabArena(size_t object_size, size_t object_align) :
+		align(std::max(object_align, alignof(FreeBlock))),
+		block_size((std::max(object_size, sizeof(FreeBlock)) + align - 1) / align * align) {}
+
+	SlabArena(const SlabArena &) = delete;
+	SlabArena &operator=(const SlabArena &) = delete;
+
+	~SlabArena() {
+		for (void *slab : slabs)
+			::operator delete(slab, std::align_val_t(align));
+	}
+
+	void *allocate() {
+		live_blocks++;
+		if (free_list != nullptr) {
+			FreeBlock *block = free_list;
+			free_list = block->next;
+			return block;
+		}
+		if (cursor == slab_end)
+			add_slab(std::min(std::max(2 * slab_blocks, min_slab_blocks), max_slab_blocks));
+		void *block = cursor;
+		cursor += block_size;
+		return block;
+	}
+
+	void deallocate(void *block) {
+		log_assert(live_blocks > 0);
+		live_blocks--;
+		FreeBlock *free_block = static_cast<FreeBlock*>(block);
+		free_block->next = free_list;
+		free_list = free_block;
+	}
+
+	// Make sure the next `count` allocations come from a single slab.
+	void reserve(size_t count) {
+		if (size_t(slab_end - cursor) < count * block_size)
+			add_slab(count);
+	}
+
+	size_t live() const { return live_blocks; }
+	size_t capacity_bytes() const { return total_blocks * block_size; }
+
+private:
+	struct FreeBlock {
+		FreeBlock *next;
+	};
+
+	void add_slab(size_t blocks) {
+		void *slab = ::operator new(blocks * block_size, std::align_val_t(align));
+		slabs.push_back(slab);
+		cursor = static_cast<char*>(slab);
+		slab_end = cursor + blocks * block_size;
+		slab_blocks = blocks;
+		total_blocks += blocks;
+	}
+
+	size_t align;
+	size_t block_size;
+	std::vector<void*> slabs;
+	FreeBlock *free_list = nullptr;
+	char *cursor = nullptr;
+	char *slab_end = nullptr;
+	size_t slab_blocks = 0;
+	size_t total_blocks = 0;
+	size_t live_blocks = 0;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
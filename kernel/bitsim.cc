@@ -0,0 +1,521 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/bitsim.h"
+#include "kernel/cellaigs.h"
+#include "kernel/ffinit.h"
+#include "kernel/utils.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Slots 0 and 1 hold the constants, literals are slot*2 + inverted
+static const int SLOT_ZERO = 0, SLOT_ONE = 1;
+static const int LIT_ZERO = 0, LIT_ONE = 1;
+
+static inline uint64_t xorshift64(uint64_t &state)
+{
+	if (state == 0)
+		state = 0x9e3779b97f4a7c15ULL;
+	state ^= state << 13;
+	state ^= state >> 7;
+	state ^= state << 17;
+	return state;
+}
+
+struct BitSim::Lowering
+{
+	BitSim &sim;
+	// temporary slots are only used within the gates of a single cell and
+	// are shared between all cells
+	int temp_base, temp_next;
+
+	Lowering(BitSim &sim) : sim(sim)
+	{
+		temp_base = sim.num_slots;
+		temp_next = temp_base;
+	}
+
+	int lit(RTLIL::SigBit bit)
+	{
+		bit = sim.sigmap(bit);
+		if (bit.wire == nullptr) {
+			if (bit.data != State::S0 && bit.data != State::S1)
+				sim.found_undef = true;
+			return bit.data == State::S1 ? LIT_ONE : LIT_ZERO;
+		}
+		return 2 * sim.bit_slots.at(bit);
+	}
+
+	void emit(int y, int a, int b, bool inv_y)
+	{
+		gate_t g;
+		g.y = y;
+		g.a = a >> 1;
+		g.b = b >> 1;
+		g.inv_a = (a & 1) ? ~word_t(0) : 0;
+		g.inv_b = (b & 1) ? ~word_t(0) : 0;
+		g.inv_y = inv_y ? ~word_t(0) : 0;
+		sim.gates.push_back(g);
+	}
+
+	int and_gate(int a, int b)
+	{
+		if (a == LIT_ZERO || b == LIT_ZERO || a == (b ^ 1))
+			return LIT_ZERO;
+		if (a == LIT_ONE || a == b)
+			return b;
+		if (b == LIT_ONE)
+			return a;
+		int y = temp_next++;
+		sim.num_slots = max(sim.num_slots, temp_next);
+		emit(y, a, b, false);
+		return 2 * y;
+	}
+
+	int or_gate(int a, int b)
+	{
+		return and_gate(a ^ 1, b ^ 1) ^ 1;
+	}
+
+	int mux_gate(int a, int b, int s)
+	{
+		if (a == b)
+			return a;
+		return or_gate(and_gate(s ^ 1, a), and_gate(s, b));
+	}
+
+	void output(RTLIL::SigBit bit, int value)
+	{
+		bit = sim.sigmap(bit);
+		if (bit.wire == nullptr)
+			return;
+		emit(sim.bit_slots.at(bit), value, LIT_ONE, false);
+	}
+
+	void lower_aig(RTLIL::Cell *cell, const Aig &aig)
+	{
+		std::vector<int> node_lits(GetSize(aig.nodes));
+
+		for (int i = 0; i < GetSize(aig.nodes); i++)
+		{
+			const AigNode &node = aig.nodes[i];
+			int value;
+
+			if (!node.portname.empty()) {
+				value = lit(cell->getPort(node.portname)[node.portbit]) ^ node.inverter;
+			} else if (node.left_parent < 0 && node.right_parent < 0) {
+				value = node.inverter ? LIT_ONE : LIT_ZERO;
+			} else {
+				int a = node_lits[node.left_parent], b = node_lits[node.right_parent];
+				// write the first output bit driven by this node directly
+				RTLIL::SigBit first_out;
+				if (!node.outports.empty())
+					first_out = sim.sigmap(cell->getPort(node.outports.front().first)[node.outports.front().second]);
+				if (first_out.wire != nullptr) {
+					int y = sim.bit_slots.at(first_out);
+					emit(y, a, b, node.inverter);
+					value = 2 * y;
+				} else {
+					value = and_gate(a, b) ^ node.inverter;
+				}
+			}
+
+			node_lits[i] = value;
+			for (auto &oport : node.outports) {
+				RTLIL::SigBit bit = sim.sigmap(cell->getPort(oport.first)[oport.second]);
+				if (bit.wire != nullptr && value != 2 * sim.bit_slots.at(bit))
+					output(bit, value);
+			}
+		}
+	}
+
+	std::vector<int> port_lits(RTLIL::Cell *cell, IdString port, int width, bool is_signed)
+	{
+		RTLIL::SigSpec sig = cell->getPort(port);
+		std::vector<int> lits;
+		for (int i = 0; i < width; i++)
+			if (i < GetSize(sig))
+				lits.push_back(lit(sig[i]));
+			else
+				lits.push_back(is_signed && !sig.empty() ? lits.back() : LIT_ZERO);
+		return lits;
+	}
+
+	bool lower_pmux(RTLIL::Cell *cell)
+	{
+		int width = GetSize(cell->getPort(ID::Y));
+		std::vector<int> a = port_lits(cell, ID::A, width, false);
+		std::vector<int> b = port_lits(cell, ID::B, GetSize(cell->getPort(ID::B)), false);
+		std::vector<int> s = port_lits(cell, ID::S, GetSize(cell->getPort(ID::S)), false);
+
+		int any_s = LIT_ZERO;
+		for (int sel : s)
+			any_s = or_gate(any_s, sel);
+
+		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+		for (int i = 0; i < width; i++) {
+			int value = LIT_ZERO;
+			for (int j = 0; j < GetSize(s); j++)
+				value = or_gate(value, and_gate(s[j], b[j * width + i]));
+			output(sig_y[i], mux_gate(a[i], value, any_s));
+		}
+		return true;
+	}
+
+	bool lower_shift(RTLIL::Cell *cell)
+	{
+		bool signed_a = cell->getParam(ID::A_SIGNED).as_bool();
+		int width_a = GetSize(cell->getPort(ID::A));
+		int width_y = GetSize(cell->getPort(ID::Y));
+		bool left = cell->type.in(ID($shl), ID($sshl));
+
+		// the same extension of A as in const_shl() etc. in calc.cc
+		int len = width_a;
+		bool sign_ext = false;
+		if (cell->type == ID($shl))
+			len = width_y;
+		else if (cell->type == ID($shr))
+			len = max(width_y, width_a);
+		else
+			sign_ext = signed_a;
+
+		std::vector<int> value = port_lits(cell, ID::A, len, signed_a);
+		int fill = sign_ext && len > 0 ? value.back() : LIT_ZERO;
+		int width = max(width_y, len);
+		value.resize(width, fill);
+
+		std::vector<int> b = port_lits(cell, ID::B, GetSize(cell->getPort(ID::B)), false);
+		for (int k = 0; k < GetSize(b); k++) {
+			std::vector<int> shifted(width);
+			for (int i = 0; i < width; i++) {
+				int64_t pos = k < 31 ? int64_t(i) + (left ? -1 : 1) * (int64_t(1) << k) : -1;
+				if (left)
+					shifted[i] = pos >= 0 ? value[pos] : LIT_ZERO;
+				else
+					shifted[i] = k < 31 && pos < width ? value[pos] : fill;
+			}
+			for (int i = 0; i < width; i++)
+				value[i] = mux_gate(value[i], shifted[i], b[k]);
+		}
+
+		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+		for (int i = 0; i < width_y; i++)
+			output(sig_y[i], value[i]);
+		return true;
+	}
+
+	// $eqx and $nex are the same as $eq and $ne with two-valued logic
+	bool lower_eqx(RTLIL::Cell *cell)
+	{
+		bool is_signed = cell->getParam(ID::A_SIGNED).as_bool() && cell->getParam(ID::B_SIGNED).as_bool();
+		int width = max(GetSize(cell->getPort(ID::A)), GetSize(cell->getPort(ID::B)));
+		std::vector<int> a = port_lits(cell, ID::A, width, is_signed);
+		std::vector<int> b = port_lits(cell, ID::B, width, is_signed);
+
+		int equal = LIT_ONE;
+		for (int i = 0; i < width; i++) {
+			int diff = or_gate(and_gate(a[i], b[i] ^ 1), and_gate(a[i] ^ 1, b[i]));
+			equal = and_gate(equal, diff ^ 1);
+		}
+
+		RTLIL::SigSpec sig_y = cell->getPort(ID::Y);
+		for (int i = 0; i < GetSize(sig_y); i++)
+			output(sig_y[i], i > 0 ? LIT_ZERO : cell->type == ID($nex) ? equal ^ 1 : equal);
+		return true;
+	}
+
+	bool lower_equiv(RTLIL::Cell *cell)
+	{
+		output(cell->getPort(ID::Y).as_bit(), lit(cell->getPort(ID::A).as_bit()));
+		return true;
+	}
+
+	bool lower_native(RTLIL::Cell *cell)
+	{
+		if (cell->type == ID($equiv))
+			return lower_equiv(cell);
+		if (cell->type.in(ID($eqx), ID($nex)))
+			return lower_eqx(cell);
+		if (cell->type == ID($pmux))
+			return lower_pmux(cell);
+		if (cell->type.in(ID($shl), ID($shr), ID($sshl), ID($sshr)))
+			return lower_shift(cell);
+		return false;
+	}
+};
+
+BitSim::BitSim(RTLIL::Module *module, int lanes) : sigmap(module)
+{
+	log_assert(lanes > 0 && lanes % 64 == 0);
+	words = lanes / 64;
+	num_slots = 2;
+
+	for (auto wire : module->wires())
+		for (auto bit : sigmap(wire))
+			if (bit.wire != nullptr && !bit_slots.count(bit))
+				bit_slots[bit] = num_slots++;
+
+	FfInitVals initvals(&sigmap, module);
+	dict<std::pair<IdString, dict<IdString, RTLIL::Const>>, Aig> aigs;
+	dict<RTLIL::Cell*, const Aig*> cell_aigs;
+	std::vector<RTLIL::Cell*> comb_cells;
+
+	for (auto cell : module->cells())
+	{
+		if (cell->is_builtin_ff()) {
+			FfData ff(&initvals, cell);
+			if (!ff.has_arst && !ff.has_aload && !ff.has_sr && (ff.has_clk || ff.has_gclk)) {
+				ffs.emplace_back();
+				ffs.back().data = ff;
+				ffs.back().data.initvals = nullptr;
+				continue;
+			}
+			unsupported_cells.insert(cell);
+			continue;
+		}
+
+		bool has_outputs = false;
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first))
+				has_outputs = true;
+		if (!has_outputs)
+			continue;
+
+		auto fingerprint = std::make_pair(cell->type, cell->parameters);
+		if (!aigs.count(fingerprint))
+			aigs.emplace(fingerprint, Aig(cell));
+		if (aigs.at(fingerprint).name.empty() && !cell->type.in(ID($eqx), ID($nex), ID($pmux), ID($shl), ID($shr), ID($sshl), ID($sshr), ID($equiv))) {
+			unsupported_cells.insert(cell);
+			continue;
+		}
+		comb_cells.push_back(cell);
+	}
+
+	for (auto cell : comb_cells) {
+		const Aig &aig = aigs.at(std::make_pair(cell->type, cell->parameters));
+		cell_aigs[cell] = aig.name.empty() ? nullptr : &aig;
+	}
+
+	dict<RTLIL::SigBit, RTLIL::Cell*> drivers;
+	for (auto cell : comb_cells)
+		for (auto &conn : cell->connections())
+			if (cell->output(conn.first))
+				for (auto bit : sigmap(conn.second))
+					if (bit.wire != nullptr)
+						drivers[bit] = cell;
+
+	TopoSort<RTLIL::Cell*, IdString::compare_ptr_by_name<RTLIL::Cell>> toposort;
+	for (auto cell : comb_cells) {
+		toposort.node(cell);
+		for (auto &conn : cell->connections())
+			if (cell->input(conn.first))
+				for (auto bit : sigmap(conn.second))
+					if (drivers.count(bit))
+						toposort.edge(drivers.at(bit), cell);
+	}
+	if (!toposort.sort())
+		for (auto &loop : toposort.loops)
+			for (auto cell : loop)
+				loop_cells.insert(cell);
+
+	Lowering lowering(*this);
+	for (auto cell : toposort.sorted) {
+		lowering.temp_next = lowering.temp_base;
+		if (cell_aigs.at(cell) != nullptr)
+			lowering.lower_aig(cell, *cell_aigs.at(cell));
+		else
+			lowering.lower_native(cell);
+	}
+
+	for (auto &ff : ffs) {
+		auto slots = [&](const RTLIL::SigSpec &sig) {
+			std::vector<int> result;
+			for (auto bit : sig)
+				result.push_back(slot(bit));
+			return result;
+		};
+		ff.q = slots(ff.data.sig_q);
+		ff.d = slots(ff.data.sig_d);
+		if (ff.data.has_ce)
+			ff.ce = slots(ff.data.sig_ce);
+		if (ff.data.has_srst)
+			ff.srst = slots(ff.data.sig_srst);
+		for (auto bit : sigmap(ff.data.sig_q))
+			if (bit.wire != nullptr)
+				ff_q_bits.push_back(bit);
+		for (auto bit : sigmap(ff.data.sig_d))
+			if (bit.wire == nullptr && bit.data != State::S0 && bit.data != State::S1)
+				found_undef = true;
+	}
+
+	pool<RTLIL::SigBit> seen;
+	for (auto wire : module->wires())
+		for (auto bit : sigmap(wire))
+			if (bit.wire != nullptr && !drivers.count(bit) && seen.insert(bit).second)
+				input_bits.push_back(bit);
+
+	values.resize(size_t(num_slots) * words);
+	for (int i = 0; i < words; i++)
+		values[SLOT_ONE * words + i] = ~word_t(0);
+}
+
+int BitSim::slot(RTLIL::SigBit bit) const
+{
+	bit = sigmap(bit);
+	if (bit.wire == nullptr)
+		return bit.data == State::S1 ? SLOT_ONE : SLOT_ZERO;
+	return bit_slots.at(bit);
+}
+
+BitSim::word_t *BitSim::data(RTLIL::SigBit bit)
+{
+	return values.data() + size_t(slot(bit)) * words;
+}
+
+const BitSim::word_t *BitSim::data(RTLIL::SigBit bit) const
+{
+	return values.data() + size_t(slot(bit)) * words;
+}
+
+bool BitSim::get(RTLIL::SigBit bit, int lane) const
+{
+	return (data(bit)[lane / 64] >> (lane % 64)) & 1;
+}
+
+void BitSim::set(RTLIL::SigBit bit, int lane, bool value)
+{
+	log_assert(slot(bit) > SLOT_ONE);
+	word_t &w = data(bit)[lane / 64];
+	word_t mask = word_t(1) << (lane % 64);
+	w = value ? w | mask : w & ~mask;
+}
+
+RTLIL::Const BitSim::get(const RTLIL::SigSpec &sig, int lane) const
+{
+	RTLIL::Const value(State::S0, GetSize(sig));
+	for (int i = 0; i < GetSize(sig); i++)
+		if (get(sig[i], lane))
+			value.set(i, State::S1);
+	return value;
+}
+
+void BitSim::set(const RTLIL::SigSpec &sig, int lane, const RTLIL::Const &value)
+{
+	log_assert(GetSize(sig) <= GetSize(value));
+	for (int i = 0; i < GetSize(sig); i++)
+		set(sig[i], lane, value[i] == State::S1);
+}
+
+void BitSim::set_all(RTLIL::SigBit bit, bool value)
+{
+	log_assert(slot(bit) > SLOT_ONE);
+	word_t *w = data(bit);
+	for (int i = 0; i < words; i++)
+		w[i] = value ? ~word_t(0) : 0;
+}
+
+void BitSim::randomize(uint64_t &rng, bool include_state)
+{
+	pool<RTLIL::SigBit> state;
+	if (!include_state)
+		state.insert(ff_q_bits.begin(), ff_q_bits.end());
+
+	for (auto bit : input_bits) {
+		if (state.count(bit))
+			continue;
+		word_t *w = data(bit);
+		for (int i = 0; i < words; i++)
+			w[i] = xorshift64(rng);
+	}
+}
+
+void BitSim::init_state(uint64_t &rng)
+{
+	for (auto &ff : ffs)
+		for (int i = 0; i < GetSize(ff.q); i++) {
+			if (ff.q[i] <= SLOT_ONE)
+				continue;
+			word_t *w = values.data() + size_t(ff.q[i]) * words;
+			State init = ff.data.val_init[i];
+			for (int k = 0; k < words; k++)
+				w[k] = init == State::S1 ? ~word_t(0) : init == State::S0 ? 0 : xorshift64(rng);
+		}
+}
+
+void BitSim::run()
+{
+	word_t *v = values.data();
+
+	if (words == 1) {
+		for (const gate_t &g : gates)
+			v[g.y] = ((v[g.a] ^ g.inv_a) & (v[g.b] ^ g.inv_b)) ^ g.inv_y;
+		return;
+	}
+
+	// plain loops over the words of each gate, which the compiler turns into
+	// vector instructions
+	for (const gate_t &g : gates) {
+		word_t *y = v + size_t(g.y) * words;
+		const word_t *a = v + size_t(g.a) * words;
+		const word_t *b = v + size_t(g.b) * words;
+		for (int i = 0; i < words; i++)
+			y[i] = ((a[i] ^ g.inv_a) & (b[i] ^ g.inv_b)) ^ g.inv_y;
+	}
+}
+
+void BitSim::clock()
+{
+	ff_next.clear();
+
+	for (auto &ff : ffs)
+	{
+		FfData &data = ff.data;
+		word_t inv_ce = data.has_ce && !data.pol_ce ? ~word_t(0) : 0;
+		word_t inv_srst = data.has_srst && !data.pol_srst ? ~word_t(0) : 0;
+
+		for (int i = 0; i < GetSize(ff.q); i++) {
+			const word_t *q = values.data() + size_t(ff.q[i]) * words;
+			const word_t *d = values.data() + size_t(ff.d[i]) * words;
+			const word_t *ce = data.has_ce ? values.data() + size_t(ff.ce[0]) * words : nullptr;
+			const word_t *srst = data.has_srst ? values.data() + size_t(ff.srst[0]) * words : nullptr;
+			word_t rval = data.has_srst && data.val_srst[i] == State::S1 ? ~word_t(0) : 0;
+
+			for (int k = 0; k < words; k++) {
+				word_t en = ce ? ce[k] ^ inv_ce : ~word_t(0);
+				word_t rst = srst ? srst[k] ^ inv_srst : 0;
+				if (data.ce_over_srst)
+					rst &= en;
+				word_t next = (en & d[k]) | (~en & q[k]);
+				ff_next.push_back((rst & rval) | (~rst & next));
+			}
+		}
+	}
+
+	int idx = 0;
+	for (auto &ff : ffs)
+		for (int i = 0; i < GetSize(ff.q); i++) {
+			if (ff.q[i] <= SLOT_ONE) {
+				idx += words;
+				continue;
+			}
+			word_t *q = values.data() + size_t(ff.q[i]) * words;
+			for (int k = 0; k < words; k++)
+				q[k] = ff_next[idx++];
+		}
+}
+
+YOSYS_NAMESPACE_END
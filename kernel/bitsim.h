@@ -0,0 +1,117 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef BITSIM_H
+#define BITSIM_H
+
+#include "kernel/yosys.h"
+#include "kernel/sigtools.h"
+#include "kernel/ff.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Two-valued simulation of many independent stimulus vectors ("lanes") at
+// once. Every signal bit holds one bit per lane, packed into 64-bit words,
+// and the combinational cells are lowered to AND-inverter graphs (see
+// cellaigs.h, plus models for $eqx, $pmux and shifts), so that one pass over
+// a flat list of gates evaluates all lanes with plain word operations. $equiv
+// cells pass their A input through, as in the SAT model.
+//
+// Bits that aren't driven by a simulated cell are inputs: module inputs,
+// undriven wires, FF outputs and the outputs of cells without a model.
+// Undefined constants are simulated as 0. Flip-flops without asynchronous
+// reset or load are advanced together by clock(), regardless of their clock
+// signal. All other FFs are treated like cells without a model.
+struct BitSim
+{
+	typedef uint64_t word_t;
+
+	SigMap sigmap;
+
+	// Cells that have no model, their outputs are inputs.
+	pool<RTLIL::Cell*> unsupported_cells;
+	// Cells that are part of a combinational loop. They are evaluated in an
+	// arbitrary order and their outputs are not meaningful.
+	pool<RTLIL::Cell*> loop_cells;
+	// Set when the logic reads an undefined constant bit.
+	bool found_undef = false;
+
+	BitSim(RTLIL::Module *module, int lanes = 64);
+
+	int lanes() const { return 64 * words; }
+	int num_gates() const { return GetSize(gates); }
+
+	// The input bits of the simulated logic (sigmapped), including the FF
+	// outputs that are updated by clock().
+	const std::vector<RTLIL::SigBit> &inputs() const { return input_bits; }
+	// The FF outputs that are updated by clock().
+	const std::vector<RTLIL::SigBit> &state_bits() const { return ff_q_bits; }
+
+	// Pointer to the lanes()/64 words of a signal bit of the module.
+	// Constant bits map to read-only slots.
+	word_t *data(RTLIL::SigBit bit);
+	const word_t *data(RTLIL::SigBit bit) const;
+
+	bool get(RTLIL::SigBit bit, int lane) const;
+	void set(RTLIL::SigBit bit, int lane, bool value);
+	RTLIL::Const get(const RTLIL::SigSpec &sig, int lane) const;
+	void set(const RTLIL::SigSpec &sig, int lane, const RTLIL::Const &value);
+	// Sets a bit to the same value in all lanes.
+	void set_all(RTLIL::SigBit bit, bool value);
+
+	// Fills all inputs with pseudo-random values, drawn from the xorshift
+	// generator state in `rng`.
+	void randomize(uint64_t &rng, bool include_state = true);
+	// Sets the FF outputs to their init values, or random values for bits
+	// without a defined init value.
+	void init_state(uint64_t &rng);
+
+	// Evaluates all combinational cells.
+	void run();
+	// Loads the FF outputs with their next state, computed from the values
+	// produced by the last run().
+	void clock();
+
+private:
+	struct gate_t {
+		// y = ((a ^ inv_a) & (b ^ inv_b)) ^ inv_y, slots index `values`
+		int y, a, b;
+		word_t inv_a, inv_b, inv_y;
+	};
+
+	struct ff_t {
+		FfData data;
+		std::vector<int> q, d, ce, srst;
+	};
+
+	int words;
+	int num_slots = 0;
+	std::vector<word_t> values;
+	std::vector<gate_t> gates;
+	std::vector<ff_t> ffs;
+	std::vector<word_t> ff_next;
+	dict<RTLIL::SigBit, int> bit_slots;
+	std::vector<RTLIL::SigBit> input_bits, ff_q_bits;
+
+	struct Lowering;
+
+	int slot(RTLIL::SigBit bit) const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -22,6 +22,10 @@
 #include <type_traits>
 #include <stdint.h>
 
+#if defined(YOSYS_HASHLIB_SWISS) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #define YS_HASHING_VERSION 1
 
 namespace hashlib {
@@ -52,6 +56,12 @@ namespace hashlib {
  * We implement associative data structures with separate chaining.
  * Linked lists use integers into the indirection hashtable array
  * instead of pointers.
+ *
+ * When YOSYS_HASHLIB_SWISS is defined (ENABLE_HASHLIB_SWISS=1), dict<> and
+ * pool<> use the open addressing swiss_index instead. Entries are stored
+ * the same way in both variants, so the API, iteration order and hashing are
+ * identical, only memory use and performance differ. Plugins must be built
+ * with the same setting as Yosys.
  */
 
 const int hashtable_size_trigger = 2;
@@ -373,6 +383,191 @@ template<typename K, int offset = 0, typename OPS = hash_ops<K>> class idict;
 template<typename K, typename OPS = hash_ops<K>> class pool;
 template<typename K, typename OPS = hash_ops<K>> class mfp;
 
+#ifdef YOSYS_HASHLIB_SWISS
+/**
+ * Open addressing index used by dict<> and pool<> when YOSYS_HASHLIB_SWISS
+ * is defined, in the style of SwissTable. It maps hashes to positions in the
+ * entries vector of the container, the entries themselves stay in insertion
+ * order so iteration order doesn't change.
+ *
+ * Slots are organized in groups of 16. Each slot has a control byte that is
+ * either empty, deleted or holds the low 7 bits of the hash of its entry, so
+ * a probe compares a whole group with one SIMD comparison (or a short loop
+ * without SSE2) and only looks at the entries whose control byte matches.
+ * Groups are probed in triangular order from the group selected by the
+ * remaining hash bits.
+ */
+class swiss_index
+{
+	static constexpr int group_size = 16;
+	static constexpr int8_t ctrl_empty = -128;
+	static constexpr int8_t ctrl_deleted = -2;
+
+	std::vector<int8_t> ctrl;
+	std::vector<int> slots;
+	size_t used = 0;
+	size_t tombstones = 0;
+
+	static int8_t h2(Hasher::hash_t hash) { return hash & 0x7f; }
+	static size_t h1(Hasher::hash_t hash) { return hash >> 7; }
+
+	static uint32_t match(const int8_t *group, int8_t value)
+	{
+#ifdef __SSE2__
+		__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+		return _mm_movemask_epi8(_mm_cmpeq_epi8(data, _mm_set1_epi8(value)));
+#else
+		uint32_t mask = 0;
+		for (int i = 0; i < group_size; i++)
+			mask |= uint32_t(group[i] == value) << i;
+		return mask;
+#endif
+	}
+
+	// empty and deleted slots, which are the ones with the sign bit set
+	static uint32_t match_free(const int8_t *group)
+	{
+#ifdef __SSE2__
+		return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(group)));
+#else
+		uint32_t mask = 0;
+		for (int i = 0; i < group_size; i++)
+			mask |= uint32_t(group[i] < 0) << i;
+		return mask;
+#endif
+	}
+
+	static int lowest_bit(uint32_t mask)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		return __builtin_ctz(mask);
+#else
+		int i = 0;
+		while (!(mask & 1)) {
+			mask >>= 1;
+			i++;
+		}
+		return i;
+#endif
+	}
+
+	size_t find_slot(Hasher::hash_t hash, int index) const
+	{
+		size_t mask = ctrl.size() / group_size - 1;
+		size_t group = h1(hash) & mask;
+		for (size_t step = 1;; step++) {
+			size_t base = group * group_size;
+			for (uint32_t m = match(&ctrl[base], h2(hash)); m; m &= m - 1)
+				if (slots[base + lowest_bit(m)] == index)
+					return base + lowest_bit(m);
+			if (step > ctrl.size() / group_size)
+				throw std::runtime_error("swiss_index: entry not found.");
+			group = (group + step) & mask;
+		}
+	}
+
+public:
+	bool empty() const { return ctrl.empty(); }
+
+	void clear()
+	{
+		ctrl.clear();
+		slots.clear();
+		used = 0;
+		tombstones = 0;
+	}
+
+	void swap(swiss_index &other)
+	{
+		ctrl.swap(other.ctrl);
+		slots.swap(other.slots);
+		std::swap(used, other.used);
+		std::swap(tombstones, other.tombstones);
+	}
+
+	// Drop all slots and make room for `capacity` entries at a load factor
+	// of at most 7/8.
+	void reset(size_t capacity)
+	{
+		size_t groups = 1;
+		while (groups * group_size * 7 < (capacity + 1) * 8)
+			groups *= 2;
+		ctrl.assign(groups * group_size, ctrl_empty);
+		slots.assign(groups * group_size, -1);
+		used = 0;
+		tombstones = 0;
+	}
+
+	// Whether another entry can be inserted without exceeding the load factor.
+	bool has_room() const
+	{
+		return (used + tombstones + 1) * 8 <= ctrl.size() * 7;
+	}
+
+	template<typename Eq>
+	int find(Hasher::hash_t hash, const Eq &eq) const
+	{
+		size_t mask = ctrl.size() / group_size - 1;
+		size_t group = h1(hash) & mask;
+		for (size_t step = 1;; step++) {
+			size_t base = group * group_size;
+			for (uint32_t m = match(&ctrl[base], h2(hash)); m; m &= m - 1) {
+				int index = slots[base + lowest_bit(m)];
+				if (eq(index))
+					return index;
+			}
+			if (match(&ctrl[base], ctrl_empty))
+				return -1;
+			group = (group + step) & mask;
+		}
+	}
+
+	// The key must not be in the index yet and has_room() must be true.
+	void insert(Hasher::hash_t hash, int index)
+	{
+		size_t mask = ctrl.size() / group_size - 1;
+		size_t group = h1(hash) & mask;
+		for (size_t step = 1;; step++) {
+			size_t base = group * group_size;
+			uint32_t m = match_free(&ctrl[base]);
+			if (m) {
+				size_t slot = base + lowest_bit(m);
+				if (ctrl[slot] == ctrl_deleted)
+					tombstones--;
+				ctrl[slot] = h2(hash);
+				slots[slot] = index;
+				used++;
+				return;
+			}
+			group = (group + step) & mask;
+		}
+	}
+
+	void erase(Hasher::hash_t hash, int index)
+	{
+		size_t slot = find_slot(hash, index);
+		size_t base = slot - slot % group_size;
+		// A probe only continues past a group without empty slots, and a
+		// group that was ever full never gets an empty slot back. So if this
+		// group still has an empty slot, no probe depends on this one.
+		if (match(&ctrl[base], ctrl_empty)) {
+			ctrl[slot] = ctrl_empty;
+		} else {
+			ctrl[slot] = ctrl_deleted;
+			tombstones++;
+		}
+		slots[slot] = -1;
+		used--;
+	}
+
+	// Update the position of an entry that was moved within the entries vector.
+	void relocate(Hasher::hash_t hash, int from, int to)
+	{
+		slots[find_slot(hash, from)] = to;
+	}
+};
+#endif
+
 // Computes the hash value of an unordered set of elements.
 // See https://www.preprints.org/manuscript/201710.0192/v1/download.
 // This is the Sum(4) algorithm from that paper, which has good collision resistance,
@@ -398,6 +593,117 @@ private:
 
 template<typename K, typename T, typename OPS>
 class dict {
+#ifdef YOSYS_HASHLIB_SWISS
+	struct entry_t
+	{
+		std::pair<K, T> udata;
+
+		entry_t() { }
+		entry_t(const std::pair<K, T> &udata) : udata(udata) { }
+		entry_t(std::pair<K, T> &&udata) : udata(std::move(udata)) { }
+		bool operator<(const entry_t &other) const { return udata.first < other.udata.first; }
+	};
+
+	swiss_index hashtable;
+	std::vector<entry_t> entries;
+	OPS ops;
+
+#ifdef NDEBUG
+	static inline void do_assert(bool) { }
+#else
+	static inline void do_assert(bool cond) {
+		if (!cond) throw std::runtime_error("dict<> assert failed.");
+	}
+#endif
+
+	Hasher::hash_t do_hash(const K &key) const
+	{
+		Hasher::hash_t hash = 0;
+		if (!hashtable.empty())
+			hash = ops.hash(key).yield();
+		return hash;
+	}
+
+	void do_rehash()
+	{
+		if (entries.empty()) {
+			hashtable.clear();
+			return;
+		}
+		hashtable.reset(entries.capacity());
+		for (int i = 0; i < int(entries.size()); i++)
+			hashtable.insert(ops.hash(entries[i].udata.first).yield(), i);
+	}
+
+	int do_erase(int index, Hasher::hash_t hash)
+	{
+		do_assert(index < int(entries.size()));
+		if (hashtable.empty() || index < 0)
+			return 0;
+
+		hashtable.erase(hash, index);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			hashtable.relocate(do_hash(entries[back_idx].udata.first), back_idx, index);
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			hashtable.clear();
+
+		return 1;
+	}
+
+	int do_lookup(const K &key, Hasher::hash_t &hash)
+	{
+		return do_lookup_no_rehash(key, hash);
+	}
+
+	int do_lookup_internal(const K &key, Hasher::hash_t hash) const
+	{
+		return hashtable.find(hash, [&](int index) { return ops.cmp(entries[index].udata.first, key); });
+	}
+
+	int do_lookup_no_rehash(const K &key, Hasher::hash_t hash) const
+	{
+		if (hashtable.empty())
+			return -1;
+
+		return do_lookup_internal(key, hash);
+	}
+
+	int do_insert_back(Hasher::hash_t hash)
+	{
+		if (hashtable.empty() || !hashtable.has_room())
+			do_rehash();
+		else
+			hashtable.insert(hash, entries.size() - 1);
+		return entries.size() - 1;
+	}
+
+	int do_insert(const K &key, const Hasher::hash_t &hash)
+	{
+		entries.emplace_back(std::pair<K, T>(key, T()));
+		return do_insert_back(hash);
+	}
+
+	int do_insert(const std::pair<K, T> &value, const Hasher::hash_t &hash)
+	{
+		entries.emplace_back(value);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(std::pair<K, T> &&rvalue, const Hasher::hash_t &hash)
+	{
+		entries.emplace_back(std::forward<std::pair<K, T>>(rvalue));
+		return do_insert_back(hash);
+	}
+#else
 	struct entry_t
 	{
 		std::pair<K, T> udata;
@@ -560,6 +866,8 @@ class dict {
 		return entries.size() - 1;
 	}
 
+#endif
+
 public:
 	class const_iterator
 	{
@@ -877,6 +1185,112 @@ class pool
 	template<typename, int, typename> friend class idict;
 
 protected:
+#ifdef YOSYS_HASHLIB_SWISS
+	struct entry_t
+	{
+		K udata;
+
+		entry_t() { }
+		entry_t(const K &udata) : udata(udata) { }
+		entry_t(K &&udata) : udata(std::move(udata)) { }
+	};
+
+	swiss_index hashtable;
+	std::vector<entry_t> entries;
+	OPS ops;
+
+#ifdef NDEBUG
+	static inline void do_assert(bool) { }
+#else
+	static inline void do_assert(bool cond) {
+		if (!cond) throw std::runtime_error("pool<> assert failed.");
+	}
+#endif
+
+	Hasher::hash_t do_hash(const K &key) const
+	{
+		Hasher::hash_t hash = 0;
+		if (!hashtable.empty())
+			hash = ops.hash(key).yield();
+		return hash;
+	}
+
+	void do_rehash()
+	{
+		if (entries.empty()) {
+			hashtable.clear();
+			return;
+		}
+		hashtable.reset(entries.capacity());
+		for (int i = 0; i < int(entries.size()); i++)
+			hashtable.insert(ops.hash(entries[i].udata).yield(), i);
+	}
+
+	int do_erase(int index, Hasher::hash_t hash)
+	{
+		do_assert(index < int(entries.size()));
+		if (hashtable.empty() || index < 0)
+			return 0;
+
+		hashtable.erase(hash, index);
+
+		int back_idx = entries.size()-1;
+
+		if (index != back_idx)
+		{
+			hashtable.relocate(do_hash(entries[back_idx].udata), back_idx, index);
+			entries[index] = std::move(entries[back_idx]);
+		}
+
+		entries.pop_back();
+
+		if (entries.empty())
+			hashtable.clear();
+
+		return 1;
+	}
+
+	int do_lookup(const K &key, Hasher::hash_t &hash)
+	{
+		return do_lookup_no_rehash(key, hash);
+	}
+
+	int do_lookup_internal(const K &key, Hasher::hash_t hash) const
+	{
+		return hashtable.find(hash, [&](int index) { return ops.cmp(entries[index].udata, key); });
+	}
+
+	int do_lookup_no_rehash(const K &key, Hasher::hash_t hash) const
+	{
+		if (hashtable.empty())
+			return -1;
+
+		return do_lookup_internal(key, hash);
+	}
+
+	int do_insert_back(Hasher::hash_t &hash)
+	{
+		if (hashtable.empty() || !hashtable.has_room()) {
+			do_rehash();
+			hash = do_hash(entries.back().udata);
+		} else {
+			hashtable.insert(hash, entries.size() - 1);
+		}
+		return entries.size() - 1;
+	}
+
+	int do_insert(const K &value, Hasher::hash_t &hash)
+	{
+		entries.emplace_back(value);
+		return do_insert_back(hash);
+	}
+
+	int do_insert(K &&rvalue, Hasher::hash_t &hash)
+	{
+		entries.emplace_back(std::forward<K>(rvalue));
+		return do_insert_back(hash);
+	}
+#else
 	struct entry_t
 	{
 		K udata;
@@ -1024,6 +1438,8 @@ protected:
 		return entries.size() - 1;
 	}
 
+#endif
+
 public:
 	class const_iterator
 	{
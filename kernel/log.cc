@@ -18,6 +18,7 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include "backends/rtlil/rtlil_backend.h"
 
@@ -64,10 +65,14 @@ void (*log_verific_callback)(int msg_type, const char *message_id, const char* f
 
 int log_make_debug = 0;
 int log_force_debug = 0;
-int log_debug_suppressed = 0;
+thread_local int log_debug_suppressed = 0;
+thread_local DeferredLogs *log_deferred = nullptr;
 
 vector<int> header_count;
 vector<char*> log_id_cache;
+#ifdef YOSYS_ENABLE_THREADS
+static std::mutex log_id_cache_mutex;
+#endif
 
 static struct timeval initial_tv = { 0, 0 };
 static bool next_print_log = false;
@@ -205,11 +210,21 @@ void log_formatted_string(std::string_view format, std::string str)
 {
 	if (log_make_debug && !ys_debug(1))
 		return;
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::Log, {}, std::move(str));
+		return;
+	}
 	logv_string(format, std::move(str));
 }
 
 void log_formatted_header(RTLIL::Design *design, std::string_view format, std::string str)
 {
+	// headers are numbered, which is done when deferred output is replayed
+	if (log_deferred) {
+		log_deferred->append_header(design, std::move(str));
+		return;
+	}
+
 	bool pop_errfile = false;
 
 	log_spacer();
@@ -249,6 +264,11 @@ void log_formatted_header(RTLIL::Design *design, std::string_view format, std::s
 
 void log_formatted_warning(std::string_view prefix, std::string message)
 {
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::Warning, std::string(prefix), std::move(message));
+		return;
+	}
+
 	bool suppressed = false;
 
 	for (auto &re : log_nowarn_regexes)
@@ -318,9 +338,13 @@ void log_formatted_file_info(std::string_view filename, int lineno, std::string
 	log("%s:%d: Info: %s", filename, lineno, str);
 }
 
-[[noreturn]]
-static void log_error_with_prefix(std::string_view prefix, std::string str)
+void log_formatted_error_with_prefix(std::string_view prefix, std::string str)
 {
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::Error, std::string(prefix), std::move(str));
+		throw log_deferred_error_exception();
+	}
+
 #ifdef EMSCRIPTEN
 	auto backup_log_files = log_files;
 #endif
@@ -373,7 +397,7 @@ static void log_error_with_prefix(std::string_view prefix, std::string str)
 void log_formatted_file_error(std::string_view filename, int lineno, std::string str)
 {
 	std::string prefix = stringf("%s:%d: ERROR: ", filename, lineno);
-	log_error_with_prefix(prefix, str);
+	log_formatted_error_with_prefix(prefix, str);
 }
 
 void logv_file_error(const string &filename, int lineno,
@@ -384,6 +408,10 @@ void logv_file_error(const string &filename, int lineno,
 
 void log_experimental(const std::string &str)
 {
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::Experimental, {}, str);
+		return;
+	}
 	if (log_experimentals_ignored.count(str) == 0 && log_experimentals.count(str) == 0) {
 		log_warning("Feature '%s' is experimental.\n", str);
 		log_experimentals.insert(str);
@@ -392,7 +420,7 @@ void log_experimental(const std::string &str)
 
 void log_formatted_error(std::string str)
 {
-	log_error_with_prefix("ERROR: ", std::move(str));
+	log_formatted_error_with_prefix("ERROR: ", std::move(str));
 }
 
 void log_assert_failure(const char *expr, const char *file, int line)
@@ -407,6 +435,11 @@ void log_abort_internal(const char *file, int line)
 
 void log_formatted_cmd_error(std::string str)
 {
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::CmdError, {}, std::move(str));
+		throw log_deferred_error_exception();
+	}
+
 	if (log_cmd_error_throw) {
 		log_last_error = str;
 
@@ -432,6 +465,10 @@ void log_formatted_cmd_error(std::string str)
 
 void log_spacer()
 {
+	if (log_deferred) {
+		log_deferred->append(DeferredLogs::Kind::Spacer, {}, {});
+		return;
+	}
 	if (log_newline_count < 2) log("\n");
 	if (log_newline_count < 2) log("\n");
 }
@@ -555,6 +592,9 @@ void log_reset_stack()
 
 void log_flush()
 {
+	if (log_deferred)
+		return;
+
 	for (auto f : log_files)
 		fflush(f);
 
@@ -592,6 +632,9 @@ std::string log_const(const RTLIL::Const &value, bool autoint)
 const char *log_id(const RTLIL::IdString &str)
 {
 	std::string unescaped = RTLIL::unescape_id(str);
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(log_id_cache_mutex);
+#endif
 	log_id_cache.push_back(strdup(unescaped.c_str()));
 	return log_id_cache.back();
 }
@@ -94,6 +94,17 @@ YOSYS_NAMESPACE_BEGIN
 
 struct log_cmd_error_exception { };
 
+// Thrown by log_error() and log_cmd_error() while log output is deferred. The
+// error itself has been recorded and is raised when the deferred output is
+// flushed.
+struct log_deferred_error_exception { };
+
+// When set, log(), log_warning(), log_error() and friends called on this
+// thread append to this buffer instead of writing to the log. See DeferredLogs
+// and parallel_for_modules() in kernel/threading.h.
+class DeferredLogs;
+extern thread_local DeferredLogs *log_deferred;
+
 extern std::vector<FILE*> log_files;
 extern std::vector<std::ostream*> log_streams;
 extern std::vector<std::string> log_scratchpads;
@@ -117,7 +128,7 @@ extern void (*log_error_atexit)();
 
 extern int log_make_debug;
 extern int log_force_debug;
-extern int log_debug_suppressed;
+extern thread_local int log_debug_suppressed;
 
 [[deprecated]]
 [[noreturn]] void logv_file_error(const string &filename, int lineno, const char *format, va_list ap);
@@ -185,6 +196,7 @@ void log_file_info(std::string_view filename, int lineno, FmtString<TypeIdentity
 }
 
 [[noreturn]] void log_formatted_error(std::string str);
+[[noreturn]] void log_formatted_error_with_prefix(std::string_view prefix, std::string str);
 template <typename... Args>
 [[noreturn]] void log_error(FmtString<TypeIdentity<Args>...> fmt, const Args &... args)
 {
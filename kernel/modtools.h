@@ -24,6 +24,8 @@
 #include "kernel/sigtools.h"
 #include "kernel/celltypes.h"
 
+#include <mutex>
+
 YOSYS_NAMESPACE_BEGIN
 
 struct ModIndex : public RTLIL::Monitor
@@ -48,8 +50,10 @@ struct ModIndex : public RTLIL::Monitor
 			return cell == other.cell && port == other.port && offset == other.offset;
 		}
 
+		// hashes the cell by its hashidx_ rather than its name, so that
+		// cached indices survive renaming cells
 		[[nodiscard]] Hasher hash_into(Hasher h) const {
-			h.eat(cell->name);
+			h = cell->hash_into(h);
 			h.eat(port);
 			h.eat(offset);
 			return h;
@@ -80,6 +84,21 @@ struct ModIndex : public RTLIL::Monitor
 	std::map<RTLIL::SigBit, SigBitInfo> database;
 	int auto_reload_counter;
 	bool auto_reload_module;
+	Hasher::hash_t loaded_ports_hash = 0;
+
+	// Port directions aren't reported to monitors, so this is how cached()
+	// notices that they changed since the last reload
+	Hasher::hash_t ports_hash() const
+	{
+		Hasher h;
+		for (auto port : module->ports) {
+			RTLIL::Wire *wire = module->wire(port);
+			h.eat(port);
+			h.eat(wire != nullptr && wire->port_input);
+			h.eat(wire != nullptr && wire->port_output);
+		}
+		return h.yield();
+	}
 
 	void port_add(RTLIL::Cell *cell, RTLIL::IdString port, const RTLIL::SigSpec &sig)
 	{
@@ -124,6 +143,7 @@ struct ModIndex : public RTLIL::Monitor
 		for (auto cell : module->cells())
 			for (auto &conn : cell->connections())
 				port_add(cell, conn.first, conn.second);
+		loaded_ports_hash = ports_hash();
 
 		if (auto_reload_module) {
 			if (++auto_reload_counter > 2)
@@ -229,6 +249,13 @@ struct ModIndex : public RTLIL::Monitor
 		auto_reload_module = true;
 	}
 
+	// the database is ordered by wire name
+	void notify_rename(RTLIL::Wire *wire, const RTLIL::IdString &) override
+	{
+		log_assert(module == wire->module);
+		auto_reload_module = true;
+	}
+
 	ModIndex(RTLIL::Module *_m) : sigmap(_m), module(_m)
 	{
 		auto_reload_counter = 0;
@@ -241,6 +268,13 @@ struct ModIndex : public RTLIL::Monitor
 		module->monitors.erase(this);
 	}
 
+	// Returns an index of the module that is owned by its design and shared by
+	// the code that asks for it until the end of the pass, see ModIndexCache.
+	// It stays registered as a monitor, so unlike a local ModIndex it doesn't
+	// have to be rebuilt by the next caller unless the module was changed in a
+	// way that requires a reload.
+	static ModIndex &cached(RTLIL::Module *module);
+
 	SigBitInfo *query(RTLIL::SigBit bit)
 	{
 		if (auto_reload_module)
@@ -300,6 +334,122 @@ struct ModIndex : public RTLIL::Monitor
 	}
 };
 
+// The ModIndex and IncrementalSigMap instances handed out by ModIndex::cached()
+// and IncrementalSigMap::cached(), one of each per module. Owned by
+// RTLIL::Design, which drops those of a module when the module is removed
+// from the design.
+//
+// The instances only follow edits made through calls that notify monitors,
+// and some passes edit connections in place. So Pass::post_execute() drops
+// all of them at the end of every pass, unless a Keep is alive.
+struct ModIndexCache
+{
+	dict<RTLIL::Module*, ModIndex*> indices;
+	dict<RTLIL::Module*, IncrementalSigMap*> sigmaps;
+	int keep_depth = 0;
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+#endif
+
+	// Keeps the instances across the passes called while it is alive. For
+	// passes such as opt that only call sub-passes which notify monitors of
+	// all their edits, or drop() the module when they don't.
+	struct Keep
+	{
+		ModIndexCache &cache;
+		Keep(RTLIL::Design *design) : cache(*design->modindex_cache) { cache.keep_depth++; }
+		~Keep() { cache.keep_depth--; }
+		Keep(const Keep &) = delete;
+		Keep &operator=(const Keep &) = delete;
+	};
+
+	ModIndexCache() { }
+	ModIndexCache(const ModIndexCache &) = delete;
+	ModIndexCache &operator=(const ModIndexCache &) = delete;
+
+	~ModIndexCache()
+	{
+		for (auto &it : indices)
+			delete it.second;
+		for (auto &it : sigmaps)
+			delete it.second;
+	}
+
+	bool holds(RTLIL::Module *module, RTLIL::Monitor *monitor)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		auto it = indices.find(module);
+		if (it != indices.end() && it->second == monitor)
+			return true;
+		auto it2 = sigmaps.find(module);
+		return it2 != sigmaps.end() && it2->second == monitor;
+	}
+
+	void drop(RTLIL::Module *module)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		auto it = indices.find(module);
+		if (it != indices.end()) {
+			delete it->second;
+			indices.erase(it);
+		}
+		auto it2 = sigmaps.find(module);
+		if (it2 != sigmaps.end()) {
+			delete it2->second;
+			sigmaps.erase(it2);
+		}
+	}
+
+	void clear()
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(mutex);
+#endif
+		for (auto &it : indices)
+			delete it.second;
+		for (auto &it : sigmaps)
+			delete it.second;
+		indices.clear();
+		sigmaps.clear();
+	}
+
+	// Called by Pass::post_execute()
+	void pass_finished()
+	{
+		if (keep_depth == 0)
+			clear();
+	}
+};
+
+inline ModIndex &ModIndex::cached(RTLIL::Module *module)
+{
+	log_assert(module->design != nullptr);
+	ModIndexCache &cache = *module->design->modindex_cache;
+
+	ModIndex *index;
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		// parallel_for_modules() bodies may ask for their module's index
+		std::lock_guard<std::mutex> lock(cache.mutex);
+#endif
+		ModIndex *&entry = cache.indices[module];
+		if (entry == nullptr)
+			entry = new ModIndex(module);
+		index = entry;
+	}
+
+	if (!index->auto_reload_module && index->loaded_ports_hash != index->ports_hash())
+		index->auto_reload_module = true;
+	index->auto_reload_counter = 0;
+	if (index->auto_reload_module)
+		index->reload_module();
+	return *index;
+}
+
 struct ModWalker
 {
 	struct PortBit
@@ -0,0 +1,199 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/profile.h"
+
+#include <atomic>
+#include <chrono>
+#include <new>
+
+YOSYS_NAMESPACE_BEGIN
+
+bool profile_enabled = false;
+std::vector<ProfileRecord> profile_records;
+
+// records that have begun but not ended yet, innermost last
+static std::vector<int> profile_open;
+// number of records discarded by profile_clear(), ids count from there
+static int profile_discarded = 0;
+
+static int64_t wall_clock_ns()
+{
+	auto now = std::chrono::steady_clock::now().time_since_epoch();
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(now).count();
+}
+
+static void count_design(RTLIL::Design *design, int64_t &cells, int64_t &wires)
+{
+	cells = 0, wires = 0;
+	if (design == nullptr)
+		return;
+	for (auto &it : design->modules_) {
+		cells += GetSize(it.second->cells_);
+		wires += GetSize(it.second->wires_);
+	}
+}
+
+int64_t profile_peak_rss()
+{
+#if defined(_WIN32)
+	return 0;
+#else
+	struct rusage ru;
+	if (getrusage(RUSAGE_SELF, &ru) == -1)
+		return 0;
+#  if defined(__APPLE__)
+	return ru.ru_maxrss;
+#  else
+	return int64_t(ru.ru_maxrss) * 1024;
+#  endif
+#endif
+}
+
+int profile_begin(RTLIL::Design *design, const std::vector<std::string> &args)
+{
+	if (!profile_enabled)
+		return -1;
+
+	int index = GetSize(profile_records);
+	profile_records.emplace_back();
+	ProfileRecord &rec = profile_records.back();
+
+	for (auto &arg : args)
+		rec.command += (rec.command.empty() ? "" : " ") + arg;
+	if (!profile_open.empty()) {
+		rec.parent = profile_open.back();
+		rec.depth = profile_records[rec.parent].depth + 1;
+	}
+	profile_open.push_back(index);
+
+	count_design(design, rec.begin_cells, rec.begin_wires);
+	if (!profile_alloc_stats(rec.begin_alloc_count, rec.begin_alloc_bytes))
+		rec.begin_alloc_count = rec.begin_alloc_bytes = -1;
+	rec.begin_peak_rss = profile_peak_rss();
+	rec.begin_cpu_ns = PerformanceTimer::query();
+	rec.begin_wall_ns = wall_clock_ns();
+	return profile_discarded + index;
+}
+
+void profile_end(int id, RTLIL::Design *design)
+{
+	int index = id - profile_discarded;
+	if (id < 0 || index < 0)
+		return;
+	log_assert(index < GetSize(profile_records));
+
+	ProfileRecord &rec = profile_records[index];
+	rec.wall_ns = wall_clock_ns() - rec.begin_wall_ns;
+	rec.cpu_ns = PerformanceTimer::query() - rec.begin_cpu_ns;
+	rec.peak_rss_delta = profile_peak_rss() - rec.begin_peak_rss;
+
+	int64_t count, bytes;
+	if (rec.begin_alloc_count >= 0 && profile_alloc_stats(count, bytes)) {
+		rec.alloc_count = count - rec.begin_alloc_count;
+		rec.alloc_bytes = bytes - rec.begin_alloc_bytes;
+	}
+
+	int64_t cells, wires;
+	count_design(design, cells, wires);
+	rec.cells_delta = cells - rec.begin_cells;
+	rec.wires_delta = wires - rec.begin_wires;
+	rec.finished = true;
+
+	// invocations that were left by an exception are closed along with
+	// their parent, but stay unfinished
+	while (!profile_open.empty()) {
+		int top = profile_open.back();
+		profile_open.pop_back();
+		if (top == index)
+			break;
+	}
+}
+
+void profile_clear()
+{
+	profile_discarded += GetSize(profile_records);
+	profile_records.clear();
+	profile_open.clear();
+}
+
+#ifdef YOSYS_ENABLE_ALLOC_STATS
+
+static std::atomic<int64_t> alloc_count, alloc_bytes;
+
+bool profile_alloc_stats(int64_t &count, int64_t &bytes)
+{
+	count = alloc_count.load(std::memory_order_relaxed);
+	bytes = alloc_bytes.load(std::memory_order_relaxed);
+	return true;
+}
+
+YOSYS_NAMESPACE_END
+
+// Replacements for the global allocation functions that count the
+// allocations. The array and nothrow forms are implemented by the standard
+// library in terms of these.
+
+static void *counted_alloc(std::size_t size, std::size_t align)
+{
+	YOSYS_NAMESPACE_PREFIX alloc_count.fetch_add(1, std::memory_order_relaxed);
+	YOSYS_NAMESPACE_PREFIX alloc_bytes.fetch_add(size, std::memory_order_relaxed);
+
+	if (size == 0)
+		size = 1;
+	while (true) {
+		void *ptr = nullptr;
+		if (align <= alignof(std::max_align_t))
+			ptr = malloc(size);
+		else if (posix_memalign(&ptr, align, size) != 0)
+			ptr = nullptr;
+		if (ptr != nullptr)
+			return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr)
+			throw std::bad_alloc();
+		handler();
+	}
+}
+
+void *operator new(std::size_t size)
+{
+	return counted_alloc(size, 0);
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+	return counted_alloc(size, std::size_t(align));
+}
+
+void operator delete(void *ptr) noexcept { free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { free(ptr); }
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept { free(ptr); }
+
+#else
+
+bool profile_alloc_stats(int64_t &count, int64_t &bytes)
+{
+	count = bytes = 0;
+	return false;
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -0,0 +1,69 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include "kernel/yosys_common.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Resource usage of one command invocation, recorded between
+// Pass::pre_execute() and Pass::post_execute() while profiling is enabled
+// (see the `profile` command). Invocations made from within another command,
+// e.g. by a script pass, are its children.
+struct ProfileRecord
+{
+	std::string command;
+	int parent = -1;
+	int depth = 0;
+	bool finished = false;
+
+	int64_t wall_ns = 0, cpu_ns = 0;
+	// increase of the peak resident set size during the invocation
+	int64_t peak_rss_delta = 0;
+	// only counted when built with ENABLE_ALLOC_STATS, -1 otherwise
+	int64_t alloc_count = -1, alloc_bytes = -1;
+	int64_t cells_delta = 0, wires_delta = 0;
+
+	// values at the beginning of the invocation
+	int64_t begin_wall_ns, begin_cpu_ns, begin_peak_rss;
+	int64_t begin_alloc_count, begin_alloc_bytes;
+	int64_t begin_cells, begin_wires;
+};
+
+extern bool profile_enabled;
+extern std::vector<ProfileRecord> profile_records;
+
+// Returns an id for profile_end(), or -1 when profiling is disabled.
+int profile_begin(RTLIL::Design *design, const std::vector<std::string> &args);
+void profile_end(int id, RTLIL::Design *design);
+
+// Discards all records. Invocations that are still running when this is
+// called aren't recorded when they end.
+void profile_clear();
+
+// Peak resident set size of the process in bytes, 0 if unknown.
+int64_t profile_peak_rss();
+
+// Number and total size of the allocations made through operator new so far.
+// Returns false when Yosys was built without ENABLE_ALLOC_STATS.
+bool profile_alloc_stats(int64_t &count, int64_t &bytes);
+
+YOSYS_NAMESPACE_END
+
+#endif
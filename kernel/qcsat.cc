@@ -38,6 +38,7 @@ int QuickConeSat::importSigBit(SigBit bit)
 
 void QuickConeSat::prepare()
 {
+	int cell_count = 0;
 	while (!bits_queue.empty())
 	{
 		pool<ModWalker::PortBit> portbits;
@@ -68,9 +69,12 @@ void QuickConeSat::prepare()
 			bits_queue.insert(inputs.begin(), inputs.end());
 			satgen.importCell(pbit.cell);
 			imported_cells.insert(pbit.cell);
+			cell_count++;
 		}
 
-		if (max_cell_count && GetSize(imported_cells) > max_cell_count)
+		// the rest of the cone stays queued for the next call, the cells
+		// imported so far will never queue their inputs again
+		if (max_cell_count && cell_count > max_cell_count)
 			break;
 	}
 }
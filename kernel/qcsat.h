@@ -33,6 +33,12 @@ YOSYS_NAMESPACE_BEGIN
 // skipped and the solver spuriously returns SAT with a solution that
 // cannot exist in reality due to skipped constraints (ie. only UNSAT results
 // from this class should be considered binding).
+//
+// An instance can (and for performance, should) be kept for many queries on
+// the same module: every cell is only imported once, and the queries are
+// solved incrementally under assumptions. For this to work, queries must not
+// add permanent constraints with ez->assume(), but pass their conditions to
+// ez->solve() instead.
 struct QuickConeSat {
 	ModWalker &modwalker;
 	ezSatPtr ez;
@@ -46,7 +52,9 @@ struct QuickConeSat {
 	// - 3: shifts
 	// - 4: multiplication, division, power
 	int max_cell_complexity = 2;
-	// The maximum number of cells to import, or 0 for no limit.
+	// The maximum number of cells to import in one prepare() call, or 0 for
+	// no limit. The part of the cone that is left out is imported by the
+	// following calls.
 	int max_cell_count = 0;
 	// If non-0, skip importing cells with more than this number of output bits.
 	int max_cell_outs = 0;
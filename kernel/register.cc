@@ -18,6 +18,8 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/profile.h"
+#include "kernel/modtools.h"
 #include "kernel/satgen.h"
 #include "kernel/json.h"
 #include "kernel/gzip.h"
@@ -93,10 +95,12 @@ Pass::~Pass()
 {
 }
 
-Pass::pre_post_exec_state_t Pass::pre_execute()
+Pass::pre_post_exec_state_t Pass::pre_execute(RTLIL::Design *design, const std::vector<std::string> &args)
 {
 	pre_post_exec_state_t state;
 	call_counter++;
+	state.design = design;
+	state.profile_index = profile_begin(design, args);
 	state.begin_ns = PerformanceTimer::query();
 	state.parent_pass = current_pass;
 	current_pass = this;
@@ -109,11 +113,16 @@ void Pass::post_execute(Pass::pre_post_exec_state_t state)
 	IdString::checkpoint();
 	log_suppressed();
 
+	if (state.design && state.design->modindex_cache)
+		state.design->modindex_cache->pass_finished();
+
 	int64_t time_ns = PerformanceTimer::query() - state.begin_ns;
 	runtime_ns += time_ns;
 	current_pass = state.parent_pass;
 	if (current_pass)
 		current_pass->runtime_ns -= time_ns;
+
+	profile_end(state.profile_index, state.design);
 }
 
 void Pass::help()
@@ -268,7 +277,7 @@ void Pass::call(RTLIL::Design *design, std::vector<std::string> args)
 		log_experimental(args[0]);
 
 	size_t orig_sel_stack_pos = design->selection_stack.size();
-	auto state = pass_register[args[0]]->pre_execute();
+	auto state = pass_register[args[0]]->pre_execute(design, args);
 	pass_register[args[0]]->execute(args, design);
 	pass_register[args[0]]->post_execute(state);
 	while (design->selection_stack.size() > orig_sel_stack_pos)
@@ -420,7 +429,7 @@ void Frontend::execute(std::vector<std::string> args, RTLIL::Design *design)
 	do {
 		std::istream *f = NULL;
 		next_args.clear();
-		auto state = pre_execute();
+		auto state = pre_execute(design, args);
 		execute(f, std::string(), args, design);
 		post_execute(state);
 		args = next_args;
@@ -524,12 +533,12 @@ void Frontend::frontend_call(RTLIL::Design *design, std::istream *f, std::string
 		log_cmd_error("No such frontend: %s\n", args[0]);
 
 	if (f != NULL) {
-		auto state = frontend_register[args[0]]->pre_execute();
+		auto state = frontend_register[args[0]]->pre_execute(design, args);
 		frontend_register[args[0]]->execute(f, filename, args, design);
 		frontend_register[args[0]]->post_execute(state);
 	} else if (filename == "-") {
 		std::istream *f_cin = &std::cin;
-		auto state = frontend_register[args[0]]->pre_execute();
+		auto state = frontend_register[args[0]]->pre_execute(design, args);
 		frontend_register[args[0]]->execute(f_cin, "<stdin>", args, design);
 		frontend_register[args[0]]->post_execute(state);
 	} else {
@@ -563,7 +572,7 @@ Backend::~Backend()
 void Backend::execute(std::vector<std::string> args, RTLIL::Design *design)
 {
 	std::ostream *f = NULL;
-	auto state = pre_execute();
+	auto state = pre_execute(design, args);
 	execute(f, std::string(), args, design);
 	post_execute(state);
 	if (f != &std::cout)
@@ -646,12 +655,12 @@ void Backend::backend_call(RTLIL::Design *design, std::ostream *f, std::string f
 	size_t orig_sel_stack_pos = design->selection_stack.size();
 
 	if (f != NULL) {
-		auto state = backend_register[args[0]]->pre_execute();
+		auto state = backend_register[args[0]]->pre_execute(design, args);
 		backend_register[args[0]]->execute(f, filename, args, design);
 		backend_register[args[0]]->post_execute(state);
 	} else if (filename == "-") {
 		std::ostream *f_cout = &std::cout;
-		auto state = backend_register[args[0]]->pre_execute();
+		auto state = backend_register[args[0]]->pre_execute(design, args);
 		backend_register[args[0]]->execute(f_cout, "<stdout>", args, design);
 		backend_register[args[0]]->post_execute(state);
 	} else {
@@ -1144,18 +1153,6 @@ struct EchoPass : public Pass {
 	}
 } EchoPass;
 
-SatSolver *yosys_satsolver_list;
-SatSolver *yosys_satsolver;
-
-struct MinisatSatSolver : public SatSolver {
-	MinisatSatSolver() : SatSolver("minisat") {
-		yosys_satsolver = this;
-	}
-	ezSAT *create() override {
-		return new ezMiniSAT();
-	}
-} MinisatSatSolver;
-
 struct LicensePass : public Pass {
 	LicensePass() : Pass("license", "print license terms") { }
 	void help() override
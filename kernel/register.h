@@ -82,9 +82,12 @@ struct Pass
 	struct pre_post_exec_state_t {
 		Pass *parent_pass;
 		int64_t begin_ns;
+		RTLIL::Design *design;
+		int profile_index;
 	};
 
-	pre_post_exec_state_t pre_execute();
+	// `design` and `args` are only used for profiling (see kernel/profile.h)
+	pre_post_exec_state_t pre_execute(RTLIL::Design *design = nullptr, const std::vector<std::string> &args = {});
 	void post_execute(pre_post_exec_state_t state);
 
 	void cmd_log_args(const std::vector<std::string> &args);
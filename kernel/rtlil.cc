@@ -22,6 +22,7 @@
 #include "kernel/celltypes.h"
 #include "kernel/binding.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 #include "frontends/verilog/verilog_frontend.h"
 #include "frontends/verilog/preproc.h"
 #include "backends/rtlil/rtlil_backend.h"
@@ -31,8 +32,121 @@
 #include <optional>
 #include <string_view>
 
+#ifdef YOSYS_ENABLE_THREADS
+#include <mutex>
+#endif
+
 YOSYS_NAMESPACE_BEGIN
 
+// Storage for IdString names. Short names are bump-allocated from large blocks
+// and recycled through per-size-class free lists, long names fall back to
+// malloc. Blocks are only returned when the arena itself is destroyed.
+struct IdStringArena
+{
+	static constexpr size_t GRANULE = 16;
+	static constexpr size_t NUM_CLASSES = 16;
+	static constexpr size_t BLOCK_SIZE = 64 << 10;
+
+	std::vector<std::unique_ptr<char[]>> blocks;
+	char *next = nullptr, *end = nullptr;
+	std::vector<char*> free_lists[NUM_CLASSES];
+
+	static size_t size_class(size_t len) {
+		return (len + GRANULE) / GRANULE - 1;
+	}
+
+	char *alloc(const char *p)
+	{
+		size_t len = strlen(p);
+		size_t cls = size_class(len);
+		if (cls >= NUM_CLASSES)
+			return strdup(p);
+
+		char *q;
+		if (!free_lists[cls].empty()) {
+			q = free_lists[cls].back();
+			free_lists[cls].pop_back();
+		} else {
+			size_t bytes = (cls + 1) * GRANULE;
+			if (size_t(end - next) < bytes) {
+				blocks.emplace_back(new char[BLOCK_SIZE]);
+				next = blocks.back().get();
+				end = next + BLOCK_SIZE;
+			}
+			q = next;
+			next += bytes;
+		}
+		memcpy(q, p, len + 1);
+		return q;
+	}
+
+	// `p` may have been allocated by any arena as long as that arena outlives it
+	void free(char *p)
+	{
+		size_t cls = size_class(strlen(p));
+		if (cls >= NUM_CLASSES)
+			::free(p);
+		else
+			free_lists[cls].push_back(p);
+	}
+};
+
+static constexpr int CONCURRENT_ID_SHARDS = 64;
+static constexpr int CONCURRENT_ID_CHUNK_BITS = 16;
+static constexpr int CONCURRENT_ID_MAX_CHUNKS = 1 << 12;
+static constexpr int CONCURRENT_ID_FOLD_THRESHOLD = 1 << 16;
+
+struct ConcurrentIdShard
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+#endif
+	std::unordered_map<std::string_view, int> index;
+	IdStringArena arena;
+};
+
+// Refcount changes made by one thread while in concurrent mode. The log holds
+// `idx` for an increment and `~idx` for a decrement, and is periodically
+// folded into per-index net deltas to keep its size bounded.
+struct ConcurrentRefBuffer
+{
+	std::vector<int> log;
+	dict<int, int> net;
+
+	void fold()
+	{
+		for (int entry : log)
+			if (entry >= 0)
+				net[entry]++;
+			else
+				net[~entry]--;
+		log.clear();
+	}
+};
+
+struct ConcurrentIdState
+{
+	int depth = 0;
+	int epoch = 0;
+	int base = 0;
+	int next = 0;
+	std::vector<std::unique_ptr<char*[]>> chunks;
+	std::vector<std::unique_ptr<ConcurrentRefBuffer>> buffers;
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex alloc_mutex;
+	std::mutex buffers_mutex;
+#endif
+	ConcurrentIdShard shards[CONCURRENT_ID_SHARDS];
+};
+
+// Defined ahead of destruct_guard so that these outlive any IdString
+// destructor that can still get past the guard during static destruction.
+static IdStringArena id_arena;
+static ConcurrentIdState concurrent_ids;
+static thread_local ConcurrentRefBuffer *concurrent_ref_buffer = nullptr;
+static thread_local int concurrent_ref_buffer_epoch = 0;
+
+bool RTLIL::IdString::concurrent_mode_ = false;
 bool RTLIL::IdString::destruct_guard_ok = false;
 RTLIL::IdString::destruct_guard_t RTLIL::IdString::destruct_guard;
 std::vector<char*> RTLIL::IdString::global_id_storage_;
@@ -72,6 +186,155 @@ void RTLIL::IdString::prepopulate()
 #undef X
 }
 
+char *RTLIL::IdString::arena_strdup(const char *p)
+{
+	return id_arena.alloc(p);
+}
+
+void RTLIL::IdString::arena_free(char *p)
+{
+	id_arena.free(p);
+}
+
+RTLIL::IdString::ConcurrentScope::ConcurrentScope()
+{
+	if (concurrent_ids.depth++ > 0)
+		return;
+
+	ensure_prepopulated();
+	concurrent_ids.epoch++;
+	concurrent_ids.base = GetSize(global_id_storage_);
+	concurrent_ids.next = 0;
+	concurrent_ids.chunks.resize(CONCURRENT_ID_MAX_CHUNKS);
+	concurrent_mode_ = true;
+}
+
+RTLIL::IdString::ConcurrentScope::~ConcurrentScope()
+{
+	log_assert(concurrent_ids.depth > 0);
+	if (--concurrent_ids.depth > 0)
+		return;
+
+	concurrent_mode_ = false;
+
+	// Adopt the names created while in concurrent mode. They were handed out
+	// consecutive indices starting at the size of the storage on entry.
+	log_assert(GetSize(global_id_storage_) == concurrent_ids.base);
+	global_id_storage_.reserve(concurrent_ids.base + concurrent_ids.next);
+	for (int k = 0; k < concurrent_ids.next; k++)
+		global_id_storage_.push_back(concurrent_ids.chunks[k >> CONCURRENT_ID_CHUNK_BITS][k & ((1 << CONCURRENT_ID_CHUNK_BITS) - 1)]);
+	concurrent_ids.chunks.clear();
+	concurrent_ids.next = 0;
+
+	for (auto &shard : concurrent_ids.shards) {
+		for (auto &it : shard.index)
+			global_id_index_.insert(it);
+		shard.index.clear();
+	}
+
+#ifndef YOSYS_NO_IDS_REFCNT
+	// Apply the net refcount change of every thread. Names created within the
+	// scope start out at zero, so any of them that are not referenced anymore
+	// are freed here as well.
+	global_refcount_storage_.resize(global_id_storage_.size(), 0);
+
+	dict<int, int> net;
+	for (auto &buffer : concurrent_ids.buffers) {
+		buffer->fold();
+		for (auto &it : buffer->net)
+			net[it.first] += it.second;
+	}
+	concurrent_ids.buffers.clear();
+
+	for (auto &it : net) {
+		uint32_t &refcount = global_refcount_storage_[it.first];
+		refcount += it.second;
+		if (refcount == 0)
+			free_reference(it.first);
+	}
+#endif
+}
+
+int RTLIL::IdString::get_reference_concurrent(const char *p)
+{
+	// global_id_index_ is not modified while in concurrent mode
+	auto it = global_id_index_.find(p);
+	if (it != global_id_index_.end()) {
+		if (it->second >= static_cast<short>(StaticId::STATIC_ID_END))
+			record_reference_concurrent(it->second, 1);
+		return it->second;
+	}
+
+	if (!p[0])
+		return 0;
+
+	log_assert(p[0] == '$' || p[0] == '\\');
+	log_assert(p[1] != 0);
+	for (const char *c = p; *c; c++)
+		if ((unsigned)*c <= (unsigned)' ')
+			log_error("Found control character or space (0x%02x) in string '%s' which is not allowed in RTLIL identifiers\n", *c, p);
+
+	std::string_view name(p);
+	auto &shard = concurrent_ids.shards[std::hash<std::string_view>{}(name) % CONCURRENT_ID_SHARDS];
+	int idx;
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> shard_lock(shard.mutex);
+#endif
+		auto shard_it = shard.index.find(name);
+		if (shard_it != shard.index.end()) {
+			idx = shard_it->second;
+		} else {
+			char *str = shard.arena.alloc(p);
+			{
+#ifdef YOSYS_ENABLE_THREADS
+				std::lock_guard<std::mutex> alloc_lock(concurrent_ids.alloc_mutex);
+#endif
+				int k = concurrent_ids.next++;
+				log_assert(k < (CONCURRENT_ID_MAX_CHUNKS << CONCURRENT_ID_CHUNK_BITS));
+				log_assert(concurrent_ids.base + k < 0x40000000);
+				auto &chunk = concurrent_ids.chunks[k >> CONCURRENT_ID_CHUNK_BITS];
+				if (!chunk)
+					chunk.reset(new char*[1 << CONCURRENT_ID_CHUNK_BITS]);
+				chunk[k & ((1 << CONCURRENT_ID_CHUNK_BITS) - 1)] = str;
+				idx = concurrent_ids.base + k;
+			}
+			shard.index.emplace(std::string_view(str), idx);
+		}
+	}
+
+	record_reference_concurrent(idx, 1);
+	return idx;
+}
+
+void RTLIL::IdString::record_reference_concurrent(int idx, int delta)
+{
+#ifndef YOSYS_NO_IDS_REFCNT
+	if (concurrent_ref_buffer_epoch != concurrent_ids.epoch) {
+		auto buffer = std::make_unique<ConcurrentRefBuffer>();
+		concurrent_ref_buffer = buffer.get();
+		concurrent_ref_buffer_epoch = concurrent_ids.epoch;
+#ifdef YOSYS_ENABLE_THREADS
+		std::lock_guard<std::mutex> lock(concurrent_ids.buffers_mutex);
+#endif
+		concurrent_ids.buffers.push_back(std::move(buffer));
+	}
+
+	concurrent_ref_buffer->log.push_back(delta > 0 ? idx : ~idx);
+	if (GetSize(concurrent_ref_buffer->log) >= CONCURRENT_ID_FOLD_THRESHOLD)
+		concurrent_ref_buffer->fold();
+#else
+	(void)idx, (void)delta;
+#endif
+}
+
+const char *RTLIL::IdString::c_str_concurrent(int idx)
+{
+	int k = idx - concurrent_ids.base;
+	log_assert(concurrent_mode_ && k >= 0 && k < (CONCURRENT_ID_MAX_CHUNKS << CONCURRENT_ID_CHUNK_BITS));
+	return concurrent_ids.chunks[k >> CONCURRENT_ID_CHUNK_BITS][k & ((1 << CONCURRENT_ID_CHUNK_BITS) - 1)];
+}
+
 static constexpr bool check_well_known_id_order()
 {
 	int size = sizeof(IdTable) / sizeof(IdTable[0]);
@@ -259,6 +522,16 @@ Const::bitvectype& Const::get_bits() {
 	return *get_if_bits();
 }
 
+const Const::bitvectype& Const::get_bits(bitvectype &buf) const {
+	if (!is_interned())
+		return get_bits();
+	check(shared_->kind != Shared::Kind::string);
+	buf.reserve(shared_->width);
+	for (int i = 0; i < shared_->width; i++)
+		buf.push_back(shared_->at(i));
+	return buf;
+}
+
 std::string& Const::get_str() {
 	check(is_str());
 	return *get_if_str();
@@ -338,7 +611,10 @@ RTLIL::Const::Const(const RTLIL::Const &other) {
 		new ((void*)&str_) std::string(other.get_str());
 	else if (is_bits())
 		new ((void*)&bits_) bitvectype(other.get_bits());
-	else
+	else if (is_interned()) {
+		shared_ = other.shared_;
+		shared_->refcount.fetch_add(1, std::memory_order_relaxed);
+	} else
 		check(false);
 }
 
@@ -349,11 +625,28 @@ RTLIL::Const::Const(RTLIL::Const &&other) {
 		new ((void*)&str_) std::string(std::move(other.get_str()));
 	else if (is_bits())
 		new ((void*)&bits_) bitvectype(std::move(other.get_bits()));
-	else
+	else if (is_interned()) {
+		// leave `other` empty rather than interned, so the reference moves
+		shared_ = other.shared_;
+		new ((void*)&other.bits_) bitvectype();
+		other.tag = backing_tag::bits;
+	} else
 		check(false);
 }
 
 RTLIL::Const &RTLIL::Const::operator =(const RTLIL::Const &other) {
+	if (other.is_interned()) {
+		if (other.shared_ != (is_interned() ? shared_ : nullptr)) {
+			other.shared_->refcount.fetch_add(1, std::memory_order_relaxed);
+			this->~Const();
+			shared_ = other.shared_;
+			tag = backing_tag::shared;
+		}
+		flags = other.flags;
+		return *this;
+	}
+	if (is_interned())
+		release_shared();
 	flags = other.flags;
 	if (other.is_str()) {
 		if (!is_str()) {
@@ -384,10 +677,22 @@ RTLIL::Const::~Const() {
 		bits_.~bitvectype();
 	else if (is_str())
 		str_.~string();
+	else if (is_interned())
+		shared_->refcount.fetch_sub(1, std::memory_order_acq_rel);
 	else
 		check(false);
 }
 
+// Drops the reference to the shared value and leaves the Const empty. The value
+// itself is freed by ConstPool::collect().
+void RTLIL::Const::release_shared()
+{
+	check(is_interned());
+	shared_->refcount.fetch_sub(1, std::memory_order_acq_rel);
+	new ((void*)&bits_) bitvectype();
+	tag = backing_tag::bits;
+}
+
 bool RTLIL::Const::operator<(const RTLIL::Const &other) const
 {
 	if (size() != other.size())
@@ -402,6 +707,8 @@ bool RTLIL::Const::operator<(const RTLIL::Const &other) const
 
 bool RTLIL::Const::operator ==(const RTLIL::Const &other) const
 {
+	if (is_interned() && other.is_interned() && shared_ == other.shared_)
+		return true;
 	if (is_str() && other.is_str())
 		return get_str() == other.get_str();
 	if (is_bits() && other.is_bits())
@@ -438,14 +745,15 @@ std::vector<RTLIL::State> RTLIL::Const::to_bits() const
 
 bool RTLIL::Const::as_bool() const
 {
-	if (is_str()) {
-		for (char ch : get_str())
+	if (auto str = get_if_str()) {
+		for (char ch : *str)
 			if (ch != 0)
 				return true;
 		return false;
 	}
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	for (size_t i = 0; i < bv.size(); i++)
 		if (bv[i] == State::S1)
 			return true;
@@ -466,7 +774,8 @@ int RTLIL::Const::as_int(bool is_signed) const
 		return ret;
 	}
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	int significant_bits = std::min(GetSize(bv), 32);
 	for (int i = 0; i < significant_bits; i++)
 		if (bv[i] == State::S1)
@@ -593,7 +902,8 @@ std::string RTLIL::Const::decode_string() const
 	if (auto str = get_if_str())
 		return *str;
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	const int n = GetSize(bv);
 	const int n_over_8 = n / 8;
 	std::string s;
@@ -626,6 +936,8 @@ std::string RTLIL::Const::decode_string() const
 int RTLIL::Const::size() const {
 	if (is_str())
 		return 8 * str_.size();
+	else if (is_interned())
+		return shared_->kind == Shared::Kind::string ? 8 * shared_->data.size() : shared_->width;
 	else {
 		check(is_bits());
 		return bits_.size();
@@ -635,6 +947,8 @@ int RTLIL::Const::size() const {
 bool RTLIL::Const::empty() const {
 	if (is_str())
 		return str_.empty();
+	else if (is_interned())
+		return size() == 0;
 	else {
 		check(is_bits());
 		return bits_.empty();
@@ -645,6 +959,17 @@ void RTLIL::Const::bitvectorize_internal() {
 	if (tag == backing_tag::bits)
 		return;
 
+	if (is_interned()) {
+		bitvectype new_bits;
+		int width = size();
+		new_bits.reserve(width);
+		for (int i = 0; i < width; i++)
+			new_bits.push_back(shared_->at(i));
+		release_shared();
+		bits_ = std::move(new_bits);
+		return;
+	}
+
 	check(is_str());
 
 	bitvectype new_bits;
@@ -675,6 +1000,8 @@ void RTLIL::Const::append(const RTLIL::Const &other) {
 RTLIL::State RTLIL::Const::const_iterator::operator*() const {
 	if (auto bv = parent->get_if_bits())
 		return (*bv)[idx];
+	if (parent->is_interned())
+		return parent->shared_->at(idx);
 
 	int char_idx = parent->get_str().size() - idx / 8 - 1;
 	bool bit = (parent->get_str()[char_idx] & (1 << (idx % 8)));
@@ -692,7 +1019,8 @@ bool RTLIL::Const::is_fully_zero() const
 		return true;
 	}
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 
 	for (const auto &bit : bv)
 		if (bit != RTLIL::State::S0)
@@ -712,7 +1040,8 @@ bool RTLIL::Const::is_fully_ones() const
 		return true;
 	}
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	for (const auto &bit : bv)
 		if (bit != RTLIL::State::S1)
 			return false;
@@ -724,10 +1053,11 @@ bool RTLIL::Const::is_fully_def() const
 {
 	cover("kernel.rtlil.const.is_fully_def");
 
-	if (is_str())
+	if (get_if_str())
 		return true;
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	for (const auto &bit : bv)
 		if (bit != RTLIL::State::S0 && bit != RTLIL::State::S1)
 			return false;
@@ -742,7 +1072,8 @@ bool RTLIL::Const::is_fully_undef() const
 	if (auto str = get_if_str())
 		return str->empty();
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	for (const auto &bit : bv)
 		if (bit != RTLIL::State::Sx && bit != RTLIL::State::Sz)
 			return false;
@@ -757,7 +1088,8 @@ bool RTLIL::Const::is_fully_undef_x_only() const
 	if (auto str = get_if_str())
 		return str->empty();
 
-	const bitvectype& bv = get_bits();
+	bitvectype buf;
+	const bitvectype& bv = get_bits(buf);
 	for (const auto &bit : bv)
 		if (bit != RTLIL::State::Sx)
 			return false;
@@ -793,7 +1125,8 @@ Hasher RTLIL::Const::hash_into(Hasher h) const
 
 	// If the bits are all 0/1, hash packed bits using the string hash.
 	// Otherwise hash the leading packed bits with the rest of the bits individually.
-	const bitvectype &bv = get_bits();
+	bitvectype buf;
+	const bitvectype &bv = get_bits(buf);
 	int size = GetSize(bv);
 	std::string packed;
 	int packed_size = (size + 7) >> 3;
@@ -827,8 +1160,148 @@ RTLIL::Const RTLIL::Const::extract(int offset, int len, RTLIL::State padding) co
 		ret_bv.push_back(i < GetSize(*this) ? (*this)[i] : padding);
 	return RTLIL::Const(ret_bv);
 }
+
+void RTLIL::Const::intern()
+{
+	if (is_interned())
+		return;
+	const Shared *shared = ConstPool::lookup(*this);
+	this->~Const();
+	shared_ = shared;
+	tag = backing_tag::shared;
+}
 #undef check /* check(condition) for Const */
 
+bool RTLIL::ConstPool::enabled = false;
+
+struct RTLIL::ConstPool::Ops
+{
+	static inline bool cmp(const Const::Shared *a, const Const::Shared *b) {
+		return a->kind == b->kind && a->width == b->width && a->data == b->data;
+	}
+	[[nodiscard]] static inline Hasher hash_into(const Const::Shared *a, Hasher h) {
+		h.eat((int)a->kind);
+		h.eat(a->width);
+		return hashlib::hash_ops<std::string>::hash_into(a->data, h);
+	}
+	HASH_TOP_LOOP_FST (const Const::Shared *a) HASH_TOP_LOOP_SND
+};
+
+struct RTLIL::ConstPool::Storage
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+#endif
+	pool<Const::Shared*, Ops> entries;
+	int collect_threshold = 4096;
+
+	void collect() {
+		std::vector<Const::Shared*> unused;
+		for (auto entry : entries)
+			if (entry->refcount.load(std::memory_order_acquire) == 0)
+				unused.push_back(entry);
+		for (auto entry : unused) {
+			entries.erase(entry);
+			delete entry;
+		}
+		collect_threshold = std::max(4096, 2 * GetSize(entries));
+	}
+};
+
+RTLIL::ConstPool::Storage &RTLIL::ConstPool::storage()
+{
+	// Never destroyed, interned Consts in static objects may outlive it otherwise.
+	static Storage *storage = new Storage;
+	return *storage;
+}
+
+const RTLIL::Const::Shared *RTLIL::ConstPool::lookup(const RTLIL::Const &value)
+{
+	Const::Shared key;
+	if (auto str = value.get_if_str()) {
+		key.kind = Const::Shared::Kind::string;
+		key.width = 8 * GetSize(*str);
+		key.data = *str;
+	} else {
+		const Const::bitvectype &bv = value.get_bits();
+		key.width = GetSize(bv);
+		bool packable = true;
+		for (auto bit : bv)
+			if (bit > State::Sz)
+				packable = false;
+		if (packable) {
+			key.kind = Const::Shared::Kind::packed;
+			key.data.resize((key.width + 3) / 4);
+			for (int i = 0; i < key.width; i++)
+				key.data[i >> 2] |= bv[i] << (2 * (i & 3));
+		} else {
+			key.kind = Const::Shared::Kind::unpacked;
+			key.data.assign(bv.begin(), bv.end());
+		}
+	}
+
+	// Unreferenced entries are only freed while holding the lock, and only
+	// lookup() takes a reference to an entry without already holding one, so
+	// entries can't be freed while another thread takes a reference.
+	Storage &storage = ConstPool::storage();
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(storage.mutex);
+#endif
+	auto it = storage.entries.find(&key);
+	if (it != storage.entries.end()) {
+		(*it)->refcount.fetch_add(1, std::memory_order_relaxed);
+		return *it;
+	}
+	if (GetSize(storage.entries) >= storage.collect_threshold)
+		storage.collect();
+	Const::Shared *entry = new Const::Shared;
+	entry->refcount.store(1, std::memory_order_relaxed);
+	entry->kind = key.kind;
+	entry->width = key.width;
+	entry->data = std::move(key.data);
+	storage.entries.insert(entry);
+	return entry;
+}
+
+void RTLIL::ConstPool::collect()
+{
+	Storage &storage = ConstPool::storage();
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(storage.mutex);
+#endif
+	storage.collect();
+}
+
+RTLIL::ConstPool::Stats RTLIL::ConstPool::stats()
+{
+	Storage &storage = ConstPool::storage();
+#ifdef YOSYS_ENABLE_THREADS
+	std::lock_guard<std::mutex> lock(storage.mutex);
+#endif
+	Stats stats;
+	for (auto entry : storage.entries) {
+		int refcount = entry->refcount.load(std::memory_order_relaxed);
+		stats.entries++;
+		if (refcount == 0)
+			stats.unused_entries++;
+		stats.references += refcount;
+		stats.data_bytes += GetSize(entry->data);
+	}
+	return stats;
+}
+
+void RTLIL::ConstPool::intern_attributes(RTLIL::AttrObject *obj)
+{
+	for (auto &it : obj->attributes)
+		it.second.intern();
+}
+
+void RTLIL::ConstPool::intern_parameters(RTLIL::Cell *cell)
+{
+	for (auto &it : cell->parameters)
+		it.second.intern();
+}
+
 bool RTLIL::AttrObject::has_attribute(const RTLIL::IdString &id) const
 {
 	return attributes.count(id);
@@ -854,8 +1327,12 @@ void RTLIL::AttrObject::set_string_attribute(const RTLIL::IdString& id, string v
 {
 	if (value.empty())
 		attributes.erase(id);
-	else
-		attributes[id] = value;
+	else {
+		RTLIL::Const &attr = attributes[id];
+		attr = value;
+		if (RTLIL::ConstPool::enabled)
+			attr.intern();
+	}
 }
 
 string RTLIL::AttrObject::get_string_attribute(const RTLIL::IdString &id) const
@@ -1073,12 +1550,20 @@ void RTLIL::Selection::clear()
 	selected_members.clear();
 }
 
+// Advances the per-class hash index counter, or the task-local one while
+// running under parallel_for_modules().
+static unsigned int next_hashidx(unsigned int &counter)
+{
+	unsigned int &c = hashidx_local ? *hashidx_local : counter;
+	c = mkhash_xorshift(c);
+	return c;
+}
+
 RTLIL::Design::Design()
-  : verilog_defines (new define_map_t)
+  : verilog_defines (new define_map_t), modindex_cache (new ModIndexCache)
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	refcount_modules_ = 0;
 	push_full_selection();
@@ -1090,6 +1575,7 @@ RTLIL::Design::Design()
 
 RTLIL::Design::~Design()
 {
+	modindex_cache.reset();
 	for (auto &pr : modules_)
 		delete pr.second;
 	for (auto n : bindings_)
@@ -1258,10 +1744,46 @@ void RTLIL::Design::remove(RTLIL::Module *module)
 
 	log_assert(modules_.at(module->name) == module);
 	log_assert(refcount_modules_ == 0);
+	if (modindex_cache)
+		modindex_cache->drop(module);
 	modules_.erase(module->name);
 	delete module;
 }
 
+RTLIL::Module *RTLIL::Design::release(RTLIL::Module *module)
+{
+	for (auto mon : monitors)
+		mon->notify_module_del(module);
+
+	if (yosys_xtrace) {
+		log("#X# Release Module: %s\n", log_id(module));
+		log_backtrace("-X- ", yosys_xtrace-1);
+	}
+
+	log_assert(modules_.at(module->name) == module);
+	log_assert(refcount_modules_ == 0);
+	if (modindex_cache)
+		modindex_cache->drop(module);
+	modules_.erase(module->name);
+	module->design = nullptr;
+	return module;
+}
+
+IncrementalSigMap &IncrementalSigMap::cached(RTLIL::Module *module)
+{
+	log_assert(module->design != nullptr);
+	ModIndexCache &cache = *module->design->modindex_cache;
+
+#ifdef YOSYS_ENABLE_THREADS
+	// parallel_for_modules() bodies may ask for their module's map
+	std::lock_guard<std::mutex> lock(cache.mutex);
+#endif
+	IncrementalSigMap *&entry = cache.sigmaps[module];
+	if (entry == nullptr)
+		entry = new IncrementalSigMap(module);
+	return *entry;
+}
+
 void RTLIL::Design::rename(RTLIL::Module *module, RTLIL::IdString new_name)
 {
 	modules_.erase(module->name);
@@ -1420,11 +1942,10 @@ std::vector<RTLIL::Module*> RTLIL::Design::selected_modules(RTLIL::SelectPartial
 	return result;
 }
 
-RTLIL::Module::Module()
+RTLIL::Module::Module() : wire_arena_(sizeof(RTLIL::Wire), alignof(RTLIL::Wire)), cell_arena_(sizeof(RTLIL::Cell), alignof(RTLIL::Cell))
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	design = nullptr;
 	refcount_wires_ = 0;
@@ -1437,12 +1958,16 @@ RTLIL::Module::Module()
 
 RTLIL::Module::~Module()
 {
+	// The arenas release the memory of all wires and cells at once, only
+	// their destructors need to be run here.
 	for (auto &pr : wires_)
-		delete pr.second;
+		pr.second->~Wire();
 	for (auto &pr : memories)
 		delete pr.second;
 	for (auto &pr : cells_)
-		delete pr.second;
+		pr.second->~Cell();
+	for (auto cell : pending_deleted_cells)
+		cell->~Cell();
 	for (auto &pr : processes)
 		delete pr.second;
 	for (auto binding : bindings_)
@@ -1473,7 +1998,7 @@ void RTLIL::Module::makeblackbox()
 	memories.clear();
 
 	for (auto it = cells_.begin(); it != cells_.end(); ++it)
-		delete it->second;
+		free_cell(it->second);
 	cells_.clear();
 
 	for (auto it = processes.begin(); it != processes.end(); ++it)
@@ -1511,6 +2036,11 @@ RTLIL::IdString RTLIL::Module::derive(RTLIL::Design*, const dict<RTLIL::IdString
 	log_error("Module `%s' is used with parameters but is not parametric!\n", id2cstr(name));
 }
 
+RTLIL::IdString RTLIL::Module::derive_job(RTLIL::Design*, const dict<RTLIL::IdString, RTLIL::Const> &, std::function<RTLIL::Module*()> &)
+{
+	return RTLIL::IdString();
+}
+
 size_t RTLIL::Module::count_id(const RTLIL::IdString& id)
 {
 	return wires_.count(id) + memories.count(id) + cells_.count(id) + processes.count(id);
@@ -2640,12 +3170,17 @@ void RTLIL::Module::cloneInto(RTLIL::Module *new_mod) const
 	for (auto &attr : attributes)
 		new_mod->attributes[attr.first] = attr.second;
 
+	new_mod->wires_.reserve(new_mod->wires_.size() + wires_.size());
+	new_mod->wire_arena_.reserve(wires_.size());
 	for (auto &it : wires_)
 		new_mod->addWire(it.first, it.second);
 
 	for (auto &it : memories)
 		new_mod->addMemory(it.first, it.second);
 
+	new_mod->cells_.reserve(new_mod->cells_.size() + cells_.size());
+	new_mod->cell_arena_.reserve(cells_.size());
+
 	for (auto &it : cells_)
 		new_mod->addCell(it.first, it.second);
 
@@ -2657,10 +3192,15 @@ void RTLIL::Module::cloneInto(RTLIL::Module *new_mod) const
 		RTLIL::Module *mod;
 		void operator()(RTLIL::SigSpec &sig)
 		{
-			sig.pack();
-			for (auto &c : sig.chunks_)
+			if (sig.is_fully_const())
+				return;
+			RTLIL::SigSpec new_sig;
+			for (auto c : sig.chunks()) {
 				if (c.wire != NULL)
 					c.wire = mod->wires_.at(c.wire->name);
+				new_sig.append(std::move(c));
+			}
+			sig = std::move(new_sig);
 		}
 	};
 
@@ -2808,12 +3348,24 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 		const pool<RTLIL::Wire*> *wires_p;
 
 		void operator()(RTLIL::SigSpec &sig) {
-			sig.pack();
-			for (auto &c : sig.chunks_)
+			bool found = false;
+			for (auto &c : sig.chunks())
+				if (c.wire != NULL && wires_p->count(c.wire)) {
+					found = true;
+					break;
+				}
+			if (!found)
+				return;
+
+			RTLIL::SigSpec new_sig;
+			for (auto c : sig.chunks()) {
 				if (c.wire != NULL && wires_p->count(c.wire)) {
 					c.wire = module->addWire(stringf("$delete_wire$%d", autoidx++), c.width);
 					c.offset = 0;
 				}
+				new_sig.append(std::move(c));
+			}
+			sig = std::move(new_sig);
 		}
 
 		void operator()(RTLIL::SigSpec &lhs, RTLIL::SigSpec &rhs) {
@@ -2832,7 +3384,7 @@ void RTLIL::Module::remove(const pool<RTLIL::Wire*> &wires)
 	for (auto &it : wires) {
 		log_assert(wires_.count(it->name) != 0);
 		wires_.erase(it->name);
-		delete it;
+		free_wire(it);
 	}
 }
 
@@ -2849,7 +3401,7 @@ void RTLIL::Module::remove(RTLIL::Cell *cell)
 		cell->name.clear();
 		pending_deleted_cells.insert(cell);
 	} else {
-		delete cell;
+		free_cell(cell);
 	}
 }
 
@@ -2864,6 +3416,14 @@ void RTLIL::Module::rename(RTLIL::Wire *wire, RTLIL::IdString new_name)
 {
 	log_assert(wires_[wire->name] == wire);
 	log_assert(refcount_wires_ == 0);
+
+	for (auto mon : monitors)
+		mon->notify_rename(wire, new_name);
+
+	if (design)
+		for (auto mon : design->monitors)
+			mon->notify_rename(wire, new_name);
+
 	wires_.erase(wire->name);
 	wire->name = new_name;
 	add(wire);
@@ -2895,6 +3455,17 @@ void RTLIL::Module::swap_names(RTLIL::Wire *w1, RTLIL::Wire *w2)
 	log_assert(wires_[w2->name] == w2);
 	log_assert(refcount_wires_ == 0);
 
+	for (auto mon : monitors) {
+		mon->notify_rename(w1, w2->name);
+		mon->notify_rename(w2, w1->name);
+	}
+
+	if (design)
+		for (auto mon : design->monitors) {
+			mon->notify_rename(w1, w2->name);
+			mon->notify_rename(w2, w1->name);
+		}
+
 	wires_.erase(w1->name);
 	wires_.erase(w2->name);
 
@@ -3040,9 +3611,21 @@ void RTLIL::Module::fixup_ports()
 	}
 }
 
+void RTLIL::Module::free_wire(RTLIL::Wire *wire)
+{
+	wire->~Wire();
+	wire_arena_.deallocate(wire);
+}
+
+void RTLIL::Module::free_cell(RTLIL::Cell *cell)
+{
+	cell->~Cell();
+	cell_arena_.deallocate(cell);
+}
+
 RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, int width)
 {
-	RTLIL::Wire *wire = new RTLIL::Wire;
+	RTLIL::Wire *wire = new (wire_arena_.allocate()) RTLIL::Wire;
 	wire->name = name;
 	wire->width = width;
 	add(wire);
@@ -3060,12 +3643,14 @@ RTLIL::Wire *RTLIL::Module::addWire(RTLIL::IdString name, const RTLIL::Wire *oth
 	wire->upto = other->upto;
 	wire->is_signed = other->is_signed;
 	wire->attributes = other->attributes;
+	if (RTLIL::ConstPool::enabled)
+		RTLIL::ConstPool::intern_attributes(wire);
 	return wire;
 }
 
 RTLIL::Cell *RTLIL::Module::addCell(RTLIL::IdString name, RTLIL::IdString type)
 {
-	RTLIL::Cell *cell = new RTLIL::Cell;
+	RTLIL::Cell *cell = new (cell_arena_.allocate()) RTLIL::Cell;
 	cell->name = name;
 	cell->type = type;
 	add(cell);
@@ -3078,6 +3663,10 @@ RTLIL::Cell *RTLIL::Module::addCell(RTLIL::IdString name, const RTLIL::Cell *oth
 	cell->connections_ = other->connections_;
 	cell->parameters = other->parameters;
 	cell->attributes = other->attributes;
+	if (RTLIL::ConstPool::enabled) {
+		RTLIL::ConstPool::intern_parameters(cell);
+		RTLIL::ConstPool::intern_attributes(cell);
+	}
 	return cell;
 }
 
@@ -4090,8 +4679,7 @@ RTLIL::SigSpec RTLIL::Module::FutureFF(RTLIL::IdString name, const RTLIL::SigSpe
 RTLIL::Wire::Wire()
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	module = nullptr;
 	width = 1;
@@ -4125,8 +4713,7 @@ std::map<unsigned int, RTLIL::Wire*> *RTLIL::Wire::get_all_wires(void)
 RTLIL::Memory::Memory()
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	width = 1;
 	start_offset = 0;
@@ -4139,15 +4726,13 @@ RTLIL::Memory::Memory()
 RTLIL::Process::Process() : module(nullptr)
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 }
 
 RTLIL::Cell::Cell() : module(nullptr)
 {
 	static unsigned int hashidx_count = 123456789;
-	hashidx_count = mkhash_xorshift(hashidx_count);
-	hashidx_ = hashidx_count;
+	hashidx_ = next_hashidx(hashidx_count);
 
 	// log("#memtrace# %p\n", this);
 	memhasher();
@@ -4250,7 +4835,10 @@ void RTLIL::Cell::unsetParam(const RTLIL::IdString& paramname)
 
 void RTLIL::Cell::setParam(const RTLIL::IdString& paramname, RTLIL::Const value)
 {
-	parameters[paramname] = std::move(value);
+	RTLIL::Const &param = parameters[paramname];
+	param = std::move(value);
+	if (RTLIL::ConstPool::enabled)
+		param.intern();
 }
 
 const RTLIL::Const &RTLIL::Cell::getParam(const RTLIL::IdString& paramname) const
@@ -4440,277 +5028,515 @@ bool RTLIL::SigChunk::operator !=(const RTLIL::SigChunk &other) const
 	return true;
 }
 
-RTLIL::SigSpec::SigSpec(std::initializer_list<RTLIL::SigSpec> parts)
-{
-	cover("kernel.rtlil.sigspec.init.list");
-
-	width_ = 0;
-	hash_ = 0;
-
-	log_assert(parts.size() > 0);
-	auto ie = parts.begin();
-	auto it = ie + parts.size() - 1;
-	while (it >= ie)
-		append(*it--);
+void RTLIL::SigSpec::destroy()
+{
+	switch (rep_) {
+	case CHUNK:
+		std::destroy_at(&chunk_);
+		break;
+	case BIT:
+		break;
+	case CHUNKS:
+		std::destroy_at(&packed_);
+		break;
+	case BITS:
+		std::destroy_at(&bits_);
+		break;
+	}
 }
 
-RTLIL::SigSpec::SigSpec(const RTLIL::Const &value)
+void RTLIL::SigSpec::init_chunk(RTLIL::SigChunk &&chunk)
 {
-	cover("kernel.rtlil.sigspec.init.const");
-
-	if (GetSize(value) != 0) {
-		chunks_.emplace_back(value);
-		width_ = chunks_.back().width;
+	if (chunk.width == 1) {
+		rep_ = BIT;
+		new (&bit_) RTLIL::SigBit(chunk);
 	} else {
-		width_ = 0;
+		rep_ = CHUNK;
+		new (&chunk_) RTLIL::SigChunk(std::move(chunk));
 	}
-	hash_ = 0;
-	check();
 }
 
-RTLIL::SigSpec::SigSpec(RTLIL::Const &&value)
+void RTLIL::SigSpec::init_packed(std::vector<PackedChunk> &&chunks, int width)
 {
-	cover("kernel.rtlil.sigspec.init.const.move");
-
-	if (GetSize(value) != 0) {
-		chunks_.emplace_back(std::move(value));
-		width_ = chunks_.back().width;
+	if (chunks.empty()) {
+		init_chunk(RTLIL::SigChunk());
+	} else if (chunks.size() == 1) {
+		init_chunk(std::move(chunks.front().chunk));
+	} else if (prefer_bits(GetSize(chunks), width)) {
+		std::vector<RTLIL::SigBit> bits;
+		bits.reserve(width);
+		for (auto &c : chunks)
+			for (int i = 0; i < c.chunk.width; i++)
+				bits.push_back(RTLIL::SigBit(c.chunk, i));
+		init_bits(std::move(bits));
 	} else {
-		width_ = 0;
+		rep_ = CHUNKS;
+		new (&packed_) Packed{std::move(chunks), width};
 	}
-	hash_ = 0;
-	check();
 }
 
-RTLIL::SigSpec::SigSpec(const RTLIL::SigChunk &chunk)
+void RTLIL::SigSpec::init_bits(std::vector<RTLIL::SigBit> &&bits)
 {
-	cover("kernel.rtlil.sigspec.init.chunk");
+	rep_ = BITS;
+	new (&bits_) std::vector<RTLIL::SigBit>(std::move(bits));
+}
 
-	if (chunk.width != 0) {
-		chunks_.emplace_back(chunk);
-		width_ = chunks_.back().width;
-	} else {
-		width_ = 0;
+static int count_sigbit_chunks(const std::vector<RTLIL::SigBit> &bits)
+{
+	int count = 0;
+	for (size_t i = 0; i < bits.size(); i++) {
+		if (i > 0) {
+			const RTLIL::SigBit &prev = bits[i-1], &bit = bits[i];
+			if (bit.wire == NULL ? prev.wire == NULL : prev.wire == bit.wire && prev.offset + 1 == bit.offset)
+				continue;
+		}
+		count++;
 	}
-	hash_ = 0;
-	check();
+	return count;
 }
 
-RTLIL::SigSpec::SigSpec(RTLIL::SigChunk &&chunk)
+void RTLIL::SigSpec::init_from_bits(const std::vector<RTLIL::SigBit> &bits)
 {
-	cover("kernel.rtlil.sigspec.init.chunk.move");
-
-	if (chunk.width != 0) {
-		chunks_.emplace_back(std::move(chunk));
-		width_ = chunks_.back().width;
-	} else {
-		width_ = 0;
+	int num_chunks = count_sigbit_chunks(bits);
+	if (num_chunks > 1 && prefer_bits(num_chunks, GetSize(bits))) {
+		init_bits(std::vector<RTLIL::SigBit>(bits));
+		return;
 	}
-	hash_ = 0;
-	check();
+
+	std::vector<PackedChunk> chunks;
+	chunks.reserve(num_chunks);
+	int width = 0;
+	for (auto &bit : bits)
+		pack_bit(chunks, width, bit);
+	init_packed(std::move(chunks), width);
 }
 
-RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire)
+void RTLIL::SigSpec::pack_chunk(std::vector<PackedChunk> &chunks, int &width, const RTLIL::SigChunk &chunk)
 {
-	cover("kernel.rtlil.sigspec.init.wire");
+	if (chunk.width == 0)
+		return;
 
-	if (wire->width != 0) {
-		chunks_.emplace_back(wire);
-		width_ = chunks_.back().width;
-	} else {
-		width_ = 0;
+	if (!chunks.empty()) {
+		RTLIL::SigChunk &last = chunks.back().chunk;
+		if (last.wire == NULL && chunk.wire == NULL) {
+			last.data.insert(last.data.end(), chunk.data.begin(), chunk.data.end());
+			last.width += chunk.width;
+			width += chunk.width;
+			return;
+		}
+		if (last.wire != NULL && last.wire == chunk.wire && last.offset + last.width == chunk.offset) {
+			last.width += chunk.width;
+			width += chunk.width;
+			return;
+		}
 	}
-	hash_ = 0;
-	check();
+
+	chunks.push_back(PackedChunk{width, chunk});
+	width += chunk.width;
 }
 
-RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire, int offset, int width)
+void RTLIL::SigSpec::pack_bit(std::vector<PackedChunk> &chunks, int &width, const RTLIL::SigBit &bit)
 {
-	cover("kernel.rtlil.sigspec.init.wire_part");
-
-	if (width != 0) {
-		chunks_.emplace_back(wire, offset, width);
-		width_ = chunks_.back().width;
-	} else {
-		width_ = 0;
+	if (!chunks.empty()) {
+		RTLIL::SigChunk &last = chunks.back().chunk;
+		if (last.wire == NULL && bit.wire == NULL) {
+			last.data.push_back(bit.data);
+			last.width++;
+			width++;
+			return;
+		}
+		if (last.wire != NULL && last.wire == bit.wire && last.offset + last.width == bit.offset) {
+			last.width++;
+			width++;
+			return;
+		}
 	}
-	hash_ = 0;
-	check();
+
+	chunks.push_back(PackedChunk{width, RTLIL::SigChunk(bit)});
+	width++;
 }
 
-RTLIL::SigSpec::SigSpec(const std::string &str)
+int RTLIL::SigSpec::packed_index(int index, int hint) const
 {
-	cover("kernel.rtlil.sigspec.init.str");
+	const std::vector<PackedChunk> &chunks = packed_.chunks;
+	int num_chunks = GetSize(chunks);
 
-	if (str.size() != 0) {
-		chunks_.emplace_back(str);
-		width_ = chunks_.back().width;
-	} else {
-		width_ = 0;
+	if (hint < num_chunks && chunks[hint].start <= index) {
+		if (index < chunks[hint].start + chunks[hint].chunk.width)
+			return hint;
+		if (hint + 1 < num_chunks && index < chunks[hint + 1].start + chunks[hint + 1].chunk.width)
+			return hint + 1;
 	}
-	hash_ = 0;
-	check();
+
+	auto it = std::upper_bound(chunks.begin(), chunks.end(), index,
+			[](int i, const PackedChunk &c) { return i < c.start; });
+	return it - chunks.begin() - 1;
+}
+
+RTLIL::SigSpec::SigSpec(const RTLIL::SigSpec &other) : hash_(other.hash_)
+{
+	switch (other.rep_) {
+	case CHUNK:
+		rep_ = CHUNK;
+		new (&chunk_) RTLIL::SigChunk(other.chunk_);
+		break;
+	case BIT:
+		rep_ = BIT;
+		new (&bit_) RTLIL::SigBit(other.bit_);
+		break;
+	case CHUNKS:
+		rep_ = CHUNKS;
+		new (&packed_) Packed(other.packed_);
+		break;
+	case BITS:
+		// copies of an unpacked signal are packed again
+		init_from_bits(other.bits_);
+		break;
+	}
+}
+
+RTLIL::SigSpec::SigSpec(RTLIL::SigSpec &&other) : hash_(other.hash_)
+{
+	switch (other.rep_) {
+	case CHUNK:
+		rep_ = CHUNK;
+		new (&chunk_) RTLIL::SigChunk(std::move(other.chunk_));
+		break;
+	case BIT:
+		rep_ = BIT;
+		new (&bit_) RTLIL::SigBit(other.bit_);
+		break;
+	case CHUNKS:
+		rep_ = CHUNKS;
+		new (&packed_) Packed(std::move(other.packed_));
+		break;
+	case BITS:
+		init_bits(std::move(other.bits_));
+		normalize();
+		break;
+	}
+	// leave the source as an empty signal
+	other.destroy();
+	other.rep_ = CHUNK;
+	other.hash_ = 0;
+	new (&other.chunk_) RTLIL::SigChunk();
 }
 
-RTLIL::SigSpec::SigSpec(int val, int width)
+RTLIL::SigSpec &RTLIL::SigSpec::operator =(const RTLIL::SigSpec &other)
+{
+	if (this != &other) {
+		if (rep_ == CHUNK && other.rep_ == CHUNK) {
+			chunk_ = other.chunk_;
+		} else if (rep_ == CHUNKS && other.rep_ == CHUNKS) {
+			packed_ = other.packed_;
+		} else {
+			destroy();
+			new (this) RTLIL::SigSpec(other);
+		}
+		hash_ = other.hash_;
+	}
+	return *this;
+}
+
+RTLIL::SigSpec &RTLIL::SigSpec::operator =(RTLIL::SigSpec &&other)
+{
+	if (this != &other) {
+		destroy();
+		new (this) RTLIL::SigSpec(std::move(other));
+	}
+	return *this;
+}
+
+RTLIL::SigSpec::SigSpec(std::initializer_list<RTLIL::SigSpec> parts) : SigSpec()
+{
+	cover("kernel.rtlil.sigspec.init.list");
+
+	log_assert(parts.size() > 0);
+	auto ie = parts.begin();
+	auto it = ie + parts.size() - 1;
+	while (it >= ie)
+		append(*it--);
+}
+
+RTLIL::SigSpec::SigSpec(const RTLIL::Const &value) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.const");
+
+	if (GetSize(value) != 0)
+		init_chunk(RTLIL::SigChunk(value));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(RTLIL::Const &&value) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.const.move");
+
+	if (GetSize(value) != 0)
+		init_chunk(RTLIL::SigChunk(std::move(value)));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(const RTLIL::SigChunk &chunk) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.chunk");
+
+	if (chunk.width != 0)
+		init_chunk(RTLIL::SigChunk(chunk));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(RTLIL::SigChunk &&chunk) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.chunk.move");
+
+	if (chunk.width != 0)
+		init_chunk(std::move(chunk));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.wire");
+
+	if (wire->width != 0)
+		init_chunk(RTLIL::SigChunk(wire));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(RTLIL::Wire *wire, int offset, int width) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.wire_part");
+
+	if (width != 0)
+		init_chunk(RTLIL::SigChunk(wire, offset, width));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(const std::string &str) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.str");
+
+	if (str.size() != 0)
+		init_chunk(RTLIL::SigChunk(str));
+	else
+		init_chunk(RTLIL::SigChunk());
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(int val, int width) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.int");
 
 	if (width != 0)
-		chunks_.emplace_back(val, width);
-	width_ = width;
-	hash_ = 0;
+		init_chunk(RTLIL::SigChunk(val, width));
+	else
+		init_chunk(RTLIL::SigChunk());
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(RTLIL::State bit, int width)
+RTLIL::SigSpec::SigSpec(RTLIL::State bit, int width) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.state");
 
 	if (width != 0)
-		chunks_.emplace_back(bit, width);
-	width_ = width;
-	hash_ = 0;
+		init_chunk(RTLIL::SigChunk(bit, width));
+	else
+		init_chunk(RTLIL::SigChunk());
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(const RTLIL::SigBit &bit, int width)
+RTLIL::SigSpec::SigSpec(const RTLIL::SigBit &bit, int width) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.bit");
 
-	if (width != 0) {
-		if (bit.wire == NULL)
-			chunks_.emplace_back(bit.data, width);
-		else
-			for (int i = 0; i < width; i++)
-				chunks_.push_back(bit);
-	}
-	width_ = width;
-	hash_ = 0;
+	if (width == 0)
+		init_chunk(RTLIL::SigChunk());
+	else if (width == 1)
+		init_chunk(RTLIL::SigChunk(bit));
+	else if (bit.wire == NULL)
+		init_chunk(RTLIL::SigChunk(bit.data, width));
+	else
+		init_bits(std::vector<RTLIL::SigBit>(width, bit));
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(const std::vector<RTLIL::SigChunk> &chunks)
+RTLIL::SigSpec::SigSpec(const std::vector<RTLIL::SigChunk> &chunks) : SigSpec()
 {
 	cover("kernel.rtlil.sigspec.init.stdvec_chunks");
 
-	width_ = 0;
-	hash_ = 0;
 	for (const auto &c : chunks)
 		append(c);
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(const std::vector<RTLIL::SigBit> &bits)
+RTLIL::SigSpec::SigSpec(const std::vector<RTLIL::SigBit> &bits) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.stdvec_bits");
 
-	width_ = 0;
-	hash_ = 0;
-	for (const auto &bit : bits)
-		append(bit);
+	init_from_bits(bits);
+	check();
+}
+
+RTLIL::SigSpec::SigSpec(std::vector<RTLIL::SigBit> &&bits) : hash_(0)
+{
+	cover("kernel.rtlil.sigspec.init.stdvec_bits");
+
+	init_from_bits(bits);
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(const pool<RTLIL::SigBit> &bits)
+RTLIL::SigSpec::SigSpec(const pool<RTLIL::SigBit> &bits) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.pool_bits");
 
-	width_ = 0;
-	hash_ = 0;
-	for (const auto &bit : bits)
-		append(bit);
+	std::vector<PackedChunk> chunks;
+	int width = 0;
+	for (auto &bit : bits)
+		pack_bit(chunks, width, bit);
+	init_packed(std::move(chunks), width);
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(const std::set<RTLIL::SigBit> &bits)
+RTLIL::SigSpec::SigSpec(const std::set<RTLIL::SigBit> &bits) : hash_(0)
 {
 	cover("kernel.rtlil.sigspec.init.stdset_bits");
 
-	width_ = 0;
-	hash_ = 0;
-	for (const auto &bit : bits)
-		append(bit);
+	std::vector<PackedChunk> chunks;
+	int width = 0;
+	for (auto &bit : bits)
+		pack_bit(chunks, width, bit);
+	init_packed(std::move(chunks), width);
 	check();
 }
 
-RTLIL::SigSpec::SigSpec(bool bit)
+RTLIL::SigSpec::SigSpec(bool bit) : rep_(BIT), hash_(0), bit_(bit)
 {
 	cover("kernel.rtlil.sigspec.init.bool");
 
-	width_ = 0;
-	hash_ = 0;
-	append(SigBit(bit));
 	check();
 }
 
-void RTLIL::SigSpec::pack() const
+void RTLIL::SigSpec::unpack()
 {
-	RTLIL::SigSpec *that = (RTLIL::SigSpec*)this;
-
-	if (that->bits_.empty())
+	if (rep_ == BITS)
 		return;
 
-	cover("kernel.rtlil.sigspec.convert.pack");
-	log_assert(that->chunks_.empty());
+	cover("kernel.rtlil.sigspec.convert.unpack");
 
-	std::vector<RTLIL::SigBit> old_bits;
-	old_bits.swap(that->bits_);
+	std::vector<RTLIL::SigBit> bits = to_sigbit_vector();
+	destroy();
+	init_bits(std::move(bits));
+}
 
-	RTLIL::SigChunk *last = NULL;
-	int last_end_offset = 0;
+void RTLIL::SigSpec::normalize()
+{
+	if (rep_ != BITS)
+		return;
 
-	for (auto &bit : old_bits) {
-		if (last && bit.wire == last->wire) {
-			if (bit.wire == NULL) {
-				last->data.push_back(bit.data);
-				last->width++;
-				continue;
-			} else if (last_end_offset == bit.offset) {
-				last_end_offset++;
-				last->width++;
-				continue;
-			}
-		}
-		that->chunks_.push_back(bit);
-		last = &that->chunks_.back();
-		last_end_offset = bit.offset + 1;
-	}
+	int num_chunks = count_sigbit_chunks(bits_);
+	if (num_chunks > 1 && prefer_bits(num_chunks, GetSize(bits_)))
+		return;
 
-	check();
+	cover("kernel.rtlil.sigspec.convert.normalize");
+
+	std::vector<RTLIL::SigBit> bits = std::move(bits_);
+	destroy();
+	init_from_bits(bits);
 }
 
-void RTLIL::SigSpec::unpack() const
+void RTLIL::SigSpec::Chunks::const_iterator::load()
 {
-	RTLIL::SigSpec *that = (RTLIL::SigSpec*)this;
+	int width = sig_p->size();
+	if (index >= width || sig_p->rep_ == CHUNK || sig_p->rep_ == CHUNKS)
+		return;
 
-	if (that->chunks_.empty())
+	if (sig_p->rep_ == BIT) {
+		current = RTLIL::SigChunk(sig_p->bit_);
 		return;
+	}
 
-	cover("kernel.rtlil.sigspec.convert.unpack");
-	log_assert(that->bits_.empty());
+	const std::vector<RTLIL::SigBit> &bits = sig_p->bits_;
+	const RTLIL::SigBit &first = bits[index];
+	int end = index + 1;
+	if (first.wire == NULL) {
+		while (end < width && bits[end].wire == NULL)
+			end++;
+		current.wire = NULL;
+		current.offset = 0;
+		current.data.clear();
+		for (int i = index; i < end; i++)
+			current.data.push_back(bits[i].data);
+	} else {
+		while (end < width && bits[end].wire == first.wire && bits[end].offset == first.offset + (end - index))
+			end++;
+		current.wire = first.wire;
+		current.offset = first.offset;
+		current.data.clear();
+	}
+	current.width = end - index;
+}
 
-	that->bits_.reserve(that->width_);
-	for (auto &c : that->chunks_)
-		for (int i = 0; i < c.width; i++)
-			that->bits_.emplace_back(c, i);
+int RTLIL::SigSpec::Chunks::size() const
+{
+	switch (sig_p->rep_) {
+	case CHUNKS:
+		return GetSize(sig_p->packed_.chunks);
+	case BITS: {
+		int count = 0;
+		for (auto it = begin(), it_end = end(); it != it_end; ++it)
+			count++;
+		return count;
+	}
+	default:
+		return sig_p->empty() ? 0 : 1;
+	}
+}
 
-	that->chunks_.clear();
-	that->hash_ = 0;
+RTLIL::SigChunk RTLIL::SigSpec::Chunks::back() const
+{
+	log_assert(!empty());
+	if (sig_p->rep_ == CHUNKS)
+		return sig_p->packed_.chunks.back().chunk;
+	RTLIL::SigChunk last;
+	for (auto &chunk : *this)
+		last = chunk;
+	return last;
 }
 
-void RTLIL::SigSpec::updhash() const
+RTLIL::SigSpec::Chunks::operator std::vector<RTLIL::SigChunk>() const
 {
-	RTLIL::SigSpec *that = (RTLIL::SigSpec*)this;
+	std::vector<RTLIL::SigChunk> result;
+	for (auto &chunk : *this)
+		result.push_back(chunk);
+	return result;
+}
+
+RTLIL::SigSpec::operator std::vector<RTLIL::SigChunk>() const
+{
+	return chunks();
+}
 
-	if (that->hash_ != 0)
+void RTLIL::SigSpec::updhash() const
+{
+	if (hash_ != 0)
 		return;
 
 	cover("kernel.rtlil.sigspec.hash");
-	that->pack();
 
 	Hasher h;
-	for (auto &c : that->chunks_)
+	for (auto &c : chunks())
 		if (c.wire == NULL) {
 			for (auto &v : c.data)
 				h.eat(v);
@@ -4719,9 +5545,9 @@ void RTLIL::SigSpec::updhash() const
 			h.eat(c.offset);
 			h.eat(c.width);
 		}
-	that->hash_ = h.yield();
-	if (that->hash_ == 0)
-		that->hash_ = 1;
+	hash_ = h.yield();
+	if (hash_ == 0)
+		hash_ = 1;
 }
 
 void RTLIL::SigSpec::sort()
@@ -4729,22 +5555,37 @@ void RTLIL::SigSpec::sort()
 	unpack();
 	cover("kernel.rtlil.sigspec.sort");
 	std::sort(bits_.begin(), bits_.end());
+	hash_ = 0;
+	normalize();
 }
 
 void RTLIL::SigSpec::sort_and_unify()
 {
-	unpack();
 	cover("kernel.rtlil.sigspec.sort_and_unify");
 
-	// A copy of the bits vector is used to prevent duplicating the logic from
-	// SigSpec::SigSpec(std::vector<SigBit>).  This incurrs an extra copy but
-	// that isn't showing up as significant in profiles.
-	std::vector<SigBit> unique_bits = bits_;
+	std::vector<SigBit> unique_bits = to_sigbit_vector();
 	std::sort(unique_bits.begin(), unique_bits.end());
 	auto last = std::unique(unique_bits.begin(), unique_bits.end());
 	unique_bits.erase(last, unique_bits.end());
 
-	*this = unique_bits;
+	*this = std::move(unique_bits);
+}
+
+void RTLIL::SigSpec::reverse()
+{
+	if (size() <= 1)
+		return;
+
+	cover("kernel.rtlil.sigspec.reverse");
+
+	if (rep_ == CHUNK && chunk_.wire == NULL) {
+		std::reverse(chunk_.data.begin(), chunk_.data.end());
+	} else {
+		unpack();
+		std::reverse(bits_.begin(), bits_.end());
+		normalize();
+	}
+	hash_ = 0;
 }
 
 void RTLIL::SigSpec::replace(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec &with)
@@ -4755,28 +5596,37 @@ void RTLIL::SigSpec::replace(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec
 void RTLIL::SigSpec::replace(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec &with, RTLIL::SigSpec *other) const
 {
 	log_assert(other != NULL);
-	log_assert(width_ == other->width_);
-	log_assert(pattern.width_ == with.width_);
-
-	pattern.unpack();
-	with.unpack();
-	unpack();
-	other->unpack();
+	log_assert(size() == other->size());
+	log_assert(pattern.size() == with.size());
 
 	dict<RTLIL::SigBit, int> pattern_to_with;
-	for (int i = 0; i < GetSize(pattern.bits_); i++) {
-		if (pattern.bits_[i].wire != NULL) {
-			pattern_to_with.emplace(pattern.bits_[i], i);
-		}
+	int i = 0;
+	for (auto &bit : pattern) {
+		if (bit.wire != NULL)
+			pattern_to_with.emplace(bit, i);
+		i++;
 	}
+	if (pattern_to_with.empty())
+		return;
 
-	for (int j = 0; j < GetSize(bits_); j++) {
-		auto it = pattern_to_with.find(bits_[j]);
+	// other may be this signal, the iterator follows it being unpacked
+	bool changed = false;
+	int j = 0;
+	for (auto &bit : *this) {
+		auto it = pattern_to_with.find(bit);
 		if (it != pattern_to_with.end()) {
-			other->bits_[j] = with.bits_[it->second];
+			RTLIL::SigBit new_bit = with[it->second];
+			other->unpack();
+			other->bits_[j] = new_bit;
+			changed = true;
 		}
+		j++;
 	}
 
+	if (changed) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	other->check();
 }
 
@@ -4790,18 +5640,26 @@ void RTLIL::SigSpec::replace(const dict<RTLIL::SigBit, RTLIL::SigBit> &rules, RT
 	cover("kernel.rtlil.sigspec.replace_dict");
 
 	log_assert(other != NULL);
-	log_assert(width_ == other->width_);
+	log_assert(size() == other->size());
 
 	if (rules.empty()) return;
-	unpack();
-	other->unpack();
 
-	for (int i = 0; i < GetSize(bits_); i++) {
-		auto it = rules.find(bits_[i]);
-		if (it != rules.end())
+	bool changed = false;
+	int i = 0;
+	for (auto &bit : *this) {
+		auto it = rules.find(bit);
+		if (it != rules.end()) {
+			other->unpack();
 			other->bits_[i] = it->second;
+			changed = true;
+		}
+		i++;
 	}
 
+	if (changed) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	other->check();
 }
 
@@ -4815,18 +5673,26 @@ void RTLIL::SigSpec::replace(const std::map<RTLIL::SigBit, RTLIL::SigBit> &rules
 	cover("kernel.rtlil.sigspec.replace_map");
 
 	log_assert(other != NULL);
-	log_assert(width_ == other->width_);
+	log_assert(size() == other->size());
 
 	if (rules.empty()) return;
-	unpack();
-	other->unpack();
 
-	for (int i = 0; i < GetSize(bits_); i++) {
-		auto it = rules.find(bits_[i]);
-		if (it != rules.end())
+	bool changed = false;
+	int i = 0;
+	for (auto &bit : *this) {
+		auto it = rules.find(bit);
+		if (it != rules.end()) {
+			other->unpack();
 			other->bits_[i] = it->second;
+			changed = true;
+		}
+		i++;
 	}
 
+	if (changed) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	other->check();
 }
 
@@ -4848,9 +5714,11 @@ void RTLIL::SigSpec::remove2(const RTLIL::SigSpec &pattern, RTLIL::SigSpec *othe
 	else
 		cover("kernel.rtlil.sigspec.remove");
 
+	std::vector<RTLIL::SigChunk> pattern_chunks = pattern.chunks();
+
 	unpack();
 	if (other != NULL) {
-		log_assert(width_ == other->width_);
+		log_assert(size() == other->size());
 		other->unpack();
 	}
 
@@ -4858,20 +5726,23 @@ void RTLIL::SigSpec::remove2(const RTLIL::SigSpec &pattern, RTLIL::SigSpec *othe
 	{
 		if (bits_[i].wire == NULL) continue;
 
-		for (auto &pattern_chunk : pattern.chunks())
+		for (auto &pattern_chunk : pattern_chunks)
 			if (bits_[i].wire == pattern_chunk.wire &&
 				bits_[i].offset >= pattern_chunk.offset &&
 				bits_[i].offset < pattern_chunk.offset + pattern_chunk.width) {
 				bits_.erase(bits_.begin() + i);
-				width_--;
-				if (other != NULL) {
+				if (other != NULL)
 					other->bits_.erase(other->bits_.begin() + i);
-					other->width_--;
-				}
 				break;
 			}
 	}
 
+	hash_ = 0;
+	normalize();
+	if (other != NULL) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	check();
 }
 
@@ -4896,21 +5767,24 @@ void RTLIL::SigSpec::remove2(const pool<RTLIL::SigBit> &pattern, RTLIL::SigSpec
 	unpack();
 
 	if (other != NULL) {
-		log_assert(width_ == other->width_);
+		log_assert(size() == other->size());
 		other->unpack();
 	}
 
 	for (int i = GetSize(bits_) - 1; i >= 0; i--) {
 		if (bits_[i].wire != NULL && pattern.count(bits_[i])) {
 			bits_.erase(bits_.begin() + i);
-			width_--;
-			if (other != NULL) {
+			if (other != NULL)
 				other->bits_.erase(other->bits_.begin() + i);
-				other->width_--;
-			}
 		}
 	}
 
+	hash_ = 0;
+	normalize();
+	if (other != NULL) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	check();
 }
 
@@ -4924,21 +5798,24 @@ void RTLIL::SigSpec::remove2(const std::set<RTLIL::SigBit> &pattern, RTLIL::SigS
 	unpack();
 
 	if (other != NULL) {
-		log_assert(width_ == other->width_);
+		log_assert(size() == other->size());
 		other->unpack();
 	}
 
 	for (int i = GetSize(bits_) - 1; i >= 0; i--) {
 		if (bits_[i].wire != NULL && pattern.count(bits_[i])) {
 			bits_.erase(bits_.begin() + i);
-			width_--;
-			if (other != NULL) {
+			if (other != NULL)
 				other->bits_.erase(other->bits_.begin() + i);
-				other->width_--;
-			}
 		}
 	}
 
+	hash_ = 0;
+	normalize();
+	if (other != NULL) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	check();
 }
 
@@ -4952,21 +5829,24 @@ void RTLIL::SigSpec::remove2(const pool<RTLIL::Wire*> &pattern, RTLIL::SigSpec *
 	unpack();
 
 	if (other != NULL) {
-		log_assert(width_ == other->width_);
+		log_assert(size() == other->size());
 		other->unpack();
 	}
 
 	for (int i = GetSize(bits_) - 1; i >= 0; i--) {
 		if (bits_[i].wire != NULL && pattern.count(bits_[i].wire)) {
 			bits_.erase(bits_.begin() + i);
-			width_--;
-			if (other != NULL) {
+			if (other != NULL)
 				other->bits_.erase(other->bits_.begin() + i);
-				other->width_--;
-			}
 		}
 	}
 
+	hash_ = 0;
+	normalize();
+	if (other != NULL) {
+		other->hash_ = 0;
+		other->normalize();
+	}
 	check();
 }
 
@@ -4977,28 +5857,21 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(const RTLIL::SigSpec &pattern, const RTLI
 	else
 		cover("kernel.rtlil.sigspec.extract");
 
-	log_assert(other == NULL || width_ == other->width_);
+	log_assert(other == NULL || size() == other->size());
 
 	RTLIL::SigSpec ret;
 	std::vector<RTLIL::SigBit> bits_match = to_sigbit_vector();
+	std::vector<RTLIL::SigBit> bits_other;
+	if (other)
+		bits_other = other->to_sigbit_vector();
 
 	for (auto& pattern_chunk : pattern.chunks()) {
-		if (other) {
-			std::vector<RTLIL::SigBit> bits_other = other->to_sigbit_vector();
-			for (int i = 0; i < width_; i++)
-				if (bits_match[i].wire &&
-					bits_match[i].wire == pattern_chunk.wire &&
-					bits_match[i].offset >= pattern_chunk.offset &&
-					bits_match[i].offset < pattern_chunk.offset + pattern_chunk.width)
-					ret.append(bits_other[i]);
-		} else {
-			for (int i = 0; i < width_; i++)
-				if (bits_match[i].wire &&
-					bits_match[i].wire == pattern_chunk.wire &&
-					bits_match[i].offset >= pattern_chunk.offset &&
-					bits_match[i].offset < pattern_chunk.offset + pattern_chunk.width)
-					ret.append(bits_match[i]);
-		}
+		for (int i = 0; i < GetSize(bits_match); i++)
+			if (bits_match[i].wire &&
+				bits_match[i].wire == pattern_chunk.wire &&
+				bits_match[i].offset >= pattern_chunk.offset &&
+				bits_match[i].offset < pattern_chunk.offset + pattern_chunk.width)
+				ret.append(other ? bits_other[i] : bits_match[i]);
 	}
 
 	ret.check();
@@ -5012,20 +5885,15 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(const pool<RTLIL::SigBit> &pattern, const
 	else
 		cover("kernel.rtlil.sigspec.extract");
 
-	log_assert(other == NULL || width_ == other->width_);
+	log_assert(other == NULL || size() == other->size());
 
-	std::vector<RTLIL::SigBit> bits_match = to_sigbit_vector();
 	RTLIL::SigSpec ret;
 
-	if (other) {
-		std::vector<RTLIL::SigBit> bits_other = other->to_sigbit_vector();
-		for (int i = 0; i < width_; i++)
-			if (bits_match[i].wire && pattern.count(bits_match[i]))
-				ret.append(bits_other[i]);
-	} else {
-		for (int i = 0; i < width_; i++)
-			if (bits_match[i].wire && pattern.count(bits_match[i]))
-				ret.append(bits_match[i]);
+	int i = 0;
+	for (auto &bit : *this) {
+		if (bit.wire && pattern.count(bit))
+			ret.append(other ? (*other)[i] : bit);
+		i++;
 	}
 
 	ret.check();
@@ -5036,56 +5904,71 @@ void RTLIL::SigSpec::replace(int offset, const RTLIL::SigSpec &with)
 {
 	cover("kernel.rtlil.sigspec.replace_pos");
 
-	unpack();
-	with.unpack();
-
 	log_assert(offset >= 0);
-	log_assert(with.width_ >= 0);
-	log_assert(offset+with.width_ <= width_);
+	log_assert(with.size() >= 0);
+	log_assert(offset+with.size() <= size());
 
-	for (int i = 0; i < with.width_; i++)
-		bits_.at(offset + i) = with.bits_.at(i);
+	if (with.empty())
+		return;
+
+	if (&with == this) {
+		log_assert(offset == 0);
+		return;
+	}
+
+	if (rep_ == BITS) {
+		int i = offset;
+		for (auto &bit : with)
+			bits_.at(i++) = bit;
+		hash_ = 0;
+	} else {
+		RTLIL::SigSpec result = extract(0, offset);
+		result.append(with);
+		result.append(extract_end(offset + with.size()));
+		*this = std::move(result);
+	}
 
 	check();
 }
 
 void RTLIL::SigSpec::remove_const()
 {
-	if (packed())
-	{
-		cover("kernel.rtlil.sigspec.remove_const.packed");
-
-		std::vector<RTLIL::SigChunk> new_chunks;
-		new_chunks.reserve(GetSize(chunks_));
-
-		width_ = 0;
-		for (auto &chunk : chunks_)
-			if (chunk.wire != NULL) {
-				if (!new_chunks.empty() &&
-					new_chunks.back().wire == chunk.wire &&
-					new_chunks.back().offset + new_chunks.back().width == chunk.offset) {
-					new_chunks.back().width += chunk.width;
-				} else {
-					new_chunks.push_back(chunk);
-				}
-				width_ += chunk.width;
-			}
-
-		chunks_.swap(new_chunks);
+	cover("kernel.rtlil.sigspec.remove_const");
+
+	switch (rep_) {
+	case CHUNK:
+		if (chunk_.wire == NULL && chunk_.width != 0)
+			*this = SigSpec();
+		break;
+	case BIT:
+		if (bit_.wire == NULL)
+			*this = SigSpec();
+		break;
+	case CHUNKS: {
+		std::vector<PackedChunk> chunks;
+		int width = 0;
+		for (auto &c : packed_.chunks)
+			if (c.chunk.wire != NULL)
+				pack_chunk(chunks, width, c.chunk);
+
+		if (width != size()) {
+			destroy();
+			init_packed(std::move(chunks), width);
+			hash_ = 0;
+		}
+		break;
 	}
-	else
-	{
-		cover("kernel.rtlil.sigspec.remove_const.unpacked");
-
+	case BITS: {
 		std::vector<RTLIL::SigBit> new_bits;
-		new_bits.reserve(width_);
+		new_bits.reserve(size());
 
 		for (auto &bit : bits_)
 			if (bit.wire != NULL)
 				new_bits.push_back(bit);
 
-		bits_.swap(new_bits);
-		width_ = bits_.size();
+		*this = std::move(new_bits);
+		break;
+	}
 	}
 
 	check();
@@ -5095,14 +5978,22 @@ void RTLIL::SigSpec::remove(int offset, int length)
 {
 	cover("kernel.rtlil.sigspec.remove_pos");
 
-	unpack();
-
 	log_assert(offset >= 0);
 	log_assert(length >= 0);
-	log_assert(offset + length <= width_);
+	log_assert(offset + length <= size());
 
-	bits_.erase(bits_.begin() + offset, bits_.begin() + offset + length);
-	width_ = bits_.size();
+	if (length == 0)
+		return;
+
+	hash_ = 0;
+
+	if (rep_ == BITS) {
+		bits_.erase(bits_.begin() + offset, bits_.begin() + offset + length);
+	} else {
+		RTLIL::SigSpec result = extract(0, offset);
+		result.append(extract_end(offset + length));
+		*this = std::move(result);
+	}
 
 	check();
 }
@@ -5111,126 +6002,141 @@ RTLIL::SigSpec RTLIL::SigSpec::extract(int offset, int length) const
 {
 	log_assert(offset >= 0);
 	log_assert(length >= 0);
-	log_assert(offset + length <= width_);
+	log_assert(offset + length <= size());
 
 	cover("kernel.rtlil.sigspec.extract_pos");
 
-	if (packed()) {
-		SigSpec extracted;
-		extracted.width_ = length;
-
-		auto it = chunks_.begin();
-		for (; offset; offset -= it->width, it++) {
-			if (offset < it->width) {
-				int chunk_length = min(it->width - offset, length);
-				extracted.chunks_.emplace_back(it->extract(offset, chunk_length));
-				length -= chunk_length;
-				it++;
-				break;
-			}
-		}
-		for (; length; length -= it->width, it++) {
-			if (length >= it->width) {
-				extracted.chunks_.emplace_back(*it);
-			} else {
-				extracted.chunks_.emplace_back(it->extract(0, length));
-				break;
-			}
+	switch (rep_) {
+	case CHUNK:
+		return chunk_.extract(offset, length);
+	case BIT:
+		return length == 0 ? SigSpec() : *this;
+	case CHUNKS: {
+		if (length == 0)
+			return SigSpec();
+		std::vector<PackedChunk> chunks;
+		int width = 0;
+		int end = offset + length;
+		for (int i = packed_index(offset, 0); width < length; i++) {
+			const PackedChunk &c = packed_.chunks[i];
+			int lo = std::max(offset, c.start) - c.start;
+			int hi = std::min(end, c.start + c.chunk.width) - c.start;
+			if (lo == 0 && hi == c.chunk.width)
+				pack_chunk(chunks, width, c.chunk);
+			else
+				pack_chunk(chunks, width, c.chunk.extract(lo, hi - lo));
 		}
-
-		return extracted;
-	} else {
+		RTLIL::SigSpec ret;
+		ret.destroy();
+		ret.init_packed(std::move(chunks), width);
+		return ret;
+	}
+	default:
 		return std::vector<RTLIL::SigBit>(bits_.begin() + offset, bits_.begin() + offset + length);
 	}
 }
 
 void RTLIL::SigSpec::append(const RTLIL::SigSpec &signal)
 {
-	if (signal.width_ == 0)
+	if (signal.empty())
 		return;
 
-	if (width_ == 0) {
+	if (empty()) {
 		*this = signal;
 		return;
 	}
 
+	if (&signal == this) {
+		RTLIL::SigSpec copy = signal;
+		append(copy);
+		return;
+	}
+
 	cover("kernel.rtlil.sigspec.append");
 
-	if (packed() != signal.packed()) {
-		pack();
-		signal.pack();
+	hash_ = 0;
+
+	if (rep_ == BITS) {
+		bits_.reserve(bits_.size() + signal.size());
+		for (auto &bit : signal)
+			bits_.push_back(bit);
+		check();
+		return;
 	}
 
-	if (packed())
-		for (auto &other_c : signal.chunks_)
-		{
-			auto &my_last_c = chunks_.back();
-			if (my_last_c.wire == NULL && other_c.wire == NULL) {
-				auto &this_data = my_last_c.data;
-				auto &other_data = other_c.data;
-				this_data.insert(this_data.end(), other_data.begin(), other_data.end());
-				my_last_c.width += other_c.width;
-			} else
-			if (my_last_c.wire == other_c.wire && my_last_c.offset + my_last_c.width == other_c.offset) {
-				my_last_c.width += other_c.width;
-			} else
-				chunks_.push_back(other_c);
+	// appending a single chunk that continues this single chunk
+	if (rep_ == BIT && (signal.rep_ == BIT || signal.rep_ == CHUNK)) {
+		RTLIL::SigChunk chunk(bit_);
+		rep_ = CHUNK;
+		new (&chunk_) RTLIL::SigChunk(std::move(chunk));
+	}
+	if (rep_ == CHUNK && (signal.rep_ == BIT || signal.rep_ == CHUNK)) {
+		RTLIL::SigBit first = signal.bit_at(0);
+		int other_width = signal.size();
+		if (chunk_.wire == NULL && first.wire == NULL) {
+			if (signal.rep_ == BIT)
+				chunk_.data.push_back(first.data);
+			else
+				chunk_.data.insert(chunk_.data.end(), signal.chunk_.data.begin(), signal.chunk_.data.end());
+			chunk_.width += other_width;
+			check();
+			return;
 		}
-	else
-		bits_.insert(bits_.end(), signal.bits_.begin(), signal.bits_.end());
-
-	width_ += signal.width_;
-	check();
-}
-
-void RTLIL::SigSpec::append(const RTLIL::SigBit &bit)
-{
-	if (packed())
-	{
-		cover("kernel.rtlil.sigspec.append_bit.packed");
+		if (chunk_.wire != NULL && chunk_.wire == first.wire && chunk_.offset + chunk_.width == first.offset) {
+			chunk_.width += other_width;
+			check();
+			return;
+		}
+	}
 
-		if (chunks_.size() == 0)
-			chunks_.push_back(bit);
+	if (rep_ != CHUNKS) {
+		int width = size();
+		std::vector<PackedChunk> chunks;
+		if (rep_ == BIT)
+			chunks.push_back(PackedChunk{0, RTLIL::SigChunk(bit_)});
 		else
-			if (bit.wire == NULL)
-				if (chunks_.back().wire == NULL) {
-					chunks_.back().data.push_back(bit.data);
-					chunks_.back().width++;
-				} else
-					chunks_.push_back(bit);
-			else
-				if (chunks_.back().wire == bit.wire && chunks_.back().offset + chunks_.back().width == bit.offset)
-					chunks_.back().width++;
-				else
-					chunks_.push_back(bit);
+			chunks.push_back(PackedChunk{0, std::move(chunk_)});
+		destroy();
+		rep_ = CHUNKS;
+		new (&packed_) Packed{std::move(chunks), width};
 	}
+
+	if (signal.rep_ == BIT)
+		pack_bit(packed_.chunks, packed_.width, signal.bit_);
 	else
-	{
-		cover("kernel.rtlil.sigspec.append_bit.unpacked");
-		bits_.push_back(bit);
+		for (auto &chunk : signal.chunks())
+			pack_chunk(packed_.chunks, packed_.width, chunk);
+
+	// an unpacked signal may have continued the single chunk
+	if (packed_.chunks.size() == 1) {
+		RTLIL::SigChunk chunk = std::move(packed_.chunks.front().chunk);
+		destroy();
+		init_chunk(std::move(chunk));
+	} else if (prefer_bits(GetSize(packed_.chunks), packed_.width)) {
+		unpack();
 	}
 
-	width_++;
 	check();
 }
 
+void RTLIL::SigSpec::append(const RTLIL::SigBit &bit)
+{
+	append(RTLIL::SigSpec(bit));
+}
+
 void RTLIL::SigSpec::extend_u0(int width, bool is_signed)
 {
 	cover("kernel.rtlil.sigspec.extend_u0");
 
-	pack();
-
-	if (width_ > width)
-		remove(width, width_ - width);
+	if (size() > width)
+		remove(width, size() - width);
 
-	if (width_ < width) {
-		RTLIL::SigBit padding = width_ > 0 ? (*this)[width_ - 1] : RTLIL::State::Sx;
+	if (size() < width) {
+		RTLIL::SigBit padding = size() > 0 ? msb() : RTLIL::State::Sx;
 		if (!is_signed)
 			padding = RTLIL::State::S0;
-		while (width_ < width)
-			append(padding);
+		append(RTLIL::SigSpec(padding, width - size()));
 	}
-
 }
 
 RTLIL::SigSpec RTLIL::SigSpec::repeat(int num) const
@@ -5246,50 +6152,85 @@ RTLIL::SigSpec RTLIL::SigSpec::repeat(int num) const
 #ifndef NDEBUG
 void RTLIL::SigSpec::check(Module *mod) const
 {
-	if (width_ > 64)
-	{
-		cover("kernel.rtlil.sigspec.check.skip");
-	}
-	else if (packed())
+	switch (rep_)
 	{
-		cover("kernel.rtlil.sigspec.check.packed");
+	case CHUNK:
+		cover("kernel.rtlil.sigspec.check.chunk");
+
+		log_assert(chunk_.width != 1);
+		if (chunk_.wire == NULL) {
+			log_assert(chunk_.offset == 0);
+			log_assert(chunk_.data.size() == (size_t)chunk_.width);
+		} else {
+			log_assert(chunk_.width > 1);
+			log_assert(chunk_.offset >= 0);
+			log_assert(chunk_.offset + chunk_.width <= chunk_.wire->width);
+			log_assert(chunk_.data.size() == 0);
+			if (mod != nullptr)
+				log_assert(chunk_.wire->module == mod);
+		}
+		break;
+
+	case BIT:
+		cover("kernel.rtlil.sigspec.check.bit");
 
-		int w = 0;
-		for (size_t i = 0; i < chunks_.size(); i++) {
-			const RTLIL::SigChunk &chunk = chunks_[i];
-			log_assert(chunk.width != 0);
+		if (bit_.wire != nullptr) {
+			log_assert(bit_.offset >= 0 && bit_.offset < bit_.wire->width);
+			if (mod != nullptr)
+				log_assert(bit_.wire->module == mod);
+		}
+		break;
+
+	case CHUNKS: {
+		cover("kernel.rtlil.sigspec.check.chunks");
+
+		const std::vector<PackedChunk> &chunks = packed_.chunks;
+		log_assert(chunks.size() >= 2);
+		log_assert(!prefer_bits(GetSize(chunks), packed_.width));
+		if (chunks.size() > 64)
+			break;
+
+		int width = 0;
+		for (size_t i = 0; i < chunks.size(); i++) {
+			const RTLIL::SigChunk &chunk = chunks[i].chunk;
+			log_assert(chunks[i].start == width);
+			log_assert(chunk.width > 0);
 			if (chunk.wire == NULL) {
-				if (i > 0)
-					log_assert(chunks_[i-1].wire != NULL);
 				log_assert(chunk.offset == 0);
 				log_assert(chunk.data.size() == (size_t)chunk.width);
 			} else {
-				if (i > 0 && chunks_[i-1].wire == chunk.wire)
-					log_assert(chunk.offset != chunks_[i-1].offset + chunks_[i-1].width);
 				log_assert(chunk.offset >= 0);
-				log_assert(chunk.width >= 0);
 				log_assert(chunk.offset + chunk.width <= chunk.wire->width);
 				log_assert(chunk.data.size() == 0);
 				if (mod != nullptr)
 					log_assert(chunk.wire->module == mod);
 			}
-			w += chunk.width;
+			if (i > 0) {
+				// the chunks are maximal
+				const RTLIL::SigChunk &prev = chunks[i-1].chunk;
+				log_assert(prev.wire != NULL || chunk.wire != NULL);
+				log_assert(prev.wire != chunk.wire || prev.offset + prev.width != chunk.offset);
+			}
+			width += chunk.width;
 		}
-		log_assert(w == width_);
-		log_assert(bits_.empty());
+		log_assert(width == packed_.width);
+		break;
 	}
-	else
-	{
-		cover("kernel.rtlil.sigspec.check.unpacked");
+
+	case BITS:
+		if (size() > 64) {
+			cover("kernel.rtlil.sigspec.check.skip");
+			break;
+		}
+
+		cover("kernel.rtlil.sigspec.check.bits");
 
 		if (mod != nullptr) {
 			for (size_t i = 0; i < bits_.size(); i++)
 				if (bits_[i].wire != nullptr)
 					log_assert(bits_[i].wire->module == mod);
 		}
-
-		log_assert(width_ == GetSize(bits_));
-		log_assert(chunks_.empty());
+		break;
 	}
 }
 #endif
@@ -5301,14 +6242,13 @@ bool RTLIL::SigSpec::operator <(const RTLIL::SigSpec &other) const
 	if (this == &other)
 		return false;
 
-	if (width_ != other.width_)
-		return width_ < other.width_;
-
-	pack();
-	other.pack();
+	if (size() != other.size())
+		return size() < other.size();
 
-	if (chunks_.size() != other.chunks_.size())
-		return chunks_.size() < other.chunks_.size();
+	int num_chunks = chunks().size();
+	int other_num_chunks = other.chunks().size();
+	if (num_chunks != other_num_chunks)
+		return num_chunks < other_num_chunks;
 
 	updhash();
 	other.updhash();
@@ -5316,10 +6256,10 @@ bool RTLIL::SigSpec::operator <(const RTLIL::SigSpec &other) const
 	if (hash_ != other.hash_)
 		return hash_ < other.hash_;
 
-	for (size_t i = 0; i < chunks_.size(); i++)
-		if (chunks_[i] != other.chunks_[i]) {
+	for (auto it = chunks().begin(), other_it = other.chunks().begin(), it_end = chunks().end(); it != it_end; ++it, ++other_it)
+		if (*it != *other_it) {
 			cover("kernel.rtlil.sigspec.comp_lt.hash_collision");
-			return chunks_[i] < other.chunks_[i];
+			return *it < *other_it;
 		}
 
 	cover("kernel.rtlil.sigspec.comp_lt.equal");
@@ -5333,32 +6273,38 @@ bool RTLIL::SigSpec::operator ==(const RTLIL::SigSpec &other) const
 	if (this == &other)
 		return true;
 
-	if (width_ != other.width_)
+	if (size() != other.size())
 		return false;
 
-	// Without this, SigSpec() == SigSpec(State::S0, 0) will fail
-	//   since the RHS will contain one SigChunk of width 0 causing
-	//   the size check below to fail
-	if (width_ == 0)
+	if (size() == 0)
 		return true;
 
-	pack();
-	other.pack();
+	if (rep_ == CHUNK && other.rep_ == CHUNK)
+		return chunk_ == other.chunk_;
 
-	if (chunks_.size() != other.chunks_.size())
+	if (hash_ != 0 && other.hash_ != 0 && hash_ != other.hash_)
 		return false;
 
-	updhash();
-	other.updhash();
-
-	if (hash_ != other.hash_)
-		return false;
+	// packed signals are canonical, so equal ones have the same chunks
+	if (rep_ != BITS && other.rep_ != BITS) {
+		if (rep_ != other.rep_)
+			return false;
+		if (rep_ == BIT)
+			return bit_ == other.bit_;
+		const std::vector<PackedChunk> &chunks = packed_.chunks;
+		const std::vector<PackedChunk> &other_chunks = other.packed_.chunks;
+		if (chunks.size() != other_chunks.size())
+			return false;
+		for (size_t i = 0; i < chunks.size(); i++)
+			if (chunks[i].chunk != other_chunks[i].chunk)
+				return false;
+		cover("kernel.rtlil.sigspec.comp_eq.equal");
+		return true;
+	}
 
-	for (size_t i = 0; i < chunks_.size(); i++)
-		if (chunks_[i] != other.chunks_[i]) {
-			cover("kernel.rtlil.sigspec.comp_eq.hash_collision");
+	for (auto it = begin(), other_it = other.begin(), it_end = end(); it != it_end; ++it, ++other_it)
+		if (*it != *other_it)
 			return false;
-		}
 
 	cover("kernel.rtlil.sigspec.comp_eq.equal");
 	return true;
@@ -5368,22 +6314,31 @@ bool RTLIL::SigSpec::is_wire() const
 {
 	cover("kernel.rtlil.sigspec.is_wire");
 
-	pack();
-	return GetSize(chunks_) == 1 && chunks_[0].wire && chunks_[0].wire->width == width_;
+	if (!is_chunk())
+		return false;
+	RTLIL::Wire *wire = bit_at(0).wire;
+	return wire && bit_at(0).offset == 0 && wire->width == size();
 }
 
 bool RTLIL::SigSpec::is_chunk() const
 {
 	cover("kernel.rtlil.sigspec.is_chunk");
 
-	pack();
-	return GetSize(chunks_) == 1;
+	switch (rep_) {
+	case CHUNK:
+		return chunk_.width != 0;
+	case BIT:
+		return true;
+	case CHUNKS:
+		return false;
+	default:
+		return !bits_.empty() && chunks().begin()->width == size();
+	}
 }
 
 bool RTLIL::SigSpec::known_driver() const
 {
-	pack();
-	for (auto &chunk : chunks_)
+	for (auto &chunk : chunks())
 		if (chunk.is_wire() && !chunk.wire->known_driver())
 			return false;
 	return true;
@@ -5393,25 +6348,31 @@ bool RTLIL::SigSpec::is_fully_const() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_const");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
-		if (it->width > 0 && it->wire != NULL)
-			return false;
-	return true;
+	switch (rep_) {
+	case CHUNK:
+		return chunk_.wire == NULL;
+	case BIT:
+		return bit_.wire == NULL;
+	case CHUNKS:
+		for (auto &c : packed_.chunks)
+			if (c.chunk.wire != NULL)
+				return false;
+		return true;
+	default:
+		for (auto &bit : bits_)
+			if (bit.wire != NULL)
+				return false;
+		return true;
+	}
 }
 
 bool RTLIL::SigSpec::is_fully_zero() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_zero");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
-		if (it->width > 0 && it->wire != NULL)
+	for (auto &bit : *this)
+		if (bit.wire != NULL || bit.data != RTLIL::State::S0)
 			return false;
-		for (size_t i = 0; i < it->data.size(); i++)
-			if (it->data[i] != RTLIL::State::S0)
-				return false;
-	}
 	return true;
 }
 
@@ -5419,14 +6380,9 @@ bool RTLIL::SigSpec::is_fully_ones() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_ones");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
-		if (it->width > 0 && it->wire != NULL)
+	for (auto &bit : *this)
+		if (bit.wire != NULL || bit.data != RTLIL::State::S1)
 			return false;
-		for (size_t i = 0; i < it->data.size(); i++)
-			if (it->data[i] != RTLIL::State::S1)
-				return false;
-	}
 	return true;
 }
 
@@ -5434,14 +6390,9 @@ bool RTLIL::SigSpec::is_fully_def() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_def");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
-		if (it->width > 0 && it->wire != NULL)
+	for (auto &bit : *this)
+		if (bit.wire != NULL || (bit.data != RTLIL::State::S0 && bit.data != RTLIL::State::S1))
 			return false;
-		for (size_t i = 0; i < it->data.size(); i++)
-			if (it->data[i] != RTLIL::State::S0 && it->data[i] != RTLIL::State::S1)
-				return false;
-	}
 	return true;
 }
 
@@ -5449,14 +6400,9 @@ bool RTLIL::SigSpec::is_fully_undef() const
 {
 	cover("kernel.rtlil.sigspec.is_fully_undef");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++) {
-		if (it->width > 0 && it->wire != NULL)
+	for (auto &bit : *this)
+		if (bit.wire != NULL || (bit.data != RTLIL::State::Sx && bit.data != RTLIL::State::Sz))
 			return false;
-		for (size_t i = 0; i < it->data.size(); i++)
-			if (it->data[i] != RTLIL::State::Sx && it->data[i] != RTLIL::State::Sz)
-				return false;
-	}
 	return true;
 }
 
@@ -5464,49 +6410,49 @@ bool RTLIL::SigSpec::has_const() const
 {
 	cover("kernel.rtlil.sigspec.has_const");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
-		if (it->width > 0 && it->wire == NULL)
-			return true;
-	return false;
+	switch (rep_) {
+	case CHUNK:
+		return chunk_.wire == NULL && chunk_.width != 0;
+	case BIT:
+		return bit_.wire == NULL;
+	case CHUNKS:
+		for (auto &c : packed_.chunks)
+			if (c.chunk.wire == NULL)
+				return true;
+		return false;
+	default:
+		for (auto &bit : bits_)
+			if (bit.wire == NULL)
+				return true;
+		return false;
+	}
 }
 
 bool RTLIL::SigSpec::has_const(State state) const
 {
 	cover("kernel.rtlil.sigspec.has_const");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
-		if (it->width > 0 && it->wire == NULL && std::find(it->data.begin(), it->data.end(), state) != it->data.end())
+	for (auto &bit : *this)
+		if (bit.wire == NULL && bit.data == state)
 			return true;
 	return false;
 }
 
-
 bool RTLIL::SigSpec::has_marked_bits() const
 {
 	cover("kernel.rtlil.sigspec.has_marked_bits");
 
-	pack();
-	for (auto it = chunks_.begin(); it != chunks_.end(); it++)
-		if (it->width > 0 && it->wire == NULL) {
-			for (size_t i = 0; i < it->data.size(); i++)
-				if (it->data[i] == RTLIL::State::Sm)
-					return true;
-		}
-	return false;
+	return has_const(RTLIL::State::Sm);
 }
 
 bool RTLIL::SigSpec::is_onehot(int *pos) const
 {
 	cover("kernel.rtlil.sigspec.is_onehot");
 
-	pack();
 	if (!is_fully_const())
 		return false;
-	log_assert(GetSize(chunks_) <= 1);
-	if (width_)
-		return RTLIL::Const(chunks_[0].data).is_onehot(pos);
+	if (!empty())
+		return as_const().is_onehot(pos);
 	return false;
 }
 
@@ -5514,10 +6460,9 @@ bool RTLIL::SigSpec::as_bool() const
 {
 	cover("kernel.rtlil.sigspec.as_bool");
 
-	pack();
-	log_assert(is_fully_const() && GetSize(chunks_) <= 1);
-	if (width_)
-		return RTLIL::Const(chunks_[0].data).as_bool();
+	log_assert(is_fully_const());
+	if (!empty())
+		return as_const().as_bool();
 	return false;
 }
 
@@ -5525,10 +6470,9 @@ int RTLIL::SigSpec::as_int(bool is_signed) const
 {
 	cover("kernel.rtlil.sigspec.as_int");
 
-	pack();
-	log_assert(is_fully_const() && GetSize(chunks_) <= 1);
-	if (width_)
-		return RTLIL::Const(chunks_[0].data).as_int(is_signed);
+	log_assert(is_fully_const());
+	if (!empty())
+		return as_const().as_int(is_signed);
 	return 0;
 }
 
@@ -5536,52 +6480,49 @@ bool RTLIL::SigSpec::convertible_to_int(bool is_signed) const
 {
 	cover("kernel.rtlil.sigspec.convertible_to_int");
 
-	pack();
 	if (!is_fully_const())
 		return false;
 
 	if (empty())
 		return true;
 
-	return RTLIL::Const(chunks_[0].data).convertible_to_int(is_signed);
+	return as_const().convertible_to_int(is_signed);
 }
 
 std::optional<int> RTLIL::SigSpec::try_as_int(bool is_signed) const
 {
 	cover("kernel.rtlil.sigspec.try_as_int");
 
-	pack();
 	if (!is_fully_const())
 		return std::nullopt;
 
 	if (empty())
 		return 0;
 
-	return RTLIL::Const(chunks_[0].data).try_as_int(is_signed);
+	return as_const().try_as_int(is_signed);
 }
 
 int RTLIL::SigSpec::as_int_saturating(bool is_signed) const
 {
 	cover("kernel.rtlil.sigspec.try_as_int");
 
-	pack();
-	log_assert(is_fully_const() && GetSize(chunks_) <= 1);
+	log_assert(is_fully_const());
 
 	if (empty())
 		return 0;
 
-	return RTLIL::Const(chunks_[0].data).as_int_saturating(is_signed);
+	return as_const().as_int_saturating(is_signed);
 }
 
 std::string RTLIL::SigSpec::as_string() const
 {
 	cover("kernel.rtlil.sigspec.as_string");
 
-	pack();
+	std::vector<RTLIL::SigChunk> chunks = this->chunks();
 	std::string str;
 	str.reserve(size());
-	for (size_t i = chunks_.size(); i > 0; i--) {
-		const RTLIL::SigChunk &chunk = chunks_[i-1];
+	for (size_t i = chunks.size(); i > 0; i--) {
+		const RTLIL::SigChunk &chunk = chunks[i-1];
 		if (chunk.wire != NULL)
 			str.append(chunk.width, '?');
 		else
@@ -5594,63 +6535,68 @@ RTLIL::Const RTLIL::SigSpec::as_const() const
 {
 	cover("kernel.rtlil.sigspec.as_const");
 
-	pack();
-	log_assert(is_fully_const() && GetSize(chunks_) <= 1);
-	if (width_)
-		return chunks_[0].data;
-	return RTLIL::Const();
+	log_assert(is_fully_const());
+	switch (rep_) {
+	case CHUNK:
+		return chunk_.data;
+	case BIT:
+		return RTLIL::Const(bit_.data);
+	default: {
+		std::vector<RTLIL::State> data;
+		data.reserve(size());
+		for (auto &bit : *this)
+			data.push_back(bit.data);
+		return data;
+	}
+	}
 }
 
 RTLIL::Wire *RTLIL::SigSpec::as_wire() const
 {
 	cover("kernel.rtlil.sigspec.as_wire");
 
-	pack();
 	log_assert(is_wire());
-	return chunks_[0].wire;
+	return bit_at(0).wire;
 }
 
 RTLIL::SigChunk RTLIL::SigSpec::as_chunk() const
 {
 	cover("kernel.rtlil.sigspec.as_chunk");
 
-	pack();
 	log_assert(is_chunk());
-	return chunks_[0];
+	return *chunks().begin();
 }
 
 RTLIL::SigBit RTLIL::SigSpec::as_bit() const
 {
 	cover("kernel.rtlil.sigspec.as_bit");
 
-	log_assert(width_ == 1);
-	if (packed())
-		return RTLIL::SigBit(*chunks_.begin());
-	else
-		return bits_[0];
+	log_assert(size() == 1);
+	return bit_at(0);
 }
 
 bool RTLIL::SigSpec::match(const char* pattern) const
 {
 	cover("kernel.rtlil.sigspec.match");
 
-	unpack();
-	log_assert(int(strlen(pattern)) == GetSize(bits_));
+	log_assert(int(strlen(pattern)) == size());
 
-	for (auto it = bits_.rbegin(); it != bits_.rend(); it++, pattern++) {
+	std::vector<RTLIL::SigBit> bits = to_sigbit_vector();
+	for (int i = size() - 1; i >= 0; i--, pattern++) {
+		const RTLIL::SigBit &bit = bits[i];
 		if (*pattern == ' ')
 			continue;
 		if (*pattern == '*') {
-			if (*it != State::Sz && *it != State::Sx)
+			if (bit != State::Sz && bit != State::Sx)
 				return false;
 			continue;
 		}
 		if (*pattern == '0') {
-			if (*it != State::S0)
+			if (bit != State::S0)
 				return false;
 		} else
 		if (*pattern == '1') {
-			if (*it != State::S1)
+			if (bit != State::S1)
 				return false;
 		} else
 			log_abort();
@@ -5663,11 +6609,9 @@ std::set<RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_set() const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_set");
 
-	pack();
 	std::set<RTLIL::SigBit> sigbits;
-	for (auto &c : chunks_)
-		for (int i = 0; i < c.width; i++)
-			sigbits.insert(RTLIL::SigBit(c, i));
+	for (auto &bit : *this)
+		sigbits.insert(bit);
 	return sigbits;
 }
 
@@ -5675,12 +6619,10 @@ pool<RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_pool() const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_pool");
 
-	pack();
 	pool<RTLIL::SigBit> sigbits;
 	sigbits.reserve(size());
-	for (auto &c : chunks_)
-		for (int i = 0; i < c.width; i++)
-			sigbits.insert(RTLIL::SigBit(c, i));
+	for (auto &bit : *this)
+		sigbits.insert(bit);
 	return sigbits;
 }
 
@@ -5688,22 +6630,25 @@ std::vector<RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_vector() const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_vector");
 
-	unpack();
-	return bits_;
+	if (rep_ == BITS)
+		return bits_;
+
+	std::vector<RTLIL::SigBit> bits;
+	bits.reserve(size());
+	for (auto &bit : *this)
+		bits.push_back(bit);
+	return bits;
 }
 
 std::map<RTLIL::SigBit, RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_map(const RTLIL::SigSpec &other) const
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_map");
 
-	unpack();
-	other.unpack();
-
-	log_assert(width_ == other.width_);
+	log_assert(size() == other.size());
 
 	std::map<RTLIL::SigBit, RTLIL::SigBit> new_map;
-	for (int i = 0; i < width_; i++)
-		new_map[bits_[i]] = other.bits_[i];
+	for (auto it = begin(), other_it = other.begin(), it_end = end(); it != it_end; ++it, ++other_it)
+		new_map[*it] = *other_it;
 
 	return new_map;
 }
@@ -5712,15 +6657,12 @@ dict<RTLIL::SigBit, RTLIL::SigBit> RTLIL::SigSpec::to_sigbit_dict(const RTLIL::S
 {
 	cover("kernel.rtlil.sigspec.to_sigbit_dict");
 
-	unpack();
-	other.unpack();
-
-	log_assert(width_ == other.width_);
+	log_assert(size() == other.size());
 
 	dict<RTLIL::SigBit, RTLIL::SigBit> new_map;
 	new_map.reserve(size());
-	for (int i = 0; i < width_; i++)
-		new_map[bits_[i]] = other.bits_[i];
+	for (auto it = begin(), other_it = other.begin(), it_end = end(); it != it_end; ++it, ++other_it)
+		new_map[*it] = *other_it;
 
 	return new_map;
 }
@@ -5845,21 +6787,21 @@ bool RTLIL::SigSpec::parse_rhs(const RTLIL::SigSpec &lhs, RTLIL::SigSpec &sig, R
 {
 	if (str == "0") {
 		cover("kernel.rtlil.sigspec.parse.rhs_zeros");
-		sig = RTLIL::SigSpec(RTLIL::State::S0, lhs.width_);
+		sig = RTLIL::SigSpec(RTLIL::State::S0, lhs.size());
 		return true;
 	}
 
 	if (str == "~0") {
 		cover("kernel.rtlil.sigspec.parse.rhs_ones");
-		sig = RTLIL::SigSpec(RTLIL::State::S1, lhs.width_);
+		sig = RTLIL::SigSpec(RTLIL::State::S1, lhs.size());
 		return true;
 	}
 
-	if (lhs.chunks_.size() == 1) {
+	if (lhs.is_chunk()) {
 		char *p = (char*)str.c_str(), *endptr;
 		long int val = strtol(p, &endptr, 10);
 		if (endptr && endptr != p && *endptr == 0) {
-			sig = RTLIL::SigSpec(val, lhs.width_);
+			sig = RTLIL::SigSpec(val, lhs.size());
 			cover("kernel.rtlil.sigspec.parse.rhs_dec");
 			return true;
 		}
@@ -5867,8 +6809,8 @@ bool RTLIL::SigSpec::parse_rhs(const RTLIL::SigSpec &lhs, RTLIL::SigSpec &sig, R
 
 	if (!parse(sig, module, str))
 		return false;
-	if (sig.width_ > lhs.width_)
-		sig.remove(lhs.width_, sig.width_ - lhs.width_);
+	if (sig.size() > lhs.size())
+		sig.remove(lhs.size(), sig.size() - lhs.size());
 	return true;
 }
 
@@ -22,7 +22,9 @@
 
 #include "kernel/yosys_common.h"
 #include "kernel/yosys.h"
+#include "kernel/arena.h"
 
+#include <atomic>
 #include <string_view>
 #include <unordered_map>
 
@@ -99,6 +101,7 @@ namespace RTLIL
 	};
 
 	struct Const;
+	struct ConstPool;
 	struct AttrObject;
 	struct NamedObject;
 	struct Selection;
@@ -168,6 +171,31 @@ struct RTLIL::IdString
 	static int last_created_idx_[8];
 #endif
 
+	// Concurrent interning. While a ConcurrentScope is alive, IdStrings may be
+	// created, copied and destroyed from any thread. Names that already existed
+	// when the scope was entered are looked up without locking, new names are
+	// interned into mutex-protected shards, and refcount changes are recorded
+	// per thread and only reconciled when the outermost scope is left. Nothing
+	// is freed while a scope is alive. Scopes must be entered and left on the
+	// main thread, and worker threads must be done with IdStrings (e.g. the
+	// ThreadPool has been destroyed) before the scope is left.
+
+	struct ConcurrentScope {
+		ConcurrentScope();
+		~ConcurrentScope();
+		ConcurrentScope(const ConcurrentScope &) = delete;
+		ConcurrentScope &operator=(const ConcurrentScope &) = delete;
+	};
+
+	static bool concurrent_mode_;
+	static int get_reference_concurrent(const char *p);
+	static void record_reference_concurrent(int idx, int delta);
+	static const char *c_str_concurrent(int idx);
+
+	// storage for the strings themselves (see IdStringArena in rtlil.cc)
+	static char *arena_strdup(const char *p);
+	static void arena_free(char *p);
+
 	static inline void xtrace_db_dump()
 	{
 	#ifdef YOSYS_XTRACE_GET_PUT
@@ -199,6 +227,11 @@ struct RTLIL::IdString
 	static inline int get_reference(int idx)
 	{
 	#ifndef YOSYS_NO_IDS_REFCNT
+		if (concurrent_mode_) {
+			if (idx >= static_cast<short>(StaticId::STATIC_ID_END))
+				record_reference_concurrent(idx, 1);
+			return idx;
+		}
 		global_refcount_storage_[idx]++;
 	#endif
 	#ifdef YOSYS_XTRACE_GET_PUT
@@ -212,6 +245,9 @@ struct RTLIL::IdString
 	{
 		log_assert(destruct_guard_ok);
 
+		if (concurrent_mode_)
+			return get_reference_concurrent(p);
+
 		auto it = global_id_index_.find((char*)p);
 		if (it != global_id_index_.end()) {
 	#ifndef YOSYS_NO_IDS_REFCNT
@@ -245,12 +281,12 @@ struct RTLIL::IdString
 
 		int idx = global_free_idx_list_.back();
 		global_free_idx_list_.pop_back();
-		global_id_storage_.at(idx) = strdup(p);
+		global_id_storage_.at(idx) = arena_strdup(p);
 		global_id_index_[global_id_storage_.at(idx)] = idx;
 		global_refcount_storage_.at(idx)++;
 	#else
 		int idx = global_id_storage_.size();
-		global_id_storage_.push_back(strdup(p));
+		global_id_storage_.push_back(arena_strdup(p));
 		global_id_index_[global_id_storage_.back()] = idx;
 	#endif
 
@@ -284,6 +320,11 @@ struct RTLIL::IdString
 		if (idx < static_cast<short>(StaticId::STATIC_ID_END) || !destruct_guard_ok)
 			return;
 
+		if (concurrent_mode_) {
+			record_reference_concurrent(idx, -1);
+			return;
+		}
+
 	#ifdef YOSYS_XTRACE_GET_PUT
 		if (yosys_xtrace) {
 			log("#X# PUT '%s' (index %d, refcount %u)\n", global_id_storage_.at(idx), idx, global_refcount_storage_.at(idx));
@@ -306,7 +347,7 @@ struct RTLIL::IdString
 		log_assert(idx >= static_cast<short>(StaticId::STATIC_ID_END));
 
 		global_id_index_.erase(global_id_storage_.at(idx));
-		free(global_id_storage_.at(idx));
+		arena_free(global_id_storage_.at(idx));
 		global_id_storage_.at(idx) = nullptr;
 		global_free_idx_list_.push_back(idx);
 	}
@@ -344,11 +385,15 @@ struct RTLIL::IdString
 	constexpr inline const IdString &id_string() const { return *this; }
 
 	inline const char *c_str() const {
-		return global_id_storage_.at(index_);
+		// while in concurrent mode, names created since entering the
+		// scope live outside of global_id_storage_
+		if (index_ < GetSize(global_id_storage_))
+			return global_id_storage_[index_];
+		return c_str_concurrent(index_);
 	}
 
 	inline std::string str() const {
-		return std::string(global_id_storage_.at(index_));
+		return std::string(c_str());
 	}
 
 	inline bool operator<(const IdString &rhs) const {
@@ -831,14 +876,43 @@ struct RTLIL::Const
 	short int flags;
 private:
 	friend class KernelRtlilTest;
+	friend struct RTLIL::ConstPool;
 	FRIEND_TEST(KernelRtlilTest, ConstStr);
+	FRIEND_TEST(KernelRtlilTest, ConstIntern);
 	using bitvectype = std::vector<RTLIL::State>;
-	enum class backing_tag: bool { bits, string };
+
+	// Immutable value of interned Consts, owned by the ConstPool.
+	struct Shared
+	{
+		enum class Kind : unsigned char { string, packed, unpacked };
+		mutable std::atomic<int> refcount;
+		Kind kind;
+		int width;
+		// The string for Kind::string. Otherwise `width` states, packed four
+		// per byte if they are all 0, 1, x or z and one per byte if not.
+		std::string data;
+
+		RTLIL::State at(int i) const {
+			switch (kind) {
+			case Kind::string: {
+				unsigned char ch = data[data.size() - 1 - i / 8];
+				return (ch & (1 << (i % 8))) ? State::S1 : State::S0;
+			}
+			case Kind::packed:
+				return RTLIL::State((data[i >> 2] >> (2 * (i & 3))) & 3);
+			default:
+				return RTLIL::State(data[i]);
+			}
+		}
+	};
+
+	enum class backing_tag: unsigned char { bits, string, shared };
 	// Do not access the union or tag even in Const methods unless necessary
 	backing_tag tag;
 	union {
 		bitvectype bits_;
 		std::string str_;
+		const Shared *shared_;
 	};
 
 	// Use these private utilities instead
@@ -848,14 +922,24 @@ private:
 	bitvectype* get_if_bits() { return is_bits() ? &bits_ : NULL; }
 	std::string* get_if_str() { return is_str() ? &str_ : NULL; }
 	const bitvectype* get_if_bits() const { return is_bits() ? &bits_ : NULL; }
-	const std::string* get_if_str() const { return is_str() ? &str_ : NULL; }
+	// Also returns the string of an interned string value
+	const std::string* get_if_str() const {
+		if (is_str())
+			return &str_;
+		if (is_interned() && shared_->kind == Shared::Kind::string)
+			return &shared_->data;
+		return NULL;
+	}
 
 	bitvectype& get_bits();
 	std::string& get_str();
 	const bitvectype& get_bits() const;
 	const std::string& get_str() const;
+	// Like get_bits(), but unpacks an interned value into `buf`
+	const bitvectype& get_bits(bitvectype &buf) const;
 	std::vector<RTLIL::State>& bits_internal();
 	void bitvectorize_internal();
+	void release_shared();
 
 public:
 	Const() : flags(RTLIL::CONST_FLAG_NONE), tag(backing_tag::bits), bits_(std::vector<RTLIL::State>()) {}
@@ -885,6 +969,12 @@ public:
 	bool operator ==(const RTLIL::Const &other) const;
 	bool operator !=(const RTLIL::Const &other) const;
 
+	// Replaces the value with a reference to the equal value in the ConstPool,
+	// so that all interned copies of a value share its storage. Reading an
+	// interned Const works as usual, modifying it first makes a private copy.
+	void intern();
+	bool is_interned() const { return tag == backing_tag::shared; }
+
 	[[deprecated("Don't use direct access to the internal std::vector<State>, that's an implementation detail.")]]
 	std::vector<RTLIL::State>& bits() { return bits_internal(); }
 	[[deprecated("Don't call bitvectorize() directly, it's an implementation detail.")]]
@@ -1072,6 +1162,40 @@ public:
 	[[nodiscard]] Hasher hash_into(Hasher h) const;
 };
 
+// Values of interned Consts. Flattened and techmapped designs repeat the same
+// few parameter values and src attributes on a huge number of cells, storing
+// each distinct value once saves most of the memory they take. The pool is
+// global, interned Consts can be copied and destroyed from any thread.
+struct RTLIL::ConstPool
+{
+	// When set, Cell::setParam(), AttrObject::set_string_attribute() and the
+	// Module::addCell() and addWire() overloads copying another object intern
+	// the values they store.
+	static bool enabled;
+
+	struct Stats {
+		int entries = 0;
+		int unused_entries = 0;
+		int64_t references = 0;
+		int64_t data_bytes = 0;
+	};
+	static Stats stats();
+
+	// Frees the values no longer referenced by any Const. This also happens
+	// automatically as the pool grows.
+	static void collect();
+
+	static void intern_attributes(RTLIL::AttrObject *obj);
+	static void intern_parameters(RTLIL::Cell *cell);
+
+private:
+	friend struct RTLIL::Const;
+	struct Ops;
+	struct Storage;
+	static Storage &storage();
+	static const RTLIL::Const::Shared *lookup(const RTLIL::Const &value);
+};
+
 struct RTLIL::AttrObject
 {
 	dict<RTLIL::IdString, RTLIL::Const> attributes;
@@ -1209,6 +1333,10 @@ struct RTLIL::SigSpecConstIterator
 
 	const RTLIL::SigSpec *sig_p;
 	int index;
+	// The bit is computed on access as it may not be stored explicitly, this
+	// keeps `for (auto &bit : sig)` working.
+	mutable RTLIL::SigBit current;
+	mutable int chunk_hint = 0;
 
 	inline const RTLIL::SigBit &operator*() const;
 	inline bool operator!=(const RTLIL::SigSpecConstIterator &other) const { return index != other.index; }
@@ -1219,30 +1347,100 @@ struct RTLIL::SigSpecConstIterator
 struct RTLIL::SigSpec
 {
 private:
-	int width_;
-	Hasher::hash_t hash_;
-	std::vector<RTLIL::SigChunk> chunks_; // LSB at index 0
-	std::vector<RTLIL::SigBit> bits_; // LSB at index 0
+	// A signal that is a single chunk (a whole wire, a slice of a wire, a
+	// constant or nothing at all) is stored inline as that chunk, a single bit
+	// is stored inline as that bit. Signals made up of several chunks are
+	// stored packed, as the vector of their maximal chunks, unless that takes
+	// more memory than a vector of their bits (e.g. for scattered bits).
+	// Modifying a signal through a non-const bit reference unpacks it into a
+	// vector of bits, which is packed again when it is copied or moved, or by
+	// whole-signal rewrites such as sort() or remove_const(). remove(),
+	// replace() and append() keep working on the bits, so loops mixing them
+	// with bit access don't repack every time. Equal signals that are stored
+	// inline or packed are stored the same way, hashing and comparison work
+	// across all representations.
+	enum Representation : unsigned char {
+		CHUNK,
+		BIT,
+		CHUNKS,
+		BITS,
+	};
+
+	struct PackedChunk {
+		int start; // index of the chunk's first bit in the signal
+		RTLIL::SigChunk chunk;
+	};
+
+	struct Packed {
+		std::vector<PackedChunk> chunks; // LSB first, at least two
+		int width;
+	};
 
-	void pack() const;
-	void unpack() const;
+	Representation rep_;
+	mutable Hasher::hash_t hash_;
+	union {
+		RTLIL::SigChunk chunk_;
+		RTLIL::SigBit bit_;
+		Packed packed_;
+		std::vector<RTLIL::SigBit> bits_; // LSB at index 0
+	};
+
+	void destroy();
+	void init_chunk(RTLIL::SigChunk &&chunk);
+	void init_packed(std::vector<PackedChunk> &&chunks, int width);
+	void init_bits(std::vector<RTLIL::SigBit> &&bits);
+	void init_from_bits(const std::vector<RTLIL::SigBit> &bits);
+	static bool prefer_bits(int num_chunks, int width) {
+		return num_chunks * sizeof(PackedChunk) > width * sizeof(RTLIL::SigBit);
+	}
+	static void pack_chunk(std::vector<PackedChunk> &chunks, int &width, const RTLIL::SigChunk &chunk);
+	static void pack_bit(std::vector<PackedChunk> &chunks, int &width, const RTLIL::SigBit &bit);
+	// Switches to the bit vector representation, e.g. for non-const bit access.
+	void unpack();
+	// Switches from the bit vector back to the inline or packed
+	// representation, where that is smaller.
+	void normalize();
 	void updhash() const;
 
-	inline bool packed() const {
-		return bits_.empty();
+	// Index of the packed chunk holding the given bit, starting the search
+	// at the hint so that sequential access doesn't need a binary search.
+	int packed_index(int index, int hint) const;
+
+	inline RTLIL::SigBit bit_at(int index) const {
+		switch (rep_) {
+		case BIT: return bit_;
+		case CHUNKS: {
+			const PackedChunk &c = packed_.chunks[packed_index(index, 0)];
+			return RTLIL::SigBit(c.chunk, index - c.start);
+		}
+		case BITS: return bits_[index];
+		default: return RTLIL::SigBit(chunk_, index);
+		}
 	}
 
-	inline void inline_unpack() const {
-		if (!chunks_.empty())
-			unpack();
+	inline RTLIL::SigBit bit_at(int index, int &hint) const {
+		if (rep_ != CHUNKS)
+			return bit_at(index);
+		const PackedChunk *c = &packed_.chunks[hint];
+		if (index < c->start || index >= c->start + c->chunk.width) {
+			hint = packed_index(index, hint);
+			c = &packed_.chunks[hint];
+		}
+		return RTLIL::SigBit(c->chunk, index - c->start);
 	}
 
-	// Only used by Module::remove(const pool<Wire*> &wires)
-	// but cannot be more specific as it isn't yet declared
-	friend struct RTLIL::Module;
+	friend struct RTLIL::SigSpecConstIterator;
 
 public:
-	SigSpec() : width_(0), hash_(0) {}
+	class Chunks;
+
+	SigSpec() : rep_(CHUNK), hash_(0), chunk_() {}
+	SigSpec(const RTLIL::SigSpec &other);
+	SigSpec(RTLIL::SigSpec &&other);
+	RTLIL::SigSpec &operator =(const RTLIL::SigSpec &other);
+	RTLIL::SigSpec &operator =(RTLIL::SigSpec &&other);
+	~SigSpec() { destroy(); }
+
 	SigSpec(std::initializer_list<RTLIL::SigSpec> parts);
 
 	SigSpec(const RTLIL::Const &value);
@@ -1257,24 +1455,34 @@ public:
 	SigSpec(const RTLIL::SigBit &bit, int width = 1);
 	SigSpec(const std::vector<RTLIL::SigChunk> &chunks);
 	SigSpec(const std::vector<RTLIL::SigBit> &bits);
+	SigSpec(std::vector<RTLIL::SigBit> &&bits);
 	SigSpec(const pool<RTLIL::SigBit> &bits);
 	SigSpec(const std::set<RTLIL::SigBit> &bits);
 	explicit SigSpec(bool bit);
 
-	inline const std::vector<RTLIL::SigChunk> &chunks() const { pack(); return chunks_; }
-	inline const std::vector<RTLIL::SigBit> &bits() const { inline_unpack(); return bits_; }
-
-	inline int size() const { return width_; }
-	inline bool empty() const { return width_ == 0; }
+	// Iterates over the signal in maximal chunks.
+	inline Chunks chunks() const;
+	// Iterates over the individual bits, equivalent to iterating the SigSpec itself.
+	inline const RTLIL::SigSpec &bits() const { return *this; }
+
+	inline int size() const {
+		switch (rep_) {
+		case BIT: return 1;
+		case CHUNKS: return packed_.width;
+		case BITS: return GetSize(bits_);
+		default: return chunk_.width;
+		}
+	}
+	inline bool empty() const { return size() == 0; }
 
-	inline RTLIL::SigBit &operator[](int index) { inline_unpack(); return bits_.at(index); }
-	inline const RTLIL::SigBit &operator[](int index) const { inline_unpack(); return bits_.at(index); }
+	inline RTLIL::SigBit &operator[](int index) { unpack(); hash_ = 0; return bits_.at(index); }
+	inline RTLIL::SigBit operator[](int index) const { log_assert(index >= 0 && index < size()); return bit_at(index); }
 
 	inline RTLIL::SigSpecIterator begin() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = 0; return it; }
-	inline RTLIL::SigSpecIterator end() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = width_; return it; }
+	inline RTLIL::SigSpecIterator end() { RTLIL::SigSpecIterator it; it.sig_p = this; it.index = size(); return it; }
 
 	inline RTLIL::SigSpecConstIterator begin() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = 0; return it; }
-	inline RTLIL::SigSpecConstIterator end() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = width_; return it; }
+	inline RTLIL::SigSpecConstIterator end() const { RTLIL::SigSpecConstIterator it; it.sig_p = this; it.index = size(); return it; }
 
 	void sort();
 	void sort_and_unify();
@@ -1306,10 +1514,12 @@ public:
 	RTLIL::SigSpec extract(const RTLIL::SigSpec &pattern, const RTLIL::SigSpec *other = NULL) const;
 	RTLIL::SigSpec extract(const pool<RTLIL::SigBit> &pattern, const RTLIL::SigSpec *other = NULL) const;
 	RTLIL::SigSpec extract(int offset, int length = 1) const;
-	RTLIL::SigSpec extract_end(int offset) const { return extract(offset, width_ - offset); }
+	RTLIL::SigSpec extract_end(int offset) const { return extract(offset, size() - offset); }
 
-	RTLIL::SigBit lsb() const { log_assert(width_); return (*this)[0]; };
-	RTLIL::SigBit msb() const { log_assert(width_); return (*this)[width_ - 1]; };
+	RTLIL::SigBit lsb() const { log_assert(size()); return (*this)[0]; };
+	RTLIL::SigBit msb() const { log_assert(size()); return (*this)[size() - 1]; };
+	RTLIL::SigBit front() const { return lsb(); }
+	RTLIL::SigBit back() const { return msb(); }
 
 	void append(const RTLIL::SigSpec &signal);
 	inline void append(Wire *wire) { append(RTLIL::SigSpec(wire)); }
@@ -1324,7 +1534,7 @@ public:
 
 	RTLIL::SigSpec repeat(int num) const;
 
-	void reverse() { inline_unpack(); std::reverse(bits_.begin(), bits_.end()); }
+	void reverse();
 
 	bool operator <(const RTLIL::SigSpec &other) const;
 	bool operator ==(const RTLIL::SigSpec &other) const;
@@ -1332,7 +1542,7 @@ public:
 
 	bool is_wire() const;
 	bool is_chunk() const;
-	inline bool is_bit() const { return width_ == 1; }
+	inline bool is_bit() const { return size() == 1; }
 
 	bool known_driver() const;
 
@@ -1386,9 +1596,9 @@ public:
 	static bool parse_sel(RTLIL::SigSpec &sig, RTLIL::Design *design, RTLIL::Module *module, std::string str);
 	static bool parse_rhs(const RTLIL::SigSpec &lhs, RTLIL::SigSpec &sig, RTLIL::Module *module, std::string str);
 
-	operator std::vector<RTLIL::SigChunk>() const { return chunks(); }
-	operator std::vector<RTLIL::SigBit>() const { return bits(); }
-	const RTLIL::SigBit &at(int offset, const RTLIL::SigBit &defval) { return offset < width_ ? (*this)[offset] : defval; }
+	operator std::vector<RTLIL::SigChunk>() const;
+	operator std::vector<RTLIL::SigBit>() const { return to_sigbit_vector(); }
+	const RTLIL::SigBit &at(int offset, const RTLIL::SigBit &defval) { return offset < size() ? (*this)[offset] : defval; }
 
 	[[nodiscard]] Hasher hash_into(Hasher h) const { if (!hash_) updhash(); h.eat(hash_); return h; }
 
@@ -1399,6 +1609,65 @@ public:
 #endif
 };
 
+// Range over the maximal chunks of a SigSpec. Packed signals yield their
+// stored chunks, an unpacked one has its chunks computed while iterating, so
+// this must not outlive the SigSpec. Convert to a std::vector<RTLIL::SigChunk>
+// where random access is needed.
+class RTLIL::SigSpec::Chunks
+{
+public:
+	struct const_iterator
+	{
+		typedef std::input_iterator_tag iterator_category;
+		typedef RTLIL::SigChunk value_type;
+		typedef ptrdiff_t difference_type;
+		typedef const RTLIL::SigChunk* pointer;
+		typedef const RTLIL::SigChunk& reference;
+
+		const RTLIL::SigSpec *sig_p;
+		int index; // offset of the current chunk
+		int chunk_index; // of the current chunk, for packed signals
+		RTLIL::SigChunk current; // for signals without stored chunks
+
+		const_iterator(const RTLIL::SigSpec *sig_p, int index) : sig_p(sig_p), index(index), chunk_index(0) { load(); }
+
+		const RTLIL::SigChunk &operator*() const {
+			switch (sig_p->rep_) {
+			case CHUNK: return sig_p->chunk_;
+			case CHUNKS: return sig_p->packed_.chunks[chunk_index].chunk;
+			default: return current;
+			}
+		}
+		const RTLIL::SigChunk *operator->() const { return &**this; }
+		bool operator==(const const_iterator &other) const { return index == other.index; }
+		bool operator!=(const const_iterator &other) const { return index != other.index; }
+		const_iterator &operator++() { index += (**this).width; chunk_index++; load(); return *this; }
+
+	private:
+		void load();
+	};
+
+	Chunks(const RTLIL::SigSpec &sig) : sig_p(&sig) {}
+
+	const_iterator begin() const { return const_iterator(sig_p, 0); }
+	const_iterator end() const { return const_iterator(sig_p, sig_p->size()); }
+
+	// Number of chunks, this iterates over an unpacked signal.
+	int size() const;
+	bool empty() const { return sig_p->empty(); }
+	RTLIL::SigChunk front() const { log_assert(!empty()); return *begin(); }
+	RTLIL::SigChunk back() const;
+
+	operator std::vector<RTLIL::SigChunk>() const;
+
+private:
+	const RTLIL::SigSpec *sig_p;
+};
+
+inline RTLIL::SigSpec::Chunks RTLIL::SigSpec::chunks() const {
+	return Chunks(*this);
+}
+
 struct RTLIL::Selection
 {
 	// selection includes boxed modules
@@ -1509,11 +1778,15 @@ struct RTLIL::Monitor
 	virtual void notify_connect(RTLIL::Module*, const RTLIL::SigSig&) { }
 	virtual void notify_connect(RTLIL::Module*, const std::vector<RTLIL::SigSig>&) { }
 	virtual void notify_blackout(RTLIL::Module*) { }
+	virtual void notify_rename(RTLIL::Wire*, const RTLIL::IdString&) { }
 };
 
 // Forward declaration; defined in preproc.h.
 struct define_map_t;
 
+// Forward declaration; defined in modtools.h.
+struct ModIndexCache;
+
 struct RTLIL::Design
 {
 	Hasher::hash_t hashidx_;
@@ -1532,6 +1805,10 @@ struct RTLIL::Design
 	std::vector<std::unique_ptr<AST::AstNode>> verilog_packages, verilog_globals;
 	std::unique_ptr<define_map_t> verilog_defines;
 
+	// ModIndex and IncrementalSigMap instances shared between passes, see
+	// ModIndex::cached() and IncrementalSigMap::cached()
+	std::unique_ptr<ModIndexCache> modindex_cache;
+
 	std::vector<RTLIL::Selection> selection_stack;
 	dict<RTLIL::IdString, RTLIL::Selection> selection_vars;
 	std::string selected_active_module;
@@ -1553,6 +1830,9 @@ struct RTLIL::Design
 
 	RTLIL::Module *addModule(RTLIL::IdString name);
 	void remove(RTLIL::Module *module);
+	// removes the module from the design without deleting it, so that it can
+	// be added to another design
+	RTLIL::Module *release(RTLIL::Module *module);
 	void rename(RTLIL::Module *module, RTLIL::IdString new_name);
 
 	void scratchpad_unset(const std::string &varname);
@@ -1691,6 +1971,13 @@ protected:
 	void add(RTLIL::Cell *cell);
 	void add(RTLIL::Process *process);
 
+	// Wires and cells of a module are allocated from these, so that they are
+	// close together in memory and can be released in bulk with the module.
+	SlabArena wire_arena_;
+	SlabArena cell_arena_;
+	void free_wire(RTLIL::Wire *wire);
+	void free_cell(RTLIL::Cell *cell);
+
 public:
 	RTLIL::Design *design;
 	pool<RTLIL::Monitor*> monitors;
@@ -1713,6 +2000,13 @@ public:
 	virtual ~Module();
 	virtual RTLIL::IdString derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, bool mayfail = false);
 	virtual RTLIL::IdString derive(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, const dict<RTLIL::IdString, RTLIL::Module*> &interfaces, const dict<RTLIL::IdString, RTLIL::IdString> &modports, bool mayfail = false);
+	// Splits derive() without interfaces into a part run here, which returns
+	// the name of the derived module, and a job that creates the module if the
+	// design doesn't have it yet. Jobs only read the design and return the new
+	// module without adding it, so several can run concurrently (see
+	// `hierarchy -j`). Returns an empty name if the module type doesn't
+	// support this.
+	virtual RTLIL::IdString derive_job(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Const> &parameters, std::function<RTLIL::Module*()> &job);
 	virtual size_t count_id(const RTLIL::IdString& id);
 	virtual void expand_interfaces(RTLIL::Design *design, const dict<RTLIL::IdString, RTLIL::Module *> &local_interfaces);
 	virtual bool reprocess_if_necessary(RTLIL::Design *design);
@@ -2295,12 +2589,13 @@ inline RTLIL::SigBit &RTLIL::SigSpecIterator::operator*() const {
 }
 
 inline const RTLIL::SigBit &RTLIL::SigSpecConstIterator::operator*() const {
-	return (*sig_p)[index];
+	current = sig_p->bit_at(index, chunk_hint);
+	return current;
 }
 
 inline RTLIL::SigBit::SigBit(const RTLIL::SigSpec &sig) {
-	log_assert(sig.size() == 1 && sig.chunks().size() == 1);
-	*this = SigBit(sig.chunks().front());
+	log_assert(sig.size() == 1);
+	*this = sig[0];
 }
 
 template<typename T>
@@ -2310,10 +2605,31 @@ void RTLIL::Module::rewrite_sigspecs(T &functor)
 		it.second->rewrite_sigspecs(functor);
 	for (auto &it : processes)
 		it.second->rewrite_sigspecs(functor);
-	for (auto &it : connections_) {
-		functor(it.first);
-		functor(it.second);
+	if (monitors.empty() && (design == nullptr || design->monitors.empty())) {
+		for (auto &it : connections_) {
+			functor(it.first);
+			functor(it.second);
+		}
+		return;
+	}
+	// let monitors see the connections change, if any of them does
+	std::vector<RTLIL::SigSig> new_conn;
+	bool changed = false;
+	for (size_t i = 0; i < connections_.size(); i++) {
+		RTLIL::SigSig conn = connections_[i];
+		functor(conn.first);
+		functor(conn.second);
+		if (!changed) {
+			if (conn == connections_[i])
+				continue;
+			new_conn.reserve(connections_.size());
+			new_conn.insert(new_conn.end(), connections_.begin(), connections_.begin() + i);
+			changed = true;
+		}
+		new_conn.push_back(std::move(conn));
 	}
+	if (changed)
+		new_connections(new_conn);
 }
 
 template<typename T>
@@ -2323,21 +2639,53 @@ void RTLIL::Module::rewrite_sigspecs2(T &functor)
 		it.second->rewrite_sigspecs2(functor);
 	for (auto &it : processes)
 		it.second->rewrite_sigspecs2(functor);
-	for (auto &it : connections_) {
-		functor(it.first, it.second);
+	if (monitors.empty() && (design == nullptr || design->monitors.empty())) {
+		for (auto &it : connections_) {
+			functor(it.first, it.second);
+		}
+		return;
+	}
+	// let monitors see the connections change, if any of them does
+	std::vector<RTLIL::SigSig> new_conn;
+	bool changed = false;
+	for (size_t i = 0; i < connections_.size(); i++) {
+		RTLIL::SigSig conn = connections_[i];
+		functor(conn.first, conn.second);
+		if (!changed) {
+			if (conn == connections_[i])
+				continue;
+			new_conn.reserve(connections_.size());
+			new_conn.insert(new_conn.end(), connections_.begin(), connections_.begin() + i);
+			changed = true;
+		}
+		new_conn.push_back(std::move(conn));
 	}
+	if (changed)
+		new_connections(new_conn);
 }
 
 template<typename T>
 void RTLIL::Cell::rewrite_sigspecs(T &functor) {
-	for (auto &it : connections_)
-		functor(it.second);
+	if (module == nullptr || (module->monitors.empty() && (module->design == nullptr || module->design->monitors.empty()))) {
+		for (auto &it : connections_)
+			functor(it.second);
+		return;
+	}
+	// let monitors see the port changes
+	std::vector<std::pair<RTLIL::IdString, RTLIL::SigSpec>> changed;
+	for (auto &it : connections_) {
+		RTLIL::SigSpec sig = it.second;
+		functor(sig);
+		if (sig != it.second)
+			changed.emplace_back(it.first, std::move(sig));
+	}
+	for (auto &it : changed)
+		setPort(it.first, std::move(it.second));
 }
 
 template<typename T>
 void RTLIL::Cell::rewrite_sigspecs2(T &functor) {
-	for (auto &it : connections_)
-		functor(it.second);
+	rewrite_sigspecs(functor);
 }
 
 template<typename T>
@@ -530,7 +530,7 @@ void RTLIL::Module::bufNormalize()
 	}
 
 	for (auto cell : pending_deleted_cells) {
-		delete cell;
+		free_cell(cell);
 	}
 	pending_deleted_cells.clear();
 }
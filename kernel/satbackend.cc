@@ -0,0 +1,463 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+// needed for MiniSAT headers (see Minisat Makefile)
+#ifndef __STDC_FORMAT_MACROS
+#define __STDC_FORMAT_MACROS
+#endif
+#ifndef __STDC_LIMIT_MACROS
+#define __STDC_LIMIT_MACROS
+#endif
+
+#include "kernel/satgen.h"
+#include "kernel/threading.h"
+#include "libs/minisat/SimpSolver.h"
+
+#include <chrono>
+
+YOSYS_NAMESPACE_BEGIN
+
+// The first backend runs on the calling thread. The others only join a
+// solve() call that takes longer than this, so that the many easy queries
+// of a typical pass don't have to wait for other threads.
+static const int portfolio_delay_ms = 10;
+
+// Helper threads running the other backends, plus a watchdog thread for
+// the timeout. They are kept for the lifetime of the solver and wait for
+// the next solve() call in between.
+struct ezBackendSAT::Portfolio
+{
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+	std::condition_variable changed;
+	bool shutdown = false;
+
+	// state of the current solve() call
+	int generation = 0;
+	const std::vector<int> *assumptions = nullptr;
+	std::chrono::steady_clock::time_point start, deadline;
+	int timeout = 0;
+	int result = 0;
+	int num_solving = 0;
+	bool stopped = false;
+
+	int num_helpers;
+	std::unique_ptr<ThreadPool> pool;
+
+	~Portfolio() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			shutdown = true;
+		}
+		changed.notify_all();
+		pool.reset();
+	}
+#endif
+};
+
+ezBackendSAT::ezBackendSAT(std::vector<factory_t> factories) : factories(std::move(factories))
+{
+	log_assert(!this->factories.empty());
+
+	freeze(CONST_TRUE);
+	freeze(CONST_FALSE);
+}
+
+ezBackendSAT::~ezBackendSAT()
+{
+}
+
+void ezBackendSAT::clear()
+{
+	portfolio.reset();
+	backends.clear();
+	frozen_vars.clear();
+	winner = -1;
+	ezSAT::clear();
+}
+
+void ezBackendSAT::freeze(int id)
+{
+	if (!mode_non_incremental())
+		frozen_vars.push_back(bind(id));
+}
+
+bool ezBackendSAT::eliminated(int idx)
+{
+	idx = idx < 0 ? -idx : idx;
+	if (idx == 0)
+		return false;
+	for (auto &backend : backends)
+		if (backend->eliminated(idx))
+			return true;
+	return false;
+}
+
+#ifdef YOSYS_ENABLE_THREADS
+// Called with the portfolio mutex held.
+void ezBackendSAT::finish_race(Portfolio &p, int i, int result)
+{
+	if (result != 0 && winner < 0) {
+		winner = i;
+		p.result = result;
+		for (int j = 0; j <= p.num_helpers; j++)
+			if (j != i)
+				backends[j]->terminate();
+	}
+	p.changed.notify_all();
+}
+
+void ezBackendSAT::portfolio_thread(Portfolio &p, int i)
+{
+	std::unique_lock<std::mutex> lock(p.mutex);
+	auto done = [&]() { return winner >= 0 || p.stopped || p.shutdown; };
+	int seen = 0;
+
+	while (true) {
+		p.changed.wait(lock, [&]() { return p.generation != seen || p.shutdown; });
+		if (p.shutdown)
+			return;
+		seen = p.generation;
+
+		if (i == p.num_helpers) {
+			if (p.timeout > 0 && !p.changed.wait_until(lock, p.deadline, done)) {
+				p.stopped = true;
+				for (int j = 0; j <= p.num_helpers; j++)
+					backends[j]->terminate();
+				p.changed.notify_all();
+			}
+			continue;
+		}
+
+		if (p.changed.wait_until(lock, p.start + std::chrono::milliseconds(portfolio_delay_ms), done))
+			continue;
+		SatBackend *backend = backends[i+1].get();
+		backend->clear_terminate();
+		p.num_solving++;
+		lock.unlock();
+		int result = backend->solve(*p.assumptions);
+		lock.lock();
+		p.num_solving--;
+		finish_race(p, i+1, result);
+	}
+}
+
+int ezBackendSAT::race(const std::vector<int> &assumptions)
+{
+	Portfolio &p = *portfolio;
+	backends[0]->clear_terminate();
+	{
+		std::lock_guard<std::mutex> lock(p.mutex);
+		p.generation++;
+		p.assumptions = &assumptions;
+		p.start = std::chrono::steady_clock::now();
+		p.timeout = solverTimeout;
+		p.deadline = p.start + std::chrono::seconds(solverTimeout);
+		p.result = 0;
+		p.stopped = false;
+		winner = -1;
+	}
+	p.changed.notify_all();
+
+	int result = backends[0]->solve(assumptions);
+
+	std::unique_lock<std::mutex> lock(p.mutex);
+	finish_race(p, 0, result);
+	// the helpers must be done before the backends are touched again
+	p.changed.wait(lock, [&]() { return (winner >= 0 || p.stopped) && p.num_solving == 0; });
+	solverTimoutStatus = winner < 0;
+	return p.result;
+}
+#endif
+
+bool ezBackendSAT::solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions)
+{
+	preSolverCallback();
+
+	solverTimoutStatus = false;
+
+	std::vector<int> assumption_lits, model_lits;
+	for (auto id : assumptions)
+		assumption_lits.push_back(bind(id));
+	for (auto id : modelExpressions)
+		model_lits.push_back(bind(id));
+
+	if (backends.empty())
+		for (auto &factory : factories) {
+			backends.emplace_back(factory());
+			log_assert(backends.back() != nullptr);
+		}
+
+	std::vector<std::vector<int>> cnf;
+	consumeCnf(cnf);
+	for (auto &backend : backends) {
+		for (auto var : frozen_vars)
+			backend->freeze(var < 0 ? -var : var);
+		for (auto &clause : cnf)
+			backend->add_clause(clause);
+	}
+	frozen_vars.clear();
+
+	int result;
+#ifdef YOSYS_ENABLE_THREADS
+	if (portfolio == nullptr && (GetSize(backends) > 1 || solverTimeout > 0)) {
+		int num_helpers = ThreadPool::pool_size(1, GetSize(backends) - 1);
+		int num_watchdogs = ThreadPool::pool_size(0, 1);
+		if (num_watchdogs > 0) {
+			Portfolio *p = new Portfolio;
+			p->num_helpers = num_helpers;
+			portfolio.reset(p);
+			p->pool.reset(new ThreadPool(num_helpers + num_watchdogs, [this, p](int i) { portfolio_thread(*p, i); }));
+		}
+	}
+	if (portfolio != nullptr)
+		result = race(assumption_lits);
+	else
+#endif
+	{
+		// Without threads a portfolio degrades to its first member, and
+		// the timeout is ignored.
+		backends[0]->clear_terminate();
+		result = backends[0]->solve(assumption_lits);
+		winner = result != 0 ? 0 : -1;
+	}
+
+	if (result != 10)
+		return false;
+
+	modelValues.clear();
+	modelValues.reserve(model_lits.size());
+	for (auto lit : model_lits)
+		modelValues.push_back(backends[winner]->value(lit));
+	return true;
+}
+
+SatSolver *yosys_satsolver_list;
+SatSolver *yosys_satsolver;
+
+// MiniSat with variable elimination, like ezMiniSAT, with the search
+// parameters exposed so that differently configured instances can be raced
+// against each other.
+struct MinisatBackend : public SatBackend
+{
+	Minisat::SimpSolver solver;
+
+	void add_var(int lit) {
+		int var = lit > 0 ? lit : -lit;
+		while (solver.nVars() < var)
+			solver.newVar();
+	}
+
+	Minisat::Lit make_lit(int lit) {
+		add_var(lit);
+		return Minisat::mkLit(lit > 0 ? lit-1 : -lit-1, lit < 0);
+	}
+
+	void add_clause(const std::vector<int> &clause) override {
+		Minisat::vec<Minisat::Lit> ps;
+		for (auto lit : clause)
+			ps.push(make_lit(lit));
+		// a conflict puts the solver into a permanently unsatisfiable state
+		solver.addClause_(ps);
+	}
+
+	int solve(const std::vector<int> &assumptions) override {
+		Minisat::vec<Minisat::Lit> assumps;
+		for (auto lit : assumptions)
+			assumps.push(make_lit(lit));
+		using namespace Minisat;
+		lbool result = solver.solveLimited(assumps);
+		if (result == l_True)
+			return 10;
+		if (result == l_False)
+			return 20;
+		return 0;
+	}
+
+	void freeze(int var) override {
+		add_var(var);
+		solver.setFrozen(var-1, true);
+	}
+
+	bool eliminated(int var) override {
+		return var <= solver.nVars() && solver.isEliminated(var-1);
+	}
+
+	bool value(int lit) override {
+		int var = lit > 0 ? lit-1 : -lit-1;
+		if (var >= solver.model.size())
+			return lit < 0;
+		return solver.model[var] == Minisat::lbool(lit > 0);
+	}
+
+	void terminate() override { solver.interrupt(); }
+	void clear_terminate() override { solver.clearInterrupt(); }
+};
+
+struct MinisatSatSolver : public SatSolver {
+	MinisatSatSolver() : SatSolver("minisat") {
+		yosys_satsolver = this;
+	}
+	ezSAT *create() override {
+		return new ezMiniSAT();
+	}
+	SatBackend *create_backend() override {
+		return new MinisatBackend;
+	}
+} MinisatSatSolver;
+
+struct MinisatRndSatSolver : public SatSolver {
+	MinisatRndSatSolver() : SatSolver("minisat-rnd") { }
+	SatBackend *create_backend() override {
+		auto backend = new MinisatBackend;
+		backend->solver.random_seed = 1234567;
+		backend->solver.random_var_freq = 0.02;
+		backend->solver.rnd_init_act = true;
+		return backend;
+	}
+} MinisatRndSatSolver;
+
+struct MinisatGeomSatSolver : public SatSolver {
+	MinisatGeomSatSolver() : SatSolver("minisat-geom") { }
+	SatBackend *create_backend() override {
+		auto backend = new MinisatBackend;
+		backend->solver.luby_restart = false;
+		backend->solver.restart_first = 100;
+		backend->solver.restart_inc = 1.5;
+		backend->solver.var_decay = 0.9;
+		backend->solver.ccmin_mode = 1;
+		return backend;
+	}
+} MinisatGeomSatSolver;
+
+static SatSolver *find_satsolver(const std::string &name)
+{
+	for (auto solver = yosys_satsolver_list; solver != nullptr; solver = solver->next)
+		if (solver->name == name)
+			return solver;
+	return nullptr;
+}
+
+struct PortfolioSatSolver : public SatSolver {
+	std::vector<std::string> members = {"minisat", "minisat-rnd", "minisat-geom"};
+
+	PortfolioSatSolver() : SatSolver("portfolio") { }
+	ezSAT *create() override {
+		std::vector<ezBackendSAT::factory_t> factories;
+		for (auto &name : members) {
+			SatSolver *solver = find_satsolver(name);
+			log_assert(solver != nullptr);
+			factories.push_back([solver]() { return solver->create_backend(); });
+		}
+		return new ezBackendSAT(factories);
+	}
+} PortfolioSatSolver;
+
+struct SatSolverPass : public Pass {
+	SatSolverPass() : Pass("sat_solver", "select the SAT solver") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    sat_solver [<name>]\n");
+		log("\n");
+		log("Select the SAT solver used by all SAT-based commands (sat, equiv_simple,\n");
+		log("equiv_induct, freduce, share, opt_dff -sat, ...). Without an argument, list the\n");
+		log("available solvers and the current selection. The default is 'minisat'.\n");
+		log("\n");
+		log("\n");
+		log("    sat_solver -portfolio <name>[,<name>...]\n");
+		log("\n");
+		log("Select the 'portfolio' solver, which gives each SAT problem to all of the\n");
+		log("listed solvers, runs them in parallel and uses the result of the one that\n");
+		log("finishes first. Queries that the first solver answers within a few\n");
+		log("milliseconds are not run in parallel. This needs memory for one copy of the\n");
+		log("problem per solver, and when fewer cores than solvers are available only the\n");
+		log("first ones are run. Commands that already run several solvers in parallel\n");
+		log("(e.g. equiv_simple -j) don't take the portfolio threads into account.\n");
+		log("\n");
+		log("Since any of the solvers may produce the result, counterexamples and other\n");
+		log("models can differ from run to run. Solvers that are only available as an\n");
+		log("ezSAT implementation can't be used in a portfolio.\n");
+		log("\n");
+		log("The built-in solvers are:\n");
+		log("\n");
+		log("    minisat\n");
+		log("        MiniSat with variable elimination (SimpSolver) and default settings.\n");
+		log("\n");
+		log("    minisat-rnd\n");
+		log("        MiniSat with randomized initial activities and 2%% random decisions.\n");
+		log("\n");
+		log("    minisat-geom\n");
+		log("        MiniSat with geometric instead of Luby restarts, faster variable\n");
+		log("        activity decay and basic conflict clause minimization.\n");
+		log("\n");
+		log("    portfolio\n");
+		log("        A portfolio of the solvers given with -portfolio. Before the first use\n");
+		log("        of -portfolio, this races the three MiniSat configurations above.\n");
+		log("\n");
+		log("Plugins can register additional solvers, e.g. wrappers around CaDiCaL or\n");
+		log("Kissat, by deriving from SatSolver (see kernel/satgen.h and\n");
+		log("kernel/satbackend.h).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design*) override
+	{
+		if (args.size() == 3 && args[1] == "-portfolio") {
+			std::vector<std::string> members = split_tokens(args[2], ",");
+			if (members.empty())
+				cmd_error(args, 2, "Expected a list of solver names.");
+			for (auto &name : members) {
+				SatSolver *solver = find_satsolver(name);
+				if (solver == nullptr)
+					log_cmd_error("No such SAT solver: %s\n", name);
+				if (solver == &PortfolioSatSolver)
+					log_cmd_error("A portfolio can't contain itself.\n");
+				std::unique_ptr<SatBackend> backend(solver->create_backend());
+				if (backend == nullptr)
+					log_cmd_error("SAT solver %s can't be used in a portfolio.\n", name);
+			}
+			PortfolioSatSolver.members = members;
+			yosys_satsolver = &PortfolioSatSolver;
+		} else if (args.size() == 2 && args[1][0] != '-') {
+			SatSolver *solver = find_satsolver(args[1]);
+			if (solver == nullptr)
+				log_cmd_error("No such SAT solver: %s\n", args[1]);
+			yosys_satsolver = solver;
+		} else if (args.size() != 1)
+			cmd_error(args, 1, "Unexpected argument.");
+
+		if (args.size() == 1) {
+			log("Available SAT solvers:");
+			std::vector<std::string> names;
+			for (auto solver = yosys_satsolver_list; solver != nullptr; solver = solver->next)
+				names.push_back(solver->name);
+			std::sort(names.begin(), names.end());
+			for (auto &name : names)
+				log(" %s", name);
+			log("\n");
+		}
+
+		log("Selected SAT solver: %s", yosys_satsolver->name);
+		if (yosys_satsolver == &PortfolioSatSolver)
+			for (int i = 0; i < GetSize(PortfolioSatSolver.members); i++)
+				log("%s%s", i ? ", " : " (", PortfolioSatSolver.members[i]);
+		log(yosys_satsolver == &PortfolioSatSolver ? ")\n" : "\n");
+	}
+} SatSolverPass;
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,106 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef SATBACKEND_H
+#define SATBACKEND_H
+
+#include "kernel/yosys_common.h"
+#include "libs/ezsat/ezsat.h"
+
+#include <functional>
+#include <memory>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Clause-level interface to an incremental SAT solver, modeled after IPASIR,
+// so that solvers such as CaDiCaL or Kissat only need a thin wrapper to be
+// used by yosys. Variables are numbered from 1, literals use the DIMACS
+// convention (negative for a negated variable) and variables are created
+// implicitly by using them.
+struct SatBackend
+{
+	virtual ~SatBackend() { }
+
+	virtual void add_clause(const std::vector<int> &clause) = 0;
+	// Returns 10 if the clauses are satisfiable under the given assumption
+	// literals, 20 if they are not and 0 if the search was terminated.
+	virtual int solve(const std::vector<int> &assumptions) = 0;
+	// Value of a literal in the model found by the last solve() that
+	// returned 10.
+	virtual bool value(int lit) = 0;
+
+	// Backends that eliminate variables during preprocessing must keep
+	// frozen variables, and report eliminated variables so that ezSAT can
+	// re-encode expressions that use them.
+	virtual void freeze(int) { }
+	virtual bool eliminated(int) { return false; }
+
+	// Asks a running solve() to return 0 as soon as possible. May be called
+	// from another thread. The request stays pending until
+	// clear_terminate() is called, so that it also stops a solve() that
+	// hasn't started yet.
+	virtual void terminate() = 0;
+	virtual void clear_terminate() = 0;
+};
+
+// ezSAT front end for one or more SatBackend instances, which all receive
+// the complete CNF. With a single backend this is an ordinary incremental
+// solver. With more than one, each solve() call that doesn't finish right
+// away runs the backends on separate threads, uses the result of the first
+// one to finish and stops the others ("portfolio" solving). The backends
+// keep what they learned when they were stopped, so different backends may
+// win different calls, and the models returned for satisfiable queries may
+// differ from run to run.
+//
+// The solver timeout is measured in wall-clock time and needs thread
+// support.
+class ezBackendSAT : public ezSAT
+{
+public:
+	typedef std::function<SatBackend*()> factory_t;
+
+	ezBackendSAT(std::vector<factory_t> factories);
+	virtual ~ezBackendSAT();
+
+	virtual void clear();
+	virtual void freeze(int id);
+	virtual bool eliminated(int idx);
+	virtual bool solver(const std::vector<int> &modelExpressions, std::vector<bool> &modelValues, const std::vector<int> &assumptions);
+
+	int num_backends() const { return GetSize(factories); }
+	// Index of the backend that produced the result of the last solve(), or
+	// -1 if there was no result.
+	int last_winner() const { return winner; }
+
+private:
+	struct Portfolio;
+
+	std::vector<factory_t> factories;
+	std::vector<std::unique_ptr<SatBackend>> backends;
+	std::vector<int> frozen_vars;
+	int winner = -1;
+	// declared after `backends`, so that the threads are stopped first
+	std::unique_ptr<Portfolio> portfolio;
+
+	void finish_race(Portfolio &p, int i, int result);
+	void portfolio_thread(Portfolio &p, int i);
+	int race(const std::vector<int> &assumptions);
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
@@ -25,19 +25,30 @@
 #include "kernel/celltypes.h"
 #include "kernel/macc.h"
 
+#include "kernel/satbackend.h"
 #include "libs/ezsat/ezminisat.h"
 
 YOSYS_NAMESPACE_BEGIN
 
-// defined in kernel/register.cc
+// defined in kernel/satbackend.cc
 extern struct SatSolver *yosys_satsolver_list;
 extern struct SatSolver *yosys_satsolver;
 
+// A SAT solver that can be selected with the "sat_solver" command. Solvers
+// either implement create() to provide their own ezSAT subclass, or
+// create_backend() to plug a clause-level SatBackend into ezBackendSAT.
+// Only solvers with a backend can be members of a portfolio.
 struct SatSolver
 {
 	string name;
 	SatSolver *next;
-	virtual ezSAT *create() = 0;
+
+	virtual ezSAT *create() {
+		return new ezBackendSAT({[this]() { return create_backend(); }});
+	}
+	virtual SatBackend *create_backend() {
+		return nullptr;
+	}
 
 	SatSolver(string name) : name(name) {
 		next = yosys_satsolver_list;
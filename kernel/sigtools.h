@@ -249,8 +249,17 @@ struct SigMapView
 
 	void apply(RTLIL::SigSpec &sig) const
 	{
-		for (auto &bit : sig)
-			apply(bit);
+		// Writing a bit unpacks the signal, so skip the leading bits that
+		// are already their own representative
+		const RTLIL::SigSpec &csig = sig;
+		int i = 0;
+		for (auto bit : csig) {
+			if (database.find(bit) != bit)
+				break;
+			i++;
+		}
+		for (; i < GetSize(sig); i++)
+			apply(sig[i]);
 	}
 
 	RTLIL::SigBit operator()(RTLIL::SigBit bit) const
@@ -365,6 +374,135 @@ struct SigMap final : public SigMapView
 	}
 };
 
+/**
+ * IncrementalSigMap is a SigMap for a single module that keeps itself up to
+ * date while the module is being edited. It registers as a monitor of the
+ * module and adds every new connection to the union-find database as it is
+ * made. A union-find database can't split sets, so when existing connections
+ * are removed or rewritten the map is rebuilt from the module, but only the
+ * next time it is queried. Connections that are merely reordered or appended
+ * through new_connections() are handled without a rebuild.
+ *
+ * Use get() to pass the map to code that expects a SigMap. The reference stays
+ * valid for the lifetime of the IncrementalSigMap, but the mapping it holds is
+ * only current as of the last call to get() or operator().
+ *
+ * The sub-passes of the opt loop share the instance returned by cached()
+ * instead of each building a SigMap. It is dropped at the end of every other
+ * pass, see ModIndexCache.
+ */
+struct IncrementalSigMap final : public RTLIL::Monitor
+{
+	RTLIL::Module *module;
+	SigMap sigmap;
+	bool stale = false;
+	int rebuild_count = 0;
+
+	IncrementalSigMap(RTLIL::Module *module) : module(module), sigmap(module)
+	{
+		module->monitors.insert(this);
+	}
+
+	IncrementalSigMap(const IncrementalSigMap &) = delete;
+	IncrementalSigMap &operator=(const IncrementalSigMap &) = delete;
+
+	~IncrementalSigMap()
+	{
+		module->monitors.erase(this);
+	}
+
+	// Returns a map of the module that is owned by its design and shared by
+	// the code that asks for it until the end of the pass, see ModIndexCache.
+	static IncrementalSigMap &cached(RTLIL::Module *module);
+
+	// Rebuild the map from the connections of the module
+	void reload()
+	{
+		sigmap.set(module);
+		stale = false;
+		rebuild_count++;
+	}
+
+	const SigMap &get()
+	{
+		if (stale)
+			reload();
+		return sigmap;
+	}
+
+	void apply(RTLIL::SigBit &bit) { get().apply(bit); }
+	void apply(RTLIL::SigSpec &sig) { get().apply(sig); }
+
+	RTLIL::SigBit operator()(RTLIL::SigBit bit) { return get()(bit); }
+	RTLIL::SigSpec operator()(RTLIL::SigSpec sig) { return get()(std::move(sig)); }
+	RTLIL::SigSpec operator()(RTLIL::Wire *wire) { return get()(wire); }
+
+	void notify_connect(RTLIL::Module *mod, const RTLIL::SigSig &sigsig) override
+	{
+		log_assert(mod == module);
+
+		// Module::connect() drops the bits assigned to constants and notifies
+		// again with what is left
+		if (stale || sigsig.first.has_const())
+			return;
+
+		sigmap.add(sigsig.first, sigsig.second);
+	}
+
+	void notify_connect(RTLIL::Module *mod, const std::vector<RTLIL::SigSig> &new_conn) override
+	{
+		log_assert(mod == module);
+
+		if (stale)
+			return;
+
+		const std::vector<RTLIL::SigSig> &old_conn = module->connections();
+		if (&new_conn == &old_conn)
+			return;
+
+		if (new_conn.size() >= old_conn.size() && std::equal(old_conn.begin(), old_conn.end(), new_conn.begin())) {
+			for (size_t i = old_conn.size(); i < new_conn.size(); i++)
+				sigmap.add(new_conn[i].first, new_conn[i].second);
+			return;
+		}
+
+		dict<RTLIL::SigSig, int> removed;
+		for (auto &conn : old_conn)
+			removed[conn]++;
+
+		std::vector<const RTLIL::SigSig*> added;
+		for (auto &conn : new_conn) {
+			auto it = removed.find(conn);
+			if (it == removed.end() || it->second == 0)
+				added.push_back(&conn);
+			else
+				it->second--;
+		}
+
+		for (auto &it : removed)
+			if (it.second != 0 && !(it.first.first == it.first.second)) {
+				stale = true;
+				return;
+			}
+
+		for (auto conn : added)
+			sigmap.add(conn->first, conn->second);
+	}
+
+	void notify_blackout(RTLIL::Module *mod) override
+	{
+		log_assert(mod == module);
+		stale = true;
+	}
+
+	// SigBits are hashed by wire name
+	void notify_rename(RTLIL::Wire *wire, const RTLIL::IdString &) override
+	{
+		log_assert(wire->module == module);
+		stale = true;
+	}
+};
+
 /**
  * SiValgMap wraps a union-find "database" to map SigBits of a module to
  * canonical representative SigBits plus some optional Val value associated with the bits.
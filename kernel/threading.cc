@@ -1,15 +1,201 @@
 #include "kernel/yosys_common.h"
 #include "kernel/threading.h"
+#include "kernel/rtlil.h"
+#include "kernel/modtools.h"
+
+#include <algorithm>
+#include <atomic>
 
 YOSYS_NAMESPACE_BEGIN
 
 void DeferredLogs::flush()
 {
-	for (auto &m : logs)
-		if (m.error)
-			YOSYS_NAMESPACE_PREFIX log_error("%s", m.text.c_str());
-		else
+	std::vector<Message> pending;
+	std::swap(pending, logs);
+	for (auto &m : pending)
+		switch (m.kind) {
+		case Kind::Log:
 			YOSYS_NAMESPACE_PREFIX log("%s", m.text.c_str());
+			break;
+		case Kind::Warning:
+			log_formatted_warning(m.prefix, std::move(m.text));
+			break;
+		case Kind::Error:
+			if (m.prefix.empty())
+				log_formatted_error(std::move(m.text));
+			log_formatted_error_with_prefix(m.prefix, std::move(m.text));
+		case Kind::CmdError:
+			log_formatted_cmd_error(std::move(m.text));
+		case Kind::Spacer:
+			log_spacer();
+			break;
+		case Kind::Experimental:
+			log_experimental(m.text);
+			break;
+		case Kind::Header:
+			log_formatted_header(m.design, "%s", std::move(m.text));
+			break;
+		}
+}
+
+namespace {
+struct Task
+{
+	DeferredLogs logs;
+	int autoidx;
+	unsigned int hashidx;
+	int debug_suppressed = 0;
+	std::exception_ptr exception;
+};
+
+void run_task(Task &task, int index, const std::function<void(int)> &body)
+{
+	DeferredLogs *saved_deferred = log_deferred;
+	int *saved_autoidx = autoidx_local;
+	unsigned int *saved_hashidx = hashidx_local;
+	int saved_debug_suppressed = log_debug_suppressed;
+	log_deferred = &task.logs;
+	autoidx_local = &task.autoidx;
+#ifndef WITH_PYTHON
+	// the Python bindings keep global maps keyed by hash index, which need
+	// those to stay unique across modules
+	hashidx_local = &task.hashidx;
+#endif
+	log_debug_suppressed = 0;
+	try {
+		body(index);
+	} catch (const log_deferred_error_exception &) {
+		// the error message is in task.logs and raised again by flush()
+	} catch (...) {
+		task.exception = std::current_exception();
+	}
+	task.debug_suppressed = log_debug_suppressed;
+	log_debug_suppressed = saved_debug_suppressed;
+	log_deferred = saved_deferred;
+	autoidx_local = saved_autoidx;
+	hashidx_local = saved_hashidx;
+}
+
+// Runs the tasks on `num_workers` threads and the calling thread, taking them
+// in the given order, then replays their logs in index order.
+void run_tasks(std::vector<Task> &tasks, int num_workers, const std::vector<int> &order,
+		const std::function<void(int)> &body)
+{
+	int num_tasks = GetSize(tasks);
+
+	if (num_workers == 0) {
+		for (int i = 0; i < num_tasks; i++) {
+			run_task(tasks[i], i, body);
+			autoidx = std::max(autoidx, tasks[i].autoidx);
+			log_debug_suppressed += tasks[i].debug_suppressed;
+			tasks[i].logs.flush();
+			if (tasks[i].exception)
+				std::rethrow_exception(tasks[i].exception);
+		}
+		return;
+	}
+
+#ifdef YOSYS_ENABLE_THREADS
+	{
+		RTLIL::IdString::ConcurrentScope id_scope;
+		std::atomic<int> next_task(0);
+		auto worker = [&](int) {
+			for (int k; (k = next_task.fetch_add(1)) < num_tasks; )
+				run_task(tasks[order[k]], order[k], body);
+		};
+		ThreadPool pool(num_workers, worker);
+		worker(num_workers);
+	}
+#else
+	(void)order;
+#endif
+
+	for (auto &task : tasks) {
+		autoidx = std::max(autoidx, task.autoidx);
+		log_debug_suppressed += task.debug_suppressed;
+	}
+	for (auto &task : tasks) {
+		task.logs.flush();
+		if (task.exception)
+			std::rethrow_exception(task.exception);
+	}
+}
+}
+
+void parallel_for_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules,
+		const std::function<void(int, RTLIL::Module*)> &body)
+{
+	int num_modules = GetSize(modules);
+
+	// Nested call: the caller already provides the task-local state.
+	if (log_deferred != nullptr || autoidx_local != nullptr) {
+		for (int i = 0; i < num_modules; i++)
+			body(i, modules[i]);
+		return;
+	}
+
+	// Every task starts from the same counters regardless of how the tasks are
+	// scheduled, so the names and hash indices a module ends up with do not
+	// depend on the number of threads.
+	std::vector<Task> tasks(num_modules);
+	for (int i = 0; i < num_modules; i++) {
+		tasks[i].autoidx = autoidx;
+		tasks[i].hashidx = mkhash_xorshift(modules[i]->hashidx_ ^ 0x9e3779b9u) | 1;
+	}
+
+	bool parallel = num_modules > 1 && !memhasher_active &&
+			design->monitors.empty() && !design->flagBufferedNormalized;
+	// the indices kept by ModIndex::cached() only ever see their own module
+	for (auto module : modules)
+		for (auto mon : module->monitors)
+			if (!design->modindex_cache->holds(module, mon))
+				parallel = false;
+#ifdef WITH_PYTHON
+	parallel = false;
+#endif
+
+	int num_workers = parallel ? ThreadPool::pool_size(1, num_modules - 1) : 0;
+
+	// Start with the largest modules so that a big module picked up last
+	// doesn't leave the other threads idle.
+	std::vector<int> order(num_modules);
+	for (int i = 0; i < num_modules; i++)
+		order[i] = i;
+	if (num_workers > 0)
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return GetSize(modules[a]->cells_) > GetSize(modules[b]->cells_);
+		});
+
+	run_tasks(tasks, num_workers, order, [&](int i) { body(i, modules[i]); });
+}
+
+void parallel_for_tasks(const std::vector<unsigned int> &hash_seeds, int max_threads,
+		const std::function<void(int)> &body)
+{
+	int num_tasks = GetSize(hash_seeds);
+
+	if (log_deferred != nullptr || autoidx_local != nullptr) {
+		for (int i = 0; i < num_tasks; i++)
+			body(i);
+		return;
+	}
+
+	std::vector<Task> tasks(num_tasks);
+	for (int i = 0; i < num_tasks; i++) {
+		tasks[i].autoidx = autoidx;
+		tasks[i].hashidx = mkhash_xorshift(hash_seeds[i] ^ 0x9e3779b9u) | 1;
+	}
+
+	bool parallel = num_tasks > 1 && !memhasher_active;
+#ifdef WITH_PYTHON
+	parallel = false;
+#endif
+	int num_workers = parallel ? ThreadPool::pool_size(1, std::min(max_threads, num_tasks) - 1) : 0;
+
+	std::vector<int> order(num_tasks);
+	for (int i = 0; i < num_tasks; i++)
+		order[i] = i;
+	run_tasks(tasks, num_workers, order, body);
 }
 
 int ThreadPool::pool_size(int reserved_cores, int max_threads)
@@ -84,7 +84,7 @@ private:
 		if (!contents.empty())
 			not_empty_condition.notify_one();
 #endif
-		return std::move(result);
+		return result;
 	}
 
 #ifdef YOSYS_ENABLE_THREADS
@@ -99,29 +99,84 @@ private:
 	bool closed = false;
 };
 
+// Buffers log output so that it can be emitted later, e.g. in a deterministic
+// order after running work on several threads. Besides explicit log()/log_error()
+// calls, setting `log_deferred` to an instance redirects the regular log
+// functions called on that thread into it.
 class DeferredLogs
 {
 public:
+	enum class Kind {
+		Log,
+		Warning,
+		Error,
+		CmdError,
+		Spacer,
+		Experimental,
+		Header,
+	};
+
 	template <typename... Args>
 	void log(FmtString<TypeIdentity<Args>...> fmt, Args... args)
 	{
-		logs.push_back({fmt.format(args...), false});
+		append(Kind::Log, {}, fmt.format(args...));
 	}
 	template <typename... Args>
 	void log_error(FmtString<TypeIdentity<Args>...> fmt, Args... args)
 	{
-		logs.push_back({fmt.format(args...), true});
+		append(Kind::Error, {}, fmt.format(args...));
+	}
+	void append(Kind kind, std::string prefix, std::string text)
+	{
+		logs.push_back({kind, std::move(prefix), std::move(text)});
 	}
+	// Headers are numbered when they are replayed.
+	void append_header(RTLIL::Design *design, std::string text)
+	{
+		logs.push_back({Kind::Header, {}, std::move(text), design});
+	}
+	bool empty() const { return logs.empty(); }
+	// Replays the buffered messages through the regular log functions and
+	// clears the buffer. Stops at (and raises) the first buffered error.
 	void flush();
 private:
 	struct Message
 	{
+		Kind kind;
+		std::string prefix;
 		std::string text;
-		bool error;
+		RTLIL::Design *design = nullptr;
 	};
 	std::vector<Message> logs;
 };
 
+// Runs `body(i, modules[i])` for every module, in parallel where that is safe.
+// While a module is being processed, log output is deferred (see DeferredLogs)
+// and then emitted in the order of `modules`, so the log is identical to that
+// of a sequential run. NEW_ID names are drawn from a per-task counter and
+// IdStrings may be created concurrently (see RTLIL::IdString::ConcurrentScope).
+//
+// The body may only modify the module it is given. Reading other modules of
+// the design is fine, creating or removing modules is not. Design-wide state
+// (e.g. the scratchpad) must be updated after this function returns, based on
+// results the body stores per index.
+//
+// Falls back to running sequentially when threading is disabled, when there
+// are monitors attached to the design or the modules (other than the cached
+// ModIndex of each module) or when called from within another
+// parallel_for_modules().
+void parallel_for_modules(RTLIL::Design *design, const std::vector<RTLIL::Module*> &modules,
+		const std::function<void(int, RTLIL::Module*)> &body);
+
+// Runs `body(i)` for every index of `hash_seeds` on up to `max_threads`
+// threads, with deferred logging and task-local NEW_ID counters like
+// parallel_for_modules(). The hash indices of the objects task i creates are
+// drawn from a counter seeded with hash_seeds[i], so a task that builds a new
+// module gets the same result regardless of scheduling. The body must not
+// modify the design or any object reachable from it.
+void parallel_for_tasks(const std::vector<unsigned int> &hash_seeds, int max_threads,
+		const std::function<void(int)> &body);
+
 class ThreadPool
 {
 public:
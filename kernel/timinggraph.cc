@@ -0,0 +1,371 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/timinggraph.h"
+#include "kernel/log.h"
+
+#include <queue>
+
+YOSYS_NAMESPACE_BEGIN
+
+int TimingGraph::add_node()
+{
+	nodes.emplace_back();
+	return GetSize(nodes) - 1;
+}
+
+int TimingGraph::add_edge(int from, int to, int delay)
+{
+	log_assert(from >= 0 && from < GetSize(nodes));
+	log_assert(to >= 0 && to < GetSize(nodes));
+
+	int edge;
+	if (free_edges.empty()) {
+		edge = GetSize(edges);
+		edges.push_back({from, to, delay});
+	} else {
+		edge = free_edges.back();
+		free_edges.pop_back();
+		edges[edge] = {from, to, delay};
+	}
+
+	nodes[from].fanout.push_back(edge);
+	nodes[to].fanin.push_back(edge);
+	mark_fwd(to);
+	mark_bwd(from);
+
+	if (levels_valid && nodes[to].level <= nodes[from].level)
+		raise_levels(from, to);
+	return edge;
+}
+
+void TimingGraph::remove_edge(int edge)
+{
+	edge_t &e = edges[edge];
+	log_assert(e.from >= 0);
+
+	auto &fanout = nodes[e.from].fanout;
+	fanout.erase(std::find(fanout.begin(), fanout.end(), edge));
+	auto &fanin = nodes[e.to].fanin;
+	fanin.erase(std::find(fanin.begin(), fanin.end(), edge));
+	mark_fwd(e.to);
+	mark_bwd(e.from);
+
+	e.from = e.to = -1;
+	free_edges.push_back(edge);
+}
+
+void TimingGraph::set_delay(int edge, int delay)
+{
+	edge_t &e = edges[edge];
+	log_assert(e.from >= 0);
+	if (e.delay == delay)
+		return;
+	e.delay = delay;
+	mark_fwd(e.to);
+	mark_bwd(e.from);
+}
+
+void TimingGraph::set_launch(int node, int time)
+{
+	if (nodes[node].launch == time)
+		return;
+	nodes[node].launch = time;
+	mark_fwd(node);
+}
+
+void TimingGraph::set_capture(int node, int time)
+{
+	if (nodes[node].capture == time)
+		return;
+	nodes[node].capture = time;
+	mark_bwd(node);
+}
+
+void TimingGraph::mark_fwd(int node)
+{
+	if (nodes[node].queued_fwd)
+		return;
+	nodes[node].queued_fwd = true;
+	dirty_fwd.push_back(node);
+}
+
+void TimingGraph::mark_bwd(int node)
+{
+	if (nodes[node].queued_bwd)
+		return;
+	nodes[node].queued_bwd = true;
+	dirty_bwd.push_back(node);
+}
+
+// Restores the level order after adding an edge from `from` to `to`, by
+// raising the level of `to` and as much of its fanout cone as needed. Running
+// into `from` means the new edge closed a loop.
+void TimingGraph::raise_levels(int from, int to)
+{
+	std::vector<std::pair<int, int>> stack;
+	stack.emplace_back(to, nodes[from].level + 1);
+	while (!stack.empty()) {
+		auto [node, level] = stack.back();
+		stack.pop_back();
+		if (nodes[node].level >= level)
+			continue;
+		if (node == from) {
+			levels_valid = false;
+			return;
+		}
+		nodes[node].level = level;
+		for (int edge : nodes[node].fanout)
+			stack.emplace_back(edges[edge].to, level + 1);
+	}
+}
+
+bool TimingGraph::levelize(std::vector<int> &order)
+{
+	std::vector<int> indegree(GetSize(nodes));
+	order.clear();
+	for (int i = 0; i < GetSize(nodes); i++) {
+		indegree[i] = GetSize(nodes[i].fanin);
+		nodes[i].level = 0;
+		if (indegree[i] == 0)
+			order.push_back(i);
+	}
+
+	for (int i = 0; i < GetSize(order); i++) {
+		node_t &n = nodes[order[i]];
+		for (int edge : n.fanout) {
+			int to = edges[edge].to;
+			nodes[to].level = std::max(nodes[to].level, n.level + 1);
+			if (--indegree[to] == 0)
+				order.push_back(to);
+		}
+	}
+
+	loops.clear();
+	if (GetSize(order) == GetSize(nodes))
+		return true;
+	for (int i = 0; i < GetSize(nodes); i++)
+		if (indegree[i] > 0)
+			loops.push_back(i);
+	return false;
+}
+
+int TimingGraph::compute_arrival(int node) const
+{
+	const node_t &n = nodes[node];
+	int arrival = n.launch;
+	for (int edge : n.fanin) {
+		const edge_t &e = edges[edge];
+		if (nodes[e.from].arrival != NONE)
+			arrival = std::max(arrival, nodes[e.from].arrival + e.delay);
+	}
+	return arrival;
+}
+
+int TimingGraph::compute_departure(int node) const
+{
+	const node_t &n = nodes[node];
+	int departure = n.capture;
+	for (int edge : n.fanout) {
+		const edge_t &e = edges[edge];
+		if (nodes[e.to].departure != NONE)
+			departure = std::max(departure, nodes[e.to].departure + e.delay);
+	}
+	return departure;
+}
+
+bool TimingGraph::update()
+{
+	if (!levels_valid) {
+		std::vector<int> order;
+		if (!levelize(order))
+			return false;
+		levels_valid = true;
+
+		for (int node : order)
+			nodes[node].arrival = compute_arrival(node);
+		for (auto it = order.rbegin(); it != order.rend(); ++it)
+			nodes[*it].departure = compute_departure(*it);
+		num_recomputed += 2 * GetSize(order);
+
+		for (int node : dirty_fwd)
+			nodes[node].queued_fwd = false;
+		for (int node : dirty_bwd)
+			nodes[node].queued_bwd = false;
+		dirty_fwd.clear();
+		dirty_bwd.clear();
+		return true;
+	}
+
+	// Arrival times in increasing level order: when a node is taken from
+	// the queue, all nodes that can still change its fanin have a lower
+	// level and are done.
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>, std::greater<std::pair<int, int>>> fwd_queue;
+	for (int node : dirty_fwd)
+		fwd_queue.emplace(nodes[node].level, node);
+	dirty_fwd.clear();
+
+	while (!fwd_queue.empty()) {
+		int node = fwd_queue.top().second;
+		fwd_queue.pop();
+		node_t &n = nodes[node];
+		n.queued_fwd = false;
+		num_recomputed++;
+
+		int arrival = compute_arrival(node);
+		if (arrival == n.arrival)
+			continue;
+		n.arrival = arrival;
+		for (int edge : n.fanout) {
+			int to = edges[edge].to;
+			if (!nodes[to].queued_fwd) {
+				nodes[to].queued_fwd = true;
+				fwd_queue.emplace(nodes[to].level, to);
+			}
+		}
+	}
+
+	// Departure times in decreasing level order.
+	std::priority_queue<std::pair<int, int>> bwd_queue;
+	for (int node : dirty_bwd)
+		bwd_queue.emplace(nodes[node].level, node);
+	dirty_bwd.clear();
+
+	while (!bwd_queue.empty()) {
+		int node = bwd_queue.top().second;
+		bwd_queue.pop();
+		node_t &n = nodes[node];
+		n.queued_bwd = false;
+		num_recomputed++;
+
+		int departure = compute_departure(node);
+		if (departure == n.departure)
+			continue;
+		n.departure = departure;
+		for (int edge : n.fanin) {
+			int from = edges[edge].from;
+			if (!nodes[from].queued_bwd) {
+				nodes[from].queued_bwd = true;
+				bwd_queue.emplace(nodes[from].level, from);
+			}
+		}
+	}
+
+	return true;
+}
+
+int TimingGraph::critical_fanin(int node) const
+{
+	const node_t &n = nodes[node];
+	int best = n.launch, best_edge = -1;
+	for (int edge : n.fanin) {
+		const edge_t &e = edges[edge];
+		if (nodes[e.from].arrival == NONE)
+			continue;
+		int time = nodes[e.from].arrival + e.delay;
+		if (best == NONE || time > best) {
+			best = time;
+			best_edge = edge;
+		}
+	}
+	return best_edge;
+}
+
+TimingGraph::Path TimingGraph::critical_path(int node) const
+{
+	Path path;
+	if (nodes[node].arrival == NONE)
+		return path;
+
+	path.nodes.push_back(node);
+	for (int edge = critical_fanin(node); edge >= 0; edge = critical_fanin(node)) {
+		node = edges[edge].from;
+		path.nodes.push_back(node);
+		path.edges.push_back(edge);
+	}
+	std::reverse(path.nodes.begin(), path.nodes.end());
+	std::reverse(path.edges.begin(), path.edges.end());
+
+	path.times.push_back(nodes[path.nodes.front()].launch);
+	for (int edge : path.edges)
+		path.times.push_back(path.times.back() + edges[edge].delay);
+	path.time = path.times.back();
+	if (nodes[path.nodes.back()].capture != NONE)
+		path.time += nodes[path.nodes.back()].capture;
+	return path;
+}
+
+// Best-first search backwards from the end points. A search state is a path
+// suffix that ends in an end point, and its priority is the latest time of
+// any complete path with that suffix, which is exactly the arrival time of
+// its first node plus the length of the suffix. Completing a suffix at a
+// start point gives a terminal state that is reported when it is popped, so
+// the paths come out latest first.
+std::vector<TimingGraph::Path> TimingGraph::worst_paths(int k) const
+{
+	struct state_t {
+		int node, suffix, parent, edge;
+		bool terminal;
+	};
+	std::vector<state_t> states;
+	// (time, -index), so that ties are taken in the order they were found
+	std::priority_queue<std::pair<int, int>> queue;
+
+	auto push = [&](const state_t &state, int time) {
+		queue.emplace(time, -GetSize(states));
+		states.push_back(state);
+	};
+
+	for (int i = 0; i < GetSize(nodes); i++)
+		if (nodes[i].capture != NONE && nodes[i].arrival != NONE)
+			push({i, nodes[i].capture, -1, -1, false}, nodes[i].arrival + nodes[i].capture);
+
+	std::vector<Path> paths;
+	while (GetSize(paths) < k && !queue.empty()) {
+		auto [time, index] = queue.top();
+		queue.pop();
+		state_t state = states[-index];
+
+		if (state.terminal) {
+			Path &path = paths.emplace_back();
+			path.time = time;
+			for (int i = state.parent; i >= 0; i = states[i].parent) {
+				path.nodes.push_back(states[i].node);
+				if (states[i].edge >= 0)
+					path.edges.push_back(states[i].edge);
+			}
+			path.times.push_back(nodes[path.nodes.front()].launch);
+			for (int edge : path.edges)
+				path.times.push_back(path.times.back() + edges[edge].delay);
+			continue;
+		}
+
+		const node_t &n = nodes[state.node];
+		if (n.launch != NONE)
+			push({state.node, state.suffix, -index, -1, true}, n.launch + state.suffix);
+		for (int edge : n.fanin) {
+			const edge_t &e = edges[edge];
+			if (nodes[e.from].arrival == NONE)
+				continue;
+			int suffix = state.suffix + e.delay;
+			push({e.from, suffix, -index, edge, false}, nodes[e.from].arrival + suffix);
+		}
+	}
+	return paths;
+}
+
+YOSYS_NAMESPACE_END
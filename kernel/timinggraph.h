@@ -0,0 +1,136 @@
+/* -*- c++ -*-
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#ifndef TIMINGGRAPH_H
+#define TIMINGGRAPH_H
+
+#include "kernel/yosys_common.h"
+
+#include <climits>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Longest-path timing graph with dense integer node and edge ids. A pass
+// creates one node for every point it wants to time (usually a signal bit)
+// and keeps its own per-node and per-edge data in vectors indexed by the
+// ids.
+//
+// Start points have a launch time and end points have a capture time, which
+// is added to the time a path takes to reach them (e.g. a setup time). For
+// each node the graph computes the arrival time, i.e. the latest time a path
+// from a start point reaches the node, and the departure time, i.e. the
+// longest time from the node to the end of a path into an end point,
+// including the capture time. The latest path through a node thus ends at
+// arrival + departure, and for a clock period P the required time of the node
+// is P - departure.
+//
+// Nodes are levelized so that every edge goes from a lower to a higher level.
+// After local edits (adding and removing edges, changing delays, launch or
+// capture times), update() only recomputes the nodes whose times can have
+// changed, in level order, and stops propagating at nodes whose time is
+// unchanged. Levels are only raised by edits, so after removing edges they
+// are still a topological order but no longer the longest path length.
+struct TimingGraph
+{
+	// Time of nodes not reached from a start point or not reaching an end
+	// point, and argument to clear launch and capture times.
+	static constexpr int NONE = INT_MIN;
+
+	struct Path {
+		// arrival time at the end point plus its capture time
+		int time = NONE;
+		std::vector<int> nodes;
+		// edges[i] goes from nodes[i] to nodes[i+1]
+		std::vector<int> edges;
+		// arrival times along this path, starting with the launch time
+		std::vector<int> times;
+	};
+
+	int add_node();
+	int add_edge(int from, int to, int delay);
+	void remove_edge(int edge);
+	void set_delay(int edge, int delay);
+	void set_launch(int node, int time);
+	void set_capture(int node, int time);
+
+	int num_nodes() const { return GetSize(nodes); }
+	int edge_from(int edge) const { return edges[edge].from; }
+	int edge_to(int edge) const { return edges[edge].to; }
+	int edge_delay(int edge) const { return edges[edge].delay; }
+	// ids of the edges into and out of a node, in the order they were added
+	const std::vector<int> &fanin(int node) const { return nodes[node].fanin; }
+	const std::vector<int> &fanout(int node) const { return nodes[node].fanout; }
+
+	// Brings levels, arrival and departure times up to date after edits.
+	// Returns false if the graph has a combinational loop, in which case
+	// loop_nodes() returns the nodes in or behind loops and the times are
+	// left as they were.
+	bool update();
+	const std::vector<int> &loop_nodes() const { return loops; }
+
+	// The following are only valid after a successful update().
+	int level(int node) const { return nodes[node].level; }
+	int arrival(int node) const { return nodes[node].arrival; }
+	int departure(int node) const { return nodes[node].departure; }
+	int launch(int node) const { return nodes[node].launch; }
+	int capture(int node) const { return nodes[node].capture; }
+	// The fanin edge that determines the arrival time of a node (the first
+	// one on ties), or -1 if it is determined by the launch time or the node
+	// has no arrival time.
+	int critical_fanin(int node) const;
+	// The latest path into a node, empty if the node has no arrival time.
+	Path critical_path(int node) const;
+	// The (at most) k paths from start points to end points that end the
+	// latest, latest first.
+	std::vector<Path> worst_paths(int k) const;
+
+	// Number of node times computed by update() so far.
+	int64_t num_recomputed = 0;
+
+private:
+	struct node_t {
+		int level = 0;
+		int arrival = NONE, departure = NONE;
+		int launch = NONE, capture = NONE;
+		bool queued_fwd = false, queued_bwd = false;
+		std::vector<int> fanin, fanout;
+	};
+	struct edge_t {
+		int from, to, delay;
+	};
+
+	std::vector<node_t> nodes;
+	std::vector<edge_t> edges;
+	std::vector<int> free_edges;
+	// Nodes whose arrival or departure time must be recomputed.
+	std::vector<int> dirty_fwd, dirty_bwd;
+	// Cleared by edits that create loops, the next update() then levelizes
+	// and computes all nodes from scratch.
+	bool levels_valid = false;
+	std::vector<int> loops;
+
+	void mark_fwd(int node);
+	void mark_bwd(int node);
+	void raise_levels(int from, int to);
+	bool levelize(std::vector<int> &order);
+	int compute_arrival(int node) const;
+	int compute_departure(int node) const;
+};
+
+YOSYS_NAMESPACE_END
+
+#endif
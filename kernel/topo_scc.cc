@@ -0,0 +1,490 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/topo_scc.h"
+#include "kernel/threading.h"
+
+#include <atomic>
+
+YOSYS_NAMESPACE_BEGIN
+
+CsrGraph::CsrGraph(int num_nodes, const std::vector<std::pair<int, int>> &edges)
+    : offsets(num_nodes + 1, 0), targets(GetSize(edges))
+{
+    for (auto const &edge : edges) {
+        log_assert(edge.first >= 0 && edge.first < num_nodes);
+        log_assert(edge.second >= 0 && edge.second < num_nodes);
+        offsets[edge.first + 1]++;
+    }
+    for (int node = 0; node < num_nodes; node++)
+        offsets[node + 1] += offsets[node];
+
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (auto const &edge : edges)
+        targets[fill[edge.first]++] = edge.second;
+}
+
+CsrGraph CsrGraph::transposed() const
+{
+    CsrGraph result;
+    int n = num_nodes();
+    result.offsets.assign(n + 1, 0);
+    result.targets.resize(num_edges());
+
+    for (int target : targets)
+        result.offsets[target + 1]++;
+    for (int node = 0; node < n; node++)
+        result.offsets[node + 1] += result.offsets[node];
+
+    std::vector<int> fill(result.offsets.begin(), result.offsets.end() - 1);
+    for (int node = 0; node < n; node++)
+        for (const int *succ = successors_begin(node); succ != successors_end(node); ++succ)
+            result.targets[fill[*succ]++] = node;
+    return result;
+}
+
+namespace {
+
+// Runs body(begin, end) for consecutive chunks of 0 .. size-1, on up to
+// num_threads threads.
+void parallel_chunks(int size, int num_threads, const std::function<void(int, int)> &body)
+{
+    const int chunk_size = 4096;
+    int num_chunks = (size + chunk_size - 1) / chunk_size;
+    int num_workers = num_threads > 1 ? ThreadPool::pool_size(0, std::min(num_threads, num_chunks)) : 0;
+    if (num_workers <= 1) {
+        if (size > 0)
+            body(0, size);
+        return;
+    }
+
+    std::atomic<int> next_chunk(0);
+    ThreadPool pool(num_workers, [&](int) {
+        for (int chunk; (chunk = next_chunk.fetch_add(1)) < num_chunks;)
+            body(chunk * chunk_size, std::min(size, (chunk + 1) * chunk_size));
+    });
+}
+
+struct SccSolver
+{
+    // Subproblems with at most this many nodes are finished with a single
+    // TopoSortedSccs run instead of further forward-backward searches.
+    static constexpr int serial_threshold = 4096;
+
+    struct Task {
+        int label = -1;
+        std::vector<int> nodes;
+        // finish with TopoSortedSccs without trimming
+        bool serial = false;
+    };
+
+    const CsrGraph &graph;
+    const CsrGraph reverse;
+    std::vector<int> &component;
+
+    // Label of the subproblem a node belongs to, or -1 once its component is
+    // known. Nodes of other subproblems are read concurrently, they are only
+    // compared against the reader's own label.
+    std::vector<std::atomic<int>> label;
+    std::atomic<int> next_label;
+    // Only accessed for the nodes of the subproblem being processed.
+    std::vector<int> in_degree, out_degree, marks, dfs_indices, wcc_parent;
+
+#ifdef YOSYS_ENABLE_THREADS
+    std::mutex mutex;
+    std::condition_variable cond;
+#endif
+    std::vector<Task> tasks;
+    int busy = 0;
+
+    SccSolver(const CsrGraph &graph, std::vector<int> &component) :
+        graph(graph), reverse(graph.transposed()), component(component),
+        label(graph.num_nodes()), next_label(1),
+        in_degree(graph.num_nodes()), out_degree(graph.num_nodes()),
+        marks(graph.num_nodes()), dfs_indices(graph.num_nodes(), -1),
+        wcc_parent(graph.num_nodes())
+    {
+        component.assign(graph.num_nodes(), -1);
+    }
+
+    int get_label(int node) const { return label[node].load(std::memory_order_relaxed); }
+    void set_label(int node, int value) { label[node].store(value, std::memory_order_relaxed); }
+
+    void set_component(int node, int id) {
+        component[node] = id;
+        set_label(node, -1);
+    }
+
+    // Removes the nodes of a subproblem that have no predecessor or no
+    // successor in it, until there are none left. When `full_graph` is set,
+    // the subproblem is the whole graph and the degrees come from the CSR
+    // offsets.
+    void trim(Task &task, bool full_graph)
+    {
+        std::vector<int> worklist;
+        for (int node : task.nodes) {
+            if (full_graph) {
+                in_degree[node] = reverse.degree(node);
+                out_degree[node] = graph.degree(node);
+            } else {
+                in_degree[node] = 0;
+                out_degree[node] = 0;
+                for (const int *pred = reverse.successors_begin(node); pred != reverse.successors_end(node); ++pred)
+                    in_degree[node] += get_label(*pred) == task.label;
+                for (const int *succ = graph.successors_begin(node); succ != graph.successors_end(node); ++succ)
+                    out_degree[node] += get_label(*succ) == task.label;
+            }
+            if (in_degree[node] == 0 || out_degree[node] == 0)
+                worklist.push_back(node);
+        }
+
+        while (!worklist.empty()) {
+            int node = worklist.back();
+            worklist.pop_back();
+            if (get_label(node) != task.label)
+                continue;
+            set_component(node, node);
+            for (const int *succ = graph.successors_begin(node); succ != graph.successors_end(node); ++succ)
+                if (get_label(*succ) == task.label && --in_degree[*succ] == 0)
+                    worklist.push_back(*succ);
+            for (const int *pred = reverse.successors_begin(node); pred != reverse.successors_end(node); ++pred)
+                if (get_label(*pred) == task.label && --out_degree[*pred] == 0)
+                    worklist.push_back(*pred);
+        }
+
+        task.nodes.erase(std::remove_if(task.nodes.begin(), task.nodes.end(),
+                [&](int node) { return get_label(node) != task.label; }), task.nodes.end());
+    }
+
+    // Adapts a subproblem to the graph interface of TopoSortedSccs.
+    struct TaskGraph {
+        typedef int node_type;
+
+        struct node_enumerator {
+            std::vector<int>::const_iterator current, end;
+            bool finished() const { return current == end; }
+            node_type next() {
+                log_assert(!finished());
+                return *current++;
+            }
+        };
+
+        struct successor_enumerator {
+            const TaskGraph *graph;
+            const int *current, *end;
+            void skip() {
+                while (current != end && graph->solver.get_label(*current) != graph->task.label)
+                    ++current;
+            }
+            bool finished() const { return current == end; }
+            node_type next() {
+                log_assert(!finished());
+                node_type result = *current++;
+                skip();
+                return result;
+            }
+        };
+
+        SccSolver &solver;
+        const Task &task;
+
+        node_enumerator enumerate_nodes() { return {task.nodes.begin(), task.nodes.end()}; }
+        successor_enumerator enumerate_successors(int node) const {
+            successor_enumerator result{this, solver.graph.successors_begin(node), solver.graph.successors_end(node)};
+            result.skip();
+            return result;
+        }
+        int &dfs_index(int node) { return solver.dfs_indices[node]; }
+    };
+
+    void serial_sccs(const Task &task)
+    {
+        TaskGraph task_graph{*this, task};
+        // The callback must not change the labels while the search still
+        // follows edges, so components are only recorded here.
+        std::vector<std::pair<int, int>> found;
+        TopoSortedSccs(task_graph, [&](int *begin, int *end) {
+            for (int *node = begin; node != end; ++node)
+                found.emplace_back(*node, *begin);
+        }).process_all();
+        for (auto &it : found)
+            set_component(it.first, it.second);
+    }
+
+    int find_root(int node)
+    {
+        while (wcc_parent[node] != node)
+            node = wcc_parent[node] = wcc_parent[wcc_parent[node]];
+        return node;
+    }
+
+    // Splits the nodes of the given subproblems into weakly connected parts,
+    // which are combined into tasks of at least serial_threshold nodes that
+    // are finished by TopoSortedSccs. No cycle can leave a weakly connected
+    // part, so this doesn't change the components.
+    void split_serial(const std::vector<Task*> &parts, std::vector<Task> &new_tasks)
+    {
+        auto in_parts = [&](int node) {
+            int node_label = get_label(node);
+            for (auto part : parts)
+                if (part->label == node_label)
+                    return true;
+            return false;
+        };
+
+        for (auto part : parts)
+            for (int node : part->nodes)
+                wcc_parent[node] = node;
+        for (auto part : parts)
+            for (int node : part->nodes)
+                for (const int *succ = graph.successors_begin(node); succ != graph.successors_end(node); ++succ)
+                    if (in_parts(*succ)) {
+                        int a = find_root(node), b = find_root(*succ);
+                        if (a != b)
+                            wcc_parent[std::max(a, b)] = std::min(a, b);
+                    }
+
+        dict<int, std::vector<int>> wccs;
+        for (auto part : parts)
+            for (int node : part->nodes)
+                wccs[find_root(node)].push_back(node);
+
+        Task batch;
+        for (auto &it : wccs) {
+            batch.nodes.insert(batch.nodes.end(), it.second.begin(), it.second.end());
+            if (GetSize(batch.nodes) >= serial_threshold) {
+                batch.serial = true;
+                new_tasks.push_back(std::move(batch));
+                batch = Task();
+            }
+        }
+        if (!batch.nodes.empty()) {
+            batch.serial = true;
+            new_tasks.push_back(std::move(batch));
+        }
+        for (auto &task : new_tasks)
+            if (task.serial && task.label < 0) {
+                task.label = next_label.fetch_add(1);
+                for (int node : task.nodes)
+                    set_label(node, task.label);
+            }
+    }
+
+    void process(Task task, std::vector<Task> &new_tasks)
+    {
+        if (!task.serial)
+            trim(task, false);
+        if (task.nodes.empty())
+            return;
+        if (task.serial || GetSize(task.nodes) <= serial_threshold) {
+            serial_sccs(task);
+            return;
+        }
+
+        // The node with the most in- and outgoing edges is likely to be in
+        // the largest component.
+        int pivot = task.nodes.front();
+        for (int node : task.nodes)
+            if (int64_t(in_degree[node]) * out_degree[node] > int64_t(in_degree[pivot]) * out_degree[pivot])
+                pivot = node;
+
+        std::vector<int> stack;
+        for (int direction = 1; direction <= 2; direction++) {
+            const CsrGraph &g = direction == 1 ? graph : reverse;
+            marks[pivot] |= direction;
+            stack.push_back(pivot);
+            while (!stack.empty()) {
+                int node = stack.back();
+                stack.pop_back();
+                for (const int *succ = g.successors_begin(node); succ != g.successors_end(node); ++succ)
+                    if (get_label(*succ) == task.label && !(marks[*succ] & direction)) {
+                        marks[*succ] |= direction;
+                        stack.push_back(*succ);
+                    }
+            }
+        }
+
+        // marks: 1 = only forward, 2 = only backward, 3 = both, 0 = neither
+        Task parts[3];
+        for (auto &part : parts)
+            part.label = next_label.fetch_add(1);
+        int component_size = 0;
+        for (int node : task.nodes) {
+            int mark = marks[node];
+            marks[node] = 0;
+            if (mark == 3) {
+                set_component(node, pivot);
+                component_size++;
+                continue;
+            }
+            Task &part = parts[mark];
+            set_label(node, part.label);
+            part.nodes.push_back(node);
+        }
+
+        // Forward-backward search pays off while it finds large components.
+        // When the rest consists of many small components, it would take one
+        // search for each of them, so that is left to TopoSortedSccs.
+        if (component_size * 8 < GetSize(task.nodes)) {
+            split_serial({&parts[0], &parts[1], &parts[2]}, new_tasks);
+            return;
+        }
+        for (auto &part : parts)
+            if (!part.nodes.empty())
+                new_tasks.push_back(std::move(part));
+    }
+
+    void worker()
+    {
+        std::vector<Task> new_tasks;
+        while (true) {
+            Task task;
+            {
+#ifdef YOSYS_ENABLE_THREADS
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this] { return !tasks.empty() || busy == 0; });
+#endif
+                if (tasks.empty())
+                    return;
+                task = std::move(tasks.back());
+                tasks.pop_back();
+                busy++;
+            }
+
+            process(std::move(task), new_tasks);
+
+            {
+#ifdef YOSYS_ENABLE_THREADS
+                std::unique_lock<std::mutex> lock(mutex);
+#endif
+                for (auto &new_task : new_tasks)
+                    tasks.push_back(std::move(new_task));
+                new_tasks.clear();
+                busy--;
+            }
+#ifdef YOSYS_ENABLE_THREADS
+            cond.notify_all();
+#endif
+        }
+    }
+
+    void run(int num_workers)
+    {
+        Task all;
+        all.label = 0;
+        all.nodes.resize(graph.num_nodes());
+        for (int node = 0; node < graph.num_nodes(); node++) {
+            all.nodes[node] = node;
+            set_label(node, 0);
+        }
+        trim(all, true);
+        if (!all.nodes.empty())
+            tasks.push_back(std::move(all));
+
+        if (num_workers <= 1)
+            worker();
+        else
+            ThreadPool pool(num_workers, [this](int) { worker(); });
+    }
+};
+
+// A CsrGraph for TopoSortedSccs that is only read.
+struct CsrView {
+    typedef int node_type;
+    typedef CsrGraph::node_enumerator node_enumerator;
+    typedef CsrGraph::successor_enumerator successor_enumerator;
+
+    const CsrGraph &graph;
+    std::vector<int> indices;
+
+    node_enumerator enumerate_nodes() { return {0, graph.num_nodes()}; }
+    successor_enumerator enumerate_successors(int node) const { return graph.enumerate_successors(node); }
+    int &dfs_index(int node) { return indices[node]; }
+};
+
+} // namespace
+
+int parallel_sccs(const CsrGraph &graph, std::vector<int> &component, int num_threads)
+{
+    // with a single thread, forward-backward search has no advantage over
+    // a single Tarjan run
+    if (num_threads > 1) {
+        SccSolver solver(graph, component);
+        solver.run(ThreadPool::pool_size(0, num_threads));
+    } else {
+        component.assign(graph.num_nodes(), -1);
+        CsrView view{graph, std::vector<int>(graph.num_nodes(), -1)};
+        TopoSortedSccs(view, [&](int *begin, int *end) {
+            for (int *node = begin; node != end; ++node)
+                component[*node] = *begin;
+        }).process_all();
+    }
+
+    // number the components by their smallest node
+    std::vector<int> ids(graph.num_nodes(), -1);
+    int num_components = 0;
+    for (int node = 0; node < graph.num_nodes(); node++) {
+        int &id = ids[component[node]];
+        if (id < 0)
+            id = num_components++;
+        component[node] = id;
+    }
+    return num_components;
+}
+
+bool parallel_levels(const CsrGraph &graph, std::vector<int> &level, int num_threads)
+{
+    int n = graph.num_nodes();
+    std::vector<std::atomic<int>> in_degree(n);
+    for (int node = 0; node < n; node++)
+        in_degree[node].store(0, std::memory_order_relaxed);
+    for (int target : graph.targets)
+        in_degree[target].fetch_add(1, std::memory_order_relaxed);
+
+    level.assign(n, -1);
+    std::vector<int> frontier;
+    for (int node = 0; node < n; node++)
+        if (in_degree[node].load(std::memory_order_relaxed) == 0)
+            frontier.push_back(node);
+
+    int done = 0;
+#ifdef YOSYS_ENABLE_THREADS
+    std::mutex mutex;
+#endif
+    for (int current = 0; !frontier.empty(); current++) {
+        std::vector<int> next;
+        parallel_chunks(GetSize(frontier), num_threads, [&](int begin, int end) {
+            std::vector<int> local_next;
+            for (int i = begin; i < end; i++) {
+                int node = frontier[i];
+                level[node] = current;
+                for (const int *succ = graph.successors_begin(node); succ != graph.successors_end(node); ++succ)
+                    if (in_degree[*succ].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                        local_next.push_back(*succ);
+            }
+#ifdef YOSYS_ENABLE_THREADS
+            std::lock_guard<std::mutex> lock(mutex);
+#endif
+            next.insert(next.end(), local_next.begin(), local_next.end());
+        });
+        done += GetSize(frontier);
+        frontier.swap(next);
+    }
+    return done == n;
+}
+
+YOSYS_NAMESPACE_END
@@ -193,6 +193,80 @@ public:
     }
 };
 
+// Directed graph over the nodes 0 .. n-1 in compressed sparse row form: the
+// successors of node i are targets[offsets[i]] .. targets[offsets[i+1]-1].
+// The whole graph lives in two flat arrays, which makes it much cheaper to
+// build and to traverse than per-node containers when there are tens of
+// millions of edges. It can be used with TopoSortedSccs, and with the parallel
+// algorithms below.
+class CsrGraph {
+public:
+    typedef int node_type;
+    typedef IntGraph::node_enumerator node_enumerator;
+
+    struct successor_enumerator {
+        const int *current, *end;
+        bool finished() const { return current == end; }
+        node_type next() {
+            log_assert(!finished());
+            return *current++;
+        }
+    };
+
+    std::vector<int> offsets;
+    std::vector<int> targets;
+
+    CsrGraph() : offsets(1, 0) {}
+    // Builds the graph from a list of (source, target) pairs. Duplicate edges
+    // are kept, the successors of each node are in the order of the list.
+    CsrGraph(int num_nodes, const std::vector<std::pair<int, int>> &edges);
+
+    int num_nodes() const { return GetSize(offsets) - 1; }
+    int num_edges() const { return GetSize(targets); }
+    int degree(int node) const { return offsets[node + 1] - offsets[node]; }
+    const int *successors_begin(int node) const { return targets.data() + offsets[node]; }
+    const int *successors_end(int node) const { return targets.data() + offsets[node + 1]; }
+
+    // The graph with all edges reversed.
+    CsrGraph transposed() const;
+
+    node_enumerator enumerate_nodes() {
+        if (GetSize(indices_) != num_nodes())
+            indices_.assign(num_nodes(), -1);
+        return {0, num_nodes()};
+    }
+
+    successor_enumerator enumerate_successors(int node) const {
+        return {successors_begin(node), successors_end(node)};
+    }
+
+    int &dfs_index(node_type const &node) {
+        return indices_[node];
+    }
+
+private:
+    std::vector<int> indices_;
+};
+
+// Computes the strongly connected components of a graph. Sets component[i] to
+// the component of node i and returns the number of components, which are
+// numbered in the order of their smallest node.
+//
+// Nodes without a predecessor or successor in their subproblem can't be on a
+// cycle and are removed first ("trimming"), which for netlists usually leaves
+// only a small part of the graph. What remains is split by forward-backward
+// search: the nodes that are reachable from a pivot node and also reach it
+// form its component, and the nodes reached in only one or in neither
+// direction form three independent subproblems, which are processed on up to
+// num_threads threads. Small subproblems are finished with TopoSortedSccs.
+int parallel_sccs(const CsrGraph &graph, std::vector<int> &component, int num_threads = 1);
+
+// Sets level[i] to the number of edges on the longest path into node i of an
+// acyclic graph. The nodes of a level are processed in parallel on up to
+// num_threads threads. Returns false if the graph has a cycle, the nodes on or
+// behind cycles then have level -1.
+bool parallel_levels(const CsrGraph &graph, std::vector<int> &level, int num_threads = 1);
+
 template<typename G, typename ComponentCallback>
 class TopoSortedSccs
 {
@@ -80,6 +80,8 @@
 YOSYS_NAMESPACE_BEGIN
 
 int autoidx = 1;
+thread_local int *autoidx_local = nullptr;
+thread_local unsigned int *hashidx_local = nullptr;
 int yosys_xtrace = 0;
 bool yosys_write_versions = true;
 const char* yosys_maybe_version() {
@@ -285,7 +287,7 @@ RTLIL::IdString new_id(std::string file, int line, std::string func)
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
-	return stringf("$auto$%s:%d:%s$%d", file, line, func, autoidx++);
+	return stringf("$auto$%s:%d:%s$%d", file, line, func, next_autoidx());
 }
 
 RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std::string suffix)
@@ -302,7 +304,7 @@ RTLIL::IdString new_id_suffix(std::string file, int line, std::string func, std:
 	if (pos != std::string::npos)
 		func = func.substr(pos+1);
 
-	return stringf("$auto$%s:%d:%s$%s$%d", file, line, func, suffix, autoidx++);
+	return stringf("$auto$%s:%d:%s$%s$%d", file, line, func, suffix, next_autoidx());
 }
 
 RTLIL::Design *yosys_get_design()
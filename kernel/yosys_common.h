@@ -266,6 +266,16 @@ template<typename T> int GetSize(const T &obj) { return obj.size(); }
 inline int GetSize(RTLIL::Wire *wire);
 
 extern int autoidx;
+// When set, NEW_ID and the hash indices of newly created RTLIL objects are
+// taken from these counters instead of the global ones. Used by
+// parallel_for_modules() to give each task its own, deterministic sequence.
+extern thread_local int *autoidx_local;
+extern thread_local unsigned int *hashidx_local;
+
+// Returns the next index for an auto-generated name, from the task-local
+// counter if there is one.
+inline int next_autoidx() { return autoidx_local ? (*autoidx_local)++ : autoidx++; }
+
 extern int yosys_xtrace;
 extern bool yosys_write_versions;
 
@@ -18,3 +18,4 @@ patch -p0 < 00_PATCH_no_fpu_control.patch
 patch -p0 < 00_PATCH_typofixes.patch
 patch -p0 < 00_PATCH_wasm.patch
 patch -p0 < 00_PATCH_warnings.patch
+patch -p0 < 00_PATCH_atomic_interrupt.patch
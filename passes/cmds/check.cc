@@ -22,6 +22,7 @@
 #include "kernel/celledges.h"
 #include "kernel/celltypes.h"
 #include "kernel/utils.h"
+#include "kernel/topo_scc.h"
 #include "kernel/log_help.h"
 
 USING_YOSYS_NAMESPACE
@@ -71,6 +72,10 @@ struct CheckPass : public Pass {
 		log("        falling back to a simpler overapproximating model for those cells for\n");
 		log("        which the detailed model is expected costly.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        use up to N threads for finding the strongly connected components of\n");
+		log("        the connectivity graph in the combinatorial loop check (default: 1)\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
@@ -82,6 +87,7 @@ struct CheckPass : public Pass {
 		bool assert_mode = false;
 		bool force_detailed_loop_check = false;
 		bool suggest_detail = false;
+		int num_threads = 1;
 
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
@@ -109,6 +115,12 @@ struct CheckPass : public Pass {
 				force_detailed_loop_check = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads: %s\n", args[argidx]);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -124,7 +136,8 @@ struct CheckPass : public Pass {
 			dict<SigBit, Cell *> driver_cells;
 			dict<SigBit, int> wire_drivers_count;
 			pool<SigBit> used_wires;
-			TopoSort<std::pair<RTLIL::IdString, int>> topo;
+			idict<std::pair<RTLIL::IdString, int>> loop_nodes;
+			std::vector<std::pair<int, int>> loop_edges;
 			for (auto &proc_it : module->processes)
 			{
 				std::vector<RTLIL::CaseRule*> all_cases = {&proc_it.second->root_case};
@@ -170,12 +183,18 @@ struct CheckPass : public Pass {
 			}
 
 			struct CircuitEdgesDatabase : AbstractCellEdgesDatabase {
-				TopoSort<std::pair<RTLIL::IdString, int>> &topo;
+				idict<std::pair<RTLIL::IdString, int>> &nodes;
+				std::vector<std::pair<int, int>> &edges;
 				SigMap sigmap;
 				bool force_detail;
 
-				CircuitEdgesDatabase(TopoSort<std::pair<RTLIL::IdString, int>> &topo, SigMap &sigmap, bool force_detail)
-					: topo(topo), sigmap(sigmap), force_detail(force_detail) {}
+				CircuitEdgesDatabase(idict<std::pair<RTLIL::IdString, int>> &nodes, std::vector<std::pair<int, int>> &edges,
+						SigMap &sigmap, bool force_detail)
+					: nodes(nodes), edges(edges), sigmap(sigmap), force_detail(force_detail) {}
+
+				void edge(const std::pair<RTLIL::IdString, int> &from, const std::pair<RTLIL::IdString, int> &to) {
+					edges.emplace_back(nodes(from), nodes(to));
+				}
 
 				void add_edge(RTLIL::Cell *cell, RTLIL::IdString from_port, int from_bit,
 							  RTLIL::IdString to_port, int to_bit, int) override {
@@ -187,7 +206,7 @@ struct CheckPass : public Pass {
 					SigBit to = sigmap(to_portsig[to_bit]);
 
 					if (from.wire && to.wire)
-						topo.edge(std::make_pair(from.wire->name, from.offset), std::make_pair(to.wire->name, to.offset));
+						edge(std::make_pair(from.wire->name, from.offset), std::make_pair(to.wire->name, to.offset));
 				}
 
 				bool detail_costly(Cell *cell) {
@@ -237,14 +256,14 @@ struct CheckPass : public Pass {
 						if (cell->input(conn.first))
 						for (auto bit : sigmap(conn.second))
 						if (bit.wire)
-							topo.edge(std::make_pair(bit.wire->name, bit.offset),
-									  std::make_pair(cell->name, -1));
+							edge(std::make_pair(bit.wire->name, bit.offset),
+								 std::make_pair(cell->name, -1));
 
 						if (cell->output(conn.first))
 						for (auto bit : sigmap(conn.second))
 						if (bit.wire)
-							topo.edge(std::make_pair(cell->name, -1),
-									  std::make_pair(bit.wire->name, bit.offset));
+							edge(std::make_pair(cell->name, -1),
+								 std::make_pair(bit.wire->name, bit.offset));
 					}
 
 					// Return false to signify the fallback
@@ -252,7 +271,7 @@ struct CheckPass : public Pass {
 				}
 			};
 
-			CircuitEdgesDatabase edges_db(topo, sigmap, force_detailed_loop_check);
+			CircuitEdgesDatabase edges_db(loop_nodes, loop_edges, sigmap, force_detailed_loop_check);
 
 			pool<Cell *> coarsened_cells;
 			for (auto cell : module->cells())
@@ -342,6 +361,18 @@ struct CheckPass : public Pass {
 					counter++;
 				}
 
+			// Only the edges within a strongly connected component can be on a
+			// loop. Finding the components is linear in the size of the graph,
+			// and leaves TopoSort with the (usually tiny) cyclic part to find
+			// the loops to report.
+			CsrGraph loop_graph(GetSize(loop_nodes), loop_edges);
+			std::vector<int> component;
+			parallel_sccs(loop_graph, component, num_threads);
+
+			TopoSort<std::pair<RTLIL::IdString, int>> topo;
+			for (auto &edge : loop_edges)
+				if (component[edge.first] == component[edge.second])
+					topo.edge(loop_nodes[edge.first], loop_nodes[edge.second]);
 			topo.sort();
 			for (auto &loop : topo.loops) {
 				string message = stringf("found logic loop in module %s:\n", log_id(module));
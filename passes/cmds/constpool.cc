@@ -0,0 +1,126 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct ConstPoolPass : public Pass {
+	ConstPoolPass() : Pass("constpool", "share identical parameter and attribute values") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    constpool [options] [selection]\n");
+		log("\n");
+		log("Parameter and attribute values can be interned, so that all copies of the same\n");
+		log("value share a single immutable copy in a global pool. This saves a lot of\n");
+		log("memory on large flattened or techmapped designs, where millions of cells carry\n");
+		log("the same WIDTH or INIT parameters and src attributes. Interned values behave\n");
+		log("like any other value, a pass modifying one gets a private copy first.\n");
+		log("\n");
+		log("    -enable\n");
+		log("        intern the values of parameters and attributes as they are set by\n");
+		log("        the following commands. This covers values set with setParam() and\n");
+		log("        set_string_attribute() as well as the parameters and attributes of\n");
+		log("        the cells and wires copied by e.g. flatten and techmap.\n");
+		log("\n");
+		log("    -disable\n");
+		log("        stop interning values as they are set. Values interned already stay\n");
+		log("        interned.\n");
+		log("\n");
+		log("    -apply\n");
+		log("        intern the parameters and attributes of the selected modules and of\n");
+		log("        their selected wires, cells, memories and processes.\n");
+		log("\n");
+		log("    -stats\n");
+		log("        print the number of values in the pool and their size. This is the\n");
+		log("        default when no other option is given.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		bool enable = false, disable = false, apply = false, stats = false;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-enable") {
+				enable = true;
+				continue;
+			}
+			if (args[argidx] == "-disable") {
+				disable = true;
+				continue;
+			}
+			if (args[argidx] == "-apply") {
+				apply = true;
+				continue;
+			}
+			if (args[argidx] == "-stats") {
+				stats = true;
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		if (enable && disable)
+			log_cmd_error("Options -enable and -disable are exclusive.\n");
+		if (!enable && !disable && !apply)
+			stats = true;
+
+		log_header(design, "Executing CONSTPOOL pass.\n");
+
+		if (enable || disable) {
+			RTLIL::ConstPool::enabled = enable;
+			log("%s interning parameter and attribute values.\n", enable ? "Enabled" : "Disabled");
+		}
+
+		if (apply) {
+			int count = 0;
+			for (auto module : design->selected_modules()) {
+				RTLIL::ConstPool::intern_attributes(module);
+				for (auto wire : module->selected_wires())
+					RTLIL::ConstPool::intern_attributes(wire);
+				for (auto cell : module->selected_cells()) {
+					RTLIL::ConstPool::intern_parameters(cell);
+					RTLIL::ConstPool::intern_attributes(cell);
+				}
+				for (auto mem : module->selected_memories())
+					RTLIL::ConstPool::intern_attributes(mem);
+				for (auto proc : module->selected_processes())
+					RTLIL::ConstPool::intern_attributes(proc);
+				count++;
+			}
+			log("Interned parameters and attributes in %d modules.\n", count);
+		}
+
+		if (stats) {
+			RTLIL::ConstPool::collect();
+			RTLIL::ConstPool::Stats st = RTLIL::ConstPool::stats();
+			log("Values in the pool:        %d\n", st.entries);
+			log("References to the values:  %lld\n", (long long)st.references);
+			log("Size of the values:        %lld bytes\n", (long long)st.data_bytes);
+			if (st.entries > 0)
+				log("Average sharing:           %.1f references per value\n", double(st.references) / st.entries);
+		}
+	}
+} ConstPoolPass;
+
+PRIVATE_NAMESPACE_END
@@ -338,8 +338,15 @@ struct DesignPass : public Pass {
 		{
 			RTLIL::Design *design_copy = new RTLIL::Design;
 
-			for (auto mod : design->modules())
-				design_copy->add(mod->clone());
+			// The current design is cleared right after -push and -stash, so
+			// the modules can be handed over to the saved design as they are.
+			if (push_mode || reset_mode) {
+				for (auto mod : design->modules().to_vector())
+					design_copy->add(design->release(mod));
+			} else {
+				for (auto mod : design->modules())
+					design_copy->add(mod->clone());
+			}
 
 			design_copy->selection_stack = design->selection_stack;
 			design_copy->selection_vars = design->selection_vars;
@@ -377,8 +384,15 @@ struct DesignPass : public Pass {
 		{
 			RTLIL::Design *saved_design = pop_mode ? pushed_designs.back() : saved_designs.at(load_name);
 
-			for (auto mod : saved_design->modules())
-				design->add(mod->clone());
+			// A popped design is deleted afterwards, so take its modules
+			// instead of copying them.
+			if (pop_mode) {
+				for (auto mod : saved_design->modules().to_vector())
+					design->add(saved_design->release(mod));
+			} else {
+				for (auto mod : saved_design->modules())
+					design->add(mod->clone());
+			}
 
 			design->selection_stack = saved_design->selection_stack;
 			design->selection_vars = saved_design->selection_vars;
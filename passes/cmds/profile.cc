@@ -0,0 +1,217 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/profile.h"
+#include "kernel/json.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct ProfileReport
+{
+	std::vector<std::vector<int>> children;
+	std::vector<int> roots;
+	int max_depth = -1;
+
+	ProfileReport()
+	{
+		children.resize(GetSize(profile_records));
+		for (int i = 0; i < GetSize(profile_records); i++) {
+			int parent = profile_records[i].parent;
+			(parent < 0 ? roots : children[parent]).push_back(i);
+		}
+	}
+
+	static std::string fmt_delta(int64_t value)
+	{
+		return value ? stringf("%+lld", (long long)value) : std::string("0");
+	}
+
+	void print(int index)
+	{
+		const ProfileRecord &rec = profile_records[index];
+		if (max_depth >= 0 && rec.depth > max_depth)
+			return;
+
+		std::string command = std::string(2 * rec.depth, ' ') + rec.command;
+		if (GetSize(command) > 60)
+			command = command.substr(0, 57) + "...";
+
+		if (!rec.finished) {
+			log("  %10s %10s %10s %10s %10s %8s %8s  %s\n", "-", "-", "-", "-", "-", "-", "-", command.c_str());
+		} else {
+			std::string allocs = rec.alloc_count < 0 ? "-" : stringf("%lld", (long long)rec.alloc_count);
+			std::string alloc_mb = rec.alloc_bytes < 0 ? "-" : stringf("%.1f", rec.alloc_bytes / 1048576.0);
+			log("  %10.3f %10.3f %10.1f %10s %10s %8s %8s  %s\n", rec.wall_ns / 1e9, rec.cpu_ns / 1e9,
+					rec.peak_rss_delta / 1048576.0, allocs.c_str(), alloc_mb.c_str(),
+					fmt_delta(rec.cells_delta).c_str(), fmt_delta(rec.wires_delta).c_str(), command.c_str());
+		}
+
+		for (int child : children[index])
+			print(child);
+	}
+
+	void print()
+	{
+		log("  %10s %10s %10s %10s %10s %8s %8s  %s\n", "wall [s]", "cpu [s]", "rss+ [MB]",
+				"allocs", "alloc [MB]", "cells", "wires", "command");
+		for (int root : roots)
+			print(root);
+	}
+
+	void write_json(PrettyJson &json, int index)
+	{
+		const ProfileRecord &rec = profile_records[index];
+		json.begin_object();
+		json.entry("command", rec.command);
+		json.entry("finished", rec.finished);
+		if (rec.finished) {
+			json.entry("wall_ns", double(rec.wall_ns));
+			json.entry("cpu_ns", double(rec.cpu_ns));
+			json.entry("peak_rss_delta_bytes", double(rec.peak_rss_delta));
+			if (rec.alloc_count >= 0) {
+				json.entry("alloc_count", double(rec.alloc_count));
+				json.entry("alloc_bytes", double(rec.alloc_bytes));
+			}
+			json.entry("cells_delta", double(rec.cells_delta));
+			json.entry("wires_delta", double(rec.wires_delta));
+		}
+		json.name("children");
+		json.begin_array();
+		for (int child : children[index])
+			write_json(json, child);
+		json.end_array();
+		json.end_object();
+	}
+
+	void write_json(const std::string &filename)
+	{
+		PrettyJson json;
+		if (!json.write_to_file(filename))
+			log_error("Can't open file `%s' for writing: %s\n", filename, strerror(errno));
+
+		int64_t count, bytes;
+		json.begin_object();
+		json.entry("generator", yosys_maybe_version());
+		json.entry("alloc_stats", profile_alloc_stats(count, bytes));
+		json.name("invocations");
+		json.begin_array();
+		for (int root : roots)
+			write_json(json, root);
+		json.end_array();
+		json.end_object();
+	}
+};
+
+struct ProfilePass : public Pass {
+	ProfilePass() : Pass("profile", "record resource usage of each command") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    profile [options]\n");
+		log("\n");
+		log("Without options, start recording the resource usage of every command that is\n");
+		log("executed from now on, including the commands run by other commands such as\n");
+		log("script passes. For every invocation the wall and CPU time, the increase of the\n");
+		log("peak resident set size, the number and size of allocations and the change in\n");
+		log("the number of cells and wires in the design are recorded.\n");
+		log("\n");
+		log("Allocations are only counted when Yosys was built with ENABLE_ALLOC_STATS=1,\n");
+		log("which replaces the global operator new with a counting version. Memory that\n");
+		log("is allocated with malloc() directly, e.g. by ABC, is not included.\n");
+		log("\n");
+		log("    -stop\n");
+		log("        stop recording\n");
+		log("\n");
+		log("    -clear\n");
+		log("        discard the recorded invocations\n");
+		log("\n");
+		log("    -report\n");
+		log("        print the recorded invocations as a tree\n");
+		log("\n");
+		log("    -depth <n>\n");
+		log("        only print invocations nested at most <n> levels deep\n");
+		log("\n");
+		log("    -json <filename>\n");
+		log("        write the recorded invocations to a JSON file\n");
+		log("\n");
+		log("Example:\n");
+		log("\n");
+		log("    profile; synth -top top; profile -stop -report -depth 1 -json profile.json\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		bool stop = false, clear = false, report = false;
+		int depth = -1;
+		std::string json_file;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-stop") {
+				stop = true;
+				continue;
+			}
+			if (args[argidx] == "-clear") {
+				clear = true;
+				continue;
+			}
+			if (args[argidx] == "-report") {
+				report = true;
+				continue;
+			}
+			if (args[argidx] == "-depth" && argidx+1 < args.size()) {
+				depth = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-json" && argidx+1 < args.size()) {
+				json_file = args[++argidx];
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		if (!stop && !clear && !report && json_file.empty()) {
+			profile_enabled = true;
+			log("Recording the resource usage of commands.\n");
+			return;
+		}
+
+		if (stop)
+			profile_enabled = false;
+
+		if (report || !json_file.empty()) {
+			ProfileReport profile_report;
+			profile_report.max_depth = depth;
+			if (report) {
+				log_header(design, "Resource usage of recorded commands.\n");
+				profile_report.print();
+			}
+			if (!json_file.empty())
+				profile_report.write_json(json_file);
+		}
+
+		if (clear)
+			profile_clear();
+	}
+} ProfilePass;
+
+PRIVATE_NAMESPACE_END
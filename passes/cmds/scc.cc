@@ -24,6 +24,7 @@
 #include "kernel/yosys.h"
 #include "kernel/celltypes.h"
 #include "kernel/sigtools.h"
+#include "kernel/topo_scc.h"
 #include "kernel/log_help.h"
 
 USING_YOSYS_NAMESPACE
@@ -97,7 +98,7 @@ struct SccWorker
 		}
 	}
 
-	SccWorker(RTLIL::Design *design, RTLIL::Module *module, bool nofeedbackMode, bool allCellTypes, bool specifyMode, int maxDepth) :
+	SccWorker(RTLIL::Design *design, RTLIL::Module *module, bool nofeedbackMode, bool allCellTypes, bool specifyMode, int maxDepth, int numThreads) :
 			design(design), module(module), sigmap(module)
 	{
 		if (module->processes.size() > 0) {
@@ -212,6 +213,45 @@ struct SccWorker
 		labelCounter = 0;
 		cellLabels.clear();
 
+		if (maxDepth < 0)
+		{
+			// Without a depth limit these are just the strongly connected
+			// components of the cell graph, which parallel_sccs() finds
+			// without recursion and on multiple threads.
+			idict<RTLIL::Cell*> cellIds;
+			for (auto cell : workQueue)
+				cellIds(cell);
+
+			std::vector<std::pair<int, int>> edges;
+			for (auto cell : workQueue)
+				for (auto nextCell : cellToNextCell[cell])
+					edges.emplace_back(cellIds.at(cell), cellIds.at(nextCell));
+
+			std::vector<int> component;
+			int numComponents = parallel_sccs(CsrGraph(GetSize(cellIds), edges), component, numThreads);
+
+			std::vector<std::vector<RTLIL::Cell*>> componentCells(numComponents);
+			for (int i = 0; i < GetSize(cellIds); i++)
+				componentCells[component[i]].push_back(cellIds[i]);
+
+			for (auto &cells : componentCells)
+			{
+				if (GetSize(cells) < 2)
+					continue;
+				log("Found an SCC:");
+				pool<RTLIL::Cell*> scc;
+				for (auto c : cells) {
+					log(" %s", RTLIL::id2cstr(c->name));
+					cell2scc[c] = sccList.size();
+					scc.insert(c);
+				}
+				sccList.push_back(scc);
+				log("\n");
+			}
+
+			workQueue.clear();
+		}
+
 		while (!workQueue.empty())
 		{
 			RTLIL::Cell *cell = *workQueue.begin();
@@ -273,6 +313,10 @@ struct SccPass : public Pass {
 		log("        can e.g. be useful in identifying small local loops in a module that\n");
 		log("        implements one large SCC.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        use up to N threads for finding the SCCs. This is not used together\n");
+		log("        with -max_depth. (default: 1)\n");
+		log("\n");
 		log("    -nofeedback\n");
 		log("        do not count cells that have their output fed back into one of their\n");
 		log("        inputs as single-cell scc.\n");
@@ -304,6 +348,7 @@ struct SccPass : public Pass {
 		bool specifyMode = false;
 		int maxDepth = -1;
 		int expect = -1;
+		int numThreads = 1;
 
 		log_header(design, "Executing SCC pass (detecting logic loops).\n");
 
@@ -317,6 +362,12 @@ struct SccPass : public Pass {
 				expect = atoi(args[++argidx].c_str());
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				numThreads = atoi(args[++argidx].c_str());
+				if (numThreads < 1)
+					log_cmd_error("Invalid number of threads: %s\n", args[argidx]);
+				continue;
+			}
 			if (args[argidx] == "-nofeedback") {
 				nofeedbackMode = true;
 				continue;
@@ -348,7 +399,7 @@ struct SccPass : public Pass {
 
 		for (auto mod : design->selected_modules())
 		{
-			SccWorker worker(design, mod, nofeedbackMode, allCellTypes, specifyMode, maxDepth);
+			SccWorker worker(design, mod, nofeedbackMode, allCellTypes, specifyMode, maxDepth, numThreads);
 
 			if (!setAttr.empty())
 			{
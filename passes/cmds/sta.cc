@@ -21,8 +21,8 @@
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
 #include "kernel/timinginfo.h"
+#include "kernel/timinggraph.h"
 #include "kernel/log_help.h"
-#include <deque>
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -33,15 +33,19 @@ struct StaWorker
 	Module *module;
 	SigMap sigmap;
 
-	struct t_data {
-		Cell* driver;
-		IdString dst_port, src_port;
-		vector<tuple<SigBit,int,IdString>> fanouts;
-		SigBit backtrack;
-		t_data() : driver(nullptr) {}
+	TimingGraph graph;
+	dict<SigBit, int> bit_nodes;
+	std::vector<SigBit> node_bits;
+
+	struct t_driver {
+		Cell* cell;
+		IdString port;
+		t_driver() : cell(nullptr) {}
 	};
-	dict<SigBit, t_data> data;
-	std::deque<SigBit> queue;
+	std::vector<t_driver> drivers;
+	// source port of each edge, indexed by edge id
+	std::vector<IdString> edge_ports;
+
 	struct t_endpoint {
 		Cell *sink;
 		IdString port;
@@ -50,12 +54,28 @@ struct StaWorker
 	};
 	dict<SigBit, t_endpoint> endpoints;
 
-	int maxarrival;
-	SigBit maxbit;
-
 	pool<SigBit> driven;
 
-	StaWorker(RTLIL::Module *module) : design(module->design), module(module), sigmap(module), maxarrival(0)
+	int node(SigBit bit)
+	{
+		auto r = bit_nodes.insert(std::make_pair(bit, GetSize(node_bits)));
+		if (r.second) {
+			graph.add_node();
+			node_bits.push_back(bit);
+			drivers.emplace_back();
+		}
+		return r.first->second;
+	}
+
+	void add_edge(SigBit from, SigBit to, int delay, IdString port)
+	{
+		int edge = graph.add_edge(node(from), node(to), delay);
+		if (edge >= GetSize(edge_ports))
+			edge_ports.resize(edge + 1);
+		edge_ports[edge] = port;
+	}
+
+	StaWorker(RTLIL::Module *module) : design(module->design), module(module), sigmap(module)
 	{
 		TimingInfo timing;
 
@@ -113,9 +133,9 @@ struct StaWorker
 					}
 					if (cell->output(conn.first)) {
 						dst_bits.insert(std::make_pair(bit,namebit));
-						auto &d = data[bit];
-						d.driver = cell;
-						d.dst_port = conn.first;
+						auto &d = drivers[node(bit)];
+						d.cell = cell;
+						d.port = conn.first;
 						driven.insert(bit);
 
 						auto it = t.arrival.find(namebit);
@@ -125,7 +145,7 @@ struct StaWorker
 						if (cell->hasPort(s.name)) {
 							auto s_bit = sigmap(cell->getPort(s.name)[s.offset]);
 							if (s_bit.wire)
-								data[s_bit].fanouts.emplace_back(bit,it->second.first,s.name);
+								add_edge(s_bit, bit, it->second.first, s.name);
 						}
 					}
 				}
@@ -136,18 +156,18 @@ struct StaWorker
 					auto it = t.comb.find(TimingInfo::BitBit(s.second,d.second));
 					if (it == t.comb.end())
 						continue;
-					data[s.first].fanouts.emplace_back(d.first,it->second,s.second.name);
+					add_edge(s.first, d.first, it->second, s.second.name);
 				}
 		}
 
 		for (auto port_name : module->ports) {
 			auto wire = module->wire(port_name);
 			if (wire->port_input) {
+				// All primary inputs to arrive at time zero
 				for (const auto &b : sigmap(wire)) {
-					queue.emplace_back(b);
+					graph.set_launch(node(b), 0);
 					driven.insert(b);
 				}
-				// All primary inputs to arrive at time zero
 				wire->set_intvec_attribute(ID::sta_arrival, std::vector<int>(GetSize(wire), 0));
 			}
 			if (wire->port_output)
@@ -155,76 +175,75 @@ struct StaWorker
 					if (b.wire)
 						endpoints.insert(b);
 		}
-	}
 
-	void run()
-	{
-		while (!queue.empty()) {
-			auto b = queue.front();
-			queue.pop_front();
-			auto it = data.find(b);
-			if (it == data.end())
+		// Paths end in the recognised endpoints, and in any bit without
+		// fanout so that the critical path is found even if it doesn't
+		// terminate in one.
+		for (int i = 0; i < graph.num_nodes(); i++) {
+			if (graph.fanin(i).empty())
 				continue;
-			const auto& src_arrivals = b.wire->get_intvec_attribute(ID::sta_arrival);
-			log_assert(GetSize(src_arrivals) == GetSize(b.wire));
-			auto src_arrival = src_arrivals[b.offset];
-			for (const auto &d : it->second.fanouts) {
-				const auto &dst_bit = std::get<0>(d);
-				auto dst_arrivals = dst_bit.wire->get_intvec_attribute(ID::sta_arrival);
-				if (dst_arrivals.empty())
-					dst_arrivals = std::vector<int>(GetSize(dst_bit.wire), -1);
-				else
-					log_assert(GetSize(dst_arrivals) == GetSize(dst_bit.wire));
-				auto &dst_arrival = dst_arrivals[dst_bit.offset];
-				auto new_arrival = src_arrival + std::get<1>(d);
-				if (dst_arrival < new_arrival) {
-					auto dst_wire = dst_bit.wire;
-					dst_arrival = std::max(dst_arrival, new_arrival);
-					dst_wire->set_intvec_attribute(ID::sta_arrival, dst_arrivals);
-					queue.emplace_back(dst_bit);
-
-					data[dst_bit].backtrack = b;
-					data[dst_bit].src_port = std::get<2>(d);
-
-					auto it = endpoints.find(dst_bit);
-					if (it != endpoints.end())
-						new_arrival += it->second.required;
-					if (new_arrival > maxarrival && driven.count(b)) {
-						maxarrival = new_arrival;
-						maxbit = dst_bit;
-					}
-				}
-			}
-		}
-
-		auto b = maxbit;
-		if (b == SigBit()) {
-			log("No timing paths found.\n");
-			return;
+			auto it = endpoints.find(node_bits[i]);
+			if (it != endpoints.end())
+				graph.set_capture(i, it->second.required);
+			else if (graph.fanout(i).empty())
+				graph.set_capture(i, 0);
 		}
+	}
 
-		log("Latest arrival time in '%s' is %d:\n", log_id(module), maxarrival);
-		auto it = endpoints.find(maxbit);
+	void report_path(const TimingGraph::Path &path, bool critical)
+	{
+		auto b = node_bits[path.nodes.back()];
+		auto it = endpoints.find(b);
 		if (it != endpoints.end() && it->second.sink)
-			log("  %6d %s (%s.%s)\n", maxarrival, log_id(it->second.sink), log_id(it->second.sink->type), log_id(it->second.port));
+			log("  %6d %s (%s.%s)\n", path.time, log_id(it->second.sink), log_id(it->second.sink->type), log_id(it->second.port));
 		else {
-			log("  %6d (%s)\n", maxarrival, b.wire->port_output ? "<primary output>" : "<unknown>");
-			if (!b.wire->port_output)
+			log("  %6d (%s)\n", path.time, b.wire->port_output ? "<primary output>" : "<unknown>");
+			if (!b.wire->port_output && critical)
 				log_warning("Critical-path does not terminate in a recognised endpoint.\n");
 		}
-		auto jt = data.find(b);
-		while (jt != data.end()) {
-			int arrival = b.wire->get_intvec_attribute(ID::sta_arrival)[b.offset];
-			if (jt->second.driver) {
+		for (int i = GetSize(path.nodes) - 1; i >= 0; i--) {
+			b = node_bits[path.nodes[i]];
+			const auto &d = drivers[path.nodes[i]];
+			if (i > 0) {
+				log_assert(d.cell);
 				log("           %s\n", log_signal(b));
-				log("  %6d %s (%s.%s->%s)\n", arrival, log_id(jt->second.driver), log_id(jt->second.driver->type), log_id(jt->second.src_port), log_id(jt->second.dst_port));
+				log("  %6d %s (%s.%s->%s)\n", path.times[i], log_id(d.cell), log_id(d.cell->type), log_id(edge_ports[path.edges[i-1]]), log_id(d.port));
 			}
 			else if (b.wire->port_input)
-				log("  %6d   %s (%s)\n", arrival, log_signal(b), "<primary input>");
+				log("  %6d   %s (%s)\n", path.times[i], log_signal(b), "<primary input>");
 			else
 				log_abort();
-			b = jt->second.backtrack;
-			jt = data.find(b);
+		}
+	}
+
+	void run(int num_paths)
+	{
+		if (!graph.update())
+			log_error("Module '%s' contains combinational loops.\n", log_id(module));
+
+		for (int i = 0; i < graph.num_nodes(); i++) {
+			if (graph.fanin(i).empty() || graph.arrival(i) == TimingGraph::NONE)
+				continue;
+			auto b = node_bits[i];
+			auto arrivals = b.wire->get_intvec_attribute(ID::sta_arrival);
+			if (arrivals.empty())
+				arrivals = std::vector<int>(GetSize(b.wire), -1);
+			arrivals[b.offset] = graph.arrival(i);
+			b.wire->set_intvec_attribute(ID::sta_arrival, arrivals);
+		}
+
+		auto paths = graph.worst_paths(num_paths);
+		if (paths.empty()) {
+			log("No timing paths found.\n");
+			return;
+		}
+
+		for (int i = 0; i < GetSize(paths); i++) {
+			if (i == 0)
+				log("Latest arrival time in '%s' is %d:\n", log_id(module), paths[i].time);
+			else
+				log("\nPath %d in '%s' arrives at %d:\n", i + 1, log_id(module), paths[i].time);
+			report_path(paths[i], i == 0);
 		}
 
 		std::map<int, unsigned> arrival_histogram;
@@ -233,17 +252,13 @@ struct StaWorker
 			if (!driven.count(b))
 				continue;
 
-			if (!b.wire->attributes.count(ID::sta_arrival)) {
+			auto it = bit_nodes.find(b);
+			if (it == bit_nodes.end() || graph.arrival(it->second) == TimingGraph::NONE) {
 				log_warning("Endpoint %s.%s has no (* sta_arrival *) value.\n", log_id(module), log_signal(b));
 				continue;
 			}
 
-			auto arrival = b.wire->get_intvec_attribute(ID::sta_arrival)[b.offset];
-			if (arrival < 0) {
-				log_warning("Endpoint %s.%s has no (* sta_arrival *) value.\n", log_id(module), log_signal(b));
-				continue;
-			}
-			arrival += i.second.required;
+			auto arrival = graph.arrival(it->second) + i.second.required;
 			arrival_histogram[arrival]++;
 		}
 		// Adapted from https://github.com/YosysHQ/nextpnr/blob/affb12cc27ebf409eade062c4c59bb98569d8147/common/timing.cc#L946-L969
@@ -290,22 +305,28 @@ struct StaPass : public Pass {
 		log("This command performs static timing analysis on the design. (Only considers\n");
 		log("paths within a single module, so the design must be flattened.)\n");
 		log("\n");
+		log("    -paths <n>\n");
+		log("        report the <n> paths that end the latest instead of only the critical\n");
+		log("        path. (default: 1)\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, RTLIL::Design *design) override
 	{
 		log_header(design, "Executing STA pass (static timing analysis).\n");
 
-		/*
+		int num_paths = 1;
+
 		size_t argidx;
 		for (argidx = 1; argidx < args.size(); argidx++) {
-			if (args[argidx] == "-TODO") {
+			if (args[argidx] == "-paths" && argidx+1 < args.size()) {
+				num_paths = atoi(args[++argidx].c_str());
+				if (num_paths < 1)
+					log_cmd_error("The -paths option requires a positive number.\n");
 				continue;
 			}
 			break;
 		}
-		*/
-
-		extra_args(args, 1, design);
+		extra_args(args, argidx, design);
 
 		for (Module *module : design->selected_modules())
 		{
@@ -313,7 +334,7 @@ struct StaPass : public Pass {
 				continue;
 
 			StaWorker worker(module);
-			worker.run();
+			worker.run(num_paths);
 		}
 	}
 } StaPass;
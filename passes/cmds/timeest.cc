@@ -20,21 +20,17 @@
 #include "kernel/sigtools.h"
 #include "kernel/register.h"
 #include "kernel/cellaigs.h"
-#include "kernel/utils.h"
 #include "kernel/ff.h"
 #include "kernel/mem.h"
+#include "kernel/timinggraph.h"
 
 #include <assert.h>
-#include <limits>
 
 USING_YOSYS_NAMESPACE
 template<> struct Yosys::hashlib::hash_ops<AigNode *> : Yosys::hashlib::hash_ptr_ops {};
 
 PRIVATE_NAMESPACE_BEGIN
 
-typedef long int arrivalint;
-const arrivalint INF_PAST = std::numeric_limits<arrivalint>::min();
-
 // each clock domain must have its own EstimateSta structure
 struct EstimateSta {
 	SigMap sigmap;
@@ -151,167 +147,119 @@ struct EstimateSta {
 			}
 		}
 
-		// now we toposort the combinational logic
+		// now we build the timing graph of the combinational logic
 
-		// each toposort node is either a SigBit or a pair of Cell * / AigNode *
-		TopoSort<std::tuple<SigBit, Cell *, AigNode *>> topo;
+		// each graph node is either a SigBit or a pair of Cell * / AigNode *
+		TimingGraph graph;
+		dict<std::tuple<SigBit, Cell *, AigNode *>, int> node_ids;
+		std::vector<std::tuple<SigBit, Cell *, AigNode *>> nodes;
 
+		auto node_id = [&](const std::tuple<SigBit, Cell *, AigNode *> &node) {
+			auto r = node_ids.insert(std::make_pair(node, GetSize(nodes)));
+			if (r.second) {
+				graph.add_node();
+				nodes.push_back(node);
+			}
+			return r.first->second;
+		};
 		auto desc_aig = [&](Cell *cell, AigNode &node) {
-			return std::make_tuple(RTLIL::S0, cell, &node);
+			return node_id(std::make_tuple(RTLIL::S0, cell, &node));
 		};
 		auto desc_sig = [&](SigBit bit) {
-			return std::make_tuple(sigmap(bit), (Cell *) NULL, (AigNode *) NULL);
+			return node_id(std::make_tuple(sigmap(bit), (Cell *) NULL, (AigNode *) NULL));
 		};
 
-		// collect edges of the AIG graph
+		// collect edges of the AIG graph, an AND node takes a cell-specific
+		// delay after the later of its parents
 		for (auto cell : combinational) {
 			assert(cell_aigs.count(cell));
 			Aig &aig = *cell_aigs.at(cell);
+			int delay = cell_type_factor(cell->type);
 			for (auto &node : aig.nodes) {
 				if (!node.portname.empty()) {
-					topo.edge(
+					graph.add_edge(
 						desc_sig(cell->getPort(node.portname)[node.portbit]),
-						desc_aig(cell, node)
+						desc_aig(cell, node), 0
 					);
 				} else if (node.left_parent < 0 && node.right_parent < 0) {
 					// constant, nothing to do
 				} else {
-					topo.edge(
+					graph.add_edge(
 						desc_aig(cell, aig.nodes[node.left_parent]),
-						desc_aig(cell, node)
+						desc_aig(cell, node), delay
 					);
-					topo.edge(
+					graph.add_edge(
 						desc_aig(cell, aig.nodes[node.right_parent]),
-						desc_aig(cell, node)
+						desc_aig(cell, node), delay
 					);
 				}
 
 				for (auto &oport : node.outports) {
-					topo.edge(
+					graph.add_edge(
 						desc_aig(cell, node),
-						desc_sig(cell->getPort(oport.first)[oport.second])
+						desc_sig(cell->getPort(oport.first)[oport.second]), 0
 					);
 				}
 			}
 		}
 
-		if (!topo.sort())
-			log_error("Module '%s' contains combinational loops", log_id(m));
-		
-		// now we determine how long it takes for signals to stabilize
-		
-		// `levels` records the time after a clock edge after which a signal is stable
-		dict<std::tuple<SigBit, Cell *, AigNode *>, arrivalint> levels;
-
-		for (auto node : topo.sorted)
-			levels[node] = INF_PAST;
-
-		// launch points are at 0 by definition
+		// launch points are at 0 by definition, and paths end in the
+		// sample points
 		for (auto pair : launchers)
-			levels[desc_sig(pair.second)] = 0;
+			graph.set_launch(desc_sig(pair.second), 0);
+		for (auto pair : samplers)
+			graph.set_capture(desc_sig(pair.second), 0);
 
-		for (auto node : topo.sorted) {
-			AigNode *aig_node = std::get<2>(node);
-			if (aig_node) {
-				Cell *cell = std::get<1>(node);
-				Aig &aig = *cell_aigs.at(cell);
-				if (!aig_node->portname.empty()) {
-					// for a cell port, copy `levels` value from port bit
-					SigBit bit = cell->getPort(aig_node->portname)[aig_node->portbit];
-					levels[node] = levels[desc_sig(bit)];
-				} else if (aig_node->left_parent < 0 && aig_node->right_parent < 0) {
-					// constant, nothing to do
-				} else {
-					// for each AIG node, find maximum of parents and add a cell-specific delay
-					int left = levels[desc_aig(cell, aig.nodes[aig_node->left_parent])];
-					int right = levels[desc_aig(cell, aig.nodes[aig_node->right_parent])];
-					levels[node] = (std::max(left, right) + cell_type_factor(cell->type));
-				}
+		// now we determine how long it takes for signals to stabilize
+		if (!graph.update())
+			log_error("Module '%s' contains combinational loops", log_id(m));
 
-				// copy `levels` value to any output ports
-				for (auto &oport : aig_node->outports) {
-					levels[desc_sig(cell->getPort(oport.first)[oport.second])] = levels[node];
-				}
+		// now find the length of the critical path (slowest path in the design)
+		int crit = TimingGraph::NONE;
+		int crit_sampler = -1;
+		for (auto pair : samplers) {
+			int node = desc_sig(pair.second);
+			if (graph.arrival(node) > crit) {
+				crit = graph.arrival(node);
+				crit_sampler = node;
 			}
 		}
 
-		// now find the length of the critical path (slowest path in the design)
-		arrivalint crit = INF_PAST;
-		for (auto pair : samplers)
-			if (levels[desc_sig(pair.second)] > crit)
-				crit = levels[desc_sig(pair.second)];
-
 		if (crit < 0) {
 			log("No paths found\n");
 			return;
 		}
 
-		log("Critical path is %ld nodes long:\n\n", crit);
-
-		// we use dict instead of pool because dict gives us
-		// some compile-time errors related to hashing
-		dict<std::tuple<SigBit, Cell *, AigNode *>, bool> critical;
+		log("Critical path is %d nodes long:\n\n", crit);
 
 		// actually find one critical path, or all such paths if requested
-		for (auto pair : samplers) {
-			if (levels[desc_sig(pair.second)] == crit) {
-				critical[desc_sig(pair.second)] = true;
-				if (!all_paths)
-					break;
-			}
+		std::vector<bool> critical(graph.num_nodes());
+		if (all_paths) {
+			for (int node = 0; node < graph.num_nodes(); node++)
+				if (graph.arrival(node) != TimingGraph::NONE && graph.departure(node) != TimingGraph::NONE &&
+						graph.arrival(node) + graph.departure(node) == crit)
+					critical[node] = true;
+		} else {
+			for (int node : graph.critical_path(crit_sampler).nodes)
+				critical[node] = true;
 		}
 
-		// walk backwards through toposorted nodes and set critical flag on nodes in critical path
-		for (auto it = topo.sorted.rbegin(); it != topo.sorted.rend(); it++) {
-			auto node = *it;
-			AigNode *aig_node = std::get<2>(node);
-			if (aig_node) {
-				Cell *cell = std::get<1>(node);
-				Aig &aig = *cell_aigs.at(cell);
-
-				for (auto &oport : aig_node->outports) {
-					if (critical.count(desc_sig(cell->getPort(oport.first)[oport.second])))
-						critical[node] = true;
-				}
-
-				if (!aig_node->portname.empty()) {
-					SigBit bit = cell->getPort(aig_node->portname)[aig_node->portbit];
-					if (critical.count(node))
-						critical[desc_sig(bit)] = true;
-				} else if (aig_node->left_parent < 0 && aig_node->right_parent < 0) {
-					// constant, nothing to do
-				} else {
-					// figure out which parent is on the critical path
-					auto left = desc_aig(cell, aig.nodes[aig_node->left_parent]);
-					auto right = desc_aig(cell, aig.nodes[aig_node->right_parent]);
-					int crit_input_lvl = levels[node] - cell_type_factor(cell->type);
-					if (critical.count(node)) {
-						bool left_critical = (levels[left] == crit_input_lvl);
-						bool right_critical = (levels[right] == crit_input_lvl);
-						if (all_paths) {
-							if (left_critical)
-								critical[left] = true;
-							if (right_critical)
-								critical[right] = true;
-						} else {
-							if (left_critical)
-								critical[left] = true;
-							else if (right_critical)
-								critical[right] = true;
-						}
-					}
-				}
-			}
-		}
+		// order the nodes so that the path is printed from launch to sample
+		std::vector<int> order;
+		for (int node = 0; node < graph.num_nodes(); node++)
+			if (critical[node])
+				order.push_back(node);
+		std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+			return graph.level(a) < graph.level(b);
+		});
 
 		// finally print the path we found
 		SigPool bits_to_select;
 		pool<IdString> to_select;
 
 		pool<Cell *> printed;
-		for (auto node : topo.sorted) {
-			if (!critical.count(node))
-				continue;
+		for (int id : order) {
+			auto node = nodes[id];
 			AigNode *aig_node = std::get<2>(node);
 			if (aig_node) {
 				Cell *cell = std::get<1>(node);
@@ -333,7 +281,7 @@ struct EstimateSta {
 					std::string src_attr = bit.wire->get_src_attribute();
 					wire_src = stringf(" source: %s", src_attr);
 				}
-				log("    wire %s%s (level %ld)\n", log_signal(bit), wire_src, levels[node]);
+				log("    wire %s%s (level %d)\n", log_signal(bit), wire_src, graph.arrival(id));
 			}
 		}
 
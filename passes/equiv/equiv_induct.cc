@@ -20,6 +20,7 @@
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
 #include "kernel/sigtools.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -38,13 +39,14 @@ struct EquivInductWorker
 	int max_seq;
 	int success_counter;
 	bool set_assumes;
+	int num_threads = 1;
 
 	dict<int, int> ez_step_is_consistent;
 	pool<Cell*> cell_warn_cache;
 	SigPool undriven_signals;
 
-	EquivInductWorker(Module *module, const pool<Cell*> &unproven_equiv_cells, bool model_undef, int max_seq, bool set_assumes) : module(module), sigmap(module),
-			cells(module->selected_cells()), workset(unproven_equiv_cells),
+	EquivInductWorker(Module *module, const vector<Cell*> &cells, const pool<Cell*> &unproven_equiv_cells, bool model_undef, int max_seq, bool set_assumes) :
+			module(module), sigmap(module), cells(cells), workset(unproven_equiv_cells),
 			satgen(ez.get(), &sigmap), max_seq(max_seq), success_counter(0), set_assumes(set_assumes)
 	{
 		satgen.model_undef = model_undef;
@@ -97,28 +99,117 @@ struct EquivInductWorker
 		ez_step_is_consistent[step] = ez->expression(ez->OpAnd, ez_equal_terms);
 	}
 
+	void find_undriven_signals()
+	{
+		for (auto cell : cells)
+			if (yosys_celltypes.cell_known(cell->type))
+				for (auto &conn : cell->connections())
+					if (yosys_celltypes.cell_input(cell->type, conn.first))
+						undriven_signals.add(sigmap(conn.second));
+		for (auto cell : cells)
+			if (yosys_celltypes.cell_known(cell->type))
+				for (auto &conn : cell->connections())
+					if (yosys_celltypes.cell_output(cell->type, conn.first))
+						undriven_signals.del(sigmap(conn.second));
+	}
+
+	void force_def_initial_state()
+	{
+		for (auto bit : satgen.initial_state.export_all())
+			ez->assume(ez->NOT(satgen.importUndefSigBit(bit, 1)));
+	}
+
+	// Builds the same problem that run() has built when the induction
+	// fails, for proving individual cells on another solver.
+	void create_model()
+	{
+		if (satgen.model_undef)
+			find_undriven_signals();
+		create_timestep(1);
+		if (satgen.model_undef)
+			force_def_initial_state();
+		for (int step = 1; step <= max_seq; step++) {
+			ez->assume(ez_step_is_consistent[step]);
+			create_timestep(step+1);
+		}
+	}
+
+	bool prove_cell(Cell *cell)
+	{
+		SigBit bit_a = sigmap(cell->getPort(ID::A)).as_bit();
+		SigBit bit_b = sigmap(cell->getPort(ID::B)).as_bit();
+
+		int ez_a = satgen.importSigBit(bit_a, max_seq+1);
+		int ez_b = satgen.importSigBit(bit_b, max_seq+1);
+		int cond = ez->XOR(ez_a, ez_b);
+
+		if (satgen.model_undef)
+			cond = ez->AND(cond, ez->NOT(satgen.importUndefSigBit(bit_a, max_seq+1)));
+
+		return !ez->solve(cond);
+	}
+
+	// Proves the cells on worker threads, each with its own model and
+	// solver. Returns false when that isn't possible.
+	bool prove_cells_parallel(const vector<Cell*> &list, vector<bool> &proven)
+	{
+		int num_workers = ThreadPool::pool_size(0, std::min(num_threads, GetSize(list)));
+		if (num_workers < 2)
+			return false;
+
+		vector<std::unique_ptr<EquivInductWorker>> workers;
+		for (int i = 0; i < num_workers; i++)
+			workers.emplace_back(new EquivInductWorker(module, cells, {}, satgen.model_undef, max_seq, set_assumes));
+
+		ConcurrentQueue<int> work_queue;
+		for (int i = 0; i < GetSize(list); i++)
+			work_queue.push_back(i);
+		work_queue.close();
+
+		vector<char> results(GetSize(list));
+		vector<DeferredLogs> logs(num_workers);
+		vector<std::exception_ptr> exceptions(num_workers);
+		{
+			RTLIL::IdString::ConcurrentScope id_scope;
+			ThreadPool worker_threads(num_workers, [&](int thread) {
+				log_deferred = &logs[thread];
+				try {
+					EquivInductWorker &worker = *workers[thread];
+					worker.create_model();
+					// the messages of building the model were already logged by run()
+					logs[thread] = DeferredLogs();
+					while (std::optional<int> index = work_queue.pop_front())
+						results[*index] = worker.prove_cell(list[*index]);
+				} catch (const log_deferred_error_exception &) {
+					// the error message is in logs[thread] and raised again by flush()
+				} catch (...) {
+					exceptions[thread] = std::current_exception();
+				}
+				log_deferred = nullptr;
+			});
+		}
+
+		for (int i = 0; i < num_workers; i++) {
+			logs[i].flush();
+			if (exceptions[i])
+				std::rethrow_exception(exceptions[i]);
+		}
+
+		proven.assign(results.begin(), results.end());
+		return true;
+	}
+
 	void run()
 	{
 		log("Found %d unproven $equiv cells in module %s:\n", GetSize(workset), log_id(module));
 
-		if (satgen.model_undef) {
-			for (auto cell : cells)
-				if (yosys_celltypes.cell_known(cell->type))
-					for (auto &conn : cell->connections())
-						if (yosys_celltypes.cell_input(cell->type, conn.first))
-							undriven_signals.add(sigmap(conn.second));
-			for (auto cell : cells)
-				if (yosys_celltypes.cell_known(cell->type))
-					for (auto &conn : cell->connections())
-						if (yosys_celltypes.cell_output(cell->type, conn.first))
-							undriven_signals.del(sigmap(conn.second));
-		}
+		if (satgen.model_undef)
+			find_undriven_signals();
 
 		create_timestep(1);
 
 		if (satgen.model_undef) {
-			for (auto bit : satgen.initial_state.export_all())
-				ez->assume(ez->NOT(satgen.importUndefSigBit(bit, 1)));
+			force_def_initial_state();
 			log("  Undef modelling: force def on %d initial reg values and %d inputs.\n",
 				GetSize(satgen.initial_state), GetSize(undriven_signals));
 		}
@@ -151,21 +242,16 @@ struct EquivInductWorker
 
 		workset.sort();
 
-		for (auto cell : workset)
-		{
-			SigBit bit_a = sigmap(cell->getPort(ID::A)).as_bit();
-			SigBit bit_b = sigmap(cell->getPort(ID::B)).as_bit();
+		vector<Cell*> list(workset.begin(), workset.end());
+		vector<bool> proven;
+		bool parallel = prove_cells_parallel(list, proven);
 
+		for (int i = 0; i < GetSize(list); i++)
+		{
+			Cell *cell = list[i];
 			log("  Trying to prove $equiv for %s:", log_signal(sigmap(cell->getPort(ID::Y))));
 
-			int ez_a = satgen.importSigBit(bit_a, max_seq+1);
-			int ez_b = satgen.importSigBit(bit_b, max_seq+1);
-			int cond = ez->XOR(ez_a, ez_b);
-
-			if (satgen.model_undef)
-				cond = ez->AND(cond, ez->NOT(satgen.importUndefSigBit(bit_a, max_seq+1)));
-
-			if (!ez->solve(cond)) {
+			if (parallel ? proven[i] : prove_cell(cell)) {
 				log(" success!\n");
 				cell->setPort(ID::B, cell->getPort(ID::A));
 				success_counter++;
@@ -198,6 +284,11 @@ struct EquivInductPass : public Pass {
 		log("    -set-assumes\n");
 		log("        set all assumptions provided via $assume cells\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        when the induction fails for the whole set, prove the individual\n");
+		log("        $equiv cells on up to N threads. Each thread builds its own copy of\n");
+		log("        the model and SAT solver.\n");
+		log("\n");
 		log("This command is very effective in proving complex sequential circuits, when\n");
 		log("the internal state of the circuit quickly propagates to $equiv cells.\n");
 		log("\n");
@@ -216,6 +307,7 @@ struct EquivInductPass : public Pass {
 		int success_counter = 0;
 		bool model_undef = false, set_assumes = false;
 		int max_seq = 4;
+		int num_threads = 1;
 
 		log_header(design, "Executing EQUIV_INDUCT pass.\n");
 
@@ -233,6 +325,12 @@ struct EquivInductPass : public Pass {
 				set_assumes = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads `%s'.\n", args[argidx]);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -253,7 +351,8 @@ struct EquivInductPass : public Pass {
 				continue;
 			}
 
-			EquivInductWorker worker(module, unproven_equiv_cells, model_undef, max_seq, set_assumes);
+			EquivInductWorker worker(module, module->selected_cells(), unproven_equiv_cells, model_undef, max_seq, set_assumes);
+			worker.num_threads = num_threads;
 			worker.run();
 			success_counter += worker.success_counter;
 		}
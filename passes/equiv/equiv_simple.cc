@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/satgen.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -39,7 +40,7 @@ struct EquivSimpleWorker
 
 	struct DesignModel {
 		const SigMap &sigmap;
-		dict<SigBit, Cell*> &bit2driver;
+		const dict<SigBit, Cell*> &bit2driver;
 	};
 	DesignModel model;
 
@@ -58,6 +59,10 @@ struct EquivSimpleWorker
 
 	pool<pair<Cell*, int>> imported_cells_cache;
 
+	// When set, proven cells are collected here instead of being shorted
+	// right away, since other workers may be reading the module.
+	vector<Cell*> *proven_cells = nullptr;
+
 	EquivSimpleWorker(const vector<Cell*> &equiv_cells, const vector<Cell*> &assume_cells, DesignModel model, Config cfg) :
 			module(equiv_cells.front()->module), equiv_cells(equiv_cells), assume_cells(assume_cells),
 			model(model), satgen(ez.get(), &model.sigmap), cfg(cfg)
@@ -333,7 +338,10 @@ struct EquivSimpleWorker
 			if (!ez->solve(ez_context)) {
 				log("%s", cfg.verbose ? "    Proved equivalence! Marking $equiv cell as proven.\n" : " success!\n");
 				// Replace $equiv cell with a short
-				cell->setPort(ID::B, cell->getPort(ID::A));
+				if (proven_cells != nullptr)
+					proven_cells->push_back(cell);
+				else
+					cell->setPort(ID::B, cell->getPort(ID::A));
 				ez->assume(ez->NOT(ez_context));
 				return true;
 			}
@@ -433,11 +441,71 @@ struct EquivSimplePass : public Pass {
 		log("    -set-assumes\n");
 		log("        set all assumptions provided via $assume cells\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        prove the groups of $equiv cells on up to N threads, each with its own\n");
+		log("        SAT solver. The cells proven in a module are only shorted after all of\n");
+		log("        its groups are done, so the problem sizes reported with -v may differ\n");
+		log("        from a single-threaded run. The proven cells are the same.\n");
+		log("\n");
 	}
+
+	struct Task {
+		vector<Cell*> cells;
+		DeferredLogs logs;
+		vector<Cell*> proven_cells;
+		int success_counter = 0;
+		std::exception_ptr exception;
+	};
+
+	// Proves the groups on worker threads, each with its own copy of the
+	// sigmap, then replays the logs and applies the results in order.
+	int run_parallel(std::vector<Task> &tasks, const SigMap &sigmap, const dict<SigBit, Cell*> &bit2driver,
+			const vector<Cell*> &assumes, const EquivSimpleWorker::Config &cfg, int num_workers)
+	{
+		ConcurrentQueue<int> work_queue;
+		for (int i = 0; i < GetSize(tasks); i++)
+			work_queue.push_back(i);
+		work_queue.close();
+
+		std::vector<SigMap> sigmaps(num_workers, sigmap);
+		{
+			RTLIL::IdString::ConcurrentScope id_scope;
+			ThreadPool worker_threads(num_workers, [&](int thread) {
+				while (std::optional<int> index = work_queue.pop_front()) {
+					Task &task = tasks[*index];
+					log_deferred = &task.logs;
+					try {
+						EquivSimpleWorker::DesignModel model {sigmaps[thread], bit2driver};
+						EquivSimpleWorker worker(task.cells, assumes, model, cfg);
+						worker.proven_cells = &task.proven_cells;
+						task.success_counter = worker.run();
+					} catch (const log_deferred_error_exception &) {
+						// raised again by task.logs.flush()
+					} catch (...) {
+						task.exception = std::current_exception();
+					}
+					log_deferred = nullptr;
+				}
+			});
+		}
+
+		int success_counter = 0;
+		for (auto &task : tasks) {
+			task.logs.flush();
+			if (task.exception)
+				std::rethrow_exception(task.exception);
+			for (auto cell : task.proven_cells)
+				cell->setPort(ID::B, cell->getPort(ID::A));
+			success_counter += task.success_counter;
+		}
+		return success_counter;
+	}
+
 	void execute(std::vector<std::string> args, Design *design) override
 	{
 		EquivSimpleWorker::Config cfg = {};
 		int success_counter = 0;
+		int num_threads = 1;
 
 		log_header(design, "Executing EQUIV_SIMPLE pass.\n");
 
@@ -467,6 +535,12 @@ struct EquivSimplePass : public Pass {
 				cfg.set_assumes = true;
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads `%s'.\n", args[argidx]);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -514,16 +588,26 @@ struct EquivSimplePass : public Pass {
 			}
 
 			unproven_equiv_cells.sort();
+			std::vector<Task> tasks(GetSize(unproven_equiv_cells));
+			int task_index = 0;
 			for (auto [_, d] : unproven_equiv_cells)
 			{
 				d.sort();
-
-				vector<Cell*> cells;
 				for (auto [_, cell] : d)
-					cells.push_back(cell);
+					tasks[task_index].cells.push_back(cell);
+				task_index++;
+			}
+
+			int num_workers = ThreadPool::pool_size(0, std::min(num_threads, GetSize(tasks)));
+			if (num_workers > 1) {
+				success_counter += run_parallel(tasks, sigmap, bit2driver, assumes, cfg, num_workers);
+				continue;
+			}
 
+			for (auto &task : tasks)
+			{
 				EquivSimpleWorker::DesignModel model {sigmap, bit2driver};
-				EquivSimpleWorker worker(cells, assumes, model, cfg);
+				EquivSimpleWorker worker(task.cells, assumes, model, cfg);
 				success_counter += worker.run();
 			}
 		}
@@ -19,6 +19,7 @@
 
 #include "kernel/yosys.h"
 #include "kernel/sigtools.h"
+#include "kernel/bitsim.h"
 
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
@@ -30,6 +31,7 @@ struct EquivStructWorker
 	SigMap equiv_bits;
 	bool mode_fwd;
 	bool mode_icells;
+	bool mode_sim;
 	int merge_count;
 
 	const pool<IdString> &fwonly_cells;
@@ -58,6 +60,104 @@ struct EquivStructWorker
 	dict<merge_key_t, pool<IdString>> merge_cache;
 	pool<merge_key_t> fwd_merge_cache, bwd_merge_cache;
 
+	// Random simulation of the module as it was before the first merge in
+	// this iteration. Bits that depend on FF outputs, undef constants or
+	// cells without a simulation model are "tainted": their simulated
+	// values may differ even if the gold and gate circuits are equivalent.
+	std::unique_ptr<BitSim> sim;
+	dict<SigBit, bool> sim_tainted;
+
+	bool sim_taint(SigBit bit, const dict<SigBit, Cell*> &drivers, const pool<SigBit> &state_bits)
+	{
+		if (bit.wire == nullptr)
+			return bit.data != State::S0 && bit.data != State::S1;
+
+		auto it = sim_tainted.find(bit);
+		if (it != sim_tainted.end())
+			return it->second;
+
+		bool tainted = false;
+		if (state_bits.count(bit)) {
+			tainted = true;
+		} else if (drivers.count(bit)) {
+			Cell *cell = drivers.at(bit);
+			if (sim->unsupported_cells.count(cell) || sim->loop_cells.count(cell)) {
+				tainted = true;
+			} else {
+				for (auto &conn : cell->connections())
+					if (!cell->output(conn.first))
+						for (auto input_bit : sim->sigmap(conn.second))
+							if (sim_taint(input_bit, drivers, state_bits)) {
+								tainted = true;
+								break;
+							}
+			}
+		}
+
+		sim_tainted[bit] = tainted;
+		return tainted;
+	}
+
+	void sim_setup()
+	{
+		sim.reset(new BitSim(module, 256));
+		uint64_t rng = 0;
+		sim->randomize(rng);
+		sim->run();
+
+		dict<SigBit, Cell*> drivers;
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections())
+				if (cell->output(conn.first))
+					for (auto bit : sim->sigmap(conn.second))
+						if (bit.wire != nullptr)
+							drivers[bit] = cell;
+
+		pool<SigBit> state_bits(sim->state_bits().begin(), sim->state_bits().end());
+		for (auto wire : module->wires())
+			for (auto bit : sim->sigmap(wire))
+				sim_taint(bit, drivers, state_bits);
+	}
+
+	bool sim_checked(SigBit bit)
+	{
+		if (bit.wire == nullptr)
+			return bit.data == State::S0 || bit.data == State::S1;
+		// bits that were added by earlier merges aren't simulated
+		auto it = sim_tainted.find(bit);
+		return it != sim_tainted.end() && !it->second;
+	}
+
+	// Returns true if the $equiv cells that merging the two cells would add
+	// for their inputs can't hold, because the inputs have different values
+	// in simulation.
+	bool sim_refutes(Cell *cell_a, Cell *cell_b)
+	{
+		if (sim == nullptr)
+			sim_setup();
+
+		int words = sim->lanes() / 64;
+		for (auto &port_a : cell_a->connections())
+		{
+			if (cell_a->output(port_a.first))
+				continue;
+
+			SigSpec bits_a = sim->sigmap(port_a.second);
+			SigSpec bits_b = sim->sigmap(cell_b->getPort(port_a.first));
+
+			for (int i = 0; i < GetSize(bits_a); i++) {
+				SigBit bit_a = bits_a[i], bit_b = bits_b[i];
+				if (bit_a == bit_b || !sim_checked(bit_a) || !sim_checked(bit_b))
+					continue;
+				const BitSim::word_t *data_a = sim->data(bit_a), *data_b = sim->data(bit_b);
+				for (int k = 0; k < words; k++)
+					if (data_a[k] != data_b[k])
+						return true;
+			}
+		}
+		return false;
+	}
+
 	void merge_cell_pair(Cell *cell_a, Cell *cell_b)
 	{
 		SigMap merged_map;
@@ -116,9 +216,9 @@ struct EquivStructWorker
 		module->remove(cell_b);
 	}
 
-	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, const pool<IdString> &fwonly_cells, int iter_num) :
+	EquivStructWorker(Module *module, bool mode_fwd, bool mode_icells, bool mode_sim, const pool<IdString> &fwonly_cells, int iter_num) :
 			module(module), sigmap(module), equiv_bits(module),
-			mode_fwd(mode_fwd), mode_icells(mode_icells), merge_count(0), fwonly_cells(fwonly_cells)
+			mode_fwd(mode_fwd), mode_icells(mode_icells), mode_sim(mode_sim), merge_count(0), fwonly_cells(fwonly_cells)
 	{
 		log("  Starting iteration %d.\n", iter_num);
 
@@ -268,6 +368,10 @@ struct EquivStructWorker
 				log("    %s merging %d %s cells (from group of %d) using strategy %s:\n", phase ? "Bwd" : "Fwd",
 						2*GetSize(cell_pairs), log_id(cells_type), total_group_size, strategy);
 				for (auto it : cell_pairs) {
+					if (mode_sim && sim_refutes(it.first, it.second)) {
+						log("      Skipping cells %s and %s, their inputs differ in simulation.\n", log_id(it.first), log_id(it.second));
+						continue;
+					}
 					log("      Merging cells %s and %s.\n", log_id(it.first),  log_id(it.second));
 					merge_cell_pair(it.first, it.second);
 				}
@@ -313,12 +417,20 @@ struct EquivStructPass : public Pass {
 		log("    -maxiter <N>\n");
 		log("        maximum number of iterations to run before aborting\n");
 		log("\n");
+		log("    -sim\n");
+		log("        simulate the module with random input vectors and don't merge cells\n");
+		log("        if this would add $equiv cells for inputs that have different values\n");
+		log("        in simulation, i.e. $equiv cells that can't be proven. signals that\n");
+		log("        depend on FF outputs or on cells that can't be simulated (such as\n");
+		log("        instances of other modules) aren't checked.\n");
+		log("\n");
 	}
 	void execute(std::vector<std::string> args, Design *design) override
 	{
 		pool<IdString> fwonly_cells({ ID($equiv) });
 		bool mode_icells = false;
 		bool mode_fwd = false;
+		bool mode_sim = false;
 		int max_iter = -1;
 
 		log_header(design, "Executing EQUIV_STRUCT pass.\n");
@@ -333,6 +445,10 @@ struct EquivStructPass : public Pass {
 				mode_icells = true;
 				continue;
 			}
+			if (args[argidx] == "-sim") {
+				mode_sim = true;
+				continue;
+			}
 			if (args[argidx] == "-fwonly" && argidx+1 < args.size()) {
 				fwonly_cells.insert(RTLIL::escape_id(args[++argidx]));
 				continue;
@@ -353,7 +469,7 @@ struct EquivStructPass : public Pass {
 					log("  Reached iteration limit of %d.\n", iter);
 					break;
 				}
-				EquivStructWorker worker(module, mode_fwd, mode_icells, fwonly_cells, iter+1);
+				EquivStructWorker worker(module, mode_fwd, mode_icells, mode_sim, fwonly_cells, iter+1);
 				if (worker.merge_count == 0)
 					break;
 				module_merge_count += worker.merge_count;
@@ -19,6 +19,7 @@
  */
 
 #include "kernel/yosys.h"
+#include "kernel/threading.h"
 #include "frontends/verific/verific.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -439,6 +440,59 @@ void check_cell_connections(const RTLIL::Module &module, RTLIL::Cell &cell, RTLI
 	}
 }
 
+// Derives the modules that expand_module() would derive for the cells of the
+// given modules, on up to num_threads threads, and adds them to the design in
+// the order of the cells. Cells that connect interfaces are left to
+// expand_module(), and so are modules that don't support derive_job().
+void derive_modules_parallel(RTLIL::Design *design, const std::set<RTLIL::Module*, IdString::compare_ptr_by_name<Module>> &modules,
+		int num_threads)
+{
+	dict<RTLIL::Module*, bool> has_interface_ports;
+	pool<RTLIL::IdString> derived_names;
+	std::vector<std::function<RTLIL::Module*()>> jobs;
+	std::vector<unsigned int> hash_seeds;
+
+	for (auto module : modules)
+	for (auto cell : module->cells())
+	{
+		RTLIL::Module *mod = design->module(cell->type);
+		if (mod == nullptr) {
+			mod = design->module("$abstract" + cell->type.str());
+			if (mod == nullptr)
+				continue;
+		} else {
+			if (cell->parameters.empty() || mod->get_blackbox_attribute() || mod->get_bool_attribute(ID::is_interface))
+				continue;
+			if (!has_interface_ports.count(mod)) {
+				bool found = false;
+				for (auto port : mod->ports)
+					if (mod->wire(port)->get_bool_attribute(ID::is_interface))
+						found = true;
+				has_interface_ports[mod] = found;
+			}
+			if (has_interface_ports.at(mod))
+				continue;
+		}
+
+		std::function<RTLIL::Module*()> job;
+		RTLIL::IdString name = mod->derive_job(design, cell->parameters, job);
+		if (name.empty() || !job || !derived_names.insert(name).second)
+			continue;
+		jobs.push_back(std::move(job));
+		hash_seeds.push_back(run_hash(name.str()));
+	}
+
+	if (jobs.empty())
+		return;
+
+	std::vector<RTLIL::Module*> new_modules(GetSize(jobs));
+	parallel_for_tasks(hash_seeds, num_threads, [&](int i) {
+		new_modules[i] = jobs[i]();
+	});
+	for (auto mod : new_modules)
+		design->add(mod);
+}
+
 bool expand_module(RTLIL::Design *design, RTLIL::Module *module, bool flag_check, bool flag_simcheck, bool flag_smtcheck,
 		   std::vector<std::string> &libdirs)
 {
@@ -794,6 +848,11 @@ struct HierarchyPass : public Pass {
 		log("    -auto-top\n");
 		log("        automatically determine the top of the design hierarchy and mark it.\n");
 		log("\n");
+		log("    -j <N>\n");
+		log("        derive the parametric modules instantiated at each level of the\n");
+		log("        hierarchy on up to N threads. The result does not depend on N, but\n");
+		log("        auto-generated names may differ from a run without this option.\n");
+		log("\n");
 		log("    -chparam name value \n");
 		log("       elaborate the top module using this parameter value. Modules on which\n");
 		log("       this parameter does not exist may cause a warning message to be output.\n");
@@ -836,6 +895,7 @@ struct HierarchyPass : public Pass {
 		bool nodefaults = false;
 		bool nokeep_prints = false;
 		bool nokeep_asserts = false;
+		int num_threads = 0;
 		std::vector<std::string> generate_cells;
 		std::vector<generate_port_decl_t> generate_ports;
 		std::map<std::string, std::string> parameters;
@@ -928,6 +988,12 @@ struct HierarchyPass : public Pass {
 				load_top_mod = args[argidx];
 				continue;
 			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads: %s\n", args[argidx]);
+				continue;
+			}
 			if (args[argidx] == "-auto-top") {
 				auto_top_mode = true;
 				continue;
@@ -1087,6 +1153,9 @@ struct HierarchyPass : public Pass {
 					used_modules.insert(mod);
 			}
 
+			if (num_threads > 0)
+				derive_modules_parallel(design, used_modules, num_threads);
+
 			for (auto module : used_modules) {
 				if (expand_module(design, module, flag_check, flag_simcheck, flag_smtcheck, libdirs))
 					did_something = true;
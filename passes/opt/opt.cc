@@ -19,6 +19,7 @@
 
 #include "kernel/register.h"
 #include "kernel/log.h"
+#include "kernel/modtools.h"
 #include <stdlib.h>
 #include <stdio.h>
 
@@ -152,6 +153,9 @@ struct OptPass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		// the sub-passes share the cached sigmaps of the modules
+		ModIndexCache::Keep keep_cache(design);
+
 		if (fast_mode)
 		{
 			while (1) {
@@ -19,11 +19,14 @@
 
 #include "kernel/register.h"
 #include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
 #include "kernel/ffinit.h"
+#include "kernel/threading.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <atomic>
 #include <set>
 
 USING_YOSYS_NAMESPACE
@@ -44,6 +47,15 @@ struct keep_cache_t
 		cache.clear();
 	}
 
+	// Fills the cache for all modules of the design, after which query() no
+	// longer modifies the cache and may be called from several threads.
+	void populate()
+	{
+		log_assert(design != nullptr);
+		for (auto module : design->modules())
+			query(module);
+	}
+
 	bool query(Module *module)
 	{
 		log_assert(design != nullptr);
@@ -102,11 +114,13 @@ struct keep_cache_t
 
 keep_cache_t keep_cache;
 CellTypes ct_reg, ct_all;
-int count_rm_cells, count_rm_wires;
+std::atomic<int> count_rm_cells, count_rm_wires;
 
-void rmunused_module_cells(Module *module, bool verbose)
+bool rmunused_module_cells(Module *module, bool verbose)
 {
-	SigMap sigmap(module);
+	// shared with the other passes of the opt loop; removing cells doesn't
+	// invalidate it, rmunused_module_signals() drops it
+	const SigMap &sigmap = IncrementalSigMap::cached(module).get();
 	dict<IdString, pool<Cell*>> mem2cells;
 	pool<IdString> mem_unused;
 	pool<Cell*> queue, unused;
@@ -205,7 +219,6 @@ void rmunused_module_cells(Module *module, bool verbose)
 	for (auto cell : unused) {
 		if (verbose)
 			log_debug("  removing unused `%s' cell `%s'.\n", cell->type, cell->name);
-		module->design->scratchpad_set_bool("opt.did_something", true);
 		if (cell->is_builtin_ff())
 			ffinit.remove_init(cell->getPort(ID::Q));
 		module->remove(cell);
@@ -235,6 +248,8 @@ void rmunused_module_cells(Module *module, bool verbose)
 			for (auto msg : it.second)
 				log_warning("%s\n", msg);
 	}
+
+	return !unused.empty();
 }
 
 int count_nontrivial_wire_attrs(RTLIL::Wire *w)
@@ -348,8 +363,10 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 		}
 	}
 
-	// we are removing all connections
+	// we are removing all connections and rewriting the cell ports in place,
+	// which the cached index and sigmap of the module don't see
 	module->connections_.clear();
+	module->design->modindex_cache->drop(module);
 
 	// used signals sigmapped
 	SigPool used_signals;
@@ -507,9 +524,6 @@ bool rmunused_module_signals(RTLIL::Module *module, bool purge_mode, bool verbos
 	if (verbose && del_temp_wires_count)
 		log_debug("  removed %d unused temporary wires.\n", del_temp_wires_count);
 
-	if (!del_wires_queue.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
-
 	return !del_wires_queue.empty();
 }
 
@@ -588,13 +602,10 @@ bool rmunused_module_init(RTLIL::Module *module, bool verbose)
 	next_wire:;
 	}
 
-	if (did_something)
-		module->design->scratchpad_set_bool("opt.did_something", true);
-
 	return did_something;
 }
 
-void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool rminit)
+bool rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool rminit)
 {
 	if (verbose)
 		log("Finding unused cells or wires in module %s..\n", module->name);
@@ -640,14 +651,34 @@ void rmunused_module(RTLIL::Module *module, bool purge_mode, bool verbose, bool
 					log_signal(cell->getPort(ID::Y)), log_signal(cell->getPort(ID::A)));
 		module->remove(cell);
 	}
-	if (!delcells.empty())
-		module->design->scratchpad_set_bool("opt.did_something", true);
+	bool did_something = !delcells.empty();
 
-	rmunused_module_cells(module, verbose);
-	while (rmunused_module_signals(module, purge_mode, verbose)) { }
+	did_something |= rmunused_module_cells(module, verbose);
+	while (rmunused_module_signals(module, purge_mode, verbose))
+		did_something = true;
 
-	if (rminit && rmunused_module_init(module, verbose))
+	if (rminit && rmunused_module_init(module, verbose)) {
+		did_something = true;
 		while (rmunused_module_signals(module, purge_mode, verbose)) { }
+	}
+
+	return did_something;
+}
+
+// Cleans up the given modules, in parallel where possible, and flags the
+// design as changed if anything was removed.
+void rmunused_modules(Design *design, const std::vector<Module*> &modules, bool purge_mode, bool verbose, bool rminit)
+{
+	keep_cache.populate();
+
+	std::vector<char> module_changed(GetSize(modules));
+	parallel_for_modules(design, modules, [&](int idx, Module *module) {
+		module_changed[idx] = rmunused_module(module, purge_mode, verbose, rminit);
+	});
+
+	for (auto changed : module_changed)
+		if (changed)
+			design->scratchpad_set_bool("opt.did_something", true);
 }
 
 struct OptCleanPass : public Pass {
@@ -697,14 +728,16 @@ struct OptCleanPass : public Pass {
 		count_rm_cells = 0;
 		count_rm_wires = 0;
 
+		std::vector<Module*> modules;
 		for (auto module : design->selected_whole_modules_warn()) {
 			if (module->has_processes_warn())
 				continue;
-			rmunused_module(module, purge_mode, true, true);
+			modules.push_back(module);
 		}
+		rmunused_modules(design, modules, purge_mode, true, true);
 
 		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells.load(), count_rm_wires.load());
 
 		design->optimize();
 		design->sort();
@@ -759,15 +792,17 @@ struct CleanPass : public Pass {
 		count_rm_cells = 0;
 		count_rm_wires = 0;
 
+		std::vector<Module*> modules;
 		for (auto module : design->selected_unboxed_whole_modules()) {
 			if (module->has_processes())
 				continue;
-			rmunused_module(module, purge_mode, ys_debug(), true);
+			modules.push_back(module);
 		}
+		rmunused_modules(design, modules, purge_mode, ys_debug(), true);
 
 		log_suppressed();
 		if (count_rm_cells > 0 || count_rm_wires > 0)
-			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells, count_rm_wires);
+			log("Removed %d unused cells and %d unused wires.\n", count_rm_cells.load(), count_rm_wires.load());
 
 		design->optimize();
 		design->sort();
@@ -22,6 +22,7 @@
 #include "kernel/celltypes.h"
 #include "kernel/utils.h"
 #include "kernel/log.h"
+#include "kernel/threading.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <algorithm>
@@ -29,7 +30,8 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool did_something;
+// thread_local as modules are optimized in parallel
+thread_local bool did_something;
 
 void replace_undriven(RTLIL::Module *module, const CellTypes &ct)
 {
@@ -116,7 +118,7 @@ void replace_undriven(RTLIL::Module *module, const CellTypes &ct)
 	}
 }
 
-void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell,
+void replace_cell(RTLIL::Module *module, RTLIL::Cell *cell,
 		const std::string &info, IdString out_port, RTLIL::SigSpec out_val)
 {
 	RTLIL::SigSpec Y = cell->getPort(out_port);
@@ -126,13 +128,12 @@ void replace_cell(SigMap &assign_map, RTLIL::Module *module, RTLIL::Cell *cell,
 			cell->type.c_str(), cell->name.c_str(), info.c_str(),
 			module->name.c_str(), log_signal(Y), log_signal(out_val));
 	// log_cell(cell);
-	assign_map.add(Y, out_val);
 	module->connect(Y, out_val);
 	module->remove(cell);
 	did_something = true;
 }
 
-bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutative, SigMap &sigmap, bool keepdc)
+bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutative, IncrementalSigMap &sigmap, bool keepdc)
 {
 	IdString b_name = cell->hasPort(ID::B) ? ID::B : ID::A;
 
@@ -304,7 +305,7 @@ bool group_cell_inputs(RTLIL::Module *module, RTLIL::Cell *cell, bool commutativ
 	return true;
 }
 
-void handle_polarity_inv(Cell *cell, IdString port, IdString param, const SigMap &assign_map, const dict<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map)
+void handle_polarity_inv(Cell *cell, IdString port, IdString param, IncrementalSigMap &assign_map, const dict<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map)
 {
 	SigSpec sig = assign_map(cell->getPort(port));
 	if (invert_map.count(sig)) {
@@ -316,7 +317,7 @@ void handle_polarity_inv(Cell *cell, IdString port, IdString param, const SigMap
 	}
 }
 
-void handle_clkpol_celltype_swap(Cell *cell, string type1, string type2, IdString port, const SigMap &assign_map, const dict<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map)
+void handle_clkpol_celltype_swap(Cell *cell, string type1, string type2, IdString port, IncrementalSigMap &assign_map, const dict<RTLIL::SigSpec, RTLIL::SigSpec> &invert_map)
 {
 	log_assert(GetSize(type1) == GetSize(type2));
 	string cell_type = cell->type.str();
@@ -395,7 +396,9 @@ int get_highest_hot_index(RTLIL::SigSpec signal)
 
 void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool consume_x, bool mux_undef, bool mux_bool, bool do_fine, bool keepdc, bool noclkinv)
 {
-	SigMap assign_map(module);
+	// shared with the other passes of the opt loop, and kept up to date by
+	// module->connect()
+	IncrementalSigMap &assign_map = IncrementalSigMap::cached(module);
 	dict<RTLIL::SigSpec, RTLIL::SigSpec> invert_map;
 
 	for (auto cell : module->cells()) {
@@ -520,7 +523,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 	for (auto cell : cells.sorted)
 	{
-#define ACTION_DO(_p_, _s_) do { cover("opt.opt_expr.action_" S__LINE__); replace_cell(assign_map, module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
+#define ACTION_DO(_p_, _s_) do { cover("opt.opt_expr.action_" S__LINE__); replace_cell(module, cell, input.as_string(), _p_, _s_); goto next_cell; } while (0)
 #define ACTION_DO_Y(_v_) ACTION_DO(ID::Y, RTLIL::SigSpec(RTLIL::State::S ## _v_))
 
 		bool detect_const_and = false;
@@ -568,19 +571,19 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 
 			if (detect_const_and && (found_zero || found_inv || (found_undef && consume_x))) {
 				cover("opt.opt_expr.const_and");
-				replace_cell(assign_map, module, cell, "const_and", ID::Y, RTLIL::State::S0);
+				replace_cell(module, cell, "const_and", ID::Y, RTLIL::State::S0);
 				goto next_cell;
 			}
 
 			if (detect_const_or && (found_one || found_inv || (found_undef && consume_x))) {
 				cover("opt.opt_expr.const_or");
-				replace_cell(assign_map, module, cell, "const_or", ID::Y, RTLIL::State::S1);
+				replace_cell(module, cell, "const_or", ID::Y, RTLIL::State::S1);
 				goto next_cell;
 			}
 
 			if (non_const_input != State::Sm && !found_undef) {
 				cover("opt.opt_expr.and_or_buffer");
-				replace_cell(assign_map, module, cell, "and_or_buffer", ID::Y, non_const_input);
+				replace_cell(module, cell, "and_or_buffer", ID::Y, non_const_input);
 				goto next_cell;
 			}
 		}
@@ -592,14 +595,14 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 			if (!keepdc && (sig_a == sig_b || sig_a == State::Sx || sig_a == State::Sz || sig_b == State::Sx || sig_b == State::Sz)) {
 				if (cell->type.in(ID($xor), ID($_XOR_))) {
 					cover("opt.opt_expr.const_xor");
-					replace_cell(assign_map, module, cell, "const_xor", ID::Y, RTLIL::State::S0);
+					replace_cell(module, cell, "const_xor", ID::Y, RTLIL::State::S0);
 					goto next_cell;
 				}
 				if (cell->type.in(ID($xnor), ID($_XNOR_))) {
 					cover("opt.opt_expr.const_xnor");
 					// For consistency since simplemap does $xnor -> $_XOR_ + $_NOT_
 					int width = GetSize(cell->getPort(ID::Y));
-					replace_cell(assign_map, module, cell, "const_xnor", ID::Y, SigSpec(RTLIL::State::S1, width));
+					replace_cell(module, cell, "const_xnor", ID::Y, SigSpec(RTLIL::State::S1, width));
 					goto next_cell;
 				}
 				log_abort();
@@ -616,7 +619,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 					else if (cell->type == ID($_XOR_))
 						sig_y = (sig_b == State::S1 ? module->NotGate(NEW_ID, sig_a) : sig_a);
 					else log_abort();
-					replace_cell(assign_map, module, cell, "xor_buffer", ID::Y, sig_y);
+					replace_cell(module, cell, "xor_buffer", ID::Y, sig_y);
 					goto next_cell;
 				}
 				if (cell->type.in(ID($xnor), ID($_XNOR_))) {
@@ -630,7 +633,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 					else if (cell->type == ID($_XNOR_))
 						sig_y = (sig_b == State::S1 ? sig_a : module->NotGate(NEW_ID, sig_a));
 					else log_abort();
-					replace_cell(assign_map, module, cell, "xnor_buffer", ID::Y, sig_y);
+					replace_cell(module, cell, "xnor_buffer", ID::Y, sig_y);
 					goto next_cell;
 				}
 				log_abort();
@@ -648,7 +651,7 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 				did_something = true;
 			} else {
 				cover("opt.opt_expr.unary_buffer");
-				replace_cell(assign_map, module, cell, "unary_buffer", ID::Y, cell->getPort(ID::A));
+				replace_cell(module, cell, "unary_buffer", ID::Y, cell->getPort(ID::A));
 			}
 			goto next_cell;
 		}
@@ -724,9 +727,9 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 					log_abort();
 				}
 
-				assign_map.add(y_group_0, y_new_0); module->connect(y_group_0, y_new_0);
-				assign_map.add(y_group_1, y_new_1); module->connect(y_group_1, y_new_1);
-				assign_map.add(y_group_x, y_new_x); module->connect(y_group_x, y_new_x);
+				module->connect(y_group_0, y_new_0);
+				module->connect(y_group_1, y_new_1);
+				module->connect(y_group_x, y_new_x);
 
 				module->remove(cell);
 				did_something = true;
@@ -753,8 +756,8 @@ void replace_const_cells(RTLIL::Design *design, RTLIL::Module *module, bool cons
 						y_group_0.append(sig_y[i]), a_group_0.append(sig_a[i]);
 				}
 
-				assign_map.add(y_group_0, a_group_0); module->connect(y_group_0, a_group_0);
-				assign_map.add(y_group_1, b_group_1); module->connect(y_group_1, b_group_1);
+				module->connect(y_group_0, a_group_0);
+				module->connect(y_group_1, b_group_1);
 
 				module->remove(cell);
 				did_something = true;
@@ -1050,9 +1053,9 @@ skip_fine_alu:
 				cover_list("opt.opt_expr.xbit", "$reduce_xor", "$reduce_xnor", "$shl", "$shr", "$sshl", "$sshr", "$shift", "$shiftx",
 						"$lt", "$le", "$ge", "$gt", "$neg", "$add", "$sub", "$mul", "$div", "$mod", "$divfloor", "$modfloor", "$pow", cell->type.str());
 				if (cell->type.in(ID($reduce_xor), ID($reduce_xnor), ID($lt), ID($le), ID($ge), ID($gt)))
-					replace_cell(assign_map, module, cell, "x-bit in input", ID::Y, RTLIL::State::Sx);
+					replace_cell(module, cell, "x-bit in input", ID::Y, RTLIL::State::Sx);
 				else
-					replace_cell(assign_map, module, cell, "x-bit in input", ID::Y, RTLIL::SigSpec(RTLIL::State::Sx, GetSize(cell->getPort(ID::Y))));
+					replace_cell(module, cell, "x-bit in input", ID::Y, RTLIL::SigSpec(RTLIL::State::Sx, GetSize(cell->getPort(ID::Y))));
 				goto next_cell;
 			}
 		}
@@ -1082,7 +1085,7 @@ skip_fine_alu:
 		if (cell->type.in(ID($_NOT_), ID($not), ID($logic_not)) && GetSize(cell->getPort(ID::Y)) == 1 &&
 				invert_map.count(assign_map(cell->getPort(ID::A))) != 0) {
 			cover_list("opt.opt_expr.invert.double", "$_NOT_", "$not", "$logic_not", cell->type.str());
-			replace_cell(assign_map, module, cell, "double_invert", ID::Y, invert_map.at(assign_map(cell->getPort(ID::A))));
+			replace_cell(module, cell, "double_invert", ID::Y, invert_map.at(assign_map(cell->getPort(ID::A))));
 			goto next_cell;
 		}
 
@@ -1225,7 +1228,7 @@ skip_fine_alu:
 					cover_list("opt.opt_expr.eqneq.isneq", "$eq", "$ne", "$eqx", "$nex", cell->type.str());
 					RTLIL::SigSpec new_y = RTLIL::SigSpec(cell->type.in(ID($eq), ID($eqx)) ?  RTLIL::State::S0 : RTLIL::State::S1);
 					new_y.extend_u0(cell->parameters[ID::Y_WIDTH].as_int(), false);
-					replace_cell(assign_map, module, cell, "isneq", ID::Y, new_y);
+					replace_cell(module, cell, "isneq", ID::Y, new_y);
 					goto next_cell;
 				}
 				if (a[i] == b[i])
@@ -1238,7 +1241,7 @@ skip_fine_alu:
 				cover_list("opt.opt_expr.eqneq.empty", "$eq", "$ne", "$eqx", "$nex", cell->type.str());
 				RTLIL::SigSpec new_y = RTLIL::SigSpec(cell->type.in(ID($eq), ID($eqx)) ?  RTLIL::State::S1 : RTLIL::State::S0);
 				new_y.extend_u0(cell->parameters[ID::Y_WIDTH].as_int(), false);
-				replace_cell(assign_map, module, cell, "empty", ID::Y, new_y);
+				replace_cell(module, cell, "empty", ID::Y, new_y);
 				goto next_cell;
 			}
 
@@ -1464,7 +1467,7 @@ skip_identity:
 		if (mux_bool && cell->type.in(ID($mux), ID($_MUX_)) &&
 				cell->getPort(ID::A) == State::S0 && cell->getPort(ID::B) == State::S1) {
 			cover_list("opt.opt_expr.mux_bool", "$mux", "$_MUX_", cell->type.str());
-			replace_cell(assign_map, module, cell, "mux_bool", ID::Y, cell->getPort(ID::S));
+			replace_cell(module, cell, "mux_bool", ID::Y, cell->getPort(ID::S));
 			goto next_cell;
 		}
 
@@ -1534,7 +1537,7 @@ skip_identity:
 			if ((cell->getPort(ID::A).is_fully_undef() && cell->getPort(ID::B).is_fully_undef()) ||
 					cell->getPort(ID::S).is_fully_undef()) {
 				cover_list("opt.opt_expr.mux_undef", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_undef", ID::Y, cell->getPort(ID::A));
+				replace_cell(module, cell, "mux_undef", ID::Y, cell->getPort(ID::A));
 				goto next_cell;
 			}
 			for (int i = 0; i < cell->getPort(ID::S).size(); i++) {
@@ -1553,12 +1556,12 @@ skip_identity:
 			}
 			if (new_s.size() == 0) {
 				cover_list("opt.opt_expr.mux_empty", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_empty", ID::Y, new_a);
+				replace_cell(module, cell, "mux_empty", ID::Y, new_a);
 				goto next_cell;
 			}
 			if (new_a == RTLIL::SigSpec(RTLIL::State::S0) && new_b == RTLIL::SigSpec(RTLIL::State::S1)) {
 				cover_list("opt.opt_expr.mux_sel01", "$mux", "$pmux", cell->type.str());
-				replace_cell(assign_map, module, cell, "mux_sel01", ID::Y, new_s);
+				replace_cell(module, cell, "mux_sel01", ID::Y, new_s);
 				goto next_cell;
 			}
 			if (cell->getPort(ID::S).size() != new_s.size()) {
@@ -1588,7 +1591,7 @@ skip_identity:
 				if (!conn.first.in(ID::S, ID::T, ID::U, ID::V, ID::Y))
 					undef_inputs += conn.second.is_fully_undef();
 			if (undef_inputs == num_inputs) {
-				replace_cell(assign_map, module, cell, "mux_undef", ID::Y, cell->getPort(ID::A));
+				replace_cell(module, cell, "mux_undef", ID::Y, cell->getPort(ID::A));
 				goto next_cell;
 			}
 		}
@@ -1603,7 +1606,7 @@ skip_identity:
 						cell->parameters[ID::A_SIGNED].as_bool(), false, \
 						cell->parameters[ID::Y_WIDTH].as_int())); \
 				cover("opt.opt_expr.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s", log_signal(a)), ID::Y, y); \
+				replace_cell(module, cell, stringf("%s", log_signal(a)), ID::Y, y); \
 				goto next_cell; \
 			} \
 		}
@@ -1618,7 +1621,7 @@ skip_identity:
 						cell->parameters[ID::B_SIGNED].as_bool(), \
 						cell->parameters[ID::Y_WIDTH].as_int())); \
 				cover("opt.opt_expr.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), ID::Y, y); \
+				replace_cell(module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), ID::Y, y); \
 				goto next_cell; \
 			} \
 		}
@@ -1630,7 +1633,7 @@ skip_identity:
 			if (a.is_fully_const() && b.is_fully_const()) { \
 				RTLIL::SigSpec y(RTLIL::const_ ## _t(a.as_const(), b.as_const())); \
 				cover("opt.opt_expr.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), ID::Y, y); \
+				replace_cell(module, cell, stringf("%s, %s", log_signal(a), log_signal(b)), ID::Y, y); \
 				goto next_cell; \
 			} \
 		}
@@ -1643,7 +1646,7 @@ skip_identity:
 			if (a.is_fully_const() && b.is_fully_const() && s.is_fully_const()) { \
 				RTLIL::SigSpec y(RTLIL::const_ ## _t(a.as_const(), b.as_const(), s.as_const())); \
 				cover("opt.opt_expr.const.$" #_t); \
-				replace_cell(assign_map, module, cell, stringf("%s, %s, %s", log_signal(a), log_signal(b), log_signal(s)), ID::Y, y); \
+				replace_cell(module, cell, stringf("%s, %s, %s", log_signal(a), log_signal(b), log_signal(s)), ID::Y, y); \
 				goto next_cell; \
 			} \
 		}
@@ -2359,7 +2362,9 @@ struct OptExprPass : public Pass {
 		extra_args(args, argidx, design);
 
 		CellTypes ct(design);
-		for (auto module : design->selected_modules())
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		std::vector<char> module_changed(GetSize(modules));
+		parallel_for_modules(design, modules, [&](int idx, RTLIL::Module *module)
 		{
 			log("Optimizing module %s.\n", log_id(module));
 
@@ -2367,7 +2372,7 @@ struct OptExprPass : public Pass {
 				did_something = false;
 				replace_undriven(module, ct);
 				if (did_something)
-					design->scratchpad_set_bool("opt.did_something", true);
+					module_changed[idx] = true;
 			}
 
 			do {
@@ -2375,21 +2380,25 @@ struct OptExprPass : public Pass {
 					did_something = false;
 					replace_const_cells(design, module, false /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
 					if (did_something)
-						design->scratchpad_set_bool("opt.did_something", true);
+						module_changed[idx] = true;
 				} while (did_something);
 				if (!keepdc)
 					replace_const_cells(design, module, true /* consume_x */, mux_undef, mux_bool, do_fine, keepdc, noclkinv);
 				if (did_something)
-					design->scratchpad_set_bool("opt.did_something", true);
+					module_changed[idx] = true;
 			} while (did_something);
 
 			did_something = false;
 			replace_const_connections(module);
 			if (did_something)
-				design->scratchpad_set_bool("opt.did_something", true);
+				module_changed[idx] = true;
 
 			log_suppressed();
-		}
+		});
+
+		for (auto changed : module_changed)
+			if (changed)
+				design->scratchpad_set_bool("opt.did_something", true);
 
 		log_pop();
 	}
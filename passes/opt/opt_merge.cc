@@ -22,6 +22,7 @@
 #include "kernel/sigtools.h"
 #include "kernel/log.h"
 #include "kernel/celltypes.h"
+#include "kernel/threading.h"
 #include "libs/sha1/sha1.h"
 #include <stdlib.h>
 #include <stdio.h>
@@ -37,7 +38,7 @@ struct OptMergeWorker
 {
 	RTLIL::Design *design;
 	RTLIL::Module *module;
-	SigMap assign_map;
+	IncrementalSigMap &assign_map;
 	FfInitVals initvals;
 	bool mode_share_all;
 
@@ -208,7 +209,7 @@ struct OptMergeWorker
 	}
 
 	OptMergeWorker(RTLIL::Design *design, RTLIL::Module *module, bool mode_nomux, bool mode_share_all, bool mode_keepdc) :
-		design(design), module(module), mode_share_all(mode_share_all)
+		design(design), module(module), assign_map(IncrementalSigMap::cached(module)), mode_share_all(mode_share_all)
 	{
 		total_count = 0;
 		ct.setup_internals();
@@ -229,9 +230,7 @@ struct OptMergeWorker
 		ct.cell_types.erase(ID($allconst));
 
 		log("Finding identical cells in module `%s'.\n", module->name);
-		assign_map.set(module);
-
-		initvals.set(&assign_map, module);
+		initvals.set(&assign_map.get(), module);
 
 		bool did_something = true;
 		// A cell may have to go through a lot of collisions if the hash
@@ -310,7 +309,6 @@ struct OptMergeWorker
 							initvals.remove_init(it.second);
 							initvals.remove_init(other_sig);
 							module->connect(RTLIL::SigSig(it.second, other_sig));
-							assign_map.add(it.second, other_sig);
 							initvals.set_init(other_sig, init);
 						}
 					}
@@ -373,11 +371,16 @@ struct OptMergePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
-		int total_count = 0;
-		for (auto module : design->selected_modules()) {
+		std::vector<RTLIL::Module*> modules = design->selected_modules();
+		std::vector<int> module_count(GetSize(modules));
+		parallel_for_modules(design, modules, [&](int idx, RTLIL::Module *module) {
 			OptMergeWorker worker(design, module, mode_nomux, mode_share_all, mode_keepdc);
-			total_count += worker.total_count;
-		}
+			module_count[idx] = worker.total_count;
+		});
+
+		int total_count = 0;
+		for (int count : module_count)
+			total_count += count;
 
 		if (total_count)
 			design->scratchpad_set_bool("opt.did_something", true);
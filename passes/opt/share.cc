@@ -1163,7 +1163,8 @@ struct ShareWorker
 		ct.setup_internals();
 		ct.setup_stdcells();
 
-		ModIndex mi(module);
+		// follows the cells shared so far, instead of being rebuilt per call
+		ModIndex &mi = ModIndex::cached(module);
 
 		pool<RTLIL::Cell*> queue, covered;
 		queue.insert(cell);
@@ -1262,6 +1263,14 @@ struct ShareWorker
 		log("Found %d cells in module %s that may be considered for resource sharing.\n",
 				GetSize(shareable_cells), log_id(module));
 
+		// One model of the (unmodified) module for all queries, the input
+		// cones are imported as they are needed.
+		QuickConeSat qcsat(modwalker);
+		if (config.opt_fast) {
+			qcsat.max_cell_outs = 3;
+			qcsat.max_cell_count = 100;
+		}
+
 		while (!shareable_cells.empty() && config.limit != 0)
 		{
 			RTLIL::Cell *cell = *shareable_cells.begin();
@@ -1340,13 +1349,10 @@ struct ShareWorker
 				optimize_activation_patterns(filtered_cell_activation_patterns);
 				optimize_activation_patterns(filtered_other_cell_activation_patterns);
 
-				QuickConeSat qcsat(modwalker);
-				if (config.opt_fast) {
-					qcsat.max_cell_outs = 3;
-					qcsat.max_cell_count = 100;
-				}
-
-				std::set<RTLIL::SigBit> bits_queue;
+				// The patterns alone are checked on a separate solver without
+				// any of the logic.
+				QuickConeSat pattern_qcsat(modwalker);
+				std::vector<int> pattern_cell_active, pattern_other_cell_active;
 
 				std::vector<int> cell_active, other_cell_active;
 				RTLIL::SigSpec all_ctrl_signals;
@@ -1354,18 +1360,22 @@ struct ShareWorker
 				for (auto &p : filtered_cell_activation_patterns) {
 					log("      Activation pattern for cell %s: %s = %s\n", log_id(cell), log_signal(p.first), log_signal(p.second));
 					cell_active.push_back(qcsat.ez->vec_eq(qcsat.importSig(p.first), qcsat.importSig(p.second)));
+					pattern_cell_active.push_back(pattern_qcsat.ez->vec_eq(pattern_qcsat.importSig(p.first), pattern_qcsat.importSig(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
 
 				for (auto &p : filtered_other_cell_activation_patterns) {
 					log("      Activation pattern for cell %s: %s = %s\n", log_id(other_cell), log_signal(p.first), log_signal(p.second));
 					other_cell_active.push_back(qcsat.ez->vec_eq(qcsat.importSig(p.first), qcsat.importSig(p.second)));
+					pattern_other_cell_active.push_back(pattern_qcsat.ez->vec_eq(pattern_qcsat.importSig(p.first), pattern_qcsat.importSig(p.second)));
 					all_ctrl_signals.append(p.first);
 				}
 				int sub1 = qcsat.ez->expression(qcsat.ez->OpOr, cell_active);
 				int sub2 = qcsat.ez->expression(qcsat.ez->OpOr, other_cell_active);
 
-				bool pattern_only_solve = qcsat.ez->solve(qcsat.ez->AND(sub1, sub2));
+				bool pattern_only_solve = pattern_qcsat.ez->solve(pattern_qcsat.ez->AND(
+						pattern_qcsat.ez->expression(pattern_qcsat.ez->OpOr, pattern_cell_active),
+						pattern_qcsat.ez->expression(pattern_qcsat.ez->OpOr, pattern_other_cell_active)));
 				qcsat.prepare();
 
 				if (!qcsat.ez->solve(sub1)) {
@@ -1385,18 +1395,14 @@ struct ShareWorker
 				pool<ssc_pair_t> optimized_other_cell_activation_patterns = filtered_other_cell_activation_patterns;
 
 				if (pattern_only_solve) {
-					qcsat.ez->non_incremental();
-
 					all_ctrl_signals.sort_and_unify();
 					std::vector<int> sat_model = qcsat.importSig(all_ctrl_signals);
 					std::vector<bool> sat_model_values;
 
-					qcsat.ez->assume(qcsat.ez->AND(sub1, sub2));
-
 					log("      Size of SAT problem: %zu cells, %d variables, %d clauses\n",
 							qcsat.imported_cells.size(), qcsat.ez->numCnfVariables(), qcsat.ez->numCnfClauses());
 
-					if (qcsat.ez->solve(sat_model, sat_model_values)) {
+					if (qcsat.ez->solve(sat_model, sat_model_values, qcsat.ez->AND(sub1, sub2))) {
 						log("      According to the SAT solver this pair of cells can not be shared.\n");
 						log("      Model from SAT solver: %s = %d'", log_signal(all_ctrl_signals), GetSize(sat_model_values));
 						for (int i = GetSize(sat_model_values)-1; i >= 0; i--)
@@ -22,6 +22,7 @@
 #include "kernel/modtools.h"
 #include "kernel/ffinit.h"
 #include "kernel/utils.h"
+#include "kernel/threading.h"
 
 USING_YOSYS_NAMESPACE
 
@@ -52,7 +53,7 @@ struct WreduceWorker
 {
 	WreduceConfig *config;
 	Module *module;
-	ModIndex mi;
+	ModIndex &mi;
 
 	std::set<Cell*, IdString::compare_ptr_by_name<Cell>> work_queue_cells;
 	std::set<SigBit> work_queue_bits;
@@ -60,7 +61,7 @@ struct WreduceWorker
 	FfInitVals initvals;
 
 	WreduceWorker(WreduceConfig *config, Module *module) :
-			config(config), module(module), mi(module) { }
+			config(config), module(module), mi(ModIndex::cached(module)) { }
 
 	void run_cell_mux(Cell *cell)
 	{
@@ -571,11 +572,13 @@ struct WreducePass : public Pass {
 		}
 		extra_args(args, argidx, design);
 
+		std::vector<Module*> modules;
 		for (auto module : design->selected_modules())
-		{
-			if (module->has_processes_warn())
-				continue;
+			if (!module->has_processes_warn())
+				modules.push_back(module);
 
+		parallel_for_modules(design, modules, [&](int, Module *module)
+		{
 			for (auto c : module->selected_cells())
 			{
 				if (c->type.in(ID($reduce_and), ID($reduce_or), ID($reduce_xor), ID($reduce_xnor), ID($reduce_bool),
@@ -645,7 +648,7 @@ struct WreducePass : public Pass {
 
 			WreduceWorker worker(&config, module);
 			worker.run();
-		}
+		});
 	}
 } WreducePass;
 
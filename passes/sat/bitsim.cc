@@ -0,0 +1,330 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/bitsim.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct BitsimWorker
+{
+	Module *module;
+	BitSim sim;
+	int rounds, cycles;
+	uint64_t seed;
+
+	// bits whose toggling is recorded, and the lanes in which they were
+	// seen at 0 and 1
+	std::vector<SigBit> toggle_bits;
+	std::vector<BitSim::word_t> seen0, seen1;
+
+	SigBit check_bit;
+	bool check_enabled = false;
+	// cells in the input cone of the checked signal whose outputs aren't
+	// simulated faithfully, so a stimulus found for it may be spurious
+	pool<Cell*> check_unmodeled;
+
+	BitsimWorker(Module *module, int lanes, int rounds, int cycles, uint64_t seed) :
+			module(module), sim(module, lanes), rounds(rounds), cycles(cycles), seed(seed) { }
+
+	void setup_toggle()
+	{
+		pool<SigBit> seen;
+		for (auto wire : module->wires()) {
+			if (!wire->name.isPublic())
+				continue;
+			for (auto bit : sim.sigmap(wire))
+				if (bit.wire != nullptr && seen.insert(bit).second)
+					toggle_bits.push_back(bit);
+		}
+		seen0.resize(toggle_bits.size());
+		seen1.resize(toggle_bits.size());
+	}
+
+	void record_toggle()
+	{
+		int words = sim.lanes() / 64;
+		for (int i = 0; i < GetSize(toggle_bits); i++) {
+			const BitSim::word_t *w = sim.data(toggle_bits[i]);
+			for (int k = 0; k < words; k++) {
+				seen0[i] |= ~w[k];
+				seen1[i] |= w[k];
+			}
+		}
+	}
+
+	void setup_check(SigBit bit)
+	{
+		check_bit = bit;
+		check_enabled = true;
+
+		dict<SigBit, Cell*> drivers;
+		for (auto cell : module->cells())
+			for (auto &conn : cell->connections())
+				if (cell->output(conn.first))
+					for (auto driven : sim.sigmap(conn.second))
+						drivers[driven] = cell;
+
+		pool<Cell*> visited;
+		std::vector<Cell*> queue;
+		auto enqueue = [&](SigBit driven) {
+			auto it = drivers.find(sim.sigmap(driven));
+			if (it != drivers.end() && visited.insert(it->second).second)
+				queue.push_back(it->second);
+		};
+		enqueue(check_bit);
+		while (!queue.empty()) {
+			Cell *cell = queue.back();
+			queue.pop_back();
+			if (sim.unsupported_cells.count(cell) || sim.loop_cells.count(cell))
+				check_unmodeled.insert(cell);
+			for (auto &conn : cell->connections())
+				if (!cell->output(conn.first))
+					for (auto driven : conn.second)
+						enqueue(driven);
+		}
+	}
+
+	int find_check_lane()
+	{
+		const BitSim::word_t *w = sim.data(check_bit);
+		for (int k = 0; k < sim.lanes() / 64; k++)
+			if (w[k] != 0)
+				for (int i = 0; i < 64; i++)
+					if ((w[k] >> i) & 1)
+						return 64 * k + i;
+		return -1;
+	}
+
+	// Simulates one round of `cycles` clock cycles. When `trace_lane` is
+	// non-negative the stimulus of that lane is printed instead of
+	// recording coverage. Returns the lane in which the checked signal was
+	// set, or -1.
+	int run_round(uint64_t rng, int trace_lane = -1)
+	{
+		sim.init_state(rng);
+		if (trace_lane >= 0) {
+			pool<SigBit> state_bits(sim.state_bits().begin(), sim.state_bits().end());
+			for (auto wire : module->wires()) {
+				if (!wire->name.isPublic())
+					continue;
+				SigSpec sig = sim.sigmap(wire);
+				for (auto bit : sig)
+					if (state_bits.count(bit)) {
+						log("    initial %s = %s\n", log_id(wire), log_signal(sim.get(sig, trace_lane)));
+						break;
+					}
+			}
+		}
+
+		for (int cycle = 0; cycle < cycles; cycle++) {
+			if (cycle > 0)
+				sim.clock();
+			sim.randomize(rng, false);
+			sim.run();
+
+			if (trace_lane >= 0) {
+				for (auto wire : module->wires())
+					if (wire->port_input)
+						log("    cycle %d: %s = %s\n", cycle, log_id(wire), log_signal(sim.get(SigSpec(wire), trace_lane)));
+				if (check_enabled && sim.get(check_bit, trace_lane))
+					return trace_lane;
+				continue;
+			}
+
+			if (!toggle_bits.empty())
+				record_toggle();
+			if (check_enabled) {
+				int lane = find_check_lane();
+				if (lane >= 0)
+					return lane;
+			}
+		}
+		return -1;
+	}
+
+	void run()
+	{
+		log("Simulating module %s with %d lanes: %d gates, %d input bits, %d state bits.\n",
+				log_id(module), sim.lanes(), sim.num_gates(), GetSize(sim.inputs()) - GetSize(sim.state_bits()),
+				GetSize(sim.state_bits()));
+		if (!sim.unsupported_cells.empty())
+			log("  %d cells without a model, their outputs are simulated as random inputs.\n", GetSize(sim.unsupported_cells));
+		if (!sim.loop_cells.empty())
+			log_warning("Module %s contains combinational loops, the %d cells on them are not simulated correctly.\n",
+					log_id(module), GetSize(sim.loop_cells));
+		if (sim.found_undef)
+			log("  Undefined constants are simulated as 0.\n");
+		if (!check_unmodeled.empty())
+			log("  %d cells without a model feed %s, a stimulus that sets it is only reported as a warning.\n",
+					GetSize(check_unmodeled), log_signal(check_bit));
+
+		int round;
+		for (round = 0; round < rounds; round++)
+		{
+			// each round starts from a fresh generator state so that it can
+			// be replayed for printing a counter example
+			uint64_t round_rng = seed ^ (0x9e3779b97f4a7c15ULL * (round + 1));
+			int lane = run_round(round_rng);
+			if (lane < 0)
+				continue;
+
+			log("  Signal %s is set in round %d, lane %d with the stimulus:\n", log_signal(check_bit), round, lane);
+			run_round(round_rng, lane);
+			if (check_unmodeled.empty())
+				log_error("Found stimulus that sets %s in module %s.\n", log_signal(check_bit), log_id(module));
+
+			// the random outputs of the cells without a model may not be
+			// reachable, e.g. two copies of the same $mul in a miter
+			log_warning("Found stimulus that sets %s in module %s, but it depends on the random outputs of %d cells without a model, such as %s.\n",
+					log_signal(check_bit), log_id(module), GetSize(check_unmodeled), log_id(*check_unmodeled.begin()));
+			round++;
+			break;
+		}
+
+		log("  Simulated %lld stimulus vectors.\n", (long long)round * cycles * sim.lanes());
+
+		if (!toggle_bits.empty()) {
+			int toggled = 0;
+			dict<Wire*, SigSpec> stuck;
+			for (int i = 0; i < GetSize(toggle_bits); i++)
+				if (seen0[i] && seen1[i])
+					toggled++;
+				else
+					stuck[toggle_bits[i].wire].append(toggle_bits[i]);
+			log("  Toggle coverage: %d of %d bits (%.1f%%).\n", toggled, GetSize(toggle_bits),
+					100.0 * toggled / GetSize(toggle_bits));
+			stuck.sort(RTLIL::sort_by_name_id<Wire>());
+			for (auto &it : stuck)
+				log("    never toggled: %s\n", log_signal(it.second));
+		}
+	}
+};
+
+struct BitsimPass : public Pass {
+	BitsimPass() : Pass("bitsim", "bit-parallel random simulation") { }
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bitsim [options] [selection]\n");
+		log("\n");
+		log("This command simulates the selected modules with random stimulus. Many stimulus\n");
+		log("vectors (lanes) are simulated at once by packing one bit per lane into machine\n");
+		log("words and evaluating the cells as AND-inverter graphs with word operations.\n");
+		log("This is much faster than 'sim' or 'eval' for screening large numbers of random\n");
+		log("vectors, e.g. on a miter or for toggle coverage.\n");
+		log("\n");
+		log("The simulation is two-valued, undefined constants are simulated as 0. Module\n");
+		log("inputs and the outputs of cells without a simulation model (e.g. memories,\n");
+		log("multipliers or submodules) get random values in every cycle. Flip-flops without\n");
+		log("asynchronous reset or load are clocked together in every cycle, independent of\n");
+		log("their clock signal. They start with their init value, or a random value where\n");
+		log("the init value is undefined. Other FFs are treated like cells without a model.\n");
+		log("\n");
+		log("    -lanes <n>\n");
+		log("        number of stimulus vectors simulated at once, a multiple of 64.\n");
+		log("        (default: 256)\n");
+		log("\n");
+		log("    -rounds <n>\n");
+		log("        number of rounds of simulation. (default: 16)\n");
+		log("\n");
+		log("    -cycles <n>\n");
+		log("        number of clock cycles in each round, FFs are reset to their initial\n");
+		log("        state at the start of each round. (default: 1)\n");
+		log("\n");
+		log("    -seed <n>\n");
+		log("        seed for the random stimulus. (default: 1)\n");
+		log("\n");
+		log("    -toggle\n");
+		log("        report the toggle coverage of the public wires and list the bits that\n");
+		log("        were never seen at both 0 and 1.\n");
+		log("\n");
+		log("    -check <signal>\n");
+		log("        look for stimulus that sets the given 1-bit signal, such as the trigger\n");
+		log("        output of a miter. If it is found, the stimulus is printed and the\n");
+		log("        command fails. When cells without a model feed the signal, the\n");
+		log("        stimulus may not be valid and only a warning is printed.\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		int lanes = 256, rounds = 16, cycles = 1;
+		uint64_t seed = 1;
+		bool toggle = false;
+		std::string check;
+
+		log_header(design, "Executing BITSIM pass (bit-parallel random simulation).\n");
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (args[argidx] == "-lanes" && argidx+1 < args.size()) {
+				lanes = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-rounds" && argidx+1 < args.size()) {
+				rounds = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-cycles" && argidx+1 < args.size()) {
+				cycles = atoi(args[++argidx].c_str());
+				continue;
+			}
+			if (args[argidx] == "-seed" && argidx+1 < args.size()) {
+				seed = strtoull(args[++argidx].c_str(), nullptr, 0);
+				continue;
+			}
+			if (args[argidx] == "-toggle") {
+				toggle = true;
+				continue;
+			}
+			if (args[argidx] == "-check" && argidx+1 < args.size()) {
+				check = args[++argidx];
+				continue;
+			}
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		if (lanes <= 0 || lanes % 64 != 0)
+			log_cmd_error("The number of lanes must be a positive multiple of 64.\n");
+		if (rounds <= 0 || cycles <= 0)
+			log_cmd_error("The number of rounds and cycles must be positive.\n");
+
+		for (auto module : design->selected_whole_modules_warn())
+		{
+			BitsimWorker worker(module, lanes, rounds, cycles, seed);
+
+			if (!check.empty()) {
+				SigSpec sig;
+				if (!SigSpec::parse_sel(sig, design, module, check))
+					log_cmd_error("Failed to parse check expression `%s'.\n", check);
+				if (GetSize(sig) != 1)
+					log_cmd_error("Check expression `%s' must be a single bit.\n", check);
+				worker.setup_check(sig[0]);
+			}
+			if (toggle)
+				worker.setup_toggle();
+
+			worker.run();
+		}
+	}
+} BitsimPass;
+
+PRIVATE_NAMESPACE_END
@@ -17,6 +17,7 @@
  *
  */
 
+#include "kernel/bitsim.h"
 #include "kernel/celltypes.h"
 #include "kernel/consteval.h"
 #include "kernel/sigtools.h"
@@ -27,7 +28,7 @@
 USING_YOSYS_NAMESPACE
 PRIVATE_NAMESPACE_BEGIN
 
-bool inv_mode;
+bool inv_mode, sim_mode;
 int verbose_level, reduce_counter, reduce_stop_at;
 typedef std::map<RTLIL::SigBit, std::pair<RTLIL::Cell*, std::set<RTLIL::SigBit>>> drivers_t;
 std::string dump_prefix;
@@ -64,6 +65,152 @@ struct CountBitUsage
 	}
 };
 
+// Candidate equivalence classes from bit-parallel simulation. Bits that are
+// equivalent (or, with -inv, inverted) have the same simulated value in all
+// lanes, so only bits that are in the same class need to be checked with SAT.
+// Bits that are constant in all simulated lanes share one class. Counterexamples
+// from the SAT solver are collected and simulated in the next refine() call,
+// together with new random vectors, to split the classes further.
+//
+// This is only used when the simulation computes the same values as the SAT
+// model for defined inputs, i.e. without undef constants, and when all cells
+// in the logic are simulated.
+struct FreduceSim
+{
+	static const int lanes = 256;
+	// number of counterexamples that are collected before the next refine()
+	static const int batch_size = 64;
+
+	BitSim sim;
+	uint64_t rng = 0;
+	int num_classes = 1, num_refines = 0;
+
+	dict<RTLIL::SigBit, int> bit_class;
+	dict<RTLIL::SigBit, bool> bit_inverted;
+	std::vector<int> class_size;
+	std::vector<dict<RTLIL::SigBit, bool>> counterexamples;
+
+	FreduceSim(RTLIL::Module *module) : sim(module, lanes) { }
+
+	bool check_cells(drivers_t &drivers, std::string &reason)
+	{
+		if (sim.found_undef) {
+			reason = "undef constants";
+			return false;
+		}
+		for (auto &it : drivers) {
+			RTLIL::Cell *cell = it.second.first;
+			// the SAT model is undef-aware and undefined if more than one
+			// $pmux select input is active
+			if (sim.unsupported_cells.count(cell) || sim.loop_cells.count(cell) || cell->type == ID($pmux)) {
+				reason = stringf("no simulation model for cell %s (%s)", log_id(cell), log_id(cell->type));
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void add_bit(RTLIL::SigBit bit)
+	{
+		if (bit.wire != NULL)
+			bit_class[bit] = 0;
+	}
+
+	bool is_single(RTLIL::SigBit bit)
+	{
+		auto it = bit_class.find(bit);
+		return it != bit_class.end() && class_size[it->second] == 1;
+	}
+
+	void add_counterexample(const dict<RTLIL::SigBit, bool> &values)
+	{
+		counterexamples.push_back(values);
+	}
+
+	// Simulates the collected counterexamples and random vectors, and splits
+	// the classes accordingly. Returns true if any class was split.
+	bool refine()
+	{
+		sim.randomize(rng);
+		int num_cex = min(GetSize(counterexamples), lanes);
+		for (int lane = 0; lane < num_cex; lane++)
+			for (auto &it : counterexamples[lane])
+				sim.set(it.first, lane, it.second);
+		counterexamples.erase(counterexamples.begin(), counterexamples.begin() + num_cex);
+		sim.run();
+		num_refines++;
+
+		int words = lanes / 64;
+		dict<std::pair<int, std::vector<BitSim::word_t>>, int> new_classes;
+
+		for (auto &it : bit_class)
+		{
+			const BitSim::word_t *data = sim.data(it.first);
+			std::vector<BitSim::word_t> value(data, data + words);
+
+			bool all_zero = true, all_one = true;
+			for (auto w : value) {
+				all_zero = all_zero && w == 0;
+				all_one = all_one && w == ~BitSim::word_t(0);
+			}
+
+			if (all_zero || all_one)
+				value.clear();
+			else if (inv_mode) {
+				// the polarity is fixed by the first lane of the first
+				// run in which the bit isn't constant
+				if (!bit_inverted.count(it.first))
+					bit_inverted[it.first] = value[0] & 1;
+				if (bit_inverted.at(it.first))
+					for (auto &w : value)
+						w = ~w;
+			}
+
+			auto key = std::make_pair(it.second, std::move(value));
+			it.second = new_classes.emplace(key, GetSize(new_classes)).first->second;
+		}
+
+		bool split = GetSize(new_classes) > num_classes;
+		num_classes = GetSize(new_classes);
+
+		class_size.assign(num_classes, 0);
+		for (auto &it : bit_class)
+			class_size[it.second]++;
+
+		return split;
+	}
+
+	void refine_if_full()
+	{
+		if (GetSize(counterexamples) < batch_size)
+			return;
+		if (verbose_level >= 1)
+			log("    Simulating %d counterexamples.\n", GetSize(counterexamples));
+		refine();
+	}
+
+	// Splits a list of bits (given as indices into `bits`) by class, and
+	// drops the bits that are the only member of their class in the list.
+	std::vector<std::vector<int>> partition(const std::vector<RTLIL::SigBit> &bits, const std::vector<int> &indices)
+	{
+		dict<int, std::vector<int>> by_class;
+		std::vector<std::vector<int>> result;
+
+		for (int idx : indices) {
+			auto it = bit_class.find(bits[idx]);
+			if (it == bit_class.end())
+				return {indices};
+			by_class[it->second].push_back(idx);
+		}
+
+		for (auto &it : by_class)
+			if (GetSize(it.second) > 1)
+				result.push_back(std::move(it.second));
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+};
+
 struct FindReducedInputs
 {
 	SigMap &sigmap;
@@ -225,6 +372,7 @@ struct PerformReduction
 	SigMap &sigmap;
 	drivers_t &drivers;
 	std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs;
+	FreduceSim *sim;
 	pool<SigBit> recursion_guard;
 
 	ezSatPtr ez;
@@ -274,8 +422,8 @@ struct PerformReduction
 		return sigdepth.at(out);
 	}
 
-	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size) :
-			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), satgen(ez.get(), &sigmap), out_bits(bits), cone_size(cone_size)
+	PerformReduction(SigMap &sigmap, drivers_t &drivers, std::set<std::pair<RTLIL::SigBit, RTLIL::SigBit>> &inv_pairs, std::vector<RTLIL::SigBit> &bits, int cone_size, FreduceSim *sim = nullptr) :
+			sigmap(sigmap), drivers(drivers), inv_pairs(inv_pairs), sim(sim), satgen(ez.get(), &sigmap), out_bits(bits), cone_size(cone_size)
 	{
 		satgen.model_undef = true;
 
@@ -342,7 +490,7 @@ struct PerformReduction
 		results[result_idx].push_back(bit);
 	}
 
-	void analyze(std::vector<std::set<int>> &results, std::map<int, int> &results_map, std::vector<int> &bucket, std::string indent1, std::string indent2)
+	void analyze(std::vector<std::set<int>> &results, std::map<int, int> &results_map, const std::vector<int> &bucket, std::string indent1, std::string indent2)
 	{
 		std::string indent = indent1 + indent2;
 		const char *indt = indent.c_str();
@@ -370,7 +518,7 @@ struct PerformReduction
 		std::vector<bool> model;
 
 		modelVars.insert(modelVars.end(), sat_def.begin(), sat_def.end());
-		if (verbose_level >= 2)
+		if (verbose_level >= 2 || sim != nullptr)
 			modelVars.insert(modelVars.end(), sat_pi.begin(), sat_pi.end());
 
 		if (ez->solve(modelVars, model, ez->expression(ezSAT::OpOr, sat_set_list), ez->expression(ezSAT::OpOr, sat_clr_list)))
@@ -409,6 +557,13 @@ struct PerformReduction
 				log("%s    After %d iterations: %d set vs. %d clr vs %d undef\n", indt, iter_count, count_set, count_clr, count_undef);
 			}
 
+			if (sim != nullptr) {
+				dict<RTLIL::SigBit, bool> cex;
+				for (size_t i = 0; i < pi_bits.size(); i++)
+					cex[pi_bits[i]] = model[2*sat_out.size() + i];
+				sim->add_counterexample(cex);
+			}
+
 			if (verbose_level >= 2) {
 				for (size_t i = 0; i < pi_bits.size(); i++)
 					log("%s       -> PI  %c == %s\n", indt, model[2*sat_out.size() + i] ? '1' : '0', log_signal(pi_bits[i]));
@@ -483,15 +638,21 @@ struct PerformReduction
 		}
 	}
 
-	void analyze(std::vector<std::vector<equiv_bit_t>> &results, int perc)
+	void analyze(std::vector<std::vector<equiv_bit_t>> &results, int perc, const std::vector<std::vector<int>> &classes)
 	{
-		std::vector<int> bucket;
-		for (size_t i = 0; i < sat_out.size(); i++)
-			bucket.push_back(i);
-
 		std::vector<std::set<int>> results_buf;
 		std::map<int, int> results_map;
-		analyze(results_buf, results_map, bucket, stringf("[%2d%%] %d ", perc, cone_size), "");
+
+		for (auto &cls : classes) {
+			if (sim == nullptr) {
+				analyze(results_buf, results_map, cls, stringf("[%2d%%] %d ", perc, cone_size), "");
+				continue;
+			}
+			// counterexamples from the previous classes may split this one
+			sim->refine_if_full();
+			for (auto &bucket : sim->partition(out_bits, cls))
+				analyze(results_buf, results_map, bucket, stringf("[%2d%%] %d ", perc, cone_size), "");
+		}
 
 		for (auto &r : results_buf)
 		{
@@ -516,7 +677,7 @@ struct PerformReduction
 					undef_slaves.push_back(idx);
 			}
 
-			if (undef_slaves.size() == bucket.size()) {
+			if (undef_slaves.size() == sat_out.size()) {
 				if (verbose_level >= 1)
 					log("    Complex undef overlap. None of the signals covers the others.\n");
 				// FIXME: We could try to further shatter a group with complex undef overlaps
@@ -635,23 +796,67 @@ struct FreduceWorker
 				inv_pairs.insert(std::pair<RTLIL::SigBit, RTLIL::SigBit>(sigmap(cell->getPort(ID::A)), sigmap(cell->getPort(ID::Y))));
 		}
 
+		auto batch_selected = [&](const std::set<RTLIL::SigBit> &batch) {
+			for (auto &bit : batch)
+				if (bit.wire != NULL && design->selected(module, bit.wire))
+					return true;
+			return false;
+		};
+
+		std::unique_ptr<FreduceSim> sim;
+		if (sim_mode) {
+			sim.reset(new FreduceSim(module));
+			std::string reason;
+			if (sim->check_cells(drivers, reason)) {
+				for (auto &batch : batches)
+					if (batch_selected(batch))
+						for (auto &bit : batch)
+							sim->add_bit(bit);
+				// random simulation until it stops splitting classes
+				while (sim->refine() && sim->num_refines < 16) { }
+				log("  Simulated %d random vectors, sorted %d signal bits into %d classes.\n",
+						sim->num_refines * FreduceSim::lanes, GetSize(sim->bit_class), sim->num_classes);
+			} else {
+				log("  Not using simulation: %s.\n", reason);
+				sim.reset();
+			}
+		}
+
 		int bits_count = 0;
 		int bits_full_count = 0;
+		int bits_skipped = 0;
 		std::map<std::vector<RTLIL::SigBit>, std::vector<RTLIL::SigBit>> buckets;
+		// shared by all batches, so that each cell is only imported once
+		FindReducedInputs infinder(sigmap, drivers);
 		for (auto &batch : batches)
 		{
-			for (auto &bit : batch)
-				if (bit.wire != NULL && design->selected(module, bit.wire))
-					goto found_selected_wire;
-			bits_full_count += batch.size();
-			continue;
+			if (!batch_selected(batch)) {
+				bits_full_count += batch.size();
+				continue;
+			}
+
+			if (sim != nullptr) {
+				bool all_single = true;
+				for (auto &bit : batch)
+					all_single = all_single && sim->is_single(bit);
+				if (all_single) {
+					bits_full_count += batch.size();
+					bits_skipped += batch.size();
+					continue;
+				}
+			}
 
-		found_selected_wire:
 			log("  Finding reduced input cone for signal batch %s%c\n",
 					log_signal(batch), verbose_level ? ':' : '.');
 
-			FindReducedInputs infinder(sigmap, drivers);
 			for (auto &bit : batch) {
+				// simulation has shown that this bit is different from all
+				// others, so it can't be merged
+				if (sim != nullptr && sim->is_single(bit)) {
+					bits_full_count++;
+					bits_skipped++;
+					continue;
+				}
 				std::vector<RTLIL::SigBit> inputs;
 				infinder.analyze(inputs, bit, 100 * bits_full_count / bits_full_total);
 				buckets[inputs].push_back(bit);
@@ -659,6 +864,8 @@ struct FreduceWorker
 				bits_count++;
 			}
 		}
+		if (sim != nullptr)
+			log("  Skipped %d signal bits that are not equivalent to any other bit.\n", bits_skipped);
 		log("  Sorted %d signal bits into %d buckets.\n", bits_count, int(buckets.size()));
 
 		int bucket_count = 0;
@@ -675,10 +882,35 @@ struct FreduceWorker
 				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
 				for (size_t idx = 0; idx < bucket.second.size(); idx++)
 					worker.analyze_const(equiv, idx);
-			} else {
+				continue;
+			}
+
+			std::vector<int> all_bits;
+			for (int i = 0; i < GetSize(bucket.second); i++)
+				all_bits.push_back(i);
+
+			if (sim == nullptr) {
 				log("  Trying to shatter bucket %s%c\n", log_signal(bucket.second), verbose_level ? ':' : '.');
 				PerformReduction worker(sigmap, drivers, inv_pairs, bucket.second, bucket.first.size());
-				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1));
+				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1), {all_bits});
+			} else {
+				// only keep the bits that share a class with another bit
+				// in this bucket, equivalent bits have the same inputs
+				sim->refine_if_full();
+				std::vector<RTLIL::SigBit> bits;
+				std::vector<std::vector<int>> classes;
+				for (auto &cls : sim->partition(bucket.second, all_bits)) {
+					classes.emplace_back();
+					for (int idx : cls) {
+						classes.back().push_back(GetSize(bits));
+						bits.push_back(bucket.second[idx]);
+					}
+				}
+				if (bits.empty())
+					continue;
+				log("  Trying to shatter bucket %s%c\n", log_signal(bits), verbose_level ? ':' : '.');
+				PerformReduction worker(sigmap, drivers, inv_pairs, bits, bucket.first.size(), sim.get());
+				worker.analyze(equiv, 100 * bucket_count / (buckets.size() + 1), classes);
 			}
 		}
 
@@ -781,6 +1013,10 @@ struct FreducePass : public Pass {
 		log("        stop after <n> reduction operations. this is mostly used for\n");
 		log("        debugging the freduce command itself.\n");
 		log("\n");
+		log("    -nosim\n");
+		log("        don't use simulation to sort out signals that can't be equivalent\n");
+		log("        before running the SAT solver (see below)\n");
+		log("\n");
 		log("    -dump <prefix>\n");
 		log("        dump the design to <prefix>_<module>_<num>.il after each reduction\n");
 		log("        operation. this is mostly used for debugging the freduce command.\n");
@@ -788,6 +1024,12 @@ struct FreducePass : public Pass {
 		log("This pass is undef-aware, i.e. it considers don't-care values for detecting\n");
 		log("equivalent nodes.\n");
 		log("\n");
+		log("Unless -nosim is used, the circuit is first simulated with random input\n");
+		log("vectors, so that only signals with the same simulated values are checked with\n");
+		log("the SAT solver. Counterexamples found by the SAT solver are simulated as well\n");
+		log("to split the remaining candidate groups. This is skipped for modules with\n");
+		log("undef constants or cells without a simulation model.\n");
+		log("\n");
 		log("All selected wires are considered for rewiring. The selected cells cover the\n");
 		log("circuit that is analyzed.\n");
 		log("\n");
@@ -798,6 +1040,7 @@ struct FreducePass : public Pass {
 		reduce_stop_at = 0;
 		verbose_level = 0;
 		inv_mode = false;
+		sim_mode = true;
 		dump_prefix = std::string();
 
 		log_header(design, "Executing FREDUCE pass (perform functional reduction).\n");
@@ -816,6 +1059,10 @@ struct FreducePass : public Pass {
 				inv_mode = true;
 				continue;
 			}
+			if (args[argidx] == "-nosim") {
+				sim_mode = false;
+				continue;
+			}
 			if (args[argidx] == "-stop" && argidx+1 < args.size()) {
 				reduce_stop_at = atoi(args[++argidx].c_str());
 				continue;
@@ -26,6 +26,7 @@
 #include "kernel/yw.h"
 #include "kernel/json.h"
 #include "kernel/fmt.h"
+#include "kernel/threading.h"
 
 #include <ctime>
 
@@ -73,10 +74,118 @@ struct OutputWriter
 {
 	OutputWriter(SimWorker *w) { worker = w;};
 	virtual ~OutputWriter() {};
-	virtual void write(std::map<int, bool> &use_signal) = 0;
+	// Called on the main thread once the set of traced signals is known.
+	virtual void write_header(std::map<int, bool> &use_signal) = 0;
+	// Called for each output step in order, usually on the output thread
+	// (see OutputQueue), so it must not log or create IdStrings.
+	virtual void write_step(int time, const std::map<int, Const> &data) = 0;
 	SimWorker *worker;
 };
 
+// Hands the output steps of the simulation over to a background thread, so
+// that formatting and writing the output files overlaps with the simulation.
+// At most `capacity` steps are queued, the simulation waits for the writer
+// when it falls behind.
+struct OutputQueue
+{
+	typedef std::function<void(int, const std::map<int, Const> &)> consumer_t;
+	static constexpr int capacity = 64;
+
+	OutputQueue(consumer_t consumer) : consumer(consumer)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		int num_workers = ThreadPool::pool_size(1, 1);
+		if (num_workers > 0)
+			pool.reset(new ThreadPool(num_workers, [this](int) { run(); }));
+#endif
+	}
+
+	~OutputQueue()
+	{
+		close();
+	}
+
+	void push(int time, std::map<int, Const> &&data)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		if (pool) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				space_cv.wait(lock, [&] { return GetSize(steps) < capacity || exception; });
+				// an exception of the consumer is raised by finish()
+				if (exception)
+					return;
+				steps.emplace_back(time, std::move(data));
+			}
+			data_cv.notify_one();
+			return;
+		}
+#endif
+		consumer(time, data);
+	}
+
+	// Waits until all queued steps are written.
+	void finish()
+	{
+		close();
+		if (exception) {
+			std::exception_ptr e = exception;
+			exception = nullptr;
+			std::rethrow_exception(e);
+		}
+	}
+
+private:
+	consumer_t consumer;
+	std::exception_ptr exception;
+#ifdef YOSYS_ENABLE_THREADS
+	std::mutex mutex;
+	std::condition_variable data_cv, space_cv;
+	std::deque<std::pair<int, std::map<int, Const>>> steps;
+	bool closed = false;
+	std::unique_ptr<ThreadPool> pool;
+
+	void run()
+	{
+		while (1) {
+			std::pair<int, std::map<int, Const>> step;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				data_cv.wait(lock, [&] { return closed || !steps.empty(); });
+				if (steps.empty())
+					return;
+				step = std::move(steps.front());
+				steps.pop_front();
+			}
+			space_cv.notify_one();
+			try {
+				consumer(step.first, step.second);
+			} catch (...) {
+				std::lock_guard<std::mutex> lock(mutex);
+				exception = std::current_exception();
+				steps.clear();
+				space_cv.notify_all();
+				return;
+			}
+		}
+	}
+#endif
+
+	void close()
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		if (pool == nullptr)
+			return;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			closed = true;
+		}
+		data_cv.notify_all();
+		pool.reset();
+#endif
+	}
+};
+
 struct SimInstance;
 struct TriggeredAssertion {
 	int step;
@@ -99,6 +208,121 @@ struct DisplayOutput {
 	{ }
 };
 
+// Worker threads for `sim -j`. They are kept for the whole simulation, since
+// a new batch of instances is handed out in every delta cycle.
+struct SimThreads
+{
+	SimThreads(int num_workers)
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		pool.reset(new ThreadPool(num_workers, [this](int) { worker(); }));
+#else
+		log_assert(num_workers == 0);
+#endif
+	}
+
+	~SimThreads()
+	{
+#ifdef YOSYS_ENABLE_THREADS
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		work_cv.notify_all();
+		pool.reset();
+#endif
+	}
+
+	// Calls body(i) for 0 <= i < size on the workers and the calling thread,
+	// returns when all calls have returned.
+	void run(int size, const std::function<void(int)> &body)
+	{
+		Batch batch;
+		batch.body = &body;
+		batch.size = size;
+#ifdef YOSYS_ENABLE_THREADS
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			current = &batch;
+			generation++;
+		}
+		work_cv.notify_all();
+#endif
+		work(batch);
+#ifdef YOSYS_ENABLE_THREADS
+		std::unique_lock<std::mutex> lock(mutex);
+		current = nullptr;
+		done_cv.wait(lock, [&] { return batch.active == 0; });
+#endif
+	}
+
+private:
+	struct Batch {
+		const std::function<void(int)> *body;
+		int size;
+		std::atomic<int> next{0};
+		// number of workers that are still working on the batch
+		int active = 0;
+	};
+
+	static void work(Batch &batch)
+	{
+		for (int i; (i = batch.next.fetch_add(1)) < batch.size; )
+			(*batch.body)(i);
+	}
+
+#ifdef YOSYS_ENABLE_THREADS
+	void worker()
+	{
+		uint64_t seen = 0;
+		while (1) {
+			Batch *batch;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				work_cv.wait(lock, [&] { return stop || (current != nullptr && generation != seen); });
+				if (stop)
+					return;
+				batch = current;
+				seen = generation;
+				batch->active++;
+			}
+			work(*batch);
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--batch->active == 0)
+					done_cv.notify_all();
+			}
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable work_cv, done_cv;
+	Batch *current = nullptr;
+	uint64_t generation = 0;
+	bool stop = false;
+	std::unique_ptr<ThreadPool> pool;
+#endif
+};
+
+// The effects of simulating one child instance on a worker thread that
+// reach outside of its subtree. They are applied in the order of the
+// children after the batch, so the results are the same as those of a
+// sequential run.
+struct SimTask
+{
+	SimInstance *instance;
+	DeferredLogs logs;
+	std::vector<std::pair<SigSpec, Const>> parent_updates;
+	std::vector<std::tuple<SimInstance*, IdString, int>> memory_addrs;
+	std::vector<TriggeredAssertion> triggered_assertions;
+	std::vector<DisplayOutput> display_output;
+	int debug_suppressed = 0;
+	std::exception_ptr exception;
+};
+
+// The task of the current worker thread, nullptr on the main thread
+static thread_local SimTask *sim_task = nullptr;
+
 struct SimShared
 {
 	bool debug = false;
@@ -114,7 +338,15 @@ struct SimShared
 	SimulationMode sim_mode = SimulationMode::sim;
 	bool cycles_set = false;
 	std::vector<std::unique_ptr<OutputWriter>> outputfiles;
-	std::vector<std::pair<int,std::map<int,Const>>> output_data;
+	// Set by the first output step. When the set of traced signals is known
+	// at that point, the steps are written to the output files as they are
+	// produced (output_streaming). Otherwise the first step is kept in
+	// output_first, since memory words that are first accessed later are
+	// added to it, and the remaining steps are spilled to a temporary file
+	// until the end of the simulation.
+	bool output_started = false;
+	bool output_streaming = false;
+	std::pair<int, std::map<int, Const>> output_first;
 	bool ignore_x = false;
 	bool date = false;
 	bool multiclock = false;
@@ -125,6 +357,8 @@ struct SimShared
 	bool serious_asserts = false;
 	bool fst_noinit = false;
 	bool initstate = true;
+	bool compiled = false;
+	std::unique_ptr<SimThreads> threads;
 };
 
 void zinit(Const &v)
@@ -134,6 +368,79 @@ void zinit(Const &v)
 			bit = State::S0;
 }
 
+// Cell types with a dedicated evaluation kernel in the compiled engine. All
+// other evaluable cells are evaluated with CellTypes::eval().
+enum class CombOp {
+	Generic,
+	Buf,
+	Inv,
+	Not,
+	And,
+	Or,
+	Xor,
+	Xnor,
+	Nand,
+	Nor,
+	AndNot,
+	OrNot,
+	Mux,
+	NMux,
+	Pmux,
+	ReduceAnd,
+	ReduceOr,
+	ReduceXor,
+	ReduceXnor,
+	LogicNot,
+	LogicAnd,
+	LogicOr,
+	Eq,
+	Ne,
+	Eqx,
+	Nex,
+	Add,
+	Sub,
+	Lt,
+	Le,
+	Gt,
+	Ge,
+};
+
+// Bit operations with the same x semantics as the const_* functions
+static inline State sim_inv(State a)
+{
+	return a == State::S0 ? State::S1 : a == State::S1 ? State::S0 : a;
+}
+
+static inline State sim_not(State a)
+{
+	return a == State::S0 ? State::S1 : a == State::S1 ? State::S0 : State::Sx;
+}
+
+static inline State sim_and(State a, State b)
+{
+	if (a == State::S0 || b == State::S0)
+		return State::S0;
+	if (a != State::S1 || b != State::S1)
+		return State::Sx;
+	return State::S1;
+}
+
+static inline State sim_or(State a, State b)
+{
+	if (a == State::S1 || b == State::S1)
+		return State::S1;
+	if (a != State::S0 || b != State::S0)
+		return State::Sx;
+	return State::S0;
+}
+
+static inline State sim_xor(State a, State b)
+{
+	if ((a != State::S0 && a != State::S1) || (b != State::S0 && b != State::S1))
+		return State::Sx;
+	return a != b ? State::S1 : State::S0;
+}
+
 struct SimInstance
 {
 	SimShared *shared;
@@ -167,6 +474,10 @@ struct SimInstance
 		State past_srst;
 		
 		FfData data;
+
+		// slots of the FfData signals, only used by the compiled engine
+		std::vector<int> slots_q, slots_d, slots_ad, slots_clk, slots_ce, slots_srst;
+		std::vector<int> slots_aload, slots_arst, slots_clr, slots_set;
 	};
 
 	struct mem_state_t
@@ -222,6 +533,40 @@ struct SimInstance
 	dict<Wire*, fstHandle> fst_inputs;
 	dict<IdString, dict<int,fstHandle>> fst_memories;
 
+	// State of the compiled engine. Every net has a slot in net_state, the
+	// first slots hold the constant states. The evaluable cells are
+	// levelized into comb_cells and scheduled through level_queue, all
+	// other cells that read a slot go through update_cell().
+	struct comb_cell_t
+	{
+		Cell *cell;
+		CombOp op;
+		bool is_signed;
+		bool has_b, has_c, has_s;
+		int level;
+		// offsets into comb_ports, the inputs are stored in front of the outputs
+		int a, b, c, s, y;
+		int a_len, b_len, c_len, s_len, y_len;
+	};
+
+	static constexpr int NUM_CONST_SLOTS = int(State::Sm) + 1;
+
+	std::vector<State> net_state;
+	dict<Wire*, std::vector<int>> wire_slots;
+	std::vector<comb_cell_t> comb_cells;
+	std::vector<int> comb_ports;
+	// comb cells reading slot i are fanout_cells[fanout_begin[i]..fanout_begin[i+1]]
+	std::vector<int> fanout_begin, fanout_cells;
+	// bit 0: slot_other_cells entry, bit 1: slot_outports entry
+	std::vector<unsigned char> slot_flags;
+	dict<int, std::vector<Cell*>> slot_other_cells;
+	dict<int, std::vector<Wire*>> slot_outports;
+	pool<Wire*> dirty_outports;
+	std::vector<std::vector<int>> level_queue;
+	std::vector<int> level_batch;
+	std::vector<bool> comb_queued;
+	int queue_low = 0;
+
 	SimInstance(SimShared *shared, std::string scope, Module *module, Cell *instance = nullptr, SimInstance *parent = nullptr) :
 			shared(shared), scope(scope), module(module), instance(instance), parent(parent), sigmap(module)
 	{
@@ -353,6 +698,9 @@ struct SimInstance
 
 		std::sort(print_database.begin(), print_database.end());
 
+		if (shared->compiled)
+			compile();
+
 		if (shared->zinit)
 		{
 			for (auto &it : ff_database)
@@ -412,17 +760,47 @@ struct SimInstance
 		return result;
 	}
 
+	int get_slot(SigBit bit, Wire *&last_wire, const std::vector<int> *&last_slots)
+	{
+		if (bit.wire == nullptr)
+			return int(bit.data);
+		if (bit.wire != last_wire) {
+			auto it = wire_slots.find(bit.wire);
+			last_wire = bit.wire;
+			last_slots = it == wire_slots.end() ? nullptr : &it->second;
+		}
+		return last_slots ? (*last_slots)[bit.offset] : int(State::Sz);
+	}
+
+	std::vector<int> get_slots(const SigSpec &sig)
+	{
+		std::vector<int> slots;
+		Wire *last_wire = nullptr;
+		const std::vector<int> *last_slots = nullptr;
+		slots.reserve(GetSize(sig));
+		for (auto bit : sig)
+			slots.push_back(get_slot(bit, last_wire, last_slots));
+		return slots;
+	}
+
 	Const get_state(SigSpec sig)
 	{
 		Const::Builder builder(GetSize(sig));
 
-		for (auto bit : sigmap(sig))
-			if (bit.wire == nullptr)
-				builder.push_back(bit.data);
-			else if (state_nets.count(bit))
-				builder.push_back(state_nets.at(bit));
-			else
-				builder.push_back(State::Sz);
+		if (shared->compiled) {
+			Wire *last_wire = nullptr;
+			const std::vector<int> *last_slots = nullptr;
+			for (auto bit : sig)
+				builder.push_back(net_state[get_slot(bit, last_wire, last_slots)]);
+		} else {
+			for (auto bit : sigmap(sig))
+				if (bit.wire == nullptr)
+					builder.push_back(bit.data);
+				else if (state_nets.count(bit))
+					builder.push_back(state_nets.at(bit));
+				else
+					builder.push_back(State::Sz);
+		}
 
 		Const value = builder.build();
 		if (shared->debug)
@@ -434,15 +812,76 @@ struct SimInstance
 	{
 		bool did_something = false;
 
-		sig = sigmap(sig);
-		log_assert(GetSize(sig) <= GetSize(value));
+		if (shared->compiled) {
+			log_assert(GetSize(sig) <= GetSize(value));
+			Wire *last_wire = nullptr;
+			const std::vector<int> *last_slots = nullptr;
+			for (int i = 0; i < GetSize(sig); i++)
+				if (set_slot(get_slot(sig[i], last_wire, last_slots), value[i]))
+					did_something = true;
+		} else {
+			sig = sigmap(sig);
+			log_assert(GetSize(sig) <= GetSize(value));
+
+			for (int i = 0; i < GetSize(sig); i++)
+				if (value[i] != State::Sa && state_nets.at(sig[i]) != value[i]) {
+					state_nets.at(sig[i]) = value[i];
+					dirty_bits.insert(sig[i]);
+					did_something = true;
+				}
+		}
+
+		if (shared->debug)
+			log("[%s] set %s: %s\n", hiername(), log_signal(sig), log_signal(value));
+		return did_something;
+	}
+
+	// Variants for signals whose slots were looked up by compile()
+	Const get_state(const SigSpec &sig, const std::vector<int> &slots)
+	{
+		if (!shared->compiled)
+			return get_state(sig);
+
+		Const::Builder builder(GetSize(slots));
+		for (int slot : slots)
+			builder.push_back(net_state[slot]);
+
+		Const value = builder.build();
+		if (shared->debug)
+			log("[%s] get %s: %s\n", hiername(), log_signal(sig), log_signal(value));
+		return value;
+	}
+
+	State get_state_bit(const SigSpec &sig, const std::vector<int> &slots)
+	{
+		if (!shared->compiled)
+			return get_state(sig)[0];
+		if (shared->debug)
+			log("[%s] get %s: %s\n", hiername(), log_signal(sig), log_signal(net_state[slots[0]]));
+		return net_state[slots[0]];
+	}
 
-		for (int i = 0; i < GetSize(sig); i++)
-			if (value[i] != State::Sa && state_nets.at(sig[i]) != value[i]) {
-				state_nets.at(sig[i]) = value[i];
-				dirty_bits.insert(sig[i]);
+	bool unchanged_state(const Const &value, const std::vector<int> &slots)
+	{
+		if (GetSize(value) != GetSize(slots))
+			return false;
+		int i = 0;
+		for (auto bit : value)
+			if (bit != net_state[slots[i++]])
+				return false;
+		return true;
+	}
+
+	bool set_state(const SigSpec &sig, const std::vector<int> &slots, const Const &value)
+	{
+		if (!shared->compiled)
+			return set_state(sig, value);
+
+		bool did_something = false;
+		log_assert(GetSize(slots) <= GetSize(value));
+		for (int i = 0; i < GetSize(slots); i++)
+			if (set_slot(slots[i], value[i]))
 				did_something = true;
-			}
 
 		if (shared->debug)
 			log("[%s] set %s: %s\n", hiername(), log_signal(sig), log_signal(value));
@@ -611,8 +1050,650 @@ struct SimInstance
 		}
 	}
 
+	bool is_passive_cell(Cell *cell)
+	{
+		// cells that update_cell() ignores
+		return ff_database.count(cell) || formal_database.count(cell) || cell->type == ID($print);
+	}
+
+	void push_ports(const std::vector<int> &slots, int width, bool is_signed)
+	{
+		for (int i = 0; i < width; i++)
+			if (i < GetSize(slots))
+				comb_ports.push_back(slots[i]);
+			else if (is_signed && !slots.empty())
+				comb_ports.push_back(slots.back());
+			else
+				comb_ports.push_back(int(State::S0));
+	}
+
+	void compile_cell(Cell *cell, bool has_b, bool has_c, bool has_s)
+	{
+		comb_cell_t cc;
+		cc.cell = cell;
+		cc.op = CombOp::Generic;
+		cc.is_signed = false;
+		cc.has_b = has_b;
+		cc.has_c = has_c;
+		cc.has_s = has_s;
+		cc.level = 0;
+
+		std::vector<int> a = get_slots(cell->getPort(ID::A));
+		std::vector<int> b = has_b ? get_slots(cell->getPort(ID::B)) : std::vector<int>();
+		std::vector<int> c = has_c ? get_slots(cell->getPort(ID::C)) : std::vector<int>();
+		std::vector<int> s = has_s ? get_slots(cell->getPort(ID::S)) : std::vector<int>();
+		std::vector<int> y = get_slots(cell->getPort(ID::Y));
+
+		bool signed_a = cell->parameters.count(ID::A_SIGNED) && cell->parameters.at(ID::A_SIGNED).as_bool();
+		bool signed_b = cell->parameters.count(ID::B_SIGNED) && cell->parameters.at(ID::B_SIGNED).as_bool();
+		int a_len = GetSize(a), b_len = GetSize(b), y_len = GetSize(y);
+
+		// widths of the operands as the kernel sees them, -1 means unextended
+		int a_width = -1, b_width = -1;
+		IdString type = cell->type;
+
+		if (!has_c && !has_s) {
+			if (type.in(ID($_BUF_), ID($buf)) && a_len == y_len)
+				cc.op = CombOp::Buf;
+			else if (type == ID($_NOT_) && a_len == y_len)
+				cc.op = CombOp::Inv;
+			else if (type == ID($pos))
+				cc.op = CombOp::Buf, cc.is_signed = signed_a, a_width = y_len;
+			else if (type == ID($not))
+				cc.op = CombOp::Not, cc.is_signed = signed_a, a_width = y_len;
+			else if (type.in(ID($and), ID($or), ID($xor), ID($xnor))) {
+				cc.op = type == ID($and) ? CombOp::And : type == ID($or) ? CombOp::Or :
+						type == ID($xor) ? CombOp::Xor : CombOp::Xnor;
+				cc.is_signed = signed_a && signed_b, a_width = b_width = y_len;
+			}
+			else if (type.in(ID($_AND_), ID($_OR_), ID($_XOR_), ID($_XNOR_), ID($_NAND_), ID($_NOR_), ID($_ANDNOT_), ID($_ORNOT_)) && y_len == 1) {
+				cc.op = type == ID($_AND_) ? CombOp::And : type == ID($_OR_) ? CombOp::Or :
+						type == ID($_XOR_) ? CombOp::Xor : type == ID($_XNOR_) ? CombOp::Xnor :
+						type == ID($_NAND_) ? CombOp::Nand : type == ID($_NOR_) ? CombOp::Nor :
+						type == ID($_ANDNOT_) ? CombOp::AndNot : CombOp::OrNot;
+				cc.is_signed = false, a_width = b_width = 1;
+			}
+			else if (type == ID($reduce_and))
+				cc.op = CombOp::ReduceAnd;
+			else if (type.in(ID($reduce_or), ID($reduce_bool)))
+				cc.op = CombOp::ReduceOr;
+			else if (type == ID($reduce_xor))
+				cc.op = CombOp::ReduceXor;
+			else if (type == ID($reduce_xnor))
+				cc.op = CombOp::ReduceXnor;
+			else if (type == ID($logic_not))
+				cc.op = CombOp::LogicNot;
+			else if (type == ID($logic_and))
+				cc.op = CombOp::LogicAnd;
+			else if (type == ID($logic_or))
+				cc.op = CombOp::LogicOr;
+			else if (type.in(ID($eq), ID($ne), ID($eqx), ID($nex))) {
+				cc.op = type == ID($eq) ? CombOp::Eq : type == ID($ne) ? CombOp::Ne :
+						type == ID($eqx) ? CombOp::Eqx : CombOp::Nex;
+				cc.is_signed = signed_a && signed_b, a_width = b_width = max(a_len, b_len);
+			}
+			else if (type.in(ID($add), ID($sub), ID($lt), ID($le), ID($gt), ID($ge)) && a_len <= 64 && b_len <= 64 && y_len <= 64) {
+				cc.op = type == ID($add) ? CombOp::Add : type == ID($sub) ? CombOp::Sub :
+						type == ID($lt) ? CombOp::Lt : type == ID($le) ? CombOp::Le :
+						type == ID($gt) ? CombOp::Gt : CombOp::Ge;
+				cc.is_signed = signed_a && signed_b;
+			}
+		} else if (has_b && !has_c && has_s) {
+			if (type.in(ID($mux), ID($_MUX_), ID($_NMUX_)) && a_len == y_len && b_len == y_len && GetSize(s) == 1)
+				cc.op = type == ID($_NMUX_) ? CombOp::NMux : CombOp::Mux;
+			else if (type == ID($pmux) && a_len == y_len && b_len == y_len * GetSize(s))
+				cc.op = CombOp::Pmux;
+		}
+
+		cc.a = GetSize(comb_ports);
+		push_ports(a, a_width < 0 ? a_len : a_width, cc.is_signed);
+		cc.b = GetSize(comb_ports);
+		push_ports(b, b_width < 0 ? b_len : b_width, cc.is_signed);
+		cc.c = GetSize(comb_ports);
+		push_ports(c, GetSize(c), false);
+		cc.s = GetSize(comb_ports);
+		push_ports(s, GetSize(s), false);
+		cc.y = GetSize(comb_ports);
+		push_ports(y, y_len, false);
+
+		cc.a_len = cc.b - cc.a;
+		cc.b_len = cc.c - cc.b;
+		cc.c_len = cc.s - cc.c;
+		cc.s_len = cc.y - cc.s;
+		cc.y_len = y_len;
+		comb_cells.push_back(cc);
+	}
+
+	// Converts the state built by the constructor into the compiled engine
+	void compile()
+	{
+		dict<SigBit, int> net_slot;
+		for (int i = 0; i < NUM_CONST_SLOTS; i++)
+			net_state.push_back(State(i));
+		for (auto &it : state_nets) {
+			net_slot[it.first] = GetSize(net_state);
+			net_state.push_back(it.second);
+		}
+		int num_slots = GetSize(net_state);
+
+		for (auto wire : module->wires()) {
+			std::vector<int> &slots = wire_slots[wire];
+			for (auto bit : sigmap(wire))
+				slots.push_back(bit.wire ? net_slot.at(bit) : int(bit.data));
+		}
+
+		dict<Cell*, int> comb_index;
+		for (auto cell : module->cells())
+		{
+			if (is_passive_cell(cell) || mem_cells.count(cell) || children.count(cell))
+				continue;
+			if (!yosys_celltypes.cell_evaluable(cell->type))
+				continue;
+
+			// same port combinations as in update_cell()
+			bool has_a = cell->hasPort(ID::A), has_b = cell->hasPort(ID::B);
+			bool has_c = cell->hasPort(ID::C), has_d = cell->hasPort(ID::D);
+			bool has_s = cell->hasPort(ID::S), has_y = cell->hasPort(ID::Y);
+			if (!has_a || has_d || !has_y || (has_c && (!has_b || has_s)))
+				continue;
+
+			comb_index[cell] = GetSize(comb_cells);
+			compile_cell(cell, has_b, has_c, has_s);
+		}
+
+		// fanout of the net slots, the constant slots never change
+		std::vector<int> inputs;
+		auto unique_inputs = [&](const comb_cell_t &cc) {
+			inputs.assign(comb_ports.begin() + cc.a, comb_ports.begin() + cc.y);
+			std::sort(inputs.begin(), inputs.end());
+			inputs.erase(std::unique(inputs.begin(), inputs.end()), inputs.end());
+		};
+		fanout_begin.assign(num_slots + 1, 0);
+		for (auto &cc : comb_cells) {
+			unique_inputs(cc);
+			for (int slot : inputs)
+				if (slot >= NUM_CONST_SLOTS)
+					fanout_begin[slot + 1]++;
+		}
+		for (int i = 0; i < num_slots; i++)
+			fanout_begin[i + 1] += fanout_begin[i];
+		fanout_cells.resize(fanout_begin[num_slots]);
+		std::vector<int> fanout_pos(fanout_begin.begin(), fanout_begin.end() - 1);
+		for (int idx = 0; idx < GetSize(comb_cells); idx++) {
+			unique_inputs(comb_cells[idx]);
+			for (int slot : inputs)
+				if (slot >= NUM_CONST_SLOTS)
+					fanout_cells[fanout_pos[slot]++] = idx;
+		}
+
+		// levelize, cells on combinational loops are ordered arbitrarily
+		// and evaluated until the loop settles
+		std::vector<int> slot_driver(num_slots, -1);
+		for (int idx = 0; idx < GetSize(comb_cells); idx++) {
+			auto &cc = comb_cells[idx];
+			for (int i = cc.y; i < cc.y + cc.y_len; i++)
+				if (comb_ports[i] >= NUM_CONST_SLOTS)
+					slot_driver[comb_ports[i]] = idx;
+		}
+
+		std::vector<int> level(GetSize(comb_cells), -1);
+		std::vector<std::pair<int, int>> stack;
+		int max_level = -1;
+		for (int root = 0; root < GetSize(comb_cells); root++)
+		{
+			if (level[root] != -1)
+				continue;
+			level[root] = -2;
+			stack.emplace_back(root, comb_cells[root].a);
+
+			while (!stack.empty())
+			{
+				int idx = stack.back().first;
+				auto &cc = comb_cells[idx];
+				if (stack.back().second < cc.y) {
+					int driver = slot_driver[comb_ports[stack.back().second++]];
+					if (driver >= 0 && level[driver] == -1) {
+						level[driver] = -2;
+						stack.emplace_back(driver, comb_cells[driver].a);
+					}
+					continue;
+				}
+				int lvl = 0;
+				for (int i = cc.a; i < cc.y; i++) {
+					int driver = slot_driver[comb_ports[i]];
+					if (driver >= 0 && level[driver] >= 0)
+						lvl = max(lvl, level[driver] + 1);
+				}
+				cc.level = level[idx] = lvl;
+				max_level = max(max_level, lvl);
+				stack.pop_back();
+			}
+		}
+
+		level_queue.resize(max_level + 1);
+		comb_queued.assign(GetSize(comb_cells), false);
+		queue_low = GetSize(level_queue);
+
+		slot_flags.assign(num_slots, 0);
+		for (auto &it : upd_cells) {
+			if (it.first.wire == nullptr)
+				continue;
+			int slot = net_slot.at(it.first);
+			for (auto cell : it.second)
+				if (!comb_index.count(cell) && !is_passive_cell(cell)) {
+					slot_other_cells[slot].push_back(cell);
+					slot_flags[slot] |= 1;
+				}
+		}
+		for (auto &it : upd_outports) {
+			int slot = net_slot.at(it.first);
+			slot_outports[slot].insert(slot_outports[slot].end(), it.second.begin(), it.second.end());
+			slot_flags[slot] |= 2;
+		}
+
+		for (auto &it : ff_database) {
+			ff_state_t &ff = it.second;
+			ff.slots_q = get_slots(ff.data.sig_q);
+			ff.slots_d = get_slots(ff.data.sig_d);
+			ff.slots_ad = get_slots(ff.data.sig_ad);
+			ff.slots_clk = get_slots(ff.data.sig_clk);
+			ff.slots_ce = get_slots(ff.data.sig_ce);
+			ff.slots_srst = get_slots(ff.data.sig_srst);
+			ff.slots_aload = get_slots(ff.data.sig_aload);
+			ff.slots_arst = get_slots(ff.data.sig_arst);
+			ff.slots_clr = get_slots(ff.data.sig_clr);
+			ff.slots_set = get_slots(ff.data.sig_set);
+		}
+
+		// schedule what the interpreter would evaluate in the first cycle
+		for (auto bit : dirty_bits) {
+			if (bit.wire != nullptr) {
+				mark_slot(net_slot.at(bit));
+				continue;
+			}
+			if (upd_cells.count(bit))
+				for (auto cell : upd_cells.at(bit)) {
+					if (comb_index.count(cell))
+						schedule_comb(comb_index.at(cell));
+					else if (!is_passive_cell(cell))
+						dirty_cells.insert(cell);
+				}
+		}
+
+		state_nets = dict<SigBit, State>();
+		upd_cells = dict<SigBit, pool<Cell*>>();
+		upd_outports = dict<SigBit, pool<Wire*>>();
+		dirty_bits = pool<SigBit>();
+
+		if (shared->debug)
+			log("[%s] compiled %d cells into %d levels, %d net slots\n", hiername(),
+					GetSize(comb_cells), GetSize(level_queue), num_slots - NUM_CONST_SLOTS);
+	}
+
+	void schedule_comb(int idx)
+	{
+		if (comb_queued[idx])
+			return;
+		comb_queued[idx] = true;
+		int lvl = comb_cells[idx].level;
+		level_queue[lvl].push_back(idx);
+		if (lvl < queue_low)
+			queue_low = lvl;
+	}
+
+	void mark_slot(int slot)
+	{
+		for (int i = fanout_begin[slot]; i < fanout_begin[slot + 1]; i++)
+			schedule_comb(fanout_cells[i]);
+
+		if (slot_flags[slot] & 1)
+			for (auto cell : slot_other_cells.at(slot))
+				dirty_cells.insert(cell);
+
+		if ((slot_flags[slot] & 2) && parent != nullptr)
+			for (auto wire : slot_outports.at(slot))
+				dirty_outports.insert(wire);
+	}
+
+	bool set_slot(int slot, State value)
+	{
+		if (value == State::Sa || slot < NUM_CONST_SLOTS || net_state[slot] == value)
+			return false;
+		net_state[slot] = value;
+		mark_slot(slot);
+		return true;
+	}
+
+	Const get_ports(int offset, int len)
+	{
+		Const::Builder builder(len);
+		for (int i = offset; i < offset + len; i++)
+			builder.push_back(net_state[comb_ports[i]]);
+		return builder.build();
+	}
+
+	// Reads up to 64 bits, fails if any of them is undefined
+	bool get_word(int offset, int len, bool is_signed, uint64_t &value)
+	{
+		value = 0;
+		for (int i = 0; i < len; i++) {
+			State bit = net_state[comb_ports[offset + i]];
+			if (bit == State::S1)
+				value |= uint64_t(1) << i;
+			else if (bit != State::S0)
+				return false;
+		}
+		if (is_signed && len > 0 && len < 64 && ((value >> (len - 1)) & 1))
+			value |= ~uint64_t(0) << len;
+		return true;
+	}
+
+	// Value of the operand as a condition for the $logic_* cells
+	State get_truth(int offset, int len)
+	{
+		State result = State::S0;
+		for (int i = offset; i < offset + len; i++) {
+			State bit = net_state[comb_ports[i]];
+			if (bit == State::S1)
+				return State::S1;
+			if (bit != State::S0)
+				result = State::Sx;
+		}
+		return result;
+	}
+
+	void set_result_bit(const comb_cell_t &cc, State value)
+	{
+		if (cc.y_len == 0)
+			return;
+		set_slot(comb_ports[cc.y], value);
+		for (int i = 1; i < cc.y_len; i++)
+			set_slot(comb_ports[cc.y + i], State::S0);
+	}
+
+	void eval_comb(int idx)
+	{
+		const comb_cell_t &cc = comb_cells[idx];
+		const int *a = comb_ports.data() + cc.a;
+		const int *b = comb_ports.data() + cc.b;
+		const int *y = comb_ports.data() + cc.y;
+		const State *st = net_state.data();
+
+		if (shared->debug)
+			log("[%s] eval %s (%s)\n", hiername(), log_id(cc.cell), log_id(cc.cell->type));
+
+		switch (cc.op)
+		{
+		case CombOp::Buf:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], st[a[i]]);
+			break;
+		case CombOp::Inv:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_inv(st[a[i]]));
+			break;
+		case CombOp::Not:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_not(st[a[i]]));
+			break;
+		case CombOp::And:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_and(st[a[i]], st[b[i]]));
+			break;
+		case CombOp::Or:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_or(st[a[i]], st[b[i]]));
+			break;
+		case CombOp::Xor:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_xor(st[a[i]], st[b[i]]));
+			break;
+		case CombOp::Xnor:
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], sim_inv(sim_xor(st[a[i]], st[b[i]])));
+			break;
+		case CombOp::Nand:
+			set_slot(y[0], sim_inv(sim_and(st[a[0]], st[b[0]])));
+			break;
+		case CombOp::Nor:
+			set_slot(y[0], sim_inv(sim_or(st[a[0]], st[b[0]])));
+			break;
+		case CombOp::AndNot:
+			set_slot(y[0], sim_and(st[a[0]], sim_inv(st[b[0]])));
+			break;
+		case CombOp::OrNot:
+			set_slot(y[0], sim_or(st[a[0]], sim_inv(st[b[0]])));
+			break;
+		case CombOp::Mux:
+		case CombOp::NMux: {
+			State sel = st[comb_ports[cc.s]];
+			for (int i = 0; i < cc.y_len; i++) {
+				State value = sel == State::S0 ? st[a[i]] : sel == State::S1 ? st[b[i]] :
+						st[a[i]] == st[b[i]] ? st[a[i]] : State::Sx;
+				set_slot(y[i], cc.op == CombOp::NMux ? sim_inv(value) : value);
+			}
+			break;
+		}
+		case CombOp::Pmux: {
+			int hot = -1;
+			bool all_zero = true, onehot = true;
+			for (int i = 0; i < cc.s_len; i++) {
+				State sel = st[comb_ports[cc.s + i]];
+				if (sel == State::S1) {
+					if (hot >= 0)
+						onehot = false;
+					hot = i, all_zero = false;
+				} else if (sel != State::S0)
+					all_zero = false, onehot = false;
+			}
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], all_zero ? st[a[i]] : onehot ? st[b[hot * cc.y_len + i]] : State::Sx);
+			break;
+		}
+		case CombOp::ReduceAnd:
+		case CombOp::ReduceOr:
+		case CombOp::ReduceXor:
+		case CombOp::ReduceXnor: {
+			State value = cc.op == CombOp::ReduceAnd ? State::S1 : State::S0;
+			for (int i = 0; i < cc.a_len; i++)
+				value = cc.op == CombOp::ReduceAnd ? sim_and(value, st[a[i]]) :
+						cc.op == CombOp::ReduceOr ? sim_or(value, st[a[i]]) : sim_xor(value, st[a[i]]);
+			set_result_bit(cc, cc.op == CombOp::ReduceXnor ? sim_inv(value) : value);
+			break;
+		}
+		case CombOp::LogicNot:
+			set_result_bit(cc, sim_not(get_truth(cc.a, cc.a_len)));
+			break;
+		case CombOp::LogicAnd:
+			set_result_bit(cc, sim_and(get_truth(cc.a, cc.a_len), get_truth(cc.b, cc.b_len)));
+			break;
+		case CombOp::LogicOr:
+			set_result_bit(cc, sim_or(get_truth(cc.a, cc.a_len), get_truth(cc.b, cc.b_len)));
+			break;
+		case CombOp::Eq:
+		case CombOp::Ne: {
+			State value = State::S1;
+			for (int i = 0; i < cc.a_len; i++) {
+				State bit_a = st[a[i]], bit_b = st[b[i]];
+				if ((bit_a == State::S0 && bit_b == State::S1) || (bit_a == State::S1 && bit_b == State::S0)) {
+					value = State::S0;
+					break;
+				}
+				if (bit_a > State::S1 || bit_b > State::S1)
+					value = State::Sx;
+			}
+			set_result_bit(cc, cc.op == CombOp::Ne ? sim_inv(value) : value);
+			break;
+		}
+		case CombOp::Eqx:
+		case CombOp::Nex: {
+			bool equal = true;
+			for (int i = 0; i < cc.a_len && equal; i++)
+				equal = st[a[i]] == st[b[i]];
+			set_result_bit(cc, equal == (cc.op == CombOp::Eqx) ? State::S1 : State::S0);
+			break;
+		}
+		case CombOp::Add:
+		case CombOp::Sub: {
+			uint64_t value_a, value_b;
+			if (!get_word(cc.a, cc.a_len, cc.is_signed, value_a) || !get_word(cc.b, cc.b_len, cc.is_signed, value_b)) {
+				for (int i = 0; i < cc.y_len; i++)
+					set_slot(y[i], State::Sx);
+				break;
+			}
+			uint64_t value = cc.op == CombOp::Add ? value_a + value_b : value_a - value_b;
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], ((value >> i) & 1) ? State::S1 : State::S0);
+			break;
+		}
+		case CombOp::Lt:
+		case CombOp::Le:
+		case CombOp::Gt:
+		case CombOp::Ge: {
+			uint64_t value_a, value_b;
+			if (!get_word(cc.a, cc.a_len, cc.is_signed, value_a) || !get_word(cc.b, cc.b_len, cc.is_signed, value_b)) {
+				set_result_bit(cc, State::Sx);
+				break;
+			}
+			bool less = cc.is_signed ? int64_t(value_a) < int64_t(value_b) : value_a < value_b;
+			bool greater = cc.is_signed ? int64_t(value_a) > int64_t(value_b) : value_a > value_b;
+			bool value = cc.op == CombOp::Lt ? less : cc.op == CombOp::Le ? !greater :
+					cc.op == CombOp::Gt ? greater : !less;
+			set_result_bit(cc, value ? State::S1 : State::S0);
+			break;
+		}
+		case CombOp::Generic: {
+			Const value;
+			Const arg_a = get_ports(cc.a, cc.a_len);
+			Const arg_b = get_ports(cc.b, cc.b_len);
+			if (cc.has_c)
+				value = CellTypes::eval(cc.cell, arg_a, arg_b, get_ports(cc.c, cc.c_len));
+			else if (cc.has_s && cc.has_b)
+				value = CellTypes::eval(cc.cell, arg_a, arg_b, get_ports(cc.s, cc.s_len));
+			else if (cc.has_s)
+				value = CellTypes::eval(cc.cell, arg_a, get_ports(cc.s, cc.s_len));
+			else
+				value = CellTypes::eval(cc.cell, arg_a, arg_b);
+			log_assert(cc.y_len <= GetSize(value));
+			for (int i = 0; i < cc.y_len; i++)
+				set_slot(y[i], value[i]);
+			break;
+		}
+		}
+	}
+
+	void set_parent_state(const SigSpec &sig, const Const &value)
+	{
+		if (sim_task != nullptr && sim_task->instance == this)
+			sim_task->parent_updates.emplace_back(sig, value);
+		else
+			parent->set_state(sig, value);
+	}
+
+	// Calls body(child) for each of the given children. With `sim -j` the
+	// children are simulated on the worker threads, and everything that
+	// leaves their subtree is applied here afterwards, in the order of
+	// `list`.
+	void for_each_child(const std::vector<SimInstance*> &list, const std::function<void(SimInstance*)> &body)
+	{
+		if (shared->threads == nullptr || sim_task != nullptr || GetSize(list) < 2) {
+			for (auto child : list)
+				body(child);
+			return;
+		}
+
+		std::vector<SimTask> tasks(GetSize(list));
+		{
+			RTLIL::IdString::ConcurrentScope id_scope;
+			shared->threads->run(GetSize(list), [&](int i) {
+				SimTask &task = tasks[i];
+				task.instance = list[i];
+				sim_task = &task;
+				log_deferred = &task.logs;
+				log_debug_suppressed = 0;
+				try {
+					body(list[i]);
+				} catch (const log_deferred_error_exception &) {
+					// the error message is in task.logs and raised again by flush()
+				} catch (...) {
+					task.exception = std::current_exception();
+				}
+				task.debug_suppressed = log_debug_suppressed;
+				log_deferred = nullptr;
+				sim_task = nullptr;
+			});
+		}
+
+		for (auto &task : tasks) {
+			log_debug_suppressed += task.debug_suppressed;
+			task.logs.flush();
+			if (task.exception)
+				std::rethrow_exception(task.exception);
+			for (auto &it : task.parent_updates)
+				set_state(it.first, it.second);
+			for (auto &it : task.memory_addrs)
+				std::get<0>(it)->register_memory_addr(std::get<1>(it), std::get<2>(it));
+			for (auto &it : task.triggered_assertions)
+				shared->triggered_assertions.push_back(it);
+			for (auto &it : task.display_output)
+				shared->display_output.push_back(it);
+		}
+	}
+
+	void update_ph1_compiled()
+	{
+		while (1)
+		{
+			while (queue_low < GetSize(level_queue))
+			{
+				auto &queue = level_queue[queue_low];
+				if (queue.empty()) {
+					queue_low++;
+					continue;
+				}
+				level_batch.swap(queue);
+				for (int idx : level_batch) {
+					comb_queued[idx] = false;
+					eval_comb(idx);
+				}
+				level_batch.clear();
+			}
+
+			if (!dirty_cells.empty())
+			{
+				pool<Cell*> queue_cells;
+				queue_cells.swap(dirty_cells);
+				for (auto cell : queue_cells)
+					update_cell(cell);
+				continue;
+			}
+
+			for (auto &memid : dirty_memories)
+				update_memory(memid);
+			dirty_memories.clear();
+
+			for (auto wire : dirty_outports)
+				if (instance->hasPort(wire->name)) {
+					Const value = get_state(wire);
+					set_parent_state(instance->getPort(wire->name), value);
+				}
+			dirty_outports.clear();
+
+			for_each_child(std::vector<SimInstance*>(dirty_children.begin(), dirty_children.end()), [](SimInstance *child) { child->update_ph1(); });
+			dirty_children.clear();
+
+			if (queue_low == GetSize(level_queue) && dirty_cells.empty())
+				break;
+		}
+	}
+
 	void update_ph1()
 	{
+		if (shared->compiled) {
+			update_ph1_compiled();
+			return;
+		}
+
 		pool<Cell*> queue_cells;
 		pool<Wire*> queue_outports;
 
@@ -649,13 +1730,12 @@ struct SimInstance
 			for (auto wire : queue_outports)
 				if (instance->hasPort(wire->name)) {
 					Const value = get_state(wire);
-					parent->set_state(instance->getPort(wire->name), value);
+					set_parent_state(instance->getPort(wire->name), value);
 				}
 
 			queue_outports.clear();
 
-			for (auto child : dirty_children)
-				child->update_ph1();
+			for_each_child(std::vector<SimInstance*>(dirty_children.begin(), dirty_children.end()), [](SimInstance *child) { child->update_ph1(); });
 
 			dirty_children.clear();
 
@@ -673,11 +1753,11 @@ struct SimInstance
 			ff_state_t &ff = it.second;
 			FfData &ff_data = ff.data;
 
-			Const current_q = get_state(ff.data.sig_q);
+			Const current_q = get_state(ff.data.sig_q, ff.slots_q);
 
 			if (ff_data.has_clk && !stable_past_update) {
 				// flip-flops
-				State current_clk = get_state(ff_data.sig_clk)[0];
+				State current_clk = get_state_bit(ff_data.sig_clk, ff.slots_clk);
 				if (ff_data.pol_clk ? (ff.past_clk == State::S0 && current_clk != State::S0) :
 							(ff.past_clk == State::S1 && current_clk != State::S1)) {
 					bool ce = ff.past_ce == (ff_data.pol_ce ? State::S1 : State::S0);
@@ -694,22 +1774,22 @@ struct SimInstance
 			}
 			// async load
 			if (ff_data.has_aload) {
-				State current_aload = get_state(ff_data.sig_aload)[0];
+				State current_aload = get_state_bit(ff_data.sig_aload, ff.slots_aload);
 				if (current_aload == (ff_data.pol_aload ? State::S1 : State::S0)) {
-					current_q = ff_data.has_clk && !stable_past_update ? ff.past_ad : get_state(ff.data.sig_ad);
+					current_q = ff_data.has_clk && !stable_past_update ? ff.past_ad : get_state(ff.data.sig_ad, ff.slots_ad);
 				}
 			}
 			// async reset
 			if (ff_data.has_arst) {
-				State current_arst = get_state(ff_data.sig_arst)[0];
+				State current_arst = get_state_bit(ff_data.sig_arst, ff.slots_arst);
 				if (current_arst == (ff_data.pol_arst ? State::S1 : State::S0)) {
 					current_q = ff_data.val_arst;
 				}
 			}
 			// handle set/reset
 			if (ff.data.has_sr) {
-				Const current_clr = get_state(ff.data.sig_clr);
-				Const current_set = get_state(ff.data.sig_set);
+				Const current_clr = get_state(ff.data.sig_clr, ff.slots_clr);
+				Const current_set = get_state(ff.data.sig_set, ff.slots_set);
 
 				for(int i=0;i<ff.past_d.size();i++) {
 					if (current_clr[i] == (ff_data.pol_clr ? State::S1 : State::S0)) {
@@ -725,7 +1805,7 @@ struct SimInstance
 				if (gclk)
 					current_q = ff.past_d;
 			}
-			if (set_state(ff_data.sig_q, current_q))
+			if (set_state(ff_data.sig_q, ff.slots_q, current_q))
 				did_something = true;
 		}
 
@@ -777,9 +1857,18 @@ struct SimInstance
 			}
 		}
 
+		std::vector<SimInstance*> child_list;
 		for (auto it : children)
-			if (it.second->update_ph2(gclk, stable_past_update)) {
-				dirty_children.insert(it.second);
+			child_list.push_back(it.second);
+		dict<SimInstance*, bool> child_changed;
+		for (auto child : child_list)
+			child_changed[child] = false;
+		for_each_child(child_list, [&](SimInstance *child) {
+			child_changed.at(child) = child->update_ph2(gclk, stable_past_update);
+		});
+		for (auto child : child_list)
+			if (child_changed.at(child)) {
+				dirty_children.insert(child);
 				did_something = true;
 			}
 
@@ -817,19 +1906,19 @@ struct SimInstance
 			ff_state_t &ff = it.second;
 
 			if (ff.data.has_aload)
-				ff.past_ad = get_state(ff.data.sig_ad);
+				ff.past_ad = get_state(ff.data.sig_ad, ff.slots_ad);
 
 			if (ff.data.has_clk || ff.data.has_gclk)
-				ff.past_d = get_state(ff.data.sig_d);
+				ff.past_d = get_state(ff.data.sig_d, ff.slots_d);
 
 			if (ff.data.has_clk)
-				ff.past_clk = get_state(ff.data.sig_clk)[0];
+				ff.past_clk = get_state_bit(ff.data.sig_clk, ff.slots_clk);
 
 			if (ff.data.has_ce)
-				ff.past_ce = get_state(ff.data.sig_ce)[0];
+				ff.past_ce = get_state_bit(ff.data.sig_ce, ff.slots_ce);
 
 			if (ff.data.has_srst)
-				ff.past_srst = get_state(ff.data.sig_srst)[0];
+				ff.past_srst = get_state_bit(ff.data.sig_srst, ff.slots_srst);
 		}
 
 		for (auto &it : mem_database)
@@ -891,7 +1980,10 @@ struct SimInstance
 
 					std::string rendered = print.fmt.render();
 					log("%s", rendered);
-					shared->display_output.emplace_back(shared->step, this, cell, rendered);
+					if (sim_task != nullptr)
+						sim_task->display_output.emplace_back(shared->step, this, cell, rendered);
+					else
+						shared->display_output.emplace_back(shared->step, this, cell, rendered);
 				}
 			}
 
@@ -913,7 +2005,10 @@ struct SimInstance
 				State en = get_state(cell->getPort(ID::EN))[0];
 
 				if (en == State::S1 && (cell->type == ID($cover) ? a == State::S1 : a != State::S1)) {
-					shared->triggered_assertions.emplace_back(shared->step, this, cell);
+					if (sim_task != nullptr)
+						sim_task->triggered_assertions.emplace_back(shared->step, this, cell);
+					else
+						shared->triggered_assertions.emplace_back(shared->step, this, cell);
 				}
 
 				if (cell->type == ID($cover) && en == State::S1 && a == State::S1)
@@ -932,8 +2027,10 @@ struct SimInstance
 			}
 		}
 
+		std::vector<SimInstance*> child_list;
 		for (auto it : children)
-			it.second->update_ph3(gclk_trigger);
+			child_list.push_back(it.second);
+		for_each_child(child_list, [&](SimInstance *child) { child->update_ph3(gclk_trigger); });
 	}
 
 	void set_initstate_outputs(State state)
@@ -1093,15 +2190,20 @@ struct SimInstance
 		auto it = trace_mem_database.find(memid);
 		if (it != trace_mem_database.end() && it->second.count(index))
 			return;
+		if (sim_task != nullptr) {
+			sim_task->memory_addrs.emplace_back(this, memid, addr);
+			return;
+		}
 		int output_id = shared->next_output_id++;
 		Const data;
-		if (!shared->output_data.empty()) {
+		if (shared->output_started) {
 			auto init_it = trace_mem_init_database.find(std::make_pair(memid, addr));
 			if (init_it != trace_mem_init_database.end())
 				data = init_it->second;
 			else
 				data = mem.get_init_data().extract(index * mem.width, mem.width);
-			shared->output_data.front().second.emplace(output_id, data);
+			log_assert(!shared->output_streaming);
+			shared->output_first.second.emplace(output_id, data);
 		}
 		trace_mem_database[memid].emplace(index, make_pair(output_id, data));
 
@@ -1112,6 +2214,9 @@ struct SimInstance
 		for (auto &it : signal_database)
 		{
 			Wire *wire = it.first;
+			if (shared->compiled && unchanged_state(it.second.second, wire_slots.at(wire)))
+				continue;
+
 			Const value = get_state(wire);
 			int id = it.second.first;
 
@@ -1146,6 +2251,16 @@ struct SimInstance
 			child.second->register_output_step_values(data);
 	}
 
+	bool has_memories()
+	{
+		if (!mem_database.empty())
+			return true;
+		for (auto child : children)
+			if (child.second->has_memories())
+				return true;
+		return false;
+	}
+
 	bool setInitState()
 	{
 		bool did_something = false;
@@ -1288,8 +2403,18 @@ struct SimWorker : SimShared
 	std::string summary_filename;
 	std::string scope;
 
+	std::unique_ptr<OutputQueue> output_queue;
+	std::ofstream output_spill;
+	std::string output_spill_filename;
+	pool<int> output_spill_ids;
+
 	~SimWorker()
 	{
+		output_queue.reset();
+		if (!output_spill_filename.empty()) {
+			output_spill.close();
+			remove(output_spill_filename.c_str());
+		}
 		outputfiles.clear();
 		delete top;
 	}
@@ -1304,28 +2429,103 @@ struct SimWorker : SimShared
 	{
 		std::map<int,Const> data;
 		top->register_output_step_values(&data);
-		output_data.emplace_back(t, data);
+		if (outputfiles.empty()) {
+			output_started = true;
+			return;
+		}
+
+		if (!output_started) {
+			output_started = true;
+			output_queue.reset(new OutputQueue([this](int time, const std::map<int, Const> &step) { write_output_step(time, step); }));
+			if (!ignore_x && !top->has_memories()) {
+				std::map<int, bool> use_signal;
+				for (auto &it : data)
+					use_signal[it.first] = true;
+				for (auto &writer : outputfiles)
+					writer->write_header(use_signal);
+				output_streaming = true;
+			} else {
+				output_first = std::make_pair(t, std::move(data));
+				output_spill_filename = make_temp_file();
+				output_spill.open(output_spill_filename, std::ios::binary | std::ios::trunc);
+				if (output_spill.fail())
+					log_error("Can't open temporary file `%s' for writing.\n", output_spill_filename);
+				return;
+			}
+		}
+
+		output_queue->push(t, std::move(data));
+	}
+
+	// Runs on the output thread.
+	void write_output_step(int time, const std::map<int, Const> &data)
+	{
+		if (output_streaming) {
+			for (auto &writer : outputfiles)
+				writer->write_step(time, data);
+			return;
+		}
+
+		auto put = [&](int value) { output_spill.write(reinterpret_cast<const char *>(&value), sizeof(value)); };
+		put(time);
+		put(GetSize(data));
+		for (auto &it : data) {
+			put(it.first);
+			put(GetSize(it.second));
+			for (auto bit : it.second)
+				output_spill.put(bit);
+			if (ignore_x)
+				output_spill_ids.insert(it.first);
+		}
 	}
 
 	void write_output_files()
 	{
-		std::map<int, bool> use_signal;
-		bool first = ignore_x;
-		for(auto& d : output_data)
+		if (output_queue != nullptr)
+			output_queue->finish();
+
+		if (output_started && !output_streaming && !outputfiles.empty())
 		{
-			if (first) {
-				for (auto &data : d.second)
-					use_signal[data.first] = !data.second.is_fully_undef();
-				first = false;
-			} else {
-				for (auto &data : d.second)
-					use_signal[data.first] = true;
+			output_spill.close();
+			if (output_spill.fail())
+				log_error("Failed to write temporary file `%s'.\n", output_spill_filename);
+
+			std::map<int, bool> use_signal;
+			for (auto &data : output_first.second)
+				use_signal[data.first] = !ignore_x || !data.second.is_fully_undef();
+			for (auto id : output_spill_ids)
+				use_signal[id] = true;
+
+			for (auto &writer : outputfiles) {
+				writer->write_header(use_signal);
+				writer->write_step(output_first.first, output_first.second);
+			}
+
+			std::ifstream f(output_spill_filename, std::ios::binary);
+			auto get = [&]() { int value = 0; f.read(reinterpret_cast<char *>(&value), sizeof(value)); return value; };
+			while (1) {
+				int time = get();
+				if (!f)
+					break;
+				std::map<int, Const> data;
+				for (int count = get(); count > 0; count--) {
+					int id = get();
+					int width = get();
+					Const::Builder value(width);
+					for (int i = 0; i < width; i++)
+						value.push_back(State(f.get()));
+					data.emplace(id, value.build());
+				}
+				if (!f)
+					log_error("Failed to read temporary file `%s'.\n", output_spill_filename);
+				for (auto &writer : outputfiles)
+					writer->write_step(time, data);
 			}
-			if (!ignore_x) break;
+			f.close();
+			remove(output_spill_filename.c_str());
+			output_spill_filename.clear();
 		}
-		for(auto& writer : outputfiles)
-			writer->write(use_signal);
-		
+
 		if (writeback) {
 			pool<Module*> wbmods;
 			top->writeback(wbmods);
@@ -2319,8 +3519,9 @@ struct VCDWriter : public OutputWriter
 		vcdfile.open(filename.c_str());
 	}
 
-	void write(std::map<int, bool> &use_signal) override
+	void write_header(std::map<int, bool> &use_signal) override
 	{
+		this->use_signal = use_signal;
 		if (!vcdfile.is_open()) return;
 		vcdfile << stringf("$version %s $end\n", worker->date ? yosys_maybe_version() : "Yosys");
 
@@ -2350,29 +3551,31 @@ struct VCDWriter : public OutputWriter
 		);
 
 		vcdfile << stringf("$enddefinitions $end\n");
+	}
 
-		for(auto& d : worker->output_data)
+	void write_step(int time, const std::map<int, Const> &step) override
+	{
+		if (!vcdfile.is_open()) return;
+		vcdfile << stringf("#%d\n", time);
+		for (auto &data : step)
 		{
-			vcdfile << stringf("#%d\n", d.first);
-			for (auto &data : d.second)
-			{
-				if (!use_signal.at(data.first)) continue;
-				Const value = data.second;
-				vcdfile << "b";
-				for (int i = GetSize(value)-1; i >= 0; i--) {
-					switch (value[i]) {
-						case State::S0: vcdfile << "0"; break;
-						case State::S1: vcdfile << "1"; break;
-						case State::Sx: vcdfile << "x"; break;
-						default: vcdfile << "z";
-					}
+			if (!use_signal.at(data.first)) continue;
+			const Const &value = data.second;
+			vcdfile << "b";
+			for (int i = GetSize(value)-1; i >= 0; i--) {
+				switch (value[i]) {
+					case State::S0: vcdfile << "0"; break;
+					case State::S1: vcdfile << "1"; break;
+					case State::Sx: vcdfile << "x"; break;
+					default: vcdfile << "z";
 				}
-				vcdfile << stringf(" n%d\n", data.first);
 			}
+			vcdfile << stringf(" n%d\n", data.first);
 		}
 	}
 
 	std::ofstream vcdfile;
+	std::map<int, bool> use_signal;
 };
 
 struct FSTWriter : public OutputWriter
@@ -2386,8 +3589,9 @@ struct FSTWriter : public OutputWriter
 		fstWriterClose(fstfile);
 	}
 
-	void write(std::map<int, bool> &use_signal) override
+	void write_header(std::map<int, bool> &use_signal) override
 	{
+		this->use_signal = use_signal;
 		if (!fstfile) return;
 		std::time_t t = std::time(nullptr);
 		fstWriterSetVersion(fstfile, worker->date ? yosys_maybe_version() : "Yosys");
@@ -2412,30 +3616,32 @@ struct FSTWriter : public OutputWriter
 				mapping.emplace(id, fst_id);
 			}
 		);
+	}
 
-		for(auto& d : worker->output_data)
+	void write_step(int time, const std::map<int, Const> &step) override
+	{
+		if (!fstfile) return;
+		fstWriterEmitTimeChange(fstfile, time);
+		for (auto &data : step)
 		{
-			fstWriterEmitTimeChange(fstfile, d.first);
-			for (auto &data : d.second)
-			{
-				if (!use_signal.at(data.first)) continue;
-				Const value = data.second;
-				std::stringstream ss;
-				for (int i = GetSize(value)-1; i >= 0; i--) {
-					switch (value[i]) {
-						case State::S0: ss << "0"; break;
-						case State::S1: ss << "1"; break;
-						case State::Sx: ss << "x"; break;
-						default: ss << "z";
-					}
+			if (!use_signal.at(data.first)) continue;
+			const Const &value = data.second;
+			std::stringstream ss;
+			for (int i = GetSize(value)-1; i >= 0; i--) {
+				switch (value[i]) {
+					case State::S0: ss << "0"; break;
+					case State::S1: ss << "1"; break;
+					case State::Sx: ss << "x"; break;
+					default: ss << "z";
 				}
-				fstWriterEmitValueChange(fstfile, mapping[data.first], ss.str().c_str());
 			}
+			fstWriterEmitValueChange(fstfile, mapping.at(data.first), ss.str().c_str());
 		}
 	}
 
 	struct fstWriterContext *fstfile = nullptr;
 	std::map<int,fstHandle> mapping;
+	std::map<int, bool> use_signal;
 };
 
 struct AIWWriter : public OutputWriter
@@ -2449,7 +3655,7 @@ struct AIWWriter : public OutputWriter
 		aiwfile << '.' << '\n';
 	}
 
-	void write(std::map<int, bool> &) override
+	void write_header(std::map<int, bool> &) override
 	{
 		if (!aiwfile.is_open()) return;
 		if (worker->map_filename.empty())
@@ -2458,7 +3664,6 @@ struct AIWWriter : public OutputWriter
 		std::ifstream mf(worker->map_filename);
 		std::string type, symbol;
 		int variable, index;
-		int max_input = 0;
 		if (mf.fail())
 			log_cmd_error("Not able to read AIGER witness map file.\n");
 		while (mf >> type >> variable >> index >> symbol) {
@@ -2492,67 +3697,78 @@ struct AIWWriter : public OutputWriter
 			[]() {},
 			[this](const char */*name*/, int /*size*/, Wire *wire, int id, bool) { if (wire != nullptr) mapping[wire] = id; }
 		);
+	}
+
+	// The last step isn't written, so each step is only written once the
+	// next one arrives.
+	void write_step(int, const std::map<int, Const> &step) override
+	{
+		if (!aiwfile.is_open()) return;
+		if (have_pending)
+			write_pending();
+		pending = step;
+		have_pending = true;
+	}
 
-		std::map<int, Yosys::RTLIL::Const> current;
-		bool first = true;
-		for (auto iter = worker->output_data.begin(); iter != std::prev(worker->output_data.end()); ++iter)
+	void write_pending()
+	{
+		for (auto &data : pending)
 		{
-			auto& d = *iter;
-			for (auto &data : d.second)
+			current[data.first] = data.second;
+		}
+		if (first) {
+			for (int i = 0;; i++)
 			{
-				current[data.first] = data.second;
-			}
-			if (first) {
-				for (int i = 0;; i++)
-				{
-					if (aiw_latches.count(i)) {
-						aiwfile << '0';
-						continue;
-					}
-					aiwfile << '\n';
-					break;
+				if (aiw_latches.count(i)) {
+					aiwfile << '0';
+					continue;
 				}
-				first = false;
+				aiwfile << '\n';
+				break;
 			}
+			first = false;
+		}
 
-			bool skip = false;
-			for (auto it : clocks)
-			{
-				auto val = it.second ? State::S1 : State::S0;
-				SigBit bit = aiw_inputs.at(it.first);
+		bool skip = false;
+		for (auto it : clocks)
+		{
+			auto val = it.second ? State::S1 : State::S0;
+			SigBit bit = aiw_inputs.at(it.first);
+			auto v = current[mapping[bit.wire]].at(bit.offset);
+			if (v == val)
+				skip = true;
+		}
+		if (skip)
+			return;
+		for (int i = 0; i <= max_input; i++)
+		{
+			if (aiw_inputs.count(i)) {
+				SigBit bit = aiw_inputs.at(i);
 				auto v = current[mapping[bit.wire]].at(bit.offset);
-				if (v == val)
-					skip = true;
+				if (v == State::S1)
+					aiwfile << '1';
+				else
+					aiwfile << '0';
+				continue;
 			}
-			if (skip)
+			if (aiw_inits.count(i)) {
+				SigBit bit = aiw_inits.at(i);
+				auto v = current[mapping[bit.wire]].at(bit.offset);
+				if (v == State::S1)
+					aiwfile << '1';
+				else
+					aiwfile << '0';
 				continue;
-			for (int i = 0; i <= max_input; i++)
-			{
-				if (aiw_inputs.count(i)) {
-					SigBit bit = aiw_inputs.at(i);
-					auto v = current[mapping[bit.wire]].at(bit.offset);
-					if (v == State::S1)
-						aiwfile << '1';
-					else
-						aiwfile << '0';
-					continue;
-				}
-				if (aiw_inits.count(i)) {
-					SigBit bit = aiw_inits.at(i);
-					auto v = current[mapping[bit.wire]].at(bit.offset);
-					if (v == State::S1)
-						aiwfile << '1';
-					else
-						aiwfile << '0';
-					continue;
-				}
-				aiwfile << '0';
 			}
-			aiwfile << '\n';
-		} 
+			aiwfile << '0';
+		}
+		aiwfile << '\n';
 	}
 
 	std::ofstream aiwfile;
+	std::map<int, Const> current, pending;
+	bool first = true, have_pending = false;
+	int max_input = 0;
 	dict<int, std::pair<SigBit, bool>> aiw_latches;
 	dict<int, SigBit> aiw_inputs, aiw_inits;
 	dict<int, bool> clocks;
@@ -2671,6 +3887,22 @@ struct SimPass : public Pass {
 		log("        do not initialize latches and memories from an input FST or VCD file\n");
 		log("        (use the initial defined by the design instead)\n");
 		log("\n");
+		log("    -engine <name>\n");
+		log("        select the simulation engine. 'interpreted' (the default) evaluates\n");
+		log("        the cells through the generic cell evaluation as their inputs change.\n");
+		log("        'compiled' levelizes the combinational logic once, keeps the nets in\n");
+		log("        flat arrays and evaluates the common cell types with dedicated\n");
+		log("        kernels, which is much faster for long simulations of large designs.\n");
+		log("        Both engines produce the same results, except that the compiled\n");
+		log("        engine evaluates each cell at most once per delta cycle and so does\n");
+		log("        not reproduce glitches on undefined signals.\n");
+		log("\n");
+		log("    -j <N>\n");
+		log("        simulate the child instances of a module on up to N threads. This\n");
+		log("        helps designs with many large submodule instances, flattened designs\n");
+		log("        do not benefit. The results, log messages and $print output are the\n");
+		log("        same as those of a single-threaded run.\n");
+		log("\n");
 		log("    -q\n");
 		log("        disable per-cycle/sample log message\n");
 		log("\n");
@@ -2690,6 +3922,7 @@ struct SimPass : public Pass {
 		SimWorker worker;
 		int numcycles = 20;
 		int append = 0;
+		int num_threads = 1;
 		bool start_set = false, stop_set = false, at_set = false;
 
 		log_header(design, "Executing SIM pass (simulate the circuit).\n");
@@ -2849,6 +4082,22 @@ struct SimPass : public Pass {
 				worker.multiclock = true;
 				continue;
 			}
+			if (args[argidx] == "-engine" && argidx+1 < args.size()) {
+				std::string engine = args[++argidx];
+				if (engine == "compiled")
+					worker.compiled = true;
+				else if (engine == "interpreted")
+					worker.compiled = false;
+				else
+					log_cmd_error("Unknown simulation engine `%s'.\n", engine);
+				continue;
+			}
+			if (args[argidx] == "-j" && argidx+1 < args.size()) {
+				num_threads = atoi(args[++argidx].c_str());
+				if (num_threads < 1)
+					log_cmd_error("Invalid number of threads `%s'.\n", args[argidx]);
+				continue;
+			}
 			break;
 		}
 		extra_args(args, argidx, design);
@@ -2871,6 +4120,10 @@ struct SimPass : public Pass {
 			top_mod = mods.front();
 		}
 
+		int num_workers = ThreadPool::pool_size(1, num_threads - 1);
+		if (num_workers > 0)
+			worker.threads.reset(new SimThreads(num_workers));
+
 		if (worker.sim_filename.empty())
 			worker.run(top_mod, numcycles);
 		else {
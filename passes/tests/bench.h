@@ -0,0 +1,75 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "kernel/yosys.h"
+
+#include <chrono>
+
+YOSYS_NAMESPACE_BEGIN
+
+// Helpers shared by the bench_* passes.
+
+// Measures the wall clock time since it was constructed. PerformanceTimer
+// measures the CPU time of the process instead, which adds up the time of all
+// threads and so can't show the speedup of the multi-threaded measurements.
+struct BenchTimer
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	double ms() const {
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::milli>(elapsed).count();
+	}
+
+	double ns_per_op(int64_t ops) const {
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / std::max<int64_t>(ops, 1);
+	}
+};
+
+// Xorshift generator for the synthetic inputs, seeded by the -seed option.
+struct BenchRandom
+{
+	uint32_t state = 1;
+
+	uint32_t operator()() {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+};
+
+// Parses the integer option `name` (e.g. "-n") if that is what args[argidx]
+// is, clamping the value to at least `min_value`.
+template<typename T>
+bool bench_int_option(const std::vector<std::string> &args, size_t &argidx, const char *name, T &value,
+		int min_value = std::numeric_limits<int>::min())
+{
+	if (args[argidx] != name || argidx+1 >= args.size())
+		return false;
+	value = std::max(min_value, atoi(args[++argidx].c_str()));
+	return true;
+}
+
+YOSYS_NAMESPACE_END
+
+#endif
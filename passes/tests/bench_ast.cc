@@ -0,0 +1,190 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/profile.h"
+#include "frontends/ast/ast.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+using namespace AST;
+
+struct AstBench
+{
+	int num_modules;
+	int num_assigns;
+	BenchRandom rnd;
+	AstSrcLocType loc;
+
+	std::unique_ptr<AstNode> ident(int index) {
+		auto node = std::make_unique<AstNode>(loc, AST_IDENTIFIER);
+		node->str = stringf("\\net_%d", index);
+		return node;
+	}
+
+	std::unique_ptr<AstNode> wire(int index, int port_id, bool is_input, bool is_output) {
+		auto node = std::make_unique<AstNode>(loc, AST_WIRE, std::make_unique<AstNode>(loc, AST_RANGE,
+				AstNode::mkconst_int(loc, 7, true), AstNode::mkconst_int(loc, 0, true)));
+		node->str = stringf("\\net_%d", index);
+		node->port_id = port_id;
+		node->is_input = is_input;
+		node->is_output = is_output;
+		return node;
+	}
+
+	// A module like a generated netlist: eight 8-bit inputs and one 8-bit
+	// output, and a chain of continuous assignments to 8-bit wires, each
+	// combining two or three earlier wires or a wire and a constant.
+	std::unique_ptr<AstNode> make_module(int index)
+	{
+		auto module = std::make_unique<AstNode>(loc, AST_MODULE);
+		module->str = stringf("\\bench_%d", index);
+		const int num_inputs = 8;
+		for (int i = 0; i < num_inputs; i++)
+			module->children.push_back(wire(i, i + 1, true, false));
+		module->children.push_back(wire(num_inputs + num_assigns - 1, num_inputs + 1, false, true));
+
+		for (int i = num_inputs; i < num_inputs + num_assigns; i++) {
+			if (i != num_inputs + num_assigns - 1)
+				module->children.push_back(wire(i, 0, false, false));
+			auto operand = [&]() { return ident(i - 1 - rnd() % std::min(i, 50)); };
+			std::unique_ptr<AstNode> expr;
+			switch (rnd() % 4) {
+			case 0:
+				expr = std::make_unique<AstNode>(loc, AST_BIT_XOR, std::make_unique<AstNode>(loc, AST_BIT_AND, operand(), operand()), operand());
+				break;
+			case 1:
+				expr = std::make_unique<AstNode>(loc, AST_ADD, operand(), AstNode::mkconst_int(loc, rnd() % 256, false, 8));
+				break;
+			case 2:
+				expr = std::make_unique<AstNode>(loc, AST_TERNARY, std::make_unique<AstNode>(loc, AST_LT, operand(), operand()), operand(), operand());
+				break;
+			default:
+				expr = std::make_unique<AstNode>(loc, AST_BIT_OR, operand(), std::make_unique<AstNode>(loc, AST_BIT_NOT, operand()));
+				break;
+			}
+			module->children.push_back(std::make_unique<AstNode>(loc, AST_ASSIGN, ident(i), std::move(expr)));
+		}
+		return module;
+	}
+
+	void report(const char *what, double ms, int64_t peak_before, const std::string &result)
+	{
+		log("  %-24s %10.1f %14.1f  %s\n", what, ms, (profile_peak_rss() - peak_before) / 1048576.0, result);
+	}
+
+	void execute()
+	{
+		loc.begin.filename = std::make_shared<std::string>("<bench_ast>");
+		loc.end = loc.begin;
+
+		log("  %-24s %10s %14s\n", "step", "time [ms]", "peak RSS [MB]");
+
+		unsigned long long nodes_before = astnode_count();
+		int64_t peak = profile_peak_rss();
+		BenchTimer build;
+		auto design_ast = std::make_unique<AstNode>(loc, AST_DESIGN);
+		for (int i = 0; i < num_modules; i++)
+			design_ast->children.push_back(make_module(i));
+		unsigned long long num_nodes = astnode_count() - nodes_before;
+		report("build", build.ms(), peak, stringf("%llu nodes", num_nodes));
+
+		// derive() and process_module() clone the AST of every module
+		peak = profile_peak_rss();
+		BenchTimer clone;
+		auto copy = design_ast->clone();
+		report("clone", clone.ms(), peak, "");
+
+		peak = profile_peak_rss();
+		BenchTimer destroy_copy;
+		copy.reset();
+		report("destroy clone", destroy_copy.ms(), peak, "");
+
+		RTLIL::Design scratch;
+		peak = profile_peak_rss();
+		BenchTimer process;
+		AST::process(&scratch, design_ast.get(), false, false, false, false, false, false, false, false, false, false, false, false,
+				false, false, false, false, false, false, false, false, true, "");
+		int num_cells = 0;
+		for (auto module : scratch.modules())
+			num_cells += GetSize(module->cells());
+		report("AST::process", process.ms(), peak, stringf("%d cells", num_cells));
+
+		peak = profile_peak_rss();
+		BenchTimer destroy;
+		design_ast.reset();
+		report("destroy", destroy.ms(), peak, "");
+	}
+};
+
+struct BenchAstPass : public Pass {
+	BenchAstPass() : Pass("bench_ast", "microbenchmark for the AST frontend library") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_ast [options]\n");
+		log("\n");
+		log("Measure the time and the increase of the peak memory usage for building,\n");
+		log("cloning, elaborating with AST::process (the part of read_verilog after\n");
+		log("parsing) and deleting the AST of a large generated netlist. The generated\n");
+		log("modules are added to a scratch design, not to the current one.\n");
+		log("\n");
+		log("To measure read_verilog including the parser, run it on a large file under\n");
+		log("the `profile` command instead.\n");
+		log("\n");
+		log("    -modules {integer}\n");
+		log("        number of modules (default = 10).\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of assignments in each module (default = 20000).\n");
+		log("\n");
+		log("    -seed {integer}\n");
+		log("        seed for the random netlist (default = 1).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		AstBench bench;
+		bench.num_modules = 10;
+		bench.num_assigns = 20000;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-modules", bench.num_modules))
+				continue;
+			if (bench_int_option(args, argidx, "-n", bench.num_assigns))
+				continue;
+			if (bench_int_option(args, argidx, "-seed", bench.rnd.state, 1))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Executing BENCH_AST pass.\n");
+		if (bench.num_modules < 1 || bench.num_assigns < 1)
+			log_cmd_error("Need at least one module and one assignment.\n");
+		bench.execute();
+	}
+} BenchAstPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,196 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct HashlibBench
+{
+	int num_iterations;
+	int64_t checksum = 0;
+
+	// Returns ns/op for insert, lookup (hit), lookup (miss), iterate and erase.
+	template<typename K>
+	std::array<double, 5> run_pool(const std::vector<K> &keys, const std::vector<K> &misses)
+	{
+		std::array<double, 5> r = {0, 0, 0, 0, 0};
+		int64_t n = int64_t(num_iterations) * GetSize(keys);
+
+		for (int k = 0; k < num_iterations; k++)
+		{
+			pool<K> p;
+
+			BenchTimer insert;
+			for (auto &key : keys)
+				p.insert(key);
+			r[0] += insert.ns_per_op(n);
+
+			BenchTimer lookup;
+			for (auto &key : keys)
+				checksum += p.count(key);
+			r[1] += lookup.ns_per_op(n);
+
+			BenchTimer miss;
+			for (auto &key : misses)
+				checksum += p.count(key);
+			r[2] += miss.ns_per_op(int64_t(num_iterations) * GetSize(misses));
+
+			BenchTimer iterate;
+			for (auto &key : p)
+				checksum += key == keys.front();
+			r[3] += iterate.ns_per_op(n);
+
+			BenchTimer erase;
+			for (auto &key : keys)
+				p.erase(key);
+			r[4] += erase.ns_per_op(n);
+		}
+		return r;
+	}
+
+	template<typename K>
+	std::array<double, 5> run_dict(const std::vector<K> &keys, const std::vector<K> &misses)
+	{
+		std::array<double, 5> r = {0, 0, 0, 0, 0};
+		int64_t n = int64_t(num_iterations) * GetSize(keys);
+
+		for (int k = 0; k < num_iterations; k++)
+		{
+			dict<K, int> d;
+
+			BenchTimer insert;
+			int i = 0;
+			for (auto &key : keys)
+				d[key] = i++;
+			r[0] += insert.ns_per_op(n);
+
+			BenchTimer lookup;
+			for (auto &key : keys)
+				checksum += d.at(key);
+			r[1] += lookup.ns_per_op(n);
+
+			BenchTimer miss;
+			for (auto &key : misses)
+				checksum += d.count(key);
+			r[2] += miss.ns_per_op(int64_t(num_iterations) * GetSize(misses));
+
+			BenchTimer iterate;
+			for (auto &it : d)
+				checksum += it.second;
+			r[3] += iterate.ns_per_op(n);
+
+			BenchTimer erase;
+			for (auto &key : keys)
+				d.erase(key);
+			r[4] += erase.ns_per_op(n);
+		}
+		return r;
+	}
+
+	void report(const std::string &name, int num_keys, const std::array<double, 5> &r)
+	{
+		log("  %-24s %9d %9.1f %9.1f %9.1f %9.1f %9.1f\n", name.c_str(), num_keys, r[0], r[1], r[2], r[3], r[4]);
+	}
+
+	template<typename K>
+	void run(const std::string &name, const std::vector<K> &keys, const std::vector<K> &misses)
+	{
+		if (keys.empty())
+			return;
+		report(stringf("pool<%s>", name.c_str()), GetSize(keys), run_pool(keys, misses));
+		report(stringf("dict<%s, int>", name.c_str()), GetSize(keys), run_dict(keys, misses));
+	}
+
+	void execute(RTLIL::Design *design)
+	{
+		// Keys are taken from the selected modules. The other half of every
+		// module's objects serves as the set of keys that are looked up
+		// but not present.
+		std::vector<SigBit> bits, miss_bits;
+		std::vector<IdString> ids, miss_ids;
+		std::vector<Cell*> cells, miss_cells;
+
+		for (auto module : design->selected_modules()) {
+			int i = 0;
+			for (auto wire : module->selected_wires()) {
+				for (int offset = 0; offset < wire->width; offset++)
+					(i % 2 ? miss_bits : bits).push_back(SigBit(wire, offset));
+				(i % 2 ? miss_ids : ids).push_back(wire->name);
+				i++;
+			}
+			for (auto cell : module->selected_cells()) {
+				(i % 2 ? miss_cells : cells).push_back(cell);
+				(i % 2 ? miss_ids : ids).push_back(cell->name);
+				i++;
+			}
+		}
+
+#ifdef YOSYS_HASHLIB_SWISS
+		log("  hash table implementation: open addressing (YOSYS_HASHLIB_SWISS)\n\n");
+#else
+		log("  hash table implementation: separate chaining\n\n");
+#endif
+		log("  %-24s %9s %9s %9s %9s %9s %9s\n", "[ns/op]", "keys", "insert", "lookup", "miss", "iterate", "erase");
+		run("SigBit", bits, miss_bits);
+		run("IdString", ids, miss_ids);
+		run("Cell*", cells, miss_cells);
+		log_debug("  checksum %lld\n", (long long)checksum);
+	}
+};
+
+struct BenchHashlibPass : public Pass {
+	BenchHashlibPass() : Pass("bench_hashlib", "microbenchmark for dict<> and pool<>") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_hashlib [options] [selection]\n");
+		log("\n");
+		log("Measure insert, lookup, failed lookup, iteration and erase for pool<> and dict<>\n");
+		log("keyed by SigBit, IdString and Cell*, using the wires and cells of the selected\n");
+		log("modules as keys. Compare builds with ENABLE_HASHLIB_SWISS=0 and =1 to compare\n");
+		log("the two hash table implementations.\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of times each measurement is repeated (default = 10).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		HashlibBench bench;
+		bench.num_iterations = 10;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-n", bench.num_iterations))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		log_header(design, "Executing BENCH_HASHLIB pass.\n");
+		bench.execute(design);
+	}
+} BenchHashlibPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,187 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/threading.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct IdStringBench
+{
+	int num_names;
+	int num_copies;
+	int run = 0;
+
+	std::vector<std::string> make_names(int thread, int count)
+	{
+		std::vector<std::string> names;
+		names.reserve(count);
+		for (int i = 0; i < count; i++)
+			names.push_back(stringf("\\bench_idstring$%d$%d$%d", run, thread, i));
+		return names;
+	}
+
+	// Interns, looks up, copies and releases names on the calling thread.
+	// Returns ns/op for each of the four phases.
+	std::array<double, 4> single_thread(const std::vector<std::string> &names)
+	{
+		std::array<double, 4> result;
+		std::vector<IdString> ids;
+		ids.reserve(names.size());
+
+		BenchTimer intern;
+		for (auto &name : names)
+			ids.emplace_back(name);
+		result[0] = intern.ns_per_op(GetSize(names));
+
+		BenchTimer lookup;
+		int mismatches = 0;
+		for (int i = 0; i < GetSize(names); i++)
+			mismatches += IdString(names[i]) != ids[i];
+		result[1] = lookup.ns_per_op(GetSize(names));
+		log_assert(mismatches == 0);
+
+		BenchTimer copy;
+		for (int k = 0; k < num_copies; k++)
+			for (auto &id : ids) {
+				IdString tmp = id;
+				(void)tmp;
+			}
+		result[2] = copy.ns_per_op(int64_t(num_copies) * GetSize(ids));
+
+		BenchTimer release;
+		ids.clear();
+		result[3] = release.ns_per_op(GetSize(names));
+		return result;
+	}
+
+	void report(const char *mode, const std::array<double, 4> &r)
+	{
+		log("  %-28s %10.1f %10.1f %10.1f %10.1f\n", mode, r[0], r[1], r[2], r[3]);
+	}
+
+	void execute(int num_threads)
+	{
+		log("  %-28s %10s %10s %10s %10s\n", "mode [ns/op]", "intern", "lookup", "copy", "release");
+
+		run++;
+		report("default", single_thread(make_names(0, num_names)));
+
+		// In concurrent mode releasing only records the refcount change, the
+		// names are actually freed when the scope is left, so that is included
+		// in the release column.
+		run++;
+		{
+			auto names = make_names(0, num_names);
+			std::optional<RTLIL::IdString::ConcurrentScope> scope;
+			scope.emplace();
+			auto r = single_thread(names);
+			BenchTimer reconcile;
+			scope.reset();
+			r[3] += reconcile.ns_per_op(GetSize(names));
+			report("concurrent, 1 thread", r);
+		}
+
+		if (num_threads <= 1)
+			return;
+
+		run++;
+		int per_thread = num_names / num_threads;
+		std::vector<std::vector<std::string>> names(num_threads);
+		for (int t = 0; t < num_threads; t++)
+			names[t] = make_names(t, per_thread);
+
+		std::vector<std::array<double, 4>> results(num_threads);
+		std::optional<RTLIL::IdString::ConcurrentScope> scope;
+		scope.emplace();
+		BenchTimer wall;
+		{
+			ThreadPool pool(num_threads, [&](int t) {
+				results[t] = single_thread(names[t]);
+			});
+		}
+		double wall_ns = wall.ns_per_op(int64_t(per_thread) * num_threads);
+		BenchTimer reconcile;
+		scope.reset();
+		double reconcile_ns = reconcile.ns_per_op(int64_t(per_thread) * num_threads);
+
+		std::array<double, 4> r = {0, 0, 0, 0};
+		for (auto &tr : results)
+			for (int i = 0; i < 4; i++)
+				r[i] += tr[i] / num_threads;
+		r[3] += reconcile_ns;
+		report(stringf("concurrent, %d threads", num_threads).c_str(), r);
+		log("  wall time per name with %d threads: %.1f ns (+ %.1f ns reconciling)\n", num_threads, wall_ns, reconcile_ns);
+	}
+};
+
+struct BenchIdstringPass : public Pass {
+	BenchIdstringPass() : Pass("bench_idstring", "microbenchmark for IdString interning") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_idstring [options]\n");
+		log("\n");
+		log("Measure the cost of creating, looking up, copying and releasing IdStrings,\n");
+		log("both in the default single-threaded mode and in concurrent interning mode\n");
+		log("(see RTLIL::IdString::ConcurrentScope).\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of distinct names to intern (default = 1000000).\n");
+		log("\n");
+		log("    -copies {integer}\n");
+		log("        number of times each name is copied (default = 10).\n");
+		log("\n");
+		log("    -j {integer}\n");
+		log("        additionally run the benchmark split over this many threads,\n");
+		log("        all interning concurrently (default = 0, i.e. don't).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		IdStringBench bench;
+		bench.num_names = 1000000;
+		bench.num_copies = 10;
+		int num_threads = 0;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-n", bench.num_names))
+				continue;
+			if (bench_int_option(args, argidx, "-copies", bench.num_copies))
+				continue;
+			if (bench_int_option(args, argidx, "-j", num_threads))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Executing BENCH_IDSTRING pass.\n");
+#ifndef YOSYS_ENABLE_THREADS
+		num_threads = 0;
+#endif
+		bench.execute(num_threads);
+	}
+} BenchIdstringPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,206 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "backends/rtlil/rtlil_backend.h"
+#include "frontends/rtlil/rtlil_frontend.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct RtlilBench
+{
+	int num_modules;
+	int num_cells;
+	BenchRandom rnd;
+
+	// A module like the output of synthesis: eight 8-bit inputs, a chain of
+	// 8-bit binary cells, each reading two earlier wires, and a process
+	// registering the last one.
+	void make_module(std::string &text, int index)
+	{
+		text += stringf("attribute \\src \"bench.v:%d.1-%d.10\"\n", index, index);
+		text += stringf("module \\bench_%d\n", index);
+		const int num_inputs = 8;
+		for (int i = 0; i < num_inputs; i++)
+			text += stringf("  wire width 8 input %d \\net_%d\n", i + 1, i);
+		text += stringf("  wire input %d \\clk\n", num_inputs + 1);
+		text += stringf("  wire width 8 output %d \\q\n", num_inputs + 2);
+
+		static const char *cell_types[] = { "$and", "$or", "$xor", "$add", "$sub" };
+		for (int i = num_inputs; i < num_inputs + num_cells; i++) {
+			text += stringf("  attribute \\src \"bench.v:%d.5-%d.40\"\n", i, i);
+			text += stringf("  wire width 8 \\net_%d\n", i);
+			text += stringf("  attribute \\src \"bench.v:%d.5-%d.40\"\n", i, i);
+			text += stringf("  cell %s $cell_%d\n", cell_types[rnd() % 5], i);
+			text += "    parameter \\A_SIGNED 0\n    parameter \\A_WIDTH 8\n";
+			text += "    parameter \\B_SIGNED 0\n    parameter \\B_WIDTH 8\n";
+			text += "    parameter \\Y_WIDTH 8\n";
+			text += stringf("    connect \\A \\net_%d\n", i - 1 - rnd() % std::min(i, 50));
+			text += stringf("    connect \\B { \\net_%d [3:0] \\net_%d [7:4] }\n",
+					i - 1 - rnd() % std::min(i, 50), i - 1 - rnd() % std::min(i, 50));
+			text += stringf("    connect \\Y \\net_%d\n", i);
+			text += "  end\n";
+		}
+
+		int last = num_inputs + num_cells - 1;
+		text += "  process $proc\n";
+		text += stringf("    switch \\net_%d [0]\n", last);
+		text += stringf("      case 1'1\n        assign \\q \\net_%d\n", last);
+		text += stringf("      case\n        assign \\q 8'00000000\n");
+		text += "    end\n";
+		text += "    sync posedge \\clk\n";
+		text += "  end\n";
+		text += "end\n";
+	}
+
+	void report(const std::string &what, double ms, const std::string &result)
+	{
+		log("  %-32s %10.1f  %s\n", what, ms, result);
+	}
+
+	std::string dump(RTLIL::Design *design)
+	{
+		std::ostringstream buf;
+		RTLIL_BACKEND::dump_design(buf, design, false);
+		return buf.str();
+	}
+
+	void execute(std::string text, int num_threads)
+	{
+		if (text.empty())
+			for (int i = 0; i < num_modules; i++)
+				make_module(text, i);
+		log("RTLIL text with %.1f MB.\n\n", text.size() / 1048576.0);
+		log("  %-32s %10s  %s\n", "step", "time [ms]", "MB/s");
+		auto throughput = [&](double ms) { return stringf("%.1f", text.size() / 1048576.0 / (ms / 1000.0)); };
+
+		std::string legacy_dump;
+		{
+			RTLIL::Design legacy;
+			std::istringstream f(text);
+			BenchTimer timer;
+			RTLIL_FRONTEND::lexin = &f;
+			RTLIL_FRONTEND::current_design = &legacy;
+			RTLIL_FRONTEND::flag_nooverwrite = false;
+			RTLIL_FRONTEND::flag_overwrite = false;
+			RTLIL_FRONTEND::flag_lib = false;
+			rtlil_frontend_yydebug = false;
+			rtlil_frontend_yyrestart(NULL);
+			rtlil_frontend_yyparse();
+			rtlil_frontend_yylex_destroy();
+			double ms = timer.ms();
+			report("flex/bison parser", ms, throughput(ms));
+			legacy_dump = dump(&legacy);
+		}
+
+		std::vector<int> thread_counts = {0, 1};
+		if (num_threads > 1)
+			thread_counts.push_back(num_threads);
+
+		for (int threads : thread_counts) {
+			RTLIL::Design design;
+			BenchTimer timer;
+			RTLIL_FRONTEND::parse_text(&design, text.data(), text.data() + text.size(), false, false, false, threads);
+			double ms = timer.ms();
+			report(threads == 0 ? "hand-written parser" : stringf("hand-written parser, -j %d", threads), ms, throughput(ms));
+			if (dump(&design) != legacy_dump)
+				log_error("The design read with %s differs from the one read by the flex/bison parser.\n",
+						threads == 0 ? "the hand-written parser" : stringf("-j %d", threads));
+		}
+	}
+};
+
+struct BenchRtlilPass : public Pass {
+	BenchRtlilPass() : Pass("bench_rtlil", "microbenchmark for the RTLIL frontend") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_rtlil [options]\n");
+		log("\n");
+		log("Measure the time to parse a large RTLIL text with the flex/bison parser\n");
+		log("(read_rtlil -legacy) and with the hand-written parser, on one thread and on\n");
+		log("several with the -j option of read_rtlil, and check that all of them read\n");
+		log("the same design. The text is parsed from memory into scratch designs, not\n");
+		log("into the current one.\n");
+		log("\n");
+		log("    -modules {integer}\n");
+		log("        number of generated modules (default = 50).\n");
+		log("\n");
+		log("    -cells {integer}\n");
+		log("        number of cells in each generated module (default = 5000).\n");
+		log("\n");
+		log("    -seed {integer}\n");
+		log("        seed for the generated netlist (default = 1).\n");
+		log("\n");
+		log("    -file {filename}\n");
+		log("        parse the given RTLIL file instead of a generated one.\n");
+		log("\n");
+		log("    -j {integer}\n");
+		log("        additionally run the hand-written parser on this many threads\n");
+		log("        (default = 0, i.e. don't).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		RtlilBench bench;
+		bench.num_modules = 50;
+		bench.num_cells = 5000;
+		std::string filename;
+		int num_threads = 0;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-modules", bench.num_modules))
+				continue;
+			if (bench_int_option(args, argidx, "-cells", bench.num_cells))
+				continue;
+			if (bench_int_option(args, argidx, "-seed", bench.rnd.state, 1))
+				continue;
+			if (args[argidx] == "-file" && argidx+1 < args.size()) {
+				filename = args[++argidx];
+				continue;
+			}
+			if (bench_int_option(args, argidx, "-j", num_threads))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Executing BENCH_RTLIL pass.\n");
+		if (filename.empty() && (bench.num_modules < 1 || bench.num_cells < 1))
+			log_cmd_error("Need at least one module and one cell.\n");
+
+		std::string text;
+		if (!filename.empty()) {
+			std::ifstream f(filename);
+			if (f.fail())
+				log_cmd_error("Can't open input file `%s' for reading: %s\n", filename, strerror(errno));
+			std::stringstream buf;
+			buf << f.rdbuf();
+			text = buf.str();
+		}
+		bench.execute(text, num_threads);
+	}
+} BenchRtlilPass;
+
+PRIVATE_NAMESPACE_END
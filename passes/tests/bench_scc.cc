@@ -0,0 +1,178 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "kernel/topo_scc.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct SccBench
+{
+	int num_nodes;
+	int max_ring;
+	int num_loops;
+	BenchRandom rnd;
+
+	// A netlist-like graph: every node has two edges to nodes at most 1000
+	// positions further on, so these edges alone form a deep acyclic graph.
+	// For the SCC benchmark, num_loops short rings of up to max_ring nodes are
+	// closed by adding an edge back to the start of the ring.
+	void make_edges(std::vector<std::pair<int, int>> &dag_edges, std::vector<std::pair<int, int>> &loop_edges)
+	{
+		for (int i = 0; i < num_nodes; i++)
+			for (int k = 0; k < 2; k++) {
+				int j = i + 1 + rnd() % 1000;
+				if (j < num_nodes)
+					dag_edges.emplace_back(i, j);
+			}
+		for (int i = 0; i < num_loops; i++) {
+			int start = rnd() % num_nodes;
+			int length = 1 + rnd() % max_ring;
+			if (start + length >= num_nodes)
+				continue;
+			for (int j = 0; j < length; j++)
+				loop_edges.emplace_back(start + j, start + j + 1);
+			loop_edges.emplace_back(start + length, start);
+		}
+	}
+
+	void report(const char *what, double ms, const std::string &result)
+	{
+		log("  %-32s %10.1f  %s\n", what, ms, result);
+	}
+
+	void execute(int num_threads)
+	{
+		std::vector<std::pair<int, int>> dag_edges, loop_edges;
+		make_edges(dag_edges, loop_edges);
+		std::vector<std::pair<int, int>> edges = dag_edges;
+		edges.insert(edges.end(), loop_edges.begin(), loop_edges.end());
+		log("Graph with %d nodes and %d edges (%d without the loops).\n\n", num_nodes, GetSize(edges), GetSize(dag_edges));
+		log("  %-32s %10s\n", "step", "time [ms]");
+
+		BenchTimer build;
+		CsrGraph graph(num_nodes, edges);
+		report("build CSR graph", build.ms(), "");
+
+		BenchTimer transpose;
+		CsrGraph reversed = graph.transposed();
+		report("transpose", transpose.ms(), "");
+
+		int num_components = 0, num_cyclic = 0;
+		BenchTimer tarjan;
+		TopoSortedSccs(graph, [&](int *begin, int *end) {
+			num_components++;
+			num_cyclic += end - begin > 1;
+		}).process_all();
+		report("TopoSortedSccs", tarjan.ms(), stringf("%d components, %d cyclic", num_components, num_cyclic));
+
+		std::vector<int> thread_counts = {1};
+		if (num_threads > 1)
+			thread_counts.push_back(num_threads);
+
+		for (int threads : thread_counts) {
+			std::vector<int> component;
+			BenchTimer timer;
+			int count = parallel_sccs(graph, component, threads);
+			double ms = timer.ms();
+			report(stringf("parallel_sccs, %d thread%s", threads, threads > 1 ? "s" : "").c_str(), ms,
+					stringf("%d components", count));
+			log_assert(count == num_components);
+		}
+
+		CsrGraph dag(num_nodes, dag_edges);
+		for (int threads : thread_counts) {
+			std::vector<int> level;
+			BenchTimer timer;
+			bool acyclic = parallel_levels(dag, level, threads);
+			double ms = timer.ms();
+			log_assert(acyclic);
+			report(stringf("parallel_levels, %d thread%s", threads, threads > 1 ? "s" : "").c_str(), ms,
+					stringf("%d levels", 1 + *std::max_element(level.begin(), level.end())));
+		}
+	}
+};
+
+struct BenchSccPass : public Pass {
+	BenchSccPass() : Pass("bench_scc", "microbenchmark for SCC and level computation") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_scc [options]\n");
+		log("\n");
+		log("Measure the time to build a CsrGraph, find its strongly connected components\n");
+		log("with TopoSortedSccs and parallel_sccs, and levelize its acyclic part with\n");
+		log("parallel_levels, on a random graph shaped like a large netlist.\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of nodes (default = 1000000).\n");
+		log("\n");
+		log("    -loops {integer}\n");
+		log("        number of loops added to the acyclic graph (default = 1000).\n");
+		log("\n");
+		log("    -ring {integer}\n");
+		log("        maximum number of nodes in a loop (default = 100).\n");
+		log("\n");
+		log("    -seed {integer}\n");
+		log("        seed for the random graph (default = 1).\n");
+		log("\n");
+		log("    -j {integer}\n");
+		log("        additionally run the parallel algorithms on this many threads\n");
+		log("        (default = 0, i.e. don't).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		SccBench bench;
+		bench.num_nodes = 1000000;
+		bench.num_loops = 1000;
+		bench.max_ring = 100;
+		int num_threads = 0;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-n", bench.num_nodes))
+				continue;
+			if (bench_int_option(args, argidx, "-loops", bench.num_loops))
+				continue;
+			if (bench_int_option(args, argidx, "-ring", bench.max_ring, 1))
+				continue;
+			if (bench_int_option(args, argidx, "-seed", bench.rnd.state, 1))
+				continue;
+			if (bench_int_option(args, argidx, "-j", num_threads))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design, false);
+
+		log_header(design, "Executing BENCH_SCC pass.\n");
+		if (bench.num_nodes < 2)
+			log_cmd_error("Need at least 2 nodes.\n");
+#ifndef YOSYS_ENABLE_THREADS
+		num_threads = 0;
+#endif
+		bench.execute(num_threads);
+	}
+} BenchSccPass;
+
+PRIVATE_NAMESPACE_END
@@ -0,0 +1,193 @@
+/*
+ *  yosys -- Yosys Open SYnthesis Suite
+ *
+ *  Permission to use, copy, modify, and/or distribute this software for any
+ *  purpose with or without fee is hereby granted, provided that the above
+ *  copyright notice and this permission notice appear in all copies.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ *  WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ *  MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ *  ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ *  WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ *  ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ *  OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ *
+ */
+
+#include "kernel/yosys.h"
+#include "passes/tests/bench.h"
+
+USING_YOSYS_NAMESPACE
+PRIVATE_NAMESPACE_BEGIN
+
+struct SigSpecBench
+{
+	int num_iterations;
+
+	void memory_stats(const std::vector<SigSpec> &sigs)
+	{
+		int64_t num_empty = 0, num_bit = 0, num_chunk = 0, num_packed = 0, num_bits = 0;
+		int64_t heap_bytes = 0, total_bits = 0, total_chunks = 0;
+
+		for (auto &sig : sigs) {
+			int width = GetSize(sig);
+			int chunks = GetSize(sig.chunks());
+			total_bits += width;
+			total_chunks += chunks;
+			if (width == 0) {
+				num_empty++;
+			} else if (width == 1) {
+				num_bit++;
+			} else if (chunks == 1) {
+				num_chunk++;
+				if (sig.is_fully_const())
+					heap_bytes += width * sizeof(State);
+			} else {
+				// a packed chunk is the chunk and its offset in the signal,
+				// signals with many short chunks are kept as bits instead
+				size_t packed_chunk_size = sizeof(std::pair<int, SigChunk>);
+				if (chunks * packed_chunk_size > width * sizeof(SigBit)) {
+					num_bits++;
+					heap_bytes += width * sizeof(SigBit);
+				} else {
+					num_packed++;
+					for (auto &chunk : sig.chunks())
+						heap_bytes += packed_chunk_size + chunk.data.size() * sizeof(State);
+				}
+			}
+		}
+
+		log("  sizeof(SigSpec) = %d, sizeof(SigChunk) = %d, sizeof(SigBit) = %d\n",
+				int(sizeof(SigSpec)), int(sizeof(SigChunk)), int(sizeof(SigBit)));
+		log("  %lld signals, %lld bits, %lld chunks\n", (long long)GetSize(sigs),
+				(long long)total_bits, (long long)total_chunks);
+		log("  %-28s %10lld\n", "empty", (long long)num_empty);
+		log("  %-28s %10lld\n", "single bit", (long long)num_bit);
+		log("  %-28s %10lld\n", "single chunk", (long long)num_chunk);
+		log("  %-28s %10lld\n", "packed chunks", (long long)num_packed);
+		log("  %-28s %10lld\n", "bit vector", (long long)num_bits);
+		log("  %-28s %10lld\n", "heap bytes", (long long)heap_bytes);
+	}
+
+	void timing(const std::vector<SigSpec> &sigs)
+	{
+		int64_t ops = int64_t(num_iterations) * GetSize(sigs);
+		int64_t dummy = 0;
+
+		BenchTimer construct;
+		for (int k = 0; k < num_iterations; k++)
+			for (auto &sig : sigs) {
+				SigSpec tmp;
+				for (auto bit : sig)
+					tmp.append(bit);
+				dummy += GetSize(tmp);
+			}
+		double construct_ns = construct.ns_per_op(ops);
+
+		BenchTimer copy;
+		for (int k = 0; k < num_iterations; k++)
+			for (auto &sig : sigs) {
+				SigSpec tmp = sig;
+				dummy += GetSize(tmp);
+			}
+		double copy_ns = copy.ns_per_op(ops);
+
+		BenchTimer iterate;
+		for (int k = 0; k < num_iterations; k++)
+			for (auto &sig : sigs)
+				for (auto &bit : sig)
+					dummy += bit.wire != nullptr;
+		double iterate_ns = iterate.ns_per_op(ops);
+
+		BenchTimer index;
+		for (int k = 0; k < num_iterations; k++)
+			for (auto &sig : sigs)
+				for (int i = 0; i < GetSize(sig); i++)
+					dummy += sig[i].wire != nullptr;
+		double index_ns = index.ns_per_op(ops);
+
+		BenchTimer chunks;
+		for (int k = 0; k < num_iterations; k++)
+			for (auto &sig : sigs)
+				for (auto &chunk : sig.chunks())
+					dummy += chunk.width;
+		double chunks_ns = chunks.ns_per_op(ops);
+
+		// copies share the cached hash, so hash freshly built signals, which
+		// are built outside of the timed loop
+		double hash_ns = 0;
+		for (int k = 0; k < num_iterations; k++) {
+			std::vector<SigSpec> fresh;
+			fresh.reserve(GetSize(sigs));
+			for (auto &sig : sigs)
+				fresh.emplace_back(sig.to_sigbit_vector());
+			BenchTimer hash;
+			for (auto &sig : fresh)
+				dummy += sig.hash_into(Hasher()).yield() & 1;
+			hash_ns += hash.ns_per_op(ops);
+		}
+
+		log("  %-28s %10s %10s %10s %10s %10s %10s\n", "[ns/signal]", "construct", "copy", "iterate", "index", "chunks", "hash");
+		log("  %-28s %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n", "", construct_ns, copy_ns, iterate_ns, index_ns, chunks_ns, hash_ns);
+		log_debug("  checksum %lld\n", (long long)dummy);
+	}
+
+	void execute(RTLIL::Design *design)
+	{
+		std::vector<SigSpec> sigs;
+		for (auto module : design->selected_modules()) {
+			for (auto cell : module->selected_cells())
+				for (auto &conn : cell->connections())
+					sigs.push_back(conn.second);
+			for (auto &conn : module->connections()) {
+				sigs.push_back(conn.first);
+				sigs.push_back(conn.second);
+			}
+		}
+
+		memory_stats(sigs);
+		log("\n");
+		timing(sigs);
+	}
+};
+
+struct BenchSigspecPass : public Pass {
+	BenchSigspecPass() : Pass("bench_sigspec", "microbenchmark for SigSpec storage") {
+		internal();
+	}
+	void help() override
+	{
+		//   |---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|---v---|
+		log("\n");
+		log("    bench_sigspec [options] [selection]\n");
+		log("\n");
+		log("Collect the signals connected to the selected cells and the module connections\n");
+		log("and report how they are stored and how much memory they use. Then measure the\n");
+		log("cost of building each signal bit by bit, copying it, iterating over its bits,\n");
+		log("indexing its bits, iterating over its chunks and hashing it.\n");
+		log("\n");
+		log("    -n {integer}\n");
+		log("        number of times each measurement is repeated (default = 10).\n");
+		log("\n");
+	}
+	void execute(std::vector<std::string> args, RTLIL::Design *design) override
+	{
+		SigSpecBench bench;
+		bench.num_iterations = 10;
+
+		size_t argidx;
+		for (argidx = 1; argidx < args.size(); argidx++)
+		{
+			if (bench_int_option(args, argidx, "-n", bench.num_iterations))
+				continue;
+			break;
+		}
+		extra_args(args, argidx, design);
+
+		log_header(design, "Executing BENCH_SIGSPEC pass.\n");
+		bench.execute(design);
+	}
+} BenchSigspecPass;
+
+PRIVATE_NAMESPACE_END
@@ -29,3 +29,10 @@ $YS --hash-seed=2345678 -p "read_rtlil temp/roundtrip-text.dump.il; write_rtlil
 remove_empty_lines temp/roundtrip-text.reload-hash.il
 tail -n +2 temp/roundtrip-text.reload-hash.il > temp/roundtrip-text.reload-hash-nogen.il
 diff temp/roundtrip-text.dump.il temp/roundtrip-text.reload-hash-nogen.il
+
+# The flex/bison parser and the hand-written one, on one or more threads, read the same design
+$YS -p "read_rtlil temp/roundtrip-text.dump.il; write_rtlil temp/roundtrip-text.reader.il"
+$YS -p "read_rtlil -legacy temp/roundtrip-text.dump.il; write_rtlil temp/roundtrip-text.legacy.il"
+$YS -p "read_rtlil -j 4 temp/roundtrip-text.dump.il; write_rtlil temp/roundtrip-text.threads.il"
+diff temp/roundtrip-text.reader.il temp/roundtrip-text.legacy.il
+diff temp/roundtrip-text.reader.il temp/roundtrip-text.threads.il
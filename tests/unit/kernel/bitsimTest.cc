@@ -0,0 +1,111 @@
+#include <gtest/gtest.h>
+#include "kernel/bitsim.h"
+#include "kernel/consteval.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+class KernelBitSimTest : public testing::Test {
+protected:
+	KernelBitSimTest() {
+		if (log_files.empty()) log_files.emplace_back(stdout);
+	}
+	virtual void SetUp() override {
+		yosys_setup();
+	}
+};
+
+TEST_F(KernelBitSimTest, MatchesConstEval)
+{
+	Design design;
+	Module *module = design.addModule(ID(top));
+	std::vector<Wire*> inputs;
+	for (auto &it : std::vector<std::pair<IdString, int>>{{ID(a), 8}, {ID(b), 8}, {ID(c), 8}, {ID(s), 3}}) {
+		inputs.push_back(module->addWire(it.first, it.second));
+		inputs.back()->port_input = true;
+	}
+	SigSpec a = inputs[0], b = inputs[1], c = inputs[2], s = inputs[3];
+
+	SigSpec outputs;
+	auto out = [&](int width) {
+		SigSpec sig = module->addWire(NEW_ID, width);
+		outputs.append(sig);
+		return sig;
+	};
+
+	SigSpec sum = out(9);
+	module->addAdd(NEW_ID, a, b, sum);
+	module->addSub(NEW_ID, sum, c, out(10), true);
+	module->addLt(NEW_ID, a, b, out(1), true);
+	module->addEq(NEW_ID, sum, {c, Const(0, 1)}, out(1));
+	module->addEqx(NEW_ID, a, c, out(2));
+	module->addXor(NEW_ID, a, c, out(8));
+	module->addReduceXor(NEW_ID, b, out(1));
+	module->addLogicAnd(NEW_ID, s, c, out(1));
+	module->addMux(NEW_ID, a, b, s[0], out(8));
+	module->addPmux(NEW_ID, a, {b, c, sum.extract(0, 8)}, s, out(8));
+	module->addShl(NEW_ID, a, s, out(12));
+	module->addShr(NEW_ID, a, s, out(6), true);
+	module->addSshr(NEW_ID, a, s, out(12), true);
+	module->addSshl(NEW_ID, a, b.extract(0, 4), out(8), true);
+	module->addAoi3Gate(NEW_ID, a[0], b[0], c[0], out(1));
+	module->addMuxGate(NEW_ID, a[1], b[1], s[1], out(1));
+	module->addXorGate(NEW_ID, a[2], outputs[0], out(1));
+
+	BitSim sim(module, 128);
+	EXPECT_TRUE(sim.unsupported_cells.empty());
+	EXPECT_TRUE(sim.loop_cells.empty());
+
+	uint64_t rng = 1;
+	ConstEval ce(module);
+	for (int round = 0; round < 4; round++) {
+		sim.randomize(rng);
+		sim.run();
+		for (int lane = 0; lane < sim.lanes(); lane++) {
+			ce.clear();
+			for (auto wire : inputs)
+				ce.set(wire, sim.get(SigSpec(wire), lane));
+			SigSpec expected = outputs, undef;
+			ASSERT_TRUE(ce.eval(expected, undef));
+			Const got = sim.get(outputs, lane);
+			Const want = expected.as_const();
+			for (int i = 0; i < GetSize(want); i++)
+				if (want[i] == State::S0 || want[i] == State::S1)
+					ASSERT_EQ(got[i], want[i]) << "bit " << i << " of lane " << lane;
+		}
+	}
+}
+
+TEST_F(KernelBitSimTest, ClockedCounter)
+{
+	Design design;
+	Module *module = design.addModule(ID(top));
+	Wire *clk = module->addWire(ID(clk));
+	Wire *en = module->addWire(ID(en));
+	Wire *rst = module->addWire(ID(rst));
+	Wire *q = module->addWire(ID(q), 4);
+	Wire *d = module->addWire(ID(d), 4);
+	q->attributes[ID::init] = Const(3, 4);
+	module->addAdd(NEW_ID, q, Const(1, 4), d);
+	module->addSdffe(NEW_ID, clk, en, rst, d, q, Const(0, 4));
+
+	BitSim sim(module, 64);
+	EXPECT_EQ(GetSize(sim.state_bits()), 4);
+
+	uint64_t rng = 1;
+	sim.init_state(rng);
+	sim.set_all(en, true);
+	sim.set_all(rst, false);
+	// lane 1 is never enabled, lane 2 is reset in the third cycle
+	sim.set(en, 1, false);
+	for (int cycle = 0; cycle < 5; cycle++) {
+		sim.set(rst, 2, cycle == 2);
+		sim.run();
+		sim.clock();
+	}
+	sim.run();
+	EXPECT_EQ(sim.get(SigSpec(q), 0).as_int(), 8);
+	EXPECT_EQ(sim.get(SigSpec(q), 1).as_int(), 3);
+	EXPECT_EQ(sim.get(SigSpec(q), 2).as_int(), 2);
+}
+
+YOSYS_NAMESPACE_END
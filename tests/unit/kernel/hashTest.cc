@@ -64,4 +64,75 @@ TEST(PoolHashTest, subset_collisions)
 	EXPECT_LT(collisions, 100);
 }
 
+TEST(DictTest, matches_std_map)
+{
+	// pseudo-random mix of inserts, lookups and erases, checked against
+	// std::map, with keys from a small range to get plenty of erase hits
+	dict<int, int> d;
+	std::map<int, int> ref;
+	std::vector<int> order;
+	uint32_t x = 1;
+	for (int i = 0; i < 100000; ++i) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		int key = x % 2000;
+		switch ((x >> 16) % 4) {
+		case 0:
+		case 1:
+			d[key] = i;
+			ref[key] = i;
+			break;
+		case 2:
+			EXPECT_EQ(d.erase(key), int(ref.erase(key)));
+			break;
+		case 3:
+			EXPECT_EQ(d.count(key), int(ref.count(key)));
+			if (ref.count(key)) {
+				EXPECT_EQ(d.at(key), ref.at(key));
+			}
+			break;
+		}
+		ASSERT_EQ(d.size(), ref.size());
+	}
+	for (auto &it : ref)
+		EXPECT_EQ(d.at(it.first), it.second);
+}
+
+TEST(DictTest, insertion_order)
+{
+	dict<int, int> d;
+	for (int i = 0; i < 1000; ++i)
+		d[i * 7919 % 1000] = i;
+	// iteration is in reverse insertion order
+	int i = 999;
+	for (auto &it : d) {
+		EXPECT_EQ(it.first, i * 7919 % 1000);
+		EXPECT_EQ(it.second, i);
+		i--;
+	}
+	// erasing moves the last inserted entry into the gap
+	d.erase(0);
+	EXPECT_EQ(d.begin()->first, 998 * 7919 % 1000);
+	EXPECT_EQ(d.element(GetSize(d) - 1)->first, 999 * 7919 % 1000);
+	EXPECT_EQ(d.at(999 * 7919 % 1000), 999);
+}
+
+TEST(PoolTest, erase_and_reinsert)
+{
+	pool<int> p;
+	for (int round = 0; round < 10; ++round) {
+		for (int i = 0; i < 1000; ++i)
+			p.insert(i);
+		for (int i = 0; i < 1000; i += 2)
+			p.erase(i);
+		EXPECT_EQ(GetSize(p), 500);
+		for (int i = 0; i < 1000; ++i)
+			EXPECT_EQ(p.count(i), i % 2);
+		for (int i = 1; i < 1000; i += 2)
+			p.erase(i);
+		EXPECT_TRUE(p.empty());
+	}
+}
+
 YOSYS_NAMESPACE_END
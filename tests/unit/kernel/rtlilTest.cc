@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
 #include "kernel/rtlil.h"
+#include "kernel/threading.h"
+#include "kernel/sigtools.h"
+#include "kernel/modtools.h"
 
 YOSYS_NAMESPACE_BEGIN
 
@@ -206,6 +209,75 @@ namespace RTLIL {
 		}
 	}
 
+	TEST_F(KernelRtlilTest, ConstIntern) {
+		{
+			// Equal values share the same pooled value
+			Const c1(std::string("foo.v:1.2-3.4"));
+			Const c2(std::string("foo.v:1.2-3.4"));
+			c1.intern();
+			c2.intern();
+			EXPECT_TRUE(c1.is_interned());
+			EXPECT_EQ(c1.shared_, c2.shared_);
+			EXPECT_EQ(c1.decode_string(), "foo.v:1.2-3.4");
+			EXPECT_TRUE(c1.flags & CONST_FLAG_STRING);
+			Const c3(c1);
+			EXPECT_EQ(c3.shared_, c1.shared_);
+			EXPECT_EQ(c3.hash_into(Hasher()).yield(), Const(std::string("foo.v:1.2-3.4")).hash_into(Hasher()).yield());
+		}
+
+		{
+			// Reads of a packed value
+			Const c = Const::from_string("10xz10xz1");
+			Const plain(c);
+			c.intern();
+			EXPECT_TRUE(c.is_interned());
+			EXPECT_EQ(c.shared_->kind, Const::Shared::Kind::packed);
+			EXPECT_EQ(c.size(), 9);
+			EXPECT_EQ(c.as_string(), "10xz10xz1");
+			EXPECT_TRUE(c == plain);
+			EXPECT_TRUE(plain == c);
+			EXPECT_FALSE(c.is_fully_def());
+			EXPECT_EQ(c.hash_into(Hasher()).yield(), plain.hash_into(Hasher()).yield());
+		}
+
+		{
+			// Values with don't-care bits aren't packed
+			Const c = Const::from_string("1-0");
+			c.intern();
+			EXPECT_EQ(c.shared_->kind, Const::Shared::Kind::unpacked);
+			EXPECT_EQ(c.as_string(), "1-0");
+		}
+
+		{
+			// Modifying an interned value doesn't affect its other users
+			Const c1(5, 8);
+			Const c2(5, 8);
+			c1.intern();
+			c2.intern();
+			EXPECT_EQ(c1.as_int(), 5);
+			c2.set(1, State::S1);
+			EXPECT_FALSE(c2.is_interned());
+			EXPECT_EQ(c2.as_int(), 7);
+			EXPECT_EQ(c1.as_int(), 5);
+			c2 = c1;
+			EXPECT_TRUE(c2.is_interned());
+			EXPECT_EQ(c2.as_int(), 5);
+		}
+
+		{
+			// Unreferenced values are freed by collect()
+			ConstPool::collect();
+			int entries = ConstPool::stats().entries;
+			{
+				Const c(0x1234567, 27);
+				c.intern();
+				EXPECT_EQ(ConstPool::stats().entries, entries + 1);
+			}
+			ConstPool::collect();
+			EXPECT_EQ(ConstPool::stats().entries, entries);
+		}
+	}
+
 	TEST_F(KernelRtlilTest, ConstConstIteratorWorks) {
 		const Const c(0x2, 2);
 		Const::const_iterator it = c.begin();
@@ -361,6 +433,402 @@ namespace RTLIL {
 		EXPECT_FALSE(Const().is_onehot(&pos));
 	}
 
+	TEST_F(KernelRtlilTest, IdStringConcurrentInterning) {
+		IdString existing("\\concurrent_existing");
+		int num_threads = std::max(ThreadPool::pool_size(0, 4), 1);
+		std::vector<std::vector<IdString>> results(num_threads);
+		auto body = [&](int t) {
+			for (int i = 0; i < 1000; i++) {
+				results[t].push_back(IdString(stringf("\\concurrent_%d", i % 100)));
+				results[t].push_back(existing);
+			}
+		};
+		{
+			IdString::ConcurrentScope scope;
+			{
+				// the workers are joined when the pool is destroyed
+				ThreadPool pool(ThreadPool::pool_size(0, 4), body);
+				if (pool.num_threads() == 0)
+					body(0);
+			}
+			EXPECT_EQ(results[0][0].str(), "\\concurrent_0");
+		}
+
+		for (int t = 0; t < num_threads; t++) {
+			ASSERT_EQ(GetSize(results[t]), 2000);
+			for (int i = 0; i < 2000; i++)
+				EXPECT_EQ(results[t][i], results[0][i]);
+		}
+		for (int i = 0; i < 100; i++) {
+			EXPECT_EQ(results[0][2*i], IdString(stringf("\\concurrent_%d", i)));
+			EXPECT_EQ(results[0][2*i].str(), stringf("\\concurrent_%d", i));
+			EXPECT_EQ(results[0][2*i+1], existing);
+		}
+	}
+
+	TEST_F(KernelRtlilTest, IdStringConcurrentRefcount) {
+		int temporary_idx, kept_idx;
+		IdString kept;
+		{
+			IdString::ConcurrentScope scope;
+			IdString temporary("\\concurrent_temporary");
+			temporary_idx = temporary.index_;
+			kept = IdString("\\concurrent_kept");
+			kept_idx = kept.index_;
+			{
+				IdString::ConcurrentScope nested;
+				IdString copy = kept;
+			}
+			// leaving a nested scope doesn't reconcile anything yet
+			EXPECT_EQ(kept.str(), "\\concurrent_kept");
+			EXPECT_EQ(temporary.str(), "\\concurrent_temporary");
+		}
+
+		// names only referenced within the scope are freed when it is left
+		EXPECT_EQ(IdString::global_id_storage_.at(temporary_idx), nullptr);
+		EXPECT_EQ(IdString::global_refcount_storage_.at(kept_idx), 1u);
+		EXPECT_EQ(kept, IdString("\\concurrent_kept"));
+	}
+
+	TEST_F(KernelRtlilTest, ParallelForModules) {
+		Design design;
+		std::vector<Module*> modules;
+		for (int i = 0; i < 8; i++) {
+			Module *module = design.addModule(stringf("\\parallel_%d", i));
+			for (int j = 0; j < 10 * i; j++)
+				module->addWire(stringf("\\w%d", j));
+			modules.push_back(module);
+		}
+
+		int base = autoidx;
+		std::vector<IdString> new_wires(GetSize(modules));
+		parallel_for_modules(&design, modules, [&](int idx, Module *module) {
+			new_wires[idx] = module->addWire(NEW_ID, idx + 1)->name;
+		});
+
+		// every module draws NEW_ID indices from the same starting point
+		for (int i = 0; i < GetSize(modules); i++) {
+			EXPECT_EQ(new_wires[i], new_wires[0]);
+			EXPECT_EQ(modules[i]->wire(new_wires[i])->width, i + 1);
+		}
+		EXPECT_EQ(autoidx, base + 1);
+
+		EXPECT_THROW(parallel_for_modules(&design, modules, [&](int idx, Module *) {
+			if (idx == 3)
+				throw std::runtime_error("module 3");
+		}), std::runtime_error);
+	}
+
+	static Hasher::hash_t hash(const SigSpec &sig) {
+		Hasher h;
+		h = sig.hash_into(h);
+		return h.yield();
+	}
+
+	TEST_F(KernelRtlilTest, SigSpecEqualAcrossRepresentations) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *w = module->addWire(ID(w), 8);
+
+		// built bit by bit, but ends up as the same single chunk
+		SigSpec by_bits;
+		for (int i = 2; i < 6; i++)
+			by_bits.append(SigBit(w, i));
+		SigSpec by_chunk(w, 2, 4);
+		EXPECT_EQ(by_bits, by_chunk);
+		EXPECT_EQ(hash(by_bits), hash(by_chunk));
+		EXPECT_TRUE(by_bits.is_chunk());
+		EXPECT_FALSE(by_bits < by_chunk);
+		EXPECT_FALSE(by_chunk < by_bits);
+
+		std::vector<SigBit> v = {SigBit(w, 0), SigBit(w, 1)};
+		EXPECT_EQ(SigSpec(v), SigSpec(w, 0, 2));
+		EXPECT_EQ(SigSpec(SigBit(w, 3)), SigSpec(w, 3, 1));
+		EXPECT_EQ(SigSpec(), SigSpec(Const()));
+
+		SigSpec mixed = {SigSpec(w, 4, 2), Const(5, 3)};
+		SigSpec mixed_bits(mixed.to_sigbit_vector());
+		EXPECT_EQ(mixed, mixed_bits);
+		EXPECT_EQ(hash(mixed), hash(mixed_bits));
+		EXPECT_NE(mixed, SigSpec(w, 0, 5));
+	}
+
+	TEST_F(KernelRtlilTest, SigSpecAppendMerges) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *a = module->addWire(ID(a), 4);
+		Wire *b = module->addWire(ID(b), 4);
+
+		SigSpec sig(a, 0, 2);
+		sig.append(SigSpec(a, 2, 2));
+		EXPECT_TRUE(sig.is_wire());
+		EXPECT_EQ(sig.as_wire(), a);
+
+		SigSpec c(State::S1);
+		c.append(State::S0);
+		c.append(Const(3, 2));
+		EXPECT_TRUE(c.is_fully_const());
+		EXPECT_TRUE(c.is_chunk());
+		EXPECT_EQ(c.as_const(), Const(0xd, 4));
+
+		sig.append(b);
+		sig.append(c);
+		EXPECT_EQ(GetSize(sig), 12);
+		EXPECT_EQ(GetSize(sig.chunks()), 3);
+		EXPECT_EQ(sig.extract(4, 4), SigSpec(b));
+		EXPECT_EQ(sig.extract(8, 4).as_const(), Const(0xd, 4));
+		EXPECT_EQ(sig[5], SigBit(b, 1));
+
+		SigSpec twice = sig;
+		twice.append(twice);
+		EXPECT_EQ(GetSize(twice), 24);
+		EXPECT_EQ(twice.extract(12, 12), sig);
+	}
+
+	TEST_F(KernelRtlilTest, SigSpecMutateBits) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *w = module->addWire(ID(w), 4);
+
+		SigSpec sig(w);
+		SigSpec copy = sig;
+		sig[1] = State::S0;
+		EXPECT_NE(sig, copy);
+		EXPECT_EQ(sig[1], SigBit(State::S0));
+		EXPECT_EQ(GetSize(sig.chunks()), 3);
+		sig[1] = SigBit(w, 1);
+		EXPECT_EQ(sig, copy);
+		EXPECT_EQ(hash(sig), hash(copy));
+
+		sig.reverse();
+		EXPECT_EQ(sig[0], SigBit(w, 3));
+		sig.sort();
+		EXPECT_EQ(sig, copy);
+
+		sig.remove(1, 2);
+		EXPECT_EQ(sig, SigSpec({SigSpec(w, 3, 1), SigSpec(w, 0, 1)}));
+		sig.replace(SigSpec(w, 0, 1), State::S1);
+		EXPECT_EQ(sig[0], SigBit(State::S1));
+	}
+
+	TEST_F(KernelRtlilTest, SigSpecPackedChunks) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *a = module->addWire(ID(a), 8);
+		Wire *b = module->addWire(ID(b), 8);
+
+		// {b[7:4], 2'b10, a[3], a[7:0]}
+		SigSpec sig = {SigSpec(b, 4, 4), Const(2, 2), SigBit(a, 3), SigSpec(a)};
+		std::vector<SigBit> bits = sig.to_sigbit_vector();
+		EXPECT_EQ(GetSize(sig), 15);
+		EXPECT_EQ(GetSize(sig.chunks()), 4);
+		EXPECT_EQ(sig.chunks().back(), SigChunk(b, 4, 4));
+		for (int i = 0; i < GetSize(sig); i++)
+			EXPECT_EQ(sig[i], bits[i]);
+		for (int i = GetSize(sig) - 1; i >= 0; i--)
+			EXPECT_EQ(sig.extract(i, 1), SigSpec(bits[i]));
+
+		EXPECT_EQ(sig.extract(6, 6), SigSpec({SigSpec(b, 4, 1), Const(2, 2), SigBit(a, 3), SigSpec(a, 6, 2)}));
+		EXPECT_EQ(sig.extract(9, 2).as_const(), Const(2, 2));
+		EXPECT_TRUE(sig.extract(0, 8).is_wire());
+
+		// removing the constant joins a[7:0] and a[3] but not b
+		SigSpec no_const = sig;
+		no_const.remove_const();
+		EXPECT_EQ(GetSize(no_const.chunks()), 3);
+		EXPECT_EQ(no_const, SigSpec({SigSpec(b, 4, 4), SigBit(a, 3), SigSpec(a)}));
+		no_const.remove(8, 1);
+		EXPECT_EQ(no_const, SigSpec({SigSpec(b, 4, 4), SigSpec(a)}));
+
+		SigSpec replaced = sig;
+		replaced.replace(8, SigSpec(a, 0, 3));
+		EXPECT_EQ(replaced, SigSpec({SigSpec(b, 4, 4), SigSpec(a, 0, 3), SigSpec(a)}));
+		EXPECT_EQ(GetSize(replaced.chunks()), 3);
+
+		// an unpacked signal compares and hashes like the packed one,
+		// and is packed again when copied
+		SigSpec unpacked = sig;
+		unpacked[0] = SigBit(a, 0);
+		EXPECT_EQ(unpacked, sig);
+		EXPECT_EQ(hash(unpacked), hash(sig));
+		SigSpec packed = unpacked;
+		EXPECT_EQ(packed, sig);
+		EXPECT_FALSE(packed < sig);
+		EXPECT_EQ(GetSize(packed.chunks()), 4);
+
+		// scattered bits are kept as a bit vector, which is smaller
+		SigSpec repeated(SigBit(a, 1), 3);
+		EXPECT_EQ(GetSize(repeated.chunks()), 3);
+		EXPECT_EQ(repeated, SigSpec({SigBit(a, 1), SigBit(a, 1), SigBit(a, 1)}));
+		SigSpec scattered;
+		for (int i = 0; i < 8; i += 2) {
+			scattered.append(SigBit(a, i));
+			scattered.append(SigBit(b, i));
+		}
+		EXPECT_EQ(GetSize(scattered.chunks()), 8);
+		EXPECT_EQ(scattered, SigSpec(scattered.to_sigbit_vector()));
+		EXPECT_EQ(hash(scattered), hash(SigSpec(scattered.to_sigbit_vector())));
+		scattered.append(SigSpec(a));
+		EXPECT_EQ(scattered.extract(8, 8), SigSpec(a));
+		EXPECT_EQ(scattered[7], SigBit(b, 6));
+	}
+
+	TEST_F(KernelRtlilTest, ModuleArenaReuse) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		std::vector<Cell*> cells;
+		for (int i = 0; i < 100; i++) {
+			Wire *w = module->addWire(stringf("\\w%d", i), i + 1);
+			cells.push_back(module->addNot(stringf("\\c%d", i), w, w));
+		}
+
+		Cell *removed = cells[42];
+		module->remove(removed);
+		Cell *added = module->addCell(ID(replacement), ID($not));
+		EXPECT_EQ(added, removed);
+		EXPECT_EQ(module->cell(ID(replacement)), added);
+		EXPECT_EQ(module->cell(ID(c42)), nullptr);
+
+		Module *copy = design.addModule(ID(copy));
+		module->cloneInto(copy);
+		EXPECT_EQ(GetSize(copy->cells()), 100);
+		EXPECT_EQ(copy->wire(ID(w99))->width, 100);
+		EXPECT_EQ(copy->cell(ID(c7))->getPort(ID::A), SigSpec(copy->wire(ID(w7))));
+
+		module->remove({module->wire(ID(w3))});
+		EXPECT_EQ(module->wire(ID(w3)), nullptr);
+		// the cell connected to it gets a fresh wire from the arena
+		SigSpec replaced = module->cell(ID(c3))->getPort(ID::A);
+		EXPECT_TRUE(replaced.is_wire());
+		EXPECT_EQ(GetSize(replaced), 4);
+	}
+
+	TEST_F(KernelRtlilTest, IncrementalSigMap) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *a = module->addWire(ID(a), 4);
+		Wire *b = module->addWire(ID(b), 4);
+		Wire *c = module->addWire(ID(c), 4);
+		Wire *d = module->addWire(ID(d), 4);
+		module->connect(a, b);
+
+		IncrementalSigMap sigmap(module);
+		EXPECT_EQ(sigmap(a), sigmap(b));
+		EXPECT_NE(sigmap(a), sigmap(c));
+
+		module->connect(c, b);
+		module->connect(SigSpec(State::S0, 4), d);
+		EXPECT_EQ(sigmap(a), sigmap(c));
+		EXPECT_EQ(sigmap(d), SigSpec(d));
+		module->connect(SigSpec(d).extract(0, 2), Const(2, 2));
+		EXPECT_EQ(sigmap(SigBit(d, 1)), SigBit(State::S1));
+
+		// reordering and appending doesn't need a rebuild
+		auto conns = module->connections();
+		std::reverse(conns.begin(), conns.end());
+		conns.push_back(SigSig(SigSpec(d).extract(2, 2), SigSpec(a).extract(0, 2)));
+		module->new_connections(conns);
+		EXPECT_EQ(sigmap(SigBit(d, 3)), sigmap(SigBit(c, 1)));
+		EXPECT_EQ(sigmap.rebuild_count, 0);
+
+		SigMap reference(module);
+		for (auto wire : module->wires())
+			EXPECT_EQ(sigmap(wire), reference(wire));
+
+		// dropping a connection does
+		conns.erase(conns.begin() + 1);
+		module->new_connections(conns);
+		EXPECT_EQ(sigmap.rebuild_count, 0);
+		reference.set(module);
+		for (auto wire : module->wires())
+			EXPECT_EQ(sigmap(wire), reference(wire));
+		EXPECT_EQ(sigmap.rebuild_count, 1);
+
+		// and so does removing a connected wire
+		module->remove({b});
+		reference.set(module);
+		for (auto wire : module->wires())
+			EXPECT_EQ(sigmap(wire), reference(wire));
+		EXPECT_EQ(sigmap.rebuild_count, 2);
+		EXPECT_NE(sigmap(a), sigmap(c));
+	}
+
+	TEST_F(KernelRtlilTest, ModIndexCached) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *a = module->addWire(ID(a));
+		Wire *b = module->addWire(ID(b));
+		Wire *y = module->addWire(ID(y));
+		y->port_output = true;
+		module->fixup_ports();
+		Cell *cell = module->addAnd(ID(and), a, b, y);
+
+		ModIndex &index = ModIndex::cached(module);
+		EXPECT_EQ(&ModIndex::cached(module), &index);
+		EXPECT_TRUE(index.query_is_output(y));
+		EXPECT_EQ(GetSize(index.query_ports(a)), 1);
+
+		// edits are tracked between uses
+		Wire *c = module->addWire(ID(c));
+		module->connect(c, a);
+		module->addNot(ID(not), c, b);
+		module->rename(cell, ID(and2));
+		module->rename(a, ID(a2));
+		EXPECT_EQ(GetSize(ModIndex::cached(module).query_ports(c)), 2);
+
+		// port directions are checked when the index is handed out
+		a->port_input = true;
+		module->fixup_ports();
+		EXPECT_TRUE(ModIndex::cached(module).query_is_input(c));
+
+		// in-place edits aren't tracked, so the index only lives until the
+		// end of the pass
+		EXPECT_TRUE(design.modindex_cache->holds(module, &index));
+		design.modindex_cache->pass_finished();
+		EXPECT_EQ(GetSize(design.modindex_cache->indices), 0);
+
+		ModIndex::cached(module);
+		design.remove(module);
+		EXPECT_EQ(GetSize(design.modindex_cache->indices), 0);
+	}
+
+	TEST_F(KernelRtlilTest, IncrementalSigMapCached) {
+		Design design;
+		Module *module = design.addModule(ID(top));
+		Wire *a = module->addWire(ID(a));
+		Wire *b = module->addWire(ID(b));
+		Wire *c = module->addWire(ID(c));
+		module->connect(a, b);
+
+		IncrementalSigMap &sigmap = IncrementalSigMap::cached(module);
+		EXPECT_EQ(&IncrementalSigMap::cached(module), &sigmap);
+		EXPECT_EQ(sigmap(a), sigmap(b));
+
+		// rewriting that doesn't change any connection isn't a rebuild
+		auto unchanged = [](SigSpec &) { };
+		module->rewrite_sigspecs(unchanged);
+		EXPECT_EQ(sigmap(a), sigmap(b));
+		EXPECT_EQ(sigmap.rebuild_count, 0);
+
+		module->connect(c, b);
+		EXPECT_EQ(sigmap(c), sigmap(a));
+		EXPECT_EQ(sigmap.rebuild_count, 0);
+
+		// kept across the passes of a scope such as the opt loop, dropped at
+		// the end of any other pass
+		{
+			ModIndexCache::Keep keep(&design);
+			design.modindex_cache->pass_finished();
+			EXPECT_TRUE(design.modindex_cache->holds(module, &sigmap));
+		}
+		design.modindex_cache->pass_finished();
+		EXPECT_EQ(GetSize(design.modindex_cache->sigmaps), 0);
+
+		IncrementalSigMap::cached(module);
+		design.remove(module);
+		EXPECT_EQ(GetSize(design.modindex_cache->sigmaps), 0);
+	}
+
 	class WireRtlVsHdlIndexConversionTest :
 		public KernelRtlilTest,
 		public testing::WithParamInterface<std::tuple<bool, int, int>>
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "kernel/satgen.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+static SatSolver *lookup_solver(const std::string &name)
+{
+	for (auto solver = yosys_satsolver_list; solver != nullptr; solver = solver->next)
+		if (solver->name == name)
+			return solver;
+	return nullptr;
+}
+
+static std::vector<ezBackendSAT::factory_t> portfolio_factories()
+{
+	std::vector<ezBackendSAT::factory_t> factories;
+	for (auto name : {"minisat", "minisat-rnd", "minisat-geom"}) {
+		SatSolver *solver = lookup_solver(name);
+		factories.push_back([solver]() { return solver->create_backend(); });
+	}
+	return factories;
+}
+
+// Adds the same random 3-SAT instance to each solver and checks that they
+// agree on satisfiability under a sequence of assumptions, and that the
+// models they find are valid.
+static void check_random_3sat(std::vector<ezSAT*> solvers, uint32_t seed)
+{
+	const int num_vars = 60, num_clauses = 250;
+	std::vector<std::vector<int>> clauses;
+	auto rnd = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+	for (int i = 0; i < num_clauses; i++) {
+		std::vector<int> clause;
+		for (int j = 0; j < 3; j++)
+			clause.push_back((rnd() % num_vars + 1) * (rnd() % 2 ? 1 : -1));
+		clauses.push_back(clause);
+	}
+
+	std::vector<std::vector<int>> vars(solvers.size());
+	for (int k = 0; k < GetSize(solvers); k++) {
+		ezSAT *ez = solvers[k];
+		for (int i = 0; i < num_vars; i++)
+			vars[k].push_back(ez->frozen_literal());
+		for (auto &clause : clauses) {
+			std::vector<int> lits;
+			for (auto lit : clause)
+				lits.push_back(lit > 0 ? vars[k][lit-1] : ez->NOT(vars[k][-lit-1]));
+			ez->assume(ez->expression(ezSAT::OpOr, lits));
+		}
+	}
+
+	for (int round = 0; round < 8; round++) {
+		int a = rnd() % num_vars, b = rnd() % num_vars;
+		bool pol_a = rnd() % 2, pol_b = rnd() % 2;
+		std::vector<bool> results;
+		for (int k = 0; k < GetSize(solvers); k++) {
+			ezSAT *ez = solvers[k];
+			int assume_a = pol_a ? vars[k][a] : ez->NOT(vars[k][a]);
+			int assume_b = pol_b ? vars[k][b] : ez->NOT(vars[k][b]);
+			std::vector<bool> model;
+			bool sat = ez->solve(vars[k], model, assume_a, assume_b);
+			results.push_back(sat);
+			if (!sat)
+				continue;
+			EXPECT_EQ(model[a], pol_a);
+			EXPECT_EQ(model[b], pol_b);
+			for (auto &clause : clauses) {
+				bool satisfied = false;
+				for (auto lit : clause)
+					satisfied |= lit > 0 ? model[lit-1] : !model[-lit-1];
+				EXPECT_TRUE(satisfied);
+			}
+		}
+		for (int k = 1; k < GetSize(solvers); k++)
+			EXPECT_EQ(results[k], results[0]) << "round " << round << " solver " << k;
+	}
+}
+
+TEST(KernelSatBackendTest, SingleBackendMatchesMinisat)
+{
+	for (uint32_t seed = 1; seed <= 20; seed++) {
+		ezMiniSAT reference;
+		ezBackendSAT single({[]() { return lookup_solver("minisat-geom")->create_backend(); }});
+		check_random_3sat({&reference, &single}, seed);
+	}
+}
+
+TEST(KernelSatBackendTest, PortfolioMatchesMinisat)
+{
+	for (uint32_t seed = 1; seed <= 20; seed++) {
+		ezMiniSAT reference;
+		ezBackendSAT portfolio(portfolio_factories());
+		check_random_3sat({&reference, &portfolio}, seed);
+	}
+}
+
+// Pigeonhole formulas are hard enough for the portfolio members to run
+// in parallel.
+static void add_pigeonhole(ezSAT &ez, int holes)
+{
+	std::vector<std::vector<int>> in(holes + 1);
+	for (int p = 0; p <= holes; p++) {
+		for (int h = 0; h < holes; h++)
+			in[p].push_back(ez.frozen_literal());
+		ez.assume(ez.expression(ezSAT::OpOr, in[p]));
+	}
+	for (int h = 0; h < holes; h++)
+		for (int p = 0; p <= holes; p++)
+			for (int q = p+1; q <= holes; q++)
+				ez.assume(ez.NOT(ez.AND(in[p][h], in[q][h])));
+}
+
+TEST(KernelSatBackendTest, PortfolioPigeonhole)
+{
+	ezBackendSAT ez(portfolio_factories());
+	add_pigeonhole(ez, 8);
+	EXPECT_FALSE(ez.solve());
+	EXPECT_FALSE(ez.getSolverTimoutStatus());
+	EXPECT_GE(ez.last_winner(), 0);
+}
+
+TEST(KernelSatBackendTest, PortfolioTimeout)
+{
+	ezBackendSAT ez(portfolio_factories());
+	add_pigeonhole(ez, 14);
+	ez.setSolverTimeout(1);
+	EXPECT_FALSE(ez.solve());
+	EXPECT_TRUE(ez.getSolverTimoutStatus());
+	EXPECT_EQ(ez.last_winner(), -1);
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "kernel/timinggraph.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+struct TimingGraphTestEdge {
+	int from, to, delay;
+};
+
+// Builds the graph from scratch, for comparison with a graph that was
+// updated incrementally.
+static void build_reference(TimingGraph &ref, int num_nodes, const std::vector<TimingGraphTestEdge> &edges,
+		const std::vector<int> &launch, const std::vector<int> &capture)
+{
+	for (int i = 0; i < num_nodes; i++) {
+		ref.add_node();
+		ref.set_launch(i, launch[i]);
+		ref.set_capture(i, capture[i]);
+	}
+	for (auto &e : edges)
+		ref.add_edge(e.from, e.to, e.delay);
+	ASSERT_TRUE(ref.update());
+}
+
+TEST(KernelTimingGraphTest, IncrementalMatchesFromScratch)
+{
+	const int num_nodes = 60;
+	uint32_t seed = 1;
+	auto rnd = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+
+	TimingGraph graph;
+	std::vector<int> launch(num_nodes, TimingGraph::NONE), capture(num_nodes, TimingGraph::NONE);
+	for (int i = 0; i < num_nodes; i++)
+		graph.add_node();
+
+	// edges always go from a lower to a higher node index, so that the
+	// graph stays acyclic, but are added in random order so that levels have
+	// to be raised
+	std::vector<TimingGraphTestEdge> edges;
+	std::vector<int> edge_ids;
+
+	for (int round = 0; round < 300; round++) {
+		int edits = 1 + rnd() % 4;
+		for (int j = 0; j < edits; j++) {
+			int op = rnd() % 10;
+			if (op < 5 || edges.empty()) {
+				int a = rnd() % num_nodes, b = rnd() % num_nodes;
+				if (a == b)
+					continue;
+				if (a > b)
+					std::swap(a, b);
+				int delay = rnd() % 20;
+				edges.push_back({a, b, delay});
+				edge_ids.push_back(graph.add_edge(a, b, delay));
+			} else if (op < 7) {
+				int i = rnd() % GetSize(edges);
+				graph.remove_edge(edge_ids[i]);
+				edges.erase(edges.begin() + i);
+				edge_ids.erase(edge_ids.begin() + i);
+			} else if (op < 8) {
+				int i = rnd() % GetSize(edges);
+				edges[i].delay = rnd() % 20;
+				graph.set_delay(edge_ids[i], edges[i].delay);
+			} else if (op < 9) {
+				int i = rnd() % num_nodes;
+				launch[i] = rnd() % 3 ? TimingGraph::NONE : int(rnd() % 5);
+				graph.set_launch(i, launch[i]);
+			} else {
+				int i = rnd() % num_nodes;
+				capture[i] = rnd() % 3 ? TimingGraph::NONE : int(rnd() % 5);
+				graph.set_capture(i, capture[i]);
+			}
+		}
+		ASSERT_TRUE(graph.update());
+
+		TimingGraph ref;
+		build_reference(ref, num_nodes, edges, launch, capture);
+		for (int i = 0; i < num_nodes; i++) {
+			EXPECT_EQ(graph.arrival(i), ref.arrival(i)) << "round " << round << " node " << i;
+			EXPECT_EQ(graph.departure(i), ref.departure(i)) << "round " << round << " node " << i;
+			for (int edge : graph.fanout(i))
+				EXPECT_LT(graph.level(i), graph.level(graph.edge_to(edge)));
+		}
+	}
+}
+
+TEST(KernelTimingGraphTest, Loops)
+{
+	TimingGraph graph;
+	for (int i = 0; i < 4; i++)
+		graph.add_node();
+	graph.set_launch(0, 0);
+	graph.set_capture(3, 0);
+	graph.add_edge(0, 1, 1);
+	graph.add_edge(1, 2, 1);
+	graph.add_edge(2, 3, 1);
+	ASSERT_TRUE(graph.update());
+	EXPECT_EQ(graph.arrival(3), 3);
+
+	int back = graph.add_edge(2, 1, 1);
+	EXPECT_FALSE(graph.update());
+	EXPECT_EQ(graph.loop_nodes(), std::vector<int>({1, 2, 3}));
+
+	graph.remove_edge(back);
+	ASSERT_TRUE(graph.update());
+	EXPECT_EQ(graph.arrival(3), 3);
+	EXPECT_EQ(graph.departure(0), 3);
+}
+
+// Enumerates all paths from start points to end points by depth-first search.
+static void all_path_times(const TimingGraph &graph, int node, int time, std::vector<int> &times)
+{
+	if (graph.capture(node) != TimingGraph::NONE)
+		times.push_back(time + graph.capture(node));
+	for (int edge : graph.fanout(node))
+		all_path_times(graph, graph.edge_to(edge), time + graph.edge_delay(edge), times);
+}
+
+TEST(KernelTimingGraphTest, WorstPaths)
+{
+	const int num_nodes = 14;
+	for (uint32_t round = 1; round <= 20; round++) {
+		uint32_t seed = round;
+		auto rnd = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+
+		TimingGraph graph;
+		for (int i = 0; i < num_nodes; i++) {
+			graph.add_node();
+			if (rnd() % 3 == 0)
+				graph.set_launch(i, rnd() % 4);
+			if (rnd() % 3 == 0)
+				graph.set_capture(i, rnd() % 4);
+		}
+		for (int i = 0; i < 30; i++) {
+			int a = rnd() % num_nodes, b = rnd() % num_nodes;
+			if (a != b)
+				graph.add_edge(std::min(a, b), std::max(a, b), rnd() % 10);
+		}
+		ASSERT_TRUE(graph.update());
+
+		std::vector<int> expected;
+		for (int i = 0; i < num_nodes; i++)
+			if (graph.launch(i) != TimingGraph::NONE)
+				all_path_times(graph, i, graph.launch(i), expected);
+		std::sort(expected.rbegin(), expected.rend());
+
+		auto paths = graph.worst_paths(10);
+		ASSERT_EQ(GetSize(paths), std::min(10, GetSize(expected)));
+		for (int i = 0; i < GetSize(paths); i++) {
+			auto &path = paths[i];
+			EXPECT_EQ(path.time, expected[i]);
+			ASSERT_EQ(GetSize(path.nodes), GetSize(path.edges) + 1);
+			ASSERT_EQ(GetSize(path.times), GetSize(path.nodes));
+			EXPECT_NE(graph.launch(path.nodes.front()), TimingGraph::NONE);
+			EXPECT_EQ(path.time, path.times.back() + graph.capture(path.nodes.back()));
+			for (int j = 0; j < GetSize(path.edges); j++) {
+				EXPECT_EQ(graph.edge_from(path.edges[j]), path.nodes[j]);
+				EXPECT_EQ(graph.edge_to(path.edges[j]), path.nodes[j+1]);
+			}
+		}
+
+		if (!paths.empty()) {
+			auto &worst = paths.front();
+			auto crit = graph.critical_path(worst.nodes.back());
+			EXPECT_EQ(crit.time, worst.time);
+			EXPECT_GE(graph.arrival(worst.nodes.back()) + graph.departure(worst.nodes.back()), worst.time);
+		}
+	}
+}
+
+YOSYS_NAMESPACE_END
@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+#include "kernel/topo_scc.h"
+
+YOSYS_NAMESPACE_BEGIN
+
+// Random graph made of rings of random length, which are connected by random
+// forward edges (from a lower to a higher ring) so that each ring is a
+// component, plus a few backward edges that merge rings into larger
+// components.
+static CsrGraph random_ring_graph(uint32_t seed, int num_rings, int max_ring, int num_forward, int num_backward)
+{
+	auto rnd = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+
+	std::vector<std::pair<int, int>> edges;
+	std::vector<int> ring_start;
+	int num_nodes = 0;
+	for (int ring = 0; ring < num_rings; ring++) {
+		int size = 1 + rnd() % max_ring;
+		ring_start.push_back(num_nodes);
+		// size 1 rings are single nodes without a self-loop
+		if (size > 1)
+			for (int i = 0; i < size; i++)
+				edges.emplace_back(num_nodes + i, num_nodes + (i + 1) % size);
+		num_nodes += size;
+	}
+	ring_start.push_back(num_nodes);
+
+	auto node_in = [&](int ring) {
+		int size = ring_start[ring + 1] - ring_start[ring];
+		return ring_start[ring] + int(rnd() % size);
+	};
+	for (int i = 0; i < num_forward + num_backward; i++) {
+		int a = rnd() % num_rings, b = rnd() % num_rings;
+		if (a == b)
+			continue;
+		if ((a > b) == (i < num_forward))
+			std::swap(a, b);
+		edges.emplace_back(node_in(a), node_in(b));
+	}
+
+	// shuffle the node numbers
+	std::vector<int> perm(num_nodes);
+	for (int i = 0; i < num_nodes; i++)
+		perm[i] = i;
+	for (int i = num_nodes - 1; i > 0; i--)
+		std::swap(perm[i], perm[rnd() % (i + 1)]);
+	for (auto &edge : edges)
+		edge = {perm[edge.first], perm[edge.second]};
+	return CsrGraph(num_nodes, edges);
+}
+
+static std::vector<int> reference_sccs(CsrGraph &graph)
+{
+	std::vector<int> component(graph.num_nodes(), -1);
+	int num_components = 0;
+	TopoSortedSccs(graph, [&](int *begin, int *end) {
+		for (int *node = begin; node != end; ++node)
+			component[*node] = num_components;
+		num_components++;
+	}).process_all();
+	return component;
+}
+
+// Checks that two component assignments describe the same partition.
+static void expect_same_partition(const std::vector<int> &a, const std::vector<int> &b)
+{
+	ASSERT_EQ(a.size(), b.size());
+	std::map<int, int> a_to_b, b_to_a;
+	for (int i = 0; i < GetSize(a); i++) {
+		auto ra = a_to_b.emplace(a[i], b[i]);
+		EXPECT_EQ(ra.first->second, b[i]) << "node " << i;
+		auto rb = b_to_a.emplace(b[i], a[i]);
+		EXPECT_EQ(rb.first->second, a[i]) << "node " << i;
+	}
+}
+
+TEST(KernelTopoSccTest, ParallelSccsMatchTarjan)
+{
+	struct { int rings, max_ring, forward, backward; } configs[] = {
+		{50, 5, 80, 5},
+		{3000, 8, 6000, 20},
+		{20000, 3, 30000, 0},
+		{500, 200, 1000, 3},
+	};
+	for (auto &config : configs)
+	for (uint32_t seed = 1; seed <= 3; seed++) {
+		CsrGraph graph = random_ring_graph(seed, config.rings, config.max_ring, config.forward, config.backward);
+		std::vector<int> expected = reference_sccs(graph);
+		for (int num_threads : {1, 4}) {
+			std::vector<int> component;
+			int num_components = parallel_sccs(graph, component, num_threads);
+			expect_same_partition(expected, component);
+			EXPECT_EQ(num_components, *std::max_element(expected.begin(), expected.end()) + 1);
+			// components are numbered by their smallest node
+			int next = 0;
+			for (int id : component) {
+				EXPECT_LE(id, next);
+				next = std::max(next, id + 1);
+			}
+		}
+	}
+}
+
+TEST(KernelTopoSccTest, ParallelLevels)
+{
+	// forward edges only, so the graph is acyclic
+	uint32_t seed = 7;
+	auto rnd = [&]() { seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5; return seed; };
+	const int num_nodes = 20000;
+	std::vector<std::pair<int, int>> edges;
+	for (int i = 0; i < 60000; i++) {
+		int a = rnd() % num_nodes, b = rnd() % num_nodes;
+		if (a != b)
+			edges.emplace_back(std::min(a, b), std::max(a, b));
+	}
+	CsrGraph graph(num_nodes, edges);
+
+	std::vector<int> expected(num_nodes, 0);
+	for (int node = 0; node < num_nodes; node++)
+		for (const int *succ = graph.successors_begin(node); succ != graph.successors_end(node); ++succ)
+			expected[*succ] = std::max(expected[*succ], expected[node] + 1);
+
+	for (int num_threads : {1, 4}) {
+		std::vector<int> level;
+		EXPECT_TRUE(parallel_levels(graph, level, num_threads));
+		EXPECT_EQ(level, expected);
+	}
+
+	auto back = edges.front();
+	edges.emplace_back(back.second, back.first);
+	CsrGraph cyclic(num_nodes, edges);
+	std::vector<int> level;
+	EXPECT_FALSE(parallel_levels(cyclic, level, 4));
+	EXPECT_EQ(level[back.first], -1);
+	EXPECT_EQ(level[back.second], -1);
+}
+
+YOSYS_NAMESPACE_END